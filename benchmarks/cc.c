@@ -26,13 +26,16 @@
 typedef uint64_t IP_NEIGHBOUR_COUNT_TYPE;
 typedef IP_VERTEX_ID_TYPE IP_MESSAGE_TYPE;
 typedef IP_VERTEX_ID_TYPE IP_VALUE_TYPE;
+#ifndef IP_USE_PARALLEL_DUMP
+	#define IP_USE_PARALLEL_DUMP
+#endif // ifndef IP_USE_PARALLEL_DUMP
 #include "iPregel.h"
 
 void ip_compute(struct ip_vertex_t* v)
 {
 	if(ip_is_first_superstep())
 	{
-		v->value = v->id;
+		v->value = ip_get_vertex_id(v);
 		ip_broadcast(v, v->value);
 	}
 	else
@@ -62,16 +65,17 @@ void ip_combine(IP_MESSAGE_TYPE* a, IP_MESSAGE_TYPE b)
 	}
 }
 
-void ip_serialise_vertex(FILE* f, struct ip_vertex_t* v)
+size_t ip_serialise_vertex_to_buffer(char* buffer, size_t size, struct ip_vertex_t* v)
 {
-	fprintf(f, "%u: %u\n", v->id, v->value);
+	return snprintf(buffer, size, "%u: %u\n", ip_get_vertex_id(v), v->value);
 }
 
 int main(int argc, char* argv[])
 {
+	ip_parse_dry_run(&argc, argv);
 	if(argc != 6) 
 	{
-		printf("Incorrect number of parameters, expecting: %s <inputFile> <outputFile> <number_of_threads> <schedule> <chunk_size>.\n", argv[0]);
+		printf("Incorrect number of parameters, expecting: %s [--dry-run] <inputFile> <outputFile> <number_of_threads> <schedule> <chunk_size>.\n", argv[0]);
 		return -1;
 	}
 
@@ -92,7 +96,7 @@ int main(int argc, char* argv[])
 	//////////////
 	// DUMPING //
 	////////////
-	FILE* f_out = fopen(argv[2], "wa");
+	FILE* f_out = fopen(argv[2], "w+");
 	if(!f_out)
 	{
 		perror("File opening failed.");
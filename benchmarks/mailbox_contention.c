@@ -0,0 +1,221 @@
+/**
+ * @file mailbox_contention.c
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This benchmark measures how fast messages are delivered to mailboxes
+ * depending on how many threads target the same ones.
+ * @details At the first superstep, every vertex sends a given number of
+ * messages through ip_send_message, to destinations picked according to one of
+ * the following patterns:
+ * - uniform: every vertex is equally likely to be picked.
+ * - zipf: the vertex of identifier i is picked with a probability proportional
+ * to 1 / (i + 1)^s.
+ * - hot: every message goes to vertex 0.
+ * The graph only provides the vertices, its edges are not used. Built with
+ * IP_USE_WIDE_MESSAGE_LOCK, as the makefile does, every message takes the
+ * lock of its destination, so comparing the lock implementations selected by
+ * IP_USE_LOCK_* on the same machine tells which one suits it best.
+ **/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+
+/*
+ * Line commented so that the vertex ID can be set to 4B or 8B ints at compile
+ * time and therefore generate two versions of this binary so that switching
+ * between the two no longer requires a recompilation.
+ * typedef uint64_t IP_VERTEX_ID_TYPE;
+ */
+typedef uint64_t IP_NEIGHBOUR_COUNT_TYPE;
+typedef IP_VERTEX_ID_TYPE IP_MESSAGE_TYPE;
+typedef IP_VERTEX_ID_TYPE IP_VALUE_TYPE;
+#include "iPregel.h"
+
+/// The patterns according to which destinations are picked.
+enum ip_contention_pattern_t
+{
+	IP_CONTENTION_UNIFORM,
+	IP_CONTENTION_ZIPF,
+	IP_CONTENTION_HOT
+};
+/// The pattern used.
+enum ip_contention_pattern_t pattern = IP_CONTENTION_UNIFORM;
+/// The number of messages each vertex sends.
+size_t messages_per_vertex = 0;
+/// The cumulative distribution of destinations in the zipf pattern.
+double* zipf_cdf = NULL;
+
+/**
+ * @brief This function returns the next pseudo-random number of the sequence
+ * whose state is \p state.
+ * @param[inout] state The state of the sequence, updated.
+ * @return A pseudo-random number.
+ **/
+uint64_t next_random(uint64_t* state)
+{
+	// SplitMix64
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/**
+ * @brief This function picks a destination according to the pattern used.
+ * @param[inout] state The state of the pseudo-random sequence of the sender.
+ * @return The identifier of the destination.
+ **/
+IP_VERTEX_ID_TYPE pick_destination(uint64_t* state)
+{
+	switch(pattern)
+	{
+		case IP_CONTENTION_HOT:
+			return 0;
+		case IP_CONTENTION_ZIPF:
+		{
+			double u = (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+			size_t first = 0;
+			size_t last = ip_get_vertices_count() - 1;
+			while(first < last)
+			{
+				size_t middle = first + (last - first) / 2;
+				if(zipf_cdf[middle] < u)
+				{
+					first = middle + 1;
+				}
+				else
+				{
+					last = middle;
+				}
+			}
+			return first;
+		}
+		default:
+			return next_random(state) % ip_get_vertices_count();
+	}
+}
+
+void ip_compute(struct ip_vertex_t* v)
+{
+	if(ip_is_first_superstep())
+	{
+		v->value = ip_get_vertex_id(v);
+		uint64_t state = ip_get_vertex_id(v);
+		for(size_t i = 0; i < messages_per_vertex; i++)
+		{
+			ip_send_message(pick_destination(&state), ip_get_vertex_id(v));
+		}
+	}
+	else
+	{
+		IP_MESSAGE_TYPE message_value;
+		while(ip_get_next_message(v, &message_value))
+		{
+			if(v->value > message_value)
+			{
+				v->value = message_value;
+			}
+		}
+	}
+	ip_vote_to_halt(v);
+}
+
+void ip_combine(IP_MESSAGE_TYPE* a, IP_MESSAGE_TYPE b)
+{
+	if(*a > b)
+	{
+		*a = b;
+	}
+}
+
+void ip_serialise_vertex(FILE* f, struct ip_vertex_t* v)
+{
+	fprintf(f, "%" PRIuMAX ": %" PRIuMAX "\n", (uintmax_t)ip_get_vertex_id(v), (uintmax_t)v->value);
+}
+
+int main(int argc, char* argv[])
+{
+	ip_parse_dry_run(&argc, argv);
+	if(argc != 7 && argc != 8)
+	{
+		printf("Incorrect number of parameters, expecting: %s [--dry-run] <inputFile> <number_of_threads> <schedule> <chunk_size> <uniform|zipf|hot> <messages_per_vertex> [zipf_exponent].\n", argv[0]);
+		return -1;
+	}
+
+	if(strcmp(argv[5], "uniform") == 0)
+	{
+		pattern = IP_CONTENTION_UNIFORM;
+	}
+	else if(strcmp(argv[5], "zipf") == 0)
+	{
+		pattern = IP_CONTENTION_ZIPF;
+	}
+	else if(strcmp(argv[5], "hot") == 0)
+	{
+		pattern = IP_CONTENTION_HOT;
+	}
+	else
+	{
+		printf("Unknown contention pattern \"%s\", expecting uniform, zipf or hot.\n", argv[5]);
+		return -1;
+	}
+	messages_per_vertex = strtoull(argv[6], NULL, 10);
+	double zipf_exponent = (argc == 8) ? atof(argv[7]) : 1.0;
+
+	printf("ApplicationConfiguration:\n");
+
+	////////////////////
+	// INITILISATION //
+	//////////////////
+	bool directed = false;
+	bool weighted = false;
+	ip_init(argv[1], atoi(argv[2]), argv[3], atoi(argv[4]), directed, weighted);
+
+	if(pattern == IP_CONTENTION_ZIPF)
+	{
+		zipf_cdf = (double*)ip_safe_malloc(sizeof(double) * ip_get_vertices_count());
+		double sum = 0.0;
+		for(size_t i = 0; i < ip_get_vertices_count(); i++)
+		{
+			sum += 1.0 / pow((double)(i + 1), zipf_exponent);
+			zipf_cdf[i] = sum;
+		}
+		for(size_t i = 0; i < ip_get_vertices_count(); i++)
+		{
+			zipf_cdf[i] /= sum;
+		}
+	}
+
+	printf("ContentionPattern:%s\n", argv[5]);
+	printf("MessagesPerVertex:%zu\n", messages_per_vertex);
+	if(pattern == IP_CONTENTION_ZIPF)
+	{
+		printf("ZipfExponent:%f\n", zipf_exponent);
+	}
+
+	//////////
+	// RUN //
+	////////
+	double start = omp_get_wtime();
+	ip_run();
+	double duration = omp_get_wtime() - start;
+	size_t message_count = messages_per_vertex * ip_get_vertices_count();
+	printf("MessageCount:%zu\n", message_count);
+	printf("MessagesPerSecond:%f\n", message_count / duration);
+
+	ip_safe_free(zipf_cdf);
+
+	return EXIT_SUCCESS;
+}
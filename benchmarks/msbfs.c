@@ -0,0 +1,258 @@
+/**
+ * @file msbfs.c
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This benchmark runs breadth-first searches from several sources in a
+ * single traversal.
+ * @details Each vertex holds a bitset whose bit i tells whether the search
+ * from the i-th source has reached it. Messages are bitsets too, combined with
+ * a bitwise or, so a vertex reached by several searches at the same superstep
+ * receives one message and broadcasts once for all of them: the cost of
+ * traversing the graph is shared by all searches. Bitsets are made of
+ * MSBFS_WORD_COUNT words of 64 bits, 1 by default, and loops over their words
+ * are left to the compiler to vectorise. Bitsets of more than 8 bytes need
+ * IP_USE_WIDE_MESSAGE_LOCK in the versions that push messages.
+ * For every search, the number of vertices reached, the sum of their distances
+ * to the source and the largest of these distances are printed, which gives
+ * closeness centralities and eccentricities. The file dumped contains the
+ * bitset of every vertex, in hexadecimal, most significant word first.
+ **/
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+/// The number of 64-bit words in a bitset.
+#ifndef MSBFS_WORD_COUNT
+	#define MSBFS_WORD_COUNT 1
+#endif // ifndef MSBFS_WORD_COUNT
+/// The maximum number of searches run together.
+#define MSBFS_QUERY_COUNT (MSBFS_WORD_COUNT * 64)
+
+/// This structure holds one bit per search.
+struct msbfs_bitset_t
+{
+	/// The words of the bitset, bit i of word w standing for search w * 64 + i.
+	uint64_t words[MSBFS_WORD_COUNT];
+};
+
+/*
+ * Line commented so that the vertex ID can be set to 4B or 8B ints at compile
+ * time and therefore generate two versions of this binary so that switching
+ * between the two no longer requires a recompilation.
+ * typedef uint64_t IP_VERTEX_ID_TYPE;
+ */
+typedef uint64_t IP_NEIGHBOUR_COUNT_TYPE;
+typedef struct msbfs_bitset_t IP_MESSAGE_TYPE;
+typedef struct msbfs_bitset_t IP_VALUE_TYPE;
+#ifndef IP_USE_PARALLEL_DUMP
+	#define IP_USE_PARALLEL_DUMP
+#endif // ifndef IP_USE_PARALLEL_DUMP
+#include "iPregel.h"
+
+/// This structure holds the results a thread gathered for every search, alone on its cache lines.
+struct msbfs_thread_results_t
+{
+	/// The number of vertices reached by each search.
+	_Alignas(IP_CACHE_LINE_SIZE) size_t reached[MSBFS_QUERY_COUNT];
+	/// The sum of the distances of the vertices reached by each search.
+	size_t distance_sum[MSBFS_QUERY_COUNT];
+	/// The largest distance of a vertex reached by each search.
+	size_t eccentricity[MSBFS_QUERY_COUNT];
+};
+/// The results of all threads.
+struct msbfs_thread_results_t* all_thread_results = NULL;
+/// The number of searches run.
+size_t query_count = 0;
+/// The source of each search.
+IP_VERTEX_ID_TYPE sources[MSBFS_QUERY_COUNT];
+
+/**
+ * @brief This function records that the searches whose bits are set in \p
+ * reached arrived at a vertex during the current superstep.
+ * @param[in] reached The searches that reached the vertex for the first time.
+ **/
+void record_reached(const struct msbfs_bitset_t* reached)
+{
+	struct msbfs_thread_results_t* results = &all_thread_results[omp_get_thread_num()];
+	size_t distance = ip_get_superstep();
+	for(size_t w = 0; w < MSBFS_WORD_COUNT; w++)
+	{
+		uint64_t bits = reached->words[w];
+		while(bits != 0)
+		{
+			size_t query = w * 64 + __builtin_ctzll(bits);
+			bits &= bits - 1;
+			results->reached[query]++;
+			results->distance_sum[query] += distance;
+			// Supersteps only go forward, so the latest distance is the largest.
+			results->eccentricity[query] = distance;
+		}
+	}
+}
+
+void ip_compute(struct ip_vertex_t* v)
+{
+	if(ip_is_first_superstep())
+	{
+		// Sources had their bits set before the run, other vertices have nothing to do.
+		bool is_source = false;
+		for(size_t w = 0; w < MSBFS_WORD_COUNT; w++)
+		{
+			is_source |= v->value.words[w] != 0;
+		}
+		if(is_source)
+		{
+			record_reached(&v->value);
+			ip_broadcast(v, v->value);
+		}
+	}
+	else
+	{
+		IP_MESSAGE_TYPE m;
+		if(ip_get_next_message(v, &m))
+		{
+			// With a combiner there is one message at most, holding every search that reached a neighbour.
+			struct msbfs_bitset_t reached;
+			uint64_t any = 0;
+			for(size_t w = 0; w < MSBFS_WORD_COUNT; w++)
+			{
+				reached.words[w] = m.words[w] & ~v->value.words[w];
+				v->value.words[w] |= reached.words[w];
+				any |= reached.words[w];
+			}
+			if(any != 0)
+			{
+				record_reached(&reached);
+				ip_broadcast(v, reached);
+			}
+		}
+	}
+
+	ip_vote_to_halt(v);
+}
+
+void ip_combine(IP_MESSAGE_TYPE* a, IP_MESSAGE_TYPE b)
+{
+	for(size_t w = 0; w < MSBFS_WORD_COUNT; w++)
+	{
+		a->words[w] |= b.words[w];
+	}
+}
+
+size_t ip_serialise_vertex_to_buffer(char* buffer, size_t size, struct ip_vertex_t* v)
+{
+	char bitset[MSBFS_WORD_COUNT * 16 + 1];
+	for(size_t w = MSBFS_WORD_COUNT; w > 0; w--)
+	{
+		snprintf(&bitset[(MSBFS_WORD_COUNT - w) * 16], 17, "%016" PRIx64, v->value.words[w - 1]);
+	}
+	return snprintf(buffer, size, "%" PRIuMAX ": %s\n", (uintmax_t)ip_get_vertex_id(v), bitset);
+}
+
+int main(int argc, char* argv[])
+{
+	ip_parse_dry_run(&argc, argv);
+	if(argc < 7 || argc - 6 > MSBFS_QUERY_COUNT)
+	{
+		printf("Incorrect number of parameters, expecting: %s [--dry-run] <inputFile> <outputFile> <number_of_threads> <schedule> <chunk_size> <source_vertex_1> [... <source_vertex_%d>].\n", argv[0], MSBFS_QUERY_COUNT);
+		return -1;
+	}
+
+	query_count = argc - 6;
+	printf("ApplicationConfiguration:queryCount=%zu\n", query_count);
+
+	////////////////////
+	// INITILISATION //
+	//////////////////
+	bool directed = false;
+	bool weighted = false;
+	ip_init(argv[1], atoi(argv[3]), argv[4], atoi(argv[5]), directed, weighted);
+
+	all_thread_results = (struct msbfs_thread_results_t*)aligned_alloc(IP_CACHE_LINE_SIZE, sizeof(struct msbfs_thread_results_t) * ip_thread_count);
+	if(all_thread_results == NULL)
+	{
+		printf("Failed to allocate the results of the threads.\n");
+		return -1;
+	}
+	memset(all_thread_results, 0, sizeof(struct msbfs_thread_results_t) * ip_thread_count);
+
+	struct msbfs_bitset_t empty;
+	memset(&empty, 0, sizeof(struct msbfs_bitset_t));
+	ip_set_initial_value(empty);
+	IP_VERTEX_ID_TYPE seeds[MSBFS_QUERY_COUNT];
+	size_t seed_count = 0;
+	// Identifiers may start at an offset, in which case they are not locations.
+	IP_VERTEX_ID_TYPE first_id = ip_get_vertex_id(ip_get_vertex_by_location(0));
+	for(size_t i = 0; i < query_count; i++)
+	{
+		sources[i] = atoi(argv[6 + i]);
+		if(sources[i] < first_id || sources[i] - first_id >= ip_get_vertices_count())
+		{
+			printf("Source vertex %" PRIuMAX " does not exist.\n", (uintmax_t)sources[i]);
+			return -1;
+		}
+		struct ip_vertex_t* source = ip_get_vertex_by_id(sources[i]);
+		bool already_seeded = false;
+		for(size_t w = 0; w < MSBFS_WORD_COUNT; w++)
+		{
+			already_seeded |= source->value.words[w] != 0;
+		}
+		if(!already_seeded)
+		{
+			seeds[seed_count] = sources[i];
+			seed_count++;
+		}
+		source->value.words[i / 64] |= UINT64_C(1) << (i % 64);
+	}
+	ip_set_initial_frontier(seeds, seed_count);
+
+	//////////
+	// RUN //
+	////////
+	ip_run();
+
+	////////////////////
+	// QUERY RESULTS //
+	//////////////////
+	for(size_t i = 0; i < query_count; i++)
+	{
+		size_t reached = 0;
+		size_t distance_sum = 0;
+		size_t eccentricity = 0;
+		for(int j = 0; j < ip_thread_count; j++)
+		{
+			reached += all_thread_results[j].reached[i];
+			distance_sum += all_thread_results[j].distance_sum[i];
+			if(eccentricity < all_thread_results[j].eccentricity[i])
+			{
+				eccentricity = all_thread_results[j].eccentricity[i];
+			}
+		}
+		printf("Query%zu:source=%" PRIuMAX ",reached=%zu,distanceSum=%zu,eccentricity=%zu,closeness=%f\n", i, (uintmax_t)sources[i], reached, distance_sum, eccentricity, distance_sum > 0 ? (double)(reached - 1) / distance_sum : 0.0);
+	}
+	free(all_thread_results);
+
+	//////////////
+	// DUMPING //
+	////////////
+	FILE* f_out = fopen(argv[2], "wa");
+	if(!f_out)
+	{
+		perror("File opening failed.");
+		return -1;
+	}
+	ip_dump(f_out);
+
+	return 0;
+}
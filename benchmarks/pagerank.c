@@ -27,11 +27,25 @@ typedef uint64_t IP_NEIGHBOUR_COUNT_TYPE;
 typedef double IP_MESSAGE_TYPE;
 typedef IP_MESSAGE_TYPE IP_VALUE_TYPE;
 #define IP_NEEDS_OUT_NEIGHBOUR_COUNT
+#define IP_NEEDS_MASTER_COMPUTE
+#ifndef IP_USE_PARALLEL_DUMP
+	#define IP_USE_PARALLEL_DUMP
+#endif // ifndef IP_USE_PARALLEL_DUMP
 #include "iPregel.h"
 
 double ratio;
 double initial_value;
+/// The maximum number of supersteps, reached if the tolerance is never met.
 const unsigned int ROUND = 10;
+/// The L1 norm of the rank changes below which the computation stops.
+double tolerance = 0.0;
+/// The aggregator summing the absolute rank changes of a superstep.
+size_t delta_aggregator;
+
+void ip_sum_double(void* accumulator, const void* value)
+{
+	*(double*)accumulator += *(const double*)value;
+}
 
 void ip_compute(struct ip_vertex_t* v)
 {
@@ -49,14 +63,16 @@ void ip_compute(struct ip_vertex_t* v)
 		}
 
 		value_temp = ratio + 0.85 * sum;
+		double delta = value_temp > v->value ? value_temp - v->value : v->value - value_temp;
+		ip_aggregate(delta_aggregator, &delta);
 		v->value = value_temp;
 	}
 
 	if(ip_get_superstep() < ROUND)
 	{
-		if(v->out_neighbour_count > 0)
+		if(ip_get_out_neighbour_count(v) > 0)
 		{
-			ip_broadcast(v, v->value / v->out_neighbour_count);
+			ip_broadcast(v, v->value / ip_get_out_neighbour_count(v));
 		}
 	}
 	else
@@ -65,25 +81,65 @@ void ip_compute(struct ip_vertex_t* v)
 	}
 }
 
+void ip_master_compute()
+{
+	// The first delta is only available once superstep 1 is over.
+	if(ip_get_superstep() > 1)
+	{
+		double delta;
+		ip_get_aggregated_value(delta_aggregator, &delta);
+		printf("Superstep%zuDelta:%.20f\n", ip_get_superstep() - 1, delta);
+		if(delta < tolerance)
+		{
+			ip_halt_computation();
+		}
+	}
+}
+
 void ip_combine(IP_MESSAGE_TYPE* a, IP_MESSAGE_TYPE b)
 {
 	*a += b;
 }
 
-void ip_serialise_vertex(FILE* f, struct ip_vertex_t* v)
+size_t ip_serialise_vertex_to_buffer(char* buffer, size_t size, struct ip_vertex_t* v)
+{
+	return snprintf(buffer, size, "%lu: %0.20f\n", ip_get_vertex_id(v), v->value);
+}
+
+/**
+ * @brief This function ranks higher PageRank values first.
+ * @param[in] a The first value.
+ * @param[in] b The second value.
+ * @retval true \p a is higher than \p b.
+ * @retval false \p a is lower than or equal to \p b.
+ **/
+bool ranks_higher(const IP_VALUE_TYPE* a, const IP_VALUE_TYPE* b)
 {
-	fprintf(f, "%lu: %0.20f\n", v->id, v->value);
+	return *a > *b;
 }
 
 int main(int argc, char* argv[])
 {
-	if(argc != 6) 
+	ip_parse_dry_run(&argc, argv);
+	if(argc < 6 || argc > 8) 
 	{
-		printf("Incorrect number of parameters, expecting: %s <inputFile> <outputFile> <number_of_threads> <schedule> <chunk_size>.\n", argv[0]);
+		printf("Incorrect number of parameters, expecting: %s [--dry-run] <inputFile> <outputFile> <number_of_threads> <schedule> <chunk_size> [tolerance] [top_k].\n", argv[0]);
 		return -1;
 	}
 
-	printf("ApplicationConfiguration:maxSuperstepCount=10\n");
+	if(argc >= 7)
+	{
+		tolerance = atof(argv[6]);
+	}
+	// The number of vertices with the highest ranks to dump, all of them if 0.
+	size_t top_k = 0;
+	if(argc == 8)
+	{
+		top_k = strtoull(argv[7], NULL, 10);
+	}
+	printf("ApplicationConfiguration:maxSuperstepCount=%u\n", ROUND);
+	printf("ApplicationConfiguration:tolerance=%g\n", tolerance);
+	printf("ApplicationConfiguration:topK=%zu\n", top_k);
 
 	////////////////////
 	// INITILISATION //
@@ -91,6 +147,8 @@ int main(int argc, char* argv[])
 	bool directed = false;
 	bool weighted = false;
 	ip_init(argv[1], atoi(argv[3]), argv[4], atoi(argv[5]), directed, weighted);
+	double zero = 0.0;
+	delta_aggregator = ip_register_aggregator(sizeof(double), &zero, ip_sum_double);
 
 	//////////
 	// RUN //
@@ -102,13 +160,20 @@ int main(int argc, char* argv[])
 	//////////////
 	// DUMPING //
 	////////////
-	FILE* f_out = fopen(argv[2], "wa");
+	FILE* f_out = fopen(argv[2], "w+");
 	if(!f_out)
 	{
 		perror("File opening failed.");
 		return -1;
 	}
-	ip_dump(f_out);
+	if(top_k > 0)
+	{
+		ip_dump_top_k(f_out, top_k, ranks_higher);
+	}
+	else
+	{
+		ip_dump(f_out);
+	}
 
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,530 @@
+/**
+ * @file server.c
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This application loads a graph once and then runs the jobs it is
+ * sent on it, one after the other.
+ * @details Jobs are read one per line, from the standard input or, if a path
+ * is given, from the clients connecting to a UNIX socket created at that path.
+ * A job is written as follows:
+ * <algorithm> <outputFile> [parameters...]
+ * where the algorithms available, and their parameters, are:
+ * - cc: connected components, without parameters.
+ * - sssp <source_vertex>: single-source shortest paths, in number of hops.
+ * The line "quit" stops the server. With IP_USE_DYNAMIC_GRAPH, two more jobs
+ * are available:
+ * - insert <edgeFile>: inserts the edges listed in the file, one
+ * "<source> <destination>" pair per line.
+ * - increment <outputFile>: runs the algorithm of the previous job again,
+ * with the same parameters, from the values it left and from the sources of
+ * the edges inserted since.
+ * Every job is answered with a line
+ * starting with "OK", followed by the time the job took, or with "ERROR",
+ * followed by the reason. Between two jobs, ip_reset() brings the vertices
+ * back to their initial state, so the graph is never reloaded.
+ * Since iPregel is compiled for a given message and value type, the
+ * algorithms gathered in a server share them; each algorithm is a kernel,
+ * registered in all_kernels, to which ip_compute() and ip_combine() dispatch.
+ **/
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+ * Line commented so that the vertex ID can be set to 4B or 8B ints at compile
+ * time and therefore generate two versions of this binary so that switching
+ * between the two no longer requires a recompilation.
+ * typedef uint64_t IP_VERTEX_ID_TYPE;
+ */
+typedef uint64_t IP_NEIGHBOUR_COUNT_TYPE;
+typedef IP_VERTEX_ID_TYPE IP_MESSAGE_TYPE;
+typedef IP_VERTEX_ID_TYPE IP_VALUE_TYPE;
+#ifndef IP_USE_PARALLEL_DUMP
+	#define IP_USE_PARALLEL_DUMP
+#endif // ifndef IP_USE_PARALLEL_DUMP
+#include "iPregel.h"
+
+/// The maximum length of a job line.
+#define SERVER_LINE_LENGTH 4096
+/// The maximum number of parameters of a job.
+#define SERVER_MAX_PARAMETER_COUNT 8
+
+/// This structure describes an algorithm the server can run.
+struct kernel_t
+{
+	/// The name by which jobs refer to the algorithm.
+	const char* name;
+	/// The number of parameters the algorithm expects after the output file.
+	int parameter_count;
+	/**
+	 * Prepares a run once vertices are reset, from the parameters of the
+	 * job. It returns false, after writing the reason in its second argument,
+	 * if the parameters are invalid.
+	 **/
+	bool (*prepare)(char** parameters, char* error);
+	/// The compute function of the algorithm.
+	void (*compute)(struct ip_vertex_t* v);
+	/// The combine function of the algorithm.
+	void (*combine)(IP_MESSAGE_TYPE* a, IP_MESSAGE_TYPE b);
+};
+
+/// The kernel of the job being run.
+const struct kernel_t* current_kernel = NULL;
+/// The source vertex of the current SSSP job.
+IP_VERTEX_ID_TYPE start_vertex;
+
+/**
+ * @brief This function tells whether the job being run starts from the values
+ * left by the previous one.
+ * @retval true The job is an increment, the first superstep must broadcast
+ * the values of vertices instead of initialising them.
+ * @retval false The job starts from scratch.
+ **/
+bool is_incremental_job()
+{
+	#ifdef IP_USE_DYNAMIC_GRAPH
+		return ip_is_incremental_run();
+	#else
+		return false;
+	#endif // if(n)def IP_USE_DYNAMIC_GRAPH
+}
+
+void combine_min(IP_MESSAGE_TYPE* a, IP_MESSAGE_TYPE b)
+{
+	if(*a > b)
+	{
+		*a = b;
+	}
+}
+
+bool cc_prepare(char** parameters, char* error)
+{
+	(void)(parameters);
+	(void)(error);
+	return true;
+}
+
+void cc_compute(struct ip_vertex_t* v)
+{
+	if(ip_is_first_superstep())
+	{
+		if(!is_incremental_job())
+		{
+			v->value = ip_get_vertex_id(v);
+		}
+		ip_broadcast(v, v->value);
+	}
+	else
+	{
+		IP_MESSAGE_TYPE valueTemp = v->value;
+		IP_MESSAGE_TYPE message_value;
+		while(ip_get_next_message(v, &message_value))
+		{
+			if(v->value > message_value)
+			{
+				v->value = message_value;
+			}
+		}
+		if(valueTemp != v->value)
+		{
+			ip_broadcast(v, v->value);
+		}
+	}
+	ip_vote_to_halt(v);
+}
+
+bool sssp_prepare(char** parameters, char* error)
+{
+	char* end = NULL;
+	unsigned long long source = strtoull(parameters[0], &end, 10);
+	if(*end != '\0' || source >= ip_get_vertices_count())
+	{
+		snprintf(error, SERVER_LINE_LENGTH, "source vertex %s does not exist", parameters[0]);
+		return false;
+	}
+	start_vertex = source;
+	ip_set_initial_value(UINT_MAX);
+	ip_set_initial_frontier(&start_vertex, 1);
+	return true;
+}
+
+void sssp_compute(struct ip_vertex_t* v)
+{
+	if(ip_is_first_superstep() && is_incremental_job())
+	{
+		if(v->value != UINT_MAX)
+		{
+			ip_broadcast(v, v->value + 1);
+		}
+	}
+	else if(ip_is_first_superstep())
+	{
+		if(ip_get_vertex_id(v) == start_vertex)
+		{
+			v->value = 0;
+			ip_broadcast(v, v->value + 1);
+		}
+		else
+		{
+			v->value = UINT_MAX;
+		}
+	}
+	else
+	{
+		IP_MESSAGE_TYPE m_initial = UINT_MAX;
+		IP_MESSAGE_TYPE m;
+		while(ip_get_next_message(v, &m))
+		{
+			if(m_initial > m)
+			{
+				m_initial = m;
+			}
+		}
+		if(m_initial < v->value)
+		{
+			v->value = m_initial;
+			ip_broadcast(v, m_initial + 1);
+		}
+	}
+	ip_vote_to_halt(v);
+}
+
+/// The algorithms the server can run.
+const struct kernel_t all_kernels[] =
+{
+	{ "cc", 0, cc_prepare, cc_compute, combine_min },
+	{ "sssp", 1, sssp_prepare, sssp_compute, combine_min }
+};
+
+void ip_compute(struct ip_vertex_t* v)
+{
+	current_kernel->compute(v);
+}
+
+void ip_combine(IP_MESSAGE_TYPE* a, IP_MESSAGE_TYPE b)
+{
+	current_kernel->combine(a, b);
+}
+
+size_t ip_serialise_vertex_to_buffer(char* buffer, size_t size, struct ip_vertex_t* v)
+{
+	return snprintf(buffer, size, "%" PRIuMAX ": %" PRIuMAX "\n", (uintmax_t)ip_get_vertex_id(v), (uintmax_t)v->value);
+}
+
+/**
+ * @brief This function runs iPregel, incrementally or not, and dumps the
+ * values of vertices in the file \p output_path.
+ * @param[in] incremental Tells whether to run with ip_run_incremental().
+ * @param[in] output_path The path of the file to dump into.
+ * @param[out] error The reason of the failure, if any.
+ * @retval true The run and the dump succeeded.
+ * @retval false The output file could not be opened.
+ **/
+bool run_and_dump(bool incremental, const char* output_path, char* error)
+{
+	#ifdef IP_USE_DYNAMIC_GRAPH
+		if(incremental)
+		{
+			ip_run_incremental();
+		}
+		else
+		{
+			ip_run();
+		}
+	#else
+		(void)(incremental);
+		ip_run();
+	#endif // if(n)def IP_USE_DYNAMIC_GRAPH
+	FILE* f_out = fopen(output_path, "w");
+	if(!f_out)
+	{
+		snprintf(error, SERVER_LINE_LENGTH, "cannot open %s", output_path);
+		return false;
+	}
+	ip_dump(f_out);
+	fclose(f_out);
+	return true;
+}
+
+#ifdef IP_USE_DYNAMIC_GRAPH
+/**
+ * @brief This function inserts the edges listed in the file \p path, one
+ * "<source> <destination>" pair per line.
+ * @param[in] path The path of the file listing the edges.
+ * @param[out] error The reason of the failure, if any.
+ * @retval true The edges have been inserted.
+ * @retval false The file could not be read or names a vertex that does not
+ * exist; no edge has been inserted.
+ **/
+bool insert_edges_from_file(const char* path, char* error)
+{
+	FILE* f = fopen(path, "r");
+	if(!f)
+	{
+		snprintf(error, SERVER_LINE_LENGTH, "cannot open %s", path);
+		return false;
+	}
+	size_t capacity = 1024;
+	size_t count = 0;
+	IP_VERTEX_ID_TYPE* sources = (IP_VERTEX_ID_TYPE*)ip_safe_malloc(sizeof(IP_VERTEX_ID_TYPE) * capacity);
+	IP_VERTEX_ID_TYPE* destinations = (IP_VERTEX_ID_TYPE*)ip_safe_malloc(sizeof(IP_VERTEX_ID_TYPE) * capacity);
+	unsigned long long source;
+	unsigned long long destination;
+	bool valid = true;
+	while(valid && fscanf(f, "%llu %llu", &source, &destination) == 2)
+	{
+		if(source >= ip_get_vertices_count() || destination >= ip_get_vertices_count())
+		{
+			snprintf(error, SERVER_LINE_LENGTH, "edge %llu %llu names a vertex that does not exist", source, destination);
+			valid = false;
+		}
+		else
+		{
+			if(count == capacity)
+			{
+				capacity *= 2;
+				sources = (IP_VERTEX_ID_TYPE*)ip_safe_realloc(sources, sizeof(IP_VERTEX_ID_TYPE) * capacity);
+				destinations = (IP_VERTEX_ID_TYPE*)ip_safe_realloc(destinations, sizeof(IP_VERTEX_ID_TYPE) * capacity);
+			}
+			sources[count] = source;
+			destinations[count] = destination;
+			count++;
+		}
+	}
+	fclose(f);
+	if(valid)
+	{
+		ip_insert_edges(sources, destinations, count);
+	}
+	ip_safe_free(sources);
+	ip_safe_free(destinations);
+	return valid;
+}
+#endif // ifdef IP_USE_DYNAMIC_GRAPH
+
+/**
+ * @brief This function runs the job described by \p line and writes its
+ * answer in \p reply.
+ * @param[inout] line The job, which is split into words in place.
+ * @param[in] reply The file in which to write the answer.
+ * @retval true The server must wait for the next job.
+ * @retval false The job asked the server to stop.
+ **/
+bool run_job(char* line, FILE* reply)
+{
+	static size_t job_count = 0;
+	char error[SERVER_LINE_LENGTH];
+	char* words[SERVER_MAX_PARAMETER_COUNT + 2];
+	int word_count = 0;
+	char* saveptr = NULL;
+	for(char* word = strtok_r(line, " \t\r\n", &saveptr); word != NULL; word = strtok_r(NULL, " \t\r\n", &saveptr))
+	{
+		if(word_count == SERVER_MAX_PARAMETER_COUNT + 2)
+		{
+			fprintf(reply, "ERROR too many parameters\n");
+			fflush(reply);
+			return true;
+		}
+		words[word_count] = word;
+		word_count++;
+	}
+	if(word_count == 0)
+	{
+		return true;
+	}
+	if(strcmp(words[0], "quit") == 0)
+	{
+		fprintf(reply, "OK\n");
+		fflush(reply);
+		return false;
+	}
+
+	#ifdef IP_USE_DYNAMIC_GRAPH
+		if(strcmp(words[0], "insert") == 0 || strcmp(words[0], "increment") == 0)
+		{
+			if(word_count != 2)
+			{
+				fprintf(reply, "ERROR %s expects a file\n", words[0]);
+				fflush(reply);
+				return true;
+			}
+			bool inserting = strcmp(words[0], "insert") == 0;
+			if(!inserting && current_kernel == NULL)
+			{
+				fprintf(reply, "ERROR there is no previous job to increment\n");
+				fflush(reply);
+				return true;
+			}
+			job_count++;
+			printf("Job%zu:%s\n", job_count, inserting ? "insert" : current_kernel->name);
+			double timer_job_start = omp_get_wtime();
+			bool success = inserting ? insert_edges_from_file(words[1], error) : run_and_dump(true, words[1], error);
+			double timer_job_stop = omp_get_wtime();
+			if(!success)
+			{
+				fprintf(reply, "ERROR %s\n", error);
+				fflush(reply);
+				return true;
+			}
+			printf("Job%zuTime:%f\n", job_count, timer_job_stop - timer_job_start);
+			fprintf(reply, "OK %f\n", timer_job_stop - timer_job_start);
+			fflush(reply);
+			return true;
+		}
+	#endif // ifdef IP_USE_DYNAMIC_GRAPH
+
+	const struct kernel_t* kernel = NULL;
+	for(size_t i = 0; i < sizeof(all_kernels) / sizeof(all_kernels[0]); i++)
+	{
+		if(strcmp(words[0], all_kernels[i].name) == 0)
+		{
+			kernel = &all_kernels[i];
+		}
+	}
+	if(kernel == NULL)
+	{
+		fprintf(reply, "ERROR unknown algorithm %s\n", words[0]);
+		fflush(reply);
+		return true;
+	}
+	if(word_count != kernel->parameter_count + 2)
+	{
+		fprintf(reply, "ERROR %s expects an output file and %d parameters\n", kernel->name, kernel->parameter_count);
+		fflush(reply);
+		return true;
+	}
+
+	job_count++;
+	printf("Job%zu:%s\n", job_count, kernel->name);
+	double timer_job_start = omp_get_wtime();
+	ip_reset();
+	if(!kernel->prepare(&words[2], error))
+	{
+		fprintf(reply, "ERROR %s\n", error);
+		fflush(reply);
+		return true;
+	}
+	// Set only once the job is valid, so that an increment never runs on the values of another algorithm.
+	current_kernel = kernel;
+	if(!run_and_dump(false, words[1], error))
+	{
+		fprintf(reply, "ERROR %s\n", error);
+		fflush(reply);
+		return true;
+	}
+	double timer_job_stop = omp_get_wtime();
+	printf("Job%zuTime:%f\n", job_count, timer_job_stop - timer_job_start);
+	fprintf(reply, "OK %f\n", timer_job_stop - timer_job_start);
+	fflush(reply);
+	return true;
+}
+
+/**
+ * @brief This function runs the jobs sent by the clients of a UNIX socket
+ * until one of them sends "quit".
+ * @param[in] path The path at which to create the socket.
+ * @return The exit code of the server.
+ **/
+int serve_socket(const char* path)
+{
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(struct sockaddr_un));
+	address.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(address.sun_path))
+	{
+		printf("The socket path %s is too long.\n", path);
+		return -1;
+	}
+	strcpy(address.sun_path, path);
+
+	int listening_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listening_socket == -1)
+	{
+		perror("Socket creation failed.");
+		return -1;
+	}
+	unlink(path);
+	if(bind(listening_socket, (struct sockaddr*)&address, sizeof(struct sockaddr_un)) == -1 || listen(listening_socket, SOMAXCONN) == -1)
+	{
+		perror("Socket binding failed.");
+		close(listening_socket);
+		return -1;
+	}
+	printf("ServerSocket:%s\n", path);
+	fflush(stdout);
+
+	char line[SERVER_LINE_LENGTH];
+	bool running = true;
+	while(running)
+	{
+		int client = accept(listening_socket, NULL, NULL);
+		if(client == -1)
+		{
+			perror("Socket accept failed.");
+			continue;
+		}
+		FILE* requests = fdopen(client, "r");
+		FILE* replies = fdopen(dup(client), "w");
+		while(running && fgets(line, SERVER_LINE_LENGTH, requests) != NULL)
+		{
+			running = run_job(line, replies);
+		}
+		fclose(replies);
+		fclose(requests);
+	}
+
+	close(listening_socket);
+	unlink(path);
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	ip_parse_dry_run(&argc, argv);
+	if(argc != 5 && argc != 6)
+	{
+		printf("Incorrect number of parameters, expecting: %s [--dry-run] <inputFile> <number_of_threads> <schedule> <chunk_size> [socket_path].\n", argv[0]);
+		return -1;
+	}
+
+	printf("ApplicationConfiguration:\n");
+
+	////////////////////
+	// INITILISATION //
+	//////////////////
+	bool directed = false;
+	bool weighted = false;
+	ip_init(argv[1], atoi(argv[2]), argv[3], atoi(argv[4]), directed, weighted);
+
+	////////////
+	// SERVE //
+	//////////
+	if(argc == 6)
+	{
+		return serve_socket(argv[5]);
+	}
+
+	char line[SERVER_LINE_LENGTH];
+	bool running = true;
+	while(running && fgets(line, SERVER_LINE_LENGTH, stdin) != NULL)
+	{
+		running = run_job(line, stdout);
+	}
+
+	return 0;
+}
@@ -28,6 +28,9 @@
 typedef uint64_t IP_NEIGHBOUR_COUNT_TYPE;
 typedef IP_VERTEX_ID_TYPE IP_MESSAGE_TYPE;
 typedef IP_VERTEX_ID_TYPE IP_VALUE_TYPE;
+#ifndef IP_USE_PARALLEL_DUMP
+	#define IP_USE_PARALLEL_DUMP
+#endif // ifndef IP_USE_PARALLEL_DUMP
 #include "iPregel.h"
 // For reference DBLP, start_vertex=0
 // For reference liveJournal, start_vertex=0
@@ -39,7 +42,7 @@ void ip_compute(struct ip_vertex_t* v)
 {
 	if(ip_is_first_superstep())
 	{
-		if(v->id == start_vertex)
+		if(ip_get_vertex_id(v) == start_vertex)
 		{
 			v->value = 0;
 			ip_broadcast(v, v->value + 1);
@@ -78,28 +81,32 @@ void ip_combine(IP_MESSAGE_TYPE* a, IP_MESSAGE_TYPE b)
 	}
 }
 
-void ip_serialise_vertex(FILE* f, struct ip_vertex_t* v)
+size_t ip_serialise_vertex_to_buffer(char* buffer, size_t size, struct ip_vertex_t* v)
 {
-	fprintf(f, "%u: %u\n", v->id, v->value);
+	return snprintf(buffer, size, "%u: %u\n", ip_get_vertex_id(v), v->value);
 }
 
 int main(int argc, char* argv[])
 {
+	ip_parse_dry_run(&argc, argv);
 	if(argc != 7) 
 	{
-		printf("Incorrect number of parameters, expecting: %s <inputFile> <outputFile> <number_of_threads> <schedule> <chunk_size> <SSSP_source_vertex>.\n", argv[0]);
+		printf("Incorrect number of parameters, expecting: %s [--dry-run] <inputFile> <outputFile> <number_of_threads> <schedule> <chunk_size> <SSSP_source_vertex>.\n", argv[0]);
 		return -1;
 	}
 
-	printf("ApplicationConfiguration:startVertex=%u\n", atoi(argv[4]));
+	printf("ApplicationConfiguration:startVertex=%u\n", atoi(argv[6]));
 
 	////////////////////
 	// INITILISATION //
 	//////////////////
 	bool directed = false;
 	bool weighted = false;
-	start_vertex = atoi(argv[4]);
+	start_vertex = atoi(argv[6]);
 	ip_init(argv[1], atoi(argv[3]), argv[4], atoi(argv[5]), directed, weighted);
+	// Only the source has something to do in the first superstep, the other vertices start unreached.
+	ip_set_initial_value(UINT_MAX);
+	ip_set_initial_frontier(&start_vertex, 1);
 
 	//////////
 	// RUN //
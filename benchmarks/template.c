@@ -25,7 +25,7 @@ void ip_combine(IP_MESSAGE_TYPE* old, IP_MESSAGE_TYPE new)
 void ip_serialise_vertex(FILE* f, struct ip_vertex_t* v)
 {
 	// Write the information you want about that vertex to the file
-	// Ex: fwrite(&v->id, sizeof(IP_VERTEX_ID_TYPE), 1, f);
+	// Ex: IP_VERTEX_ID_TYPE id = ip_get_vertex_id(v); fwrite(&id, sizeof(IP_VERTEX_ID_TYPE), 1, f);
 	// Ex: fwrite(&v->value, sizeof(IP_MESSAGE_TYPE), 1, f);
 }
 
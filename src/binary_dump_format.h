@@ -0,0 +1,69 @@
+/**
+ * @file binary_dump_format.h
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This file describes the layout of the files written by ip_dump()
+ * with IP_USE_BINARY_DUMP.
+ * @details A binary dump is a header, described by
+ * struct ip_binary_dump_header_t, followed by the value of every vertex, in
+ * identifier order, as stored in memory: the value of the vertex whose
+ * identifier is first_id + i starts value_size * i bytes after the header.
+ * Numbers are in the byte order of the machine that wrote the file. The
+ * header takes 64 bytes, so values stay aligned when the file is mapped in
+ * memory. This file is included by both iPregel and the converters reading
+ * binary dumps, so it depends on nothing else.
+ **/
+
+#ifndef BINARY_DUMP_FORMAT_H_INCLUDED
+#define BINARY_DUMP_FORMAT_H_INCLUDED
+
+#include <stdint.h>
+
+/// The first 4 bytes of a binary dump.
+#define IP_BINARY_DUMP_MAGIC "IPRB"
+/// The version of the layout described here.
+#define IP_BINARY_DUMP_VERSION 1
+/// The kind of values that are unsigned integers.
+#define IP_BINARY_DUMP_KIND_UNSIGNED 'u'
+/// The kind of values that are signed integers.
+#define IP_BINARY_DUMP_KIND_SIGNED 'i'
+/// The kind of values that are floating-point numbers.
+#define IP_BINARY_DUMP_KIND_FLOATING 'f'
+/// The kind of values of any other type, such as structures, read as raw bytes.
+#define IP_BINARY_DUMP_KIND_RAW 'r'
+
+/// This structure is the header of a binary dump.
+struct ip_binary_dump_header_t
+{
+	/// IP_BINARY_DUMP_MAGIC, without terminating null character.
+	char magic[4];
+	/// IP_BINARY_DUMP_VERSION.
+	uint32_t version;
+	/// The number of values following the header.
+	uint64_t vertex_count;
+	/// The identifier of the vertex whose value comes first.
+	uint64_t first_id;
+	/// The size in bytes of vertex identifiers.
+	uint32_t id_size;
+	/// The size in bytes of every value.
+	uint32_t value_size;
+	/// The kind of values, one of the IP_BINARY_DUMP_KIND_* defines.
+	uint32_t value_kind;
+	/// The size in bytes of the header, at which values start.
+	uint32_t header_size;
+	/// Bytes left to later versions, set to 0.
+	char reserved[24];
+};
+
+#endif // BINARY_DUMP_FORMAT_H_INCLUDED
@@ -0,0 +1,286 @@
+/**
+ * @file block_centric.h
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This file implements the block-centric execution of the combiner
+ * version, enabled with IP_USE_BLOCKS.
+ * @details Vertices are grouped into blocks: ranges of IP_BLOCK_SIZE
+ * consecutive vertices by default, or the parts listed in the file
+ * "<graph>.blocks", which gives the block of every vertex, one per line, as
+ * graph partitioners such as METIS write them. A superstep hands out whole
+ * blocks to threads. Once the vertices of a block have run, the messages they
+ * sent to vertices of the same block are not delivered at the next superstep:
+ * they are combined in a local mailbox, without atomics since the block
+ * belongs to the thread, and their destinations run again straight away,
+ * until the block has no local message left. Only the messages crossing
+ * blocks go through the shared mailboxes and wait for the next superstep.
+ * Local convergence is skipped in the first superstep, in which applications
+ * initialise vertices rather than process messages.
+ * A vertex may therefore run several times per superstep, and the superstep
+ * number no longer measures a distance: this is meant for algorithms whose
+ * result does not depend on the number of supersteps, such as connected
+ * components or SSSP.
+ * This file must be included by the combiner postamble.
+ **/
+
+#ifndef BLOCK_CENTRIC_H_INCLUDED
+#define BLOCK_CENTRIC_H_INCLUDED
+
+#include <omp.h>
+
+/// The number of consecutive vertices per block, when no partition file is given.
+#ifndef IP_BLOCK_SIZE
+	#define IP_BLOCK_SIZE 4096
+#endif // ifndef IP_BLOCK_SIZE
+
+/// The block of a thread that is not running a block.
+#define IP_NO_BLOCK ((size_t)-1)
+
+/// This structure holds the state of a thread running blocks, alone on its cache lines.
+struct ip_block_worker_t
+{
+	/// The block being run, or IP_NO_BLOCK if messages must not be delivered locally.
+	_Alignas(IP_CACHE_LINE_SIZE) size_t current_block;
+	/// The locations of the vertices that received a local message, in a ring buffer.
+	size_t* queue;
+	/// The position of the first vertex in queue.
+	size_t queue_head;
+	/// The number of vertices in queue.
+	size_t queue_size;
+	/// The number of vertices that fit in queue, which is the size of the largest block.
+	size_t queue_capacity;
+	/// The number of times a vertex has been run again on a local message.
+	size_t local_compute_count;
+};
+/// The state of every thread.
+struct ip_block_worker_t* ip_all_block_workers = NULL;
+/// The block of every vertex, indexed by vertex location.
+size_t* ip_all_block_ids = NULL;
+/// The number of blocks.
+size_t ip_block_count = 0;
+/// The offset of the first vertex of each block in ip_block_members, followed by the number of vertices.
+size_t* ip_block_offsets = NULL;
+/// The locations of the vertices of every block, block after block.
+size_t* ip_block_members = NULL;
+
+/**
+ * @brief This function groups vertices into blocks and allocates the state of
+ * every thread.
+ * @details Blocks are read from the file "<\p file_path>.blocks" if it
+ * exists, and made of IP_BLOCK_SIZE consecutive vertices otherwise.
+ * @param[in] file_path The root name of the graph.
+ * @pre The vertices are allocated and the number of threads is known.
+ **/
+void ip_init_blocks(const char* file_path)
+{
+	char blocks_file_extension[] = ".blocks";
+	char blocks_file_name[strlen(file_path) + strlen(blocks_file_extension) + 1];
+	memcpy(blocks_file_name, file_path, sizeof(char) * strlen(file_path));
+	memcpy(blocks_file_name + strlen(file_path), blocks_file_extension, sizeof(char) * strlen(blocks_file_extension));
+	blocks_file_name[strlen(file_path) + strlen(blocks_file_extension)] = '\0';
+
+	ip_all_block_ids = (size_t*)ip_safe_malloc(sizeof(size_t) * ip_get_vertices_count());
+	FILE* blocks_file = fopen(blocks_file_name, "r");
+	if(blocks_file == NULL)
+	{
+		printf("\t- Blocks of %d consecutive vertices.\n", IP_BLOCK_SIZE);
+		for(size_t i = 0; i < ip_get_vertices_count(); i++)
+		{
+			ip_all_block_ids[i] = i / IP_BLOCK_SIZE;
+		}
+		ip_block_count = (ip_get_vertices_count() + IP_BLOCK_SIZE - 1) / IP_BLOCK_SIZE;
+	}
+	else
+	{
+		printf("\t- Blocks read from: \"%s\".\n", blocks_file_name);
+		ip_block_count = 0;
+		for(size_t i = 0; i < ip_get_vertices_count(); i++)
+		{
+			if(fscanf(blocks_file, "%zu", &ip_all_block_ids[i]) != 1)
+			{
+				printf("\t\t- Failure in reading the block of vertex %zu. Abort...\n", i);
+				fclose(blocks_file);
+				exit(-1);
+			}
+			if(ip_block_count <= ip_all_block_ids[i])
+			{
+				ip_block_count = ip_all_block_ids[i] + 1;
+			}
+		}
+		fclose(blocks_file);
+	}
+
+	// Gather the vertices of each block with a counting sort, so that blocks need not be made of consecutive vertices.
+	ip_block_offsets = (size_t*)ip_safe_malloc(sizeof(size_t) * (ip_block_count + 1));
+	memset(ip_block_offsets, 0, sizeof(size_t) * (ip_block_count + 1));
+	for(size_t i = 0; i < ip_get_vertices_count(); i++)
+	{
+		ip_block_offsets[ip_all_block_ids[i] + 1]++;
+	}
+	size_t largest_block_size = 0;
+	for(size_t i = 0; i < ip_block_count; i++)
+	{
+		if(largest_block_size < ip_block_offsets[i + 1])
+		{
+			largest_block_size = ip_block_offsets[i + 1];
+		}
+		ip_block_offsets[i + 1] += ip_block_offsets[i];
+	}
+	ip_block_members = (size_t*)ip_safe_malloc(sizeof(size_t) * ip_get_vertices_count());
+	size_t* cursors = (size_t*)ip_safe_malloc(sizeof(size_t) * ip_block_count);
+	memcpy(cursors, ip_block_offsets, sizeof(size_t) * ip_block_count);
+	for(size_t i = 0; i < ip_get_vertices_count(); i++)
+	{
+		ip_block_members[cursors[ip_all_block_ids[i]]++] = i;
+	}
+	ip_safe_free(cursors);
+
+	ip_all_block_workers = (struct ip_block_worker_t*)aligned_alloc(IP_CACHE_LINE_SIZE, sizeof(struct ip_block_worker_t) * ip_thread_count);
+	if(ip_all_block_workers == NULL)
+	{
+		printf("Failed to allocate the block workers.\n");
+		exit(-1);
+	}
+	#pragma omp parallel default(none) shared(ip_all_block_workers, largest_block_size)
+	{
+		struct ip_block_worker_t* worker = &ip_all_block_workers[omp_get_thread_num()];
+		worker->current_block = IP_NO_BLOCK;
+		worker->queue = (size_t*)ip_safe_malloc(sizeof(size_t) * (largest_block_size > 0 ? largest_block_size : 1));
+		worker->queue_head = 0;
+		worker->queue_size = 0;
+		worker->queue_capacity = largest_block_size;
+		worker->local_compute_count = 0;
+	}
+	printf("BlockCount:%zu\n", ip_block_count);
+	printf("LargestBlockSize:%zu\n", largest_block_size);
+}
+
+/**
+ * @brief This function returns the number of blocks.
+ * @return The number of blocks.
+ **/
+size_t ip_get_block_count()
+{
+	return ip_block_count;
+}
+
+/**
+ * @brief This function delivers the message \p message in the local mailbox
+ * of the vertex \p id if it belongs to the block the calling thread is
+ * running.
+ * @param[in] id The identifier of the destination vertex.
+ * @param[in] message The message to send.
+ * @retval true The message has been delivered locally.
+ * @retval false The destination is in another block, or the thread is not
+ * running a block, so the message must go through the shared mailboxes.
+ **/
+bool ip_try_send_message_in_block(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message)
+{
+	struct ip_block_worker_t* worker = &ip_all_block_workers[omp_get_thread_num()];
+	if(worker->current_block == IP_NO_BLOCK)
+	{
+		return false;
+	}
+	size_t location = ip_get_vertex_by_id(id) - ip_all_vertices;
+	if(ip_all_block_ids[location] != worker->current_block)
+	{
+		return false;
+	}
+
+	struct ip_vertex_t* v = &ip_all_vertices[location];
+	if(v->has_message_local)
+	{
+		ip_combine(&v->message_local, message);
+	}
+	else
+	{
+		v->message_local = message;
+		v->has_message_local = true;
+		// A vertex is queued once until it runs, so the queue never holds more vertices than the block.
+		worker->queue[(worker->queue_head + worker->queue_size) % worker->queue_capacity] = location;
+		worker->queue_size++;
+	}
+	return true;
+}
+
+/**
+ * @brief This function runs the vertices of the block \p block, then runs
+ * again those that receive local messages until there are none left.
+ * @param[in] block The block to run.
+ * @return The number of vertices of the block still active.
+ **/
+size_t ip_run_block(size_t block)
+{
+	struct ip_block_worker_t* worker = &ip_all_block_workers[omp_get_thread_num()];
+	worker->current_block = ip_is_first_superstep() ? IP_NO_BLOCK : block;
+
+	for(size_t i = ip_block_offsets[block]; i < ip_block_offsets[block + 1]; i++)
+	{
+		struct ip_vertex_t* v = &ip_all_vertices[ip_block_members[i]];
+		if(v->active || ip_has_message(v))
+		{
+			v->active = true;
+			ip_compute(v);
+			#ifdef IP_ENABLE_METRICS
+				ip_record_metrics_vertex(v);
+			#endif // ifdef IP_ENABLE_METRICS
+		}
+	}
+
+	// Messages read are consumed, so a vertex run again on a local message only sees that message.
+	while(worker->queue_size > 0)
+	{
+		struct ip_vertex_t* v = &ip_all_vertices[worker->queue[worker->queue_head]];
+		worker->queue_head = (worker->queue_head + 1) % worker->queue_capacity;
+		worker->queue_size--;
+		v->message = v->message_local;
+		v->has_message = true;
+		v->has_message_local = false;
+		v->active = true;
+		ip_compute(v);
+		worker->local_compute_count++;
+		#ifdef IP_ENABLE_METRICS
+			ip_record_metrics_vertex(v);
+		#endif // ifdef IP_ENABLE_METRICS
+	}
+	worker->current_block = IP_NO_BLOCK;
+
+	size_t active_count = 0;
+	for(size_t i = ip_block_offsets[block]; i < ip_block_offsets[block + 1]; i++)
+	{
+		if(ip_all_vertices[ip_block_members[i]].active)
+		{
+			active_count++;
+		}
+	}
+	return active_count;
+}
+
+/**
+ * @brief This function returns the number of times vertices have been run
+ * again on a local message since the last call, and resets it.
+ * @return The number of local runs of all threads.
+ **/
+size_t ip_collect_local_compute_count()
+{
+	size_t total = 0;
+	for(int i = 0; i < ip_thread_count; i++)
+	{
+		total += ip_all_block_workers[i].local_compute_count;
+		ip_all_block_workers[i].local_compute_count = 0;
+	}
+	return total;
+}
+
+#endif // BLOCK_CENTRIC_H_INCLUDED
@@ -0,0 +1,650 @@
+/**
+ * @file checkpoint.h
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This file implements the checkpoints of a run, enabled with
+ * IP_USE_CHECKPOINTS, and the resumption of a run from a checkpoint.
+ * @details A checkpoint is taken between two supersteps, once the master
+ * compute has run, when all threads are waiting for the next superstep. At
+ * that point, the mailboxes of the superstep to come are empty, so the state
+ * of the engine is the value, the status and the message of every vertex, the
+ * frontier of the spread versions, the results of the aggregators and the
+ * superstep number. All threads copy it into a snapshot, after which
+ * IP_CHECKPOINT_WRITER_COUNT background threads write the snapshot, each a
+ * part of the file, while the supersteps go on. The file is written under a
+ * temporary name and renamed once complete, so a run killed while writing
+ * leaves the previous checkpoint intact. A checkpoint falling due while the
+ * previous one is still being written is postponed to the next superstep.
+ * Resuming from a checkpoint restores that state at the start of ip_run(), in
+ * place of the first master compute, which the checkpoint already includes.
+ * The topology is not part of a checkpoint: the graph is loaded by ip_init()
+ * as usual, and the checkpoint is rejected if it does not match it.
+ * This file must be included by the iPregel postamble.
+ **/
+
+#ifndef CHECKPOINT_H_INCLUDED
+#define CHECKPOINT_H_INCLUDED
+
+#include <errno.h>
+#include <fcntl.h> // open
+#include <inttypes.h>
+#include <omp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h> // getenv
+#include <string.h>
+#include <unistd.h> // pread, pwrite, fsync
+
+/// The first 4 bytes of a checkpoint.
+#define IP_CHECKPOINT_MAGIC "IPCK"
+/// The version of the layout described by struct ip_checkpoint_header_t.
+#define IP_CHECKPOINT_VERSION 1
+/// The alignment, in bytes, of every section of a checkpoint.
+#define IP_CHECKPOINT_SECTION_ALIGNMENT 64
+/// The number of background threads writing a checkpoint.
+#ifndef IP_CHECKPOINT_WRITER_COUNT
+	#define IP_CHECKPOINT_WRITER_COUNT 4
+#endif // ifndef IP_CHECKPOINT_WRITER_COUNT
+/// The number of bytes a thread reads at once when resuming from a checkpoint.
+#ifndef IP_CHECKPOINT_READ_CHUNK_SIZE
+	#define IP_CHECKPOINT_READ_CHUNK_SIZE (64 << 20)
+#endif // ifndef IP_CHECKPOINT_READ_CHUNK_SIZE
+/// The number of seconds between two checkpoints when IP_CHECKPOINT_PATH is set without an interval.
+#ifndef IP_CHECKPOINT_DEFAULT_SECONDS
+	#define IP_CHECKPOINT_DEFAULT_SECONDS 1800.0
+#endif // ifndef IP_CHECKPOINT_DEFAULT_SECONDS
+
+/**
+ * @brief This structure is the header of a checkpoint.
+ * @details It is followed by the sections it gives the offsets of: the value,
+ * message, status and message flag of every vertex, indexed by location, the
+ * identifiers of the frontier and the results of the aggregators, in
+ * registration order. Numbers are in the byte order of the machine that wrote
+ * the file.
+ **/
+struct ip_checkpoint_header_t
+{
+	/// IP_CHECKPOINT_MAGIC, without terminating null character.
+	char magic[4];
+	/// IP_CHECKPOINT_VERSION.
+	uint32_t version;
+	/// The application that wrote the checkpoint, IP_APPLICATION.
+	char application[32];
+	/// The version of iPregel that wrote the checkpoint, IP_ENGINE_NAME.
+	char engine[32];
+	/// The number of vertices of the graph.
+	uint64_t vertex_count;
+	/// The number of edges of the graph.
+	uint64_t edge_count;
+	/// The superstep about to start.
+	uint64_t superstep;
+	/// The number of vertices active in the superstep about to start.
+	uint64_t active_vertex_count;
+	/// The number of identifiers in the frontier.
+	uint64_t frontier_size;
+	/// The size in bytes of vertex identifiers.
+	uint32_t id_size;
+	/// The size in bytes of vertex values.
+	uint32_t value_size;
+	/// The size in bytes of messages.
+	uint32_t message_size;
+	/// The number of aggregators registered.
+	uint32_t aggregator_count;
+	/// The total size in bytes of the results of the aggregators.
+	uint64_t aggregator_size;
+	/// The offset of the values.
+	uint64_t values_offset;
+	/// The offset of the messages.
+	uint64_t messages_offset;
+	/// The offset of the statuses, one byte per vertex.
+	uint64_t active_offset;
+	/// The offset of the message flags, one byte per vertex.
+	uint64_t has_message_offset;
+	/// The offset of the frontier.
+	uint64_t frontier_offset;
+	/// The offset of the results of the aggregators.
+	uint64_t aggregators_offset;
+	/// The size in bytes of the whole checkpoint.
+	uint64_t total_size;
+};
+
+/// This structure describes a contiguous part of a checkpoint held in memory.
+struct ip_checkpoint_section_t
+{
+	/// The bytes of the section.
+	const char* data;
+	/// The number of bytes of the section.
+	size_t length;
+	/// The position of the section in the file.
+	off_t offset;
+};
+
+/// The number of sections of a checkpoint, header included.
+#define IP_CHECKPOINT_SECTION_COUNT 7
+
+/// This structure holds the state of the engine copied at the end of a superstep, or read from a checkpoint.
+struct ip_checkpoint_snapshot_t
+{
+	/// The header describing the other fields.
+	struct ip_checkpoint_header_t header;
+	/// The value of every vertex.
+	IP_VALUE_TYPE* values;
+	/// The message of every vertex, meaningful only if it has one.
+	IP_MESSAGE_TYPE* messages;
+	/// The status of every vertex.
+	bool* active;
+	/// Indicates, for every vertex, whether it has a message.
+	bool* has_message;
+	/// The identifiers of the frontier.
+	IP_VERTEX_ID_TYPE* frontier;
+	/// The number of identifiers that fit in frontier.
+	size_t frontier_capacity;
+	/// The results of the aggregators, one after the other.
+	char* aggregators;
+	/// The parts of the file to write.
+	struct ip_checkpoint_section_t sections[IP_CHECKPOINT_SECTION_COUNT];
+};
+
+/// This structure holds what a background thread writes.
+struct ip_checkpoint_writer_t
+{
+	/// The position of the first byte to write.
+	off_t begin;
+	/// The position after the last byte to write.
+	off_t end;
+	/// The thread writing.
+	pthread_t thread;
+	/// Indicates whether thread has been started and must be joined.
+	bool started;
+};
+
+/// The snapshot being written or restored.
+struct ip_checkpoint_snapshot_t ip_checkpoint_snapshot;
+/// The file into which checkpoints are written, NULL if checkpoints are disabled.
+char* ip_checkpoint_path = NULL;
+/// The name under which a checkpoint is written before it is complete.
+char* ip_checkpoint_temporary_path = NULL;
+/// The number of supersteps between two checkpoints, 0 for no limit.
+size_t ip_checkpoint_superstep_interval = 0;
+/// The number of seconds between two checkpoints, 0 for no limit.
+double ip_checkpoint_second_interval = 0;
+/// The superstep at which the last checkpoint was taken, or the run started.
+size_t ip_checkpoint_last_superstep = 0;
+/// The time at which the last checkpoint was taken, or the run started.
+double ip_checkpoint_last_time = 0;
+/// Indicates whether the threads must take a checkpoint before the next superstep.
+bool ip_checkpoint_planned = false;
+/// Indicates whether the snapshot holds a checkpoint to restore at the start of the next run.
+bool ip_checkpoint_pending_resumption = false;
+/// The background threads writing the last checkpoint.
+struct ip_checkpoint_writer_t ip_checkpoint_writers[IP_CHECKPOINT_WRITER_COUNT];
+/// The number of background threads still writing the last checkpoint.
+atomic_int ip_checkpoint_writers_left = 0;
+/// Indicates whether a background thread failed to write its part of the last checkpoint.
+atomic_bool ip_checkpoint_write_failed = false;
+/// The file descriptor of the checkpoint being written.
+int ip_checkpoint_file_descriptor = -1;
+/// The time at which the copy of the last checkpoint started.
+double ip_checkpoint_copy_start = 0;
+/// The time at which the writing of the last checkpoint started.
+double ip_checkpoint_write_start = 0;
+/// The frontier being copied into the snapshot.
+const IP_VERTEX_ID_TYPE* ip_checkpoint_frontier_source = NULL;
+
+/**
+ * @brief This function rounds \p offset up to IP_CHECKPOINT_SECTION_ALIGNMENT.
+ * @param[in] offset The offset to align.
+ * @return The aligned offset.
+ **/
+uint64_t ip_align_checkpoint_offset(uint64_t offset)
+{
+	return (offset + IP_CHECKPOINT_SECTION_ALIGNMENT - 1) / IP_CHECKPOINT_SECTION_ALIGNMENT * IP_CHECKPOINT_SECTION_ALIGNMENT;
+}
+
+/**
+ * @brief This function returns the total size in bytes of the results of the
+ * aggregators registered.
+ * @return The size of the results of all aggregators.
+ **/
+size_t ip_get_aggregators_size()
+{
+	size_t size = 0;
+	for(size_t i = 0; i < ip_aggregator_count; i++)
+	{
+		size += ip_all_aggregators[i].size;
+	}
+	return size;
+}
+
+/**
+ * @brief This function fills the sizes and offsets of the header of the
+ * snapshot, and the sections pointing to the arrays of the snapshot.
+ * @details The superstep, active vertex count, frontier size and aggregators
+ * must have been set already.
+ **/
+void ip_lay_out_checkpoint()
+{
+	struct ip_checkpoint_header_t* header = &ip_checkpoint_snapshot.header;
+	memcpy(header->magic, IP_CHECKPOINT_MAGIC, sizeof(header->magic));
+	header->version = IP_CHECKPOINT_VERSION;
+	memset(header->application, 0, sizeof(header->application));
+	strncpy(header->application, IP_APPLICATION, sizeof(header->application) - 1);
+	memset(header->engine, 0, sizeof(header->engine));
+	strncpy(header->engine, IP_ENGINE_NAME, sizeof(header->engine) - 1);
+	header->vertex_count = ip_get_vertices_count();
+	header->edge_count = ip_get_edges_count();
+	header->id_size = sizeof(IP_VERTEX_ID_TYPE);
+	header->value_size = sizeof(IP_VALUE_TYPE);
+	header->message_size = sizeof(IP_MESSAGE_TYPE);
+
+	header->values_offset = ip_align_checkpoint_offset(sizeof(struct ip_checkpoint_header_t));
+	header->messages_offset = ip_align_checkpoint_offset(header->values_offset + header->vertex_count * sizeof(IP_VALUE_TYPE));
+	header->active_offset = ip_align_checkpoint_offset(header->messages_offset + header->vertex_count * sizeof(IP_MESSAGE_TYPE));
+	header->has_message_offset = ip_align_checkpoint_offset(header->active_offset + header->vertex_count * sizeof(bool));
+	header->frontier_offset = ip_align_checkpoint_offset(header->has_message_offset + header->vertex_count * sizeof(bool));
+	header->aggregators_offset = ip_align_checkpoint_offset(header->frontier_offset + header->frontier_size * sizeof(IP_VERTEX_ID_TYPE));
+	header->total_size = header->aggregators_offset + header->aggregator_size;
+
+	struct ip_checkpoint_section_t* sections = ip_checkpoint_snapshot.sections;
+	sections[0] = (struct ip_checkpoint_section_t){(const char*)header, sizeof(struct ip_checkpoint_header_t), 0};
+	sections[1] = (struct ip_checkpoint_section_t){(const char*)ip_checkpoint_snapshot.values, header->vertex_count * sizeof(IP_VALUE_TYPE), header->values_offset};
+	sections[2] = (struct ip_checkpoint_section_t){(const char*)ip_checkpoint_snapshot.messages, header->vertex_count * sizeof(IP_MESSAGE_TYPE), header->messages_offset};
+	sections[3] = (struct ip_checkpoint_section_t){(const char*)ip_checkpoint_snapshot.active, header->vertex_count * sizeof(bool), header->active_offset};
+	sections[4] = (struct ip_checkpoint_section_t){(const char*)ip_checkpoint_snapshot.has_message, header->vertex_count * sizeof(bool), header->has_message_offset};
+	sections[5] = (struct ip_checkpoint_section_t){(const char*)ip_checkpoint_snapshot.frontier, header->frontier_size * sizeof(IP_VERTEX_ID_TYPE), header->frontier_offset};
+	sections[6] = (struct ip_checkpoint_section_t){ip_checkpoint_snapshot.aggregators, header->aggregator_size, header->aggregators_offset};
+}
+
+/**
+ * @brief This function allocates the arrays of the snapshot, and makes room
+ * for \p frontier_size identifiers and \p aggregator_size bytes of aggregator
+ * results.
+ * @param[in] frontier_size The number of identifiers in the frontier.
+ * @param[in] aggregator_size The size in bytes of the results of the
+ * aggregators.
+ **/
+void ip_reserve_checkpoint_snapshot(size_t frontier_size, size_t aggregator_size)
+{
+	if(ip_checkpoint_snapshot.values == NULL)
+	{
+		ip_checkpoint_snapshot.values = (IP_VALUE_TYPE*)ip_safe_malloc(sizeof(IP_VALUE_TYPE) * ip_get_vertices_count());
+		ip_checkpoint_snapshot.messages = (IP_MESSAGE_TYPE*)ip_safe_malloc(sizeof(IP_MESSAGE_TYPE) * ip_get_vertices_count());
+		ip_checkpoint_snapshot.active = (bool*)ip_safe_malloc(sizeof(bool) * ip_get_vertices_count());
+		ip_checkpoint_snapshot.has_message = (bool*)ip_safe_malloc(sizeof(bool) * ip_get_vertices_count());
+	}
+	if(ip_checkpoint_snapshot.frontier_capacity < frontier_size)
+	{
+		ip_checkpoint_snapshot.frontier = (IP_VERTEX_ID_TYPE*)ip_safe_realloc(ip_checkpoint_snapshot.frontier, sizeof(IP_VERTEX_ID_TYPE) * frontier_size);
+		ip_checkpoint_snapshot.frontier_capacity = frontier_size;
+	}
+	// The aggregators are registered once, before the first checkpoint, so their size does not change.
+	if(ip_checkpoint_snapshot.aggregators == NULL && aggregator_size > 0)
+	{
+		ip_checkpoint_snapshot.aggregators = (char*)ip_safe_malloc(aggregator_size);
+	}
+}
+
+void ip_enable_checkpoints(const char* path, size_t superstep_interval, double second_interval)
+{
+	const char temporary_extension[] = ".tmp";
+	ip_safe_free(ip_checkpoint_path);
+	ip_safe_free(ip_checkpoint_temporary_path);
+	ip_checkpoint_path = (char*)ip_safe_malloc(strlen(path) + 1);
+	strcpy(ip_checkpoint_path, path);
+	ip_checkpoint_temporary_path = (char*)ip_safe_malloc(strlen(path) + strlen(temporary_extension) + 1);
+	strcpy(ip_checkpoint_temporary_path, path);
+	strcat(ip_checkpoint_temporary_path, temporary_extension);
+	ip_checkpoint_superstep_interval = superstep_interval;
+	ip_checkpoint_second_interval = second_interval;
+	printf("CheckpointPath:%s\n", ip_checkpoint_path);
+	printf("CheckpointSuperstepInterval:%zu\n", ip_checkpoint_superstep_interval);
+	printf("CheckpointSecondInterval:%f\n", ip_checkpoint_second_interval);
+}
+
+/**
+ * @brief This function reads the \p length bytes at the offset \p offset of
+ * the file \p file_descriptor into \p buffer, from all threads.
+ * @param[in] file_descriptor The file to read.
+ * @param[out] buffer The buffer to fill.
+ * @param[in] length The number of bytes to read.
+ * @param[in] offset The position in the file at which read.
+ * @retval true The bytes have been read.
+ * @retval false The file is shorter or could not be read.
+ **/
+bool ip_read_checkpoint_section(int file_descriptor, char* buffer, size_t length, off_t offset)
+{
+	size_t chunk_count = (length + IP_CHECKPOINT_READ_CHUNK_SIZE - 1) / IP_CHECKPOINT_READ_CHUNK_SIZE;
+	bool failed = false;
+	#pragma omp parallel for default(none) shared(file_descriptor, buffer, length, offset, chunk_count) reduction(||:failed) schedule(dynamic, 1)
+	for(size_t i = 0; i < chunk_count; i++)
+	{
+		size_t begin = i * IP_CHECKPOINT_READ_CHUNK_SIZE;
+		size_t end = begin + IP_CHECKPOINT_READ_CHUNK_SIZE < length ? begin + IP_CHECKPOINT_READ_CHUNK_SIZE : length;
+		while(begin < end && !failed)
+		{
+			ssize_t result = pread(file_descriptor, buffer + begin, end - begin, offset + begin);
+			if(result < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if(result <= 0)
+			{
+				failed = true;
+			}
+			else
+			{
+				begin += result;
+			}
+		}
+	}
+	return !failed;
+}
+
+void ip_resume_from_checkpoint(const char* path)
+{
+	double timer_read_start = omp_get_wtime();
+	int file_descriptor = open(path, O_RDONLY);
+	if(file_descriptor < 0)
+	{
+		printf("Cannot open the checkpoint \"%s\".\n", path);
+		exit(-1);
+	}
+
+	struct ip_checkpoint_header_t header;
+	if(!ip_read_checkpoint_section(file_descriptor, (char*)&header, sizeof(struct ip_checkpoint_header_t), 0)
+	|| memcmp(header.magic, IP_CHECKPOINT_MAGIC, sizeof(header.magic)) != 0
+	|| header.version != IP_CHECKPOINT_VERSION)
+	{
+		printf("\"%s\" is not a checkpoint of this version of iPregel.\n", path);
+		exit(-1);
+	}
+	header.application[sizeof(header.application) - 1] = '\0';
+	header.engine[sizeof(header.engine) - 1] = '\0';
+	if(strcmp(header.application, IP_APPLICATION) != 0
+	|| strcmp(header.engine, IP_ENGINE_NAME) != 0
+	|| header.vertex_count != ip_get_vertices_count()
+	|| header.edge_count != ip_get_edges_count()
+	|| header.id_size != sizeof(IP_VERTEX_ID_TYPE)
+	|| header.value_size != sizeof(IP_VALUE_TYPE)
+	|| header.message_size != sizeof(IP_MESSAGE_TYPE))
+	{
+		printf("The checkpoint \"%s\" was written by %s, version %s, with %u-byte identifiers, %u-byte values and %u-byte messages, on a graph of %" PRIu64 " vertices and %" PRIu64 " edges. It cannot be resumed by %s, version %s, with %zu-byte identifiers, %zu-byte values and %zu-byte messages, on a graph of %zu vertices and %zu edges. Abort...\n", path, header.application, header.engine, header.id_size, header.value_size, header.message_size, header.vertex_count, header.edge_count, IP_APPLICATION, IP_ENGINE_NAME, sizeof(IP_VERTEX_ID_TYPE), sizeof(IP_VALUE_TYPE), sizeof(IP_MESSAGE_TYPE), ip_get_vertices_count(), ip_get_edges_count());
+		exit(-1);
+	}
+
+	ip_reserve_checkpoint_snapshot(header.frontier_size, header.aggregator_size);
+	ip_checkpoint_snapshot.header = header;
+	ip_lay_out_checkpoint();
+	if(ip_checkpoint_snapshot.header.total_size != header.total_size)
+	{
+		printf("The layout of the checkpoint \"%s\" is inconsistent. Abort...\n", path);
+		exit(-1);
+	}
+	for(int i = 1; i < IP_CHECKPOINT_SECTION_COUNT; i++)
+	{
+		struct ip_checkpoint_section_t* section = &ip_checkpoint_snapshot.sections[i];
+		if(!ip_read_checkpoint_section(file_descriptor, (char*)section->data, section->length, section->offset))
+		{
+			printf("The checkpoint \"%s\" is truncated. Abort...\n", path);
+			exit(-1);
+		}
+	}
+	close(file_descriptor);
+
+	ip_checkpoint_pending_resumption = true;
+	printf("ResumedCheckpoint:%s\n", path);
+	printf("ResumedSuperstep:%" PRIu64 "\n", header.superstep);
+	printf("CheckpointReadTime:%f\n", omp_get_wtime() - timer_read_start);
+}
+
+void ip_configure_checkpoints_from_environment()
+{
+	const char* path = getenv("IP_CHECKPOINT_PATH");
+	if(path != NULL && path[0] != '\0')
+	{
+		const char* supersteps = getenv("IP_CHECKPOINT_SUPERSTEPS");
+		const char* seconds = getenv("IP_CHECKPOINT_SECONDS");
+		size_t superstep_interval = supersteps == NULL ? 0 : strtoull(supersteps, NULL, 10);
+		double second_interval = seconds == NULL ? 0 : strtod(seconds, NULL);
+		if(superstep_interval == 0 && second_interval <= 0)
+		{
+			second_interval = IP_CHECKPOINT_DEFAULT_SECONDS;
+		}
+		ip_enable_checkpoints(path, superstep_interval, second_interval);
+	}
+
+	const char* resume_path = getenv("IP_CHECKPOINT_RESUME");
+	if(resume_path != NULL && resume_path[0] != '\0')
+	{
+		ip_resume_from_checkpoint(resume_path);
+	}
+}
+
+bool ip_start_checkpoints()
+{
+	bool resumed = ip_checkpoint_pending_resumption;
+	if(resumed)
+	{
+		struct ip_checkpoint_header_t* header = &ip_checkpoint_snapshot.header;
+		if(header->aggregator_count != ip_aggregator_count || header->aggregator_size != ip_get_aggregators_size())
+		{
+			printf("The checkpoint holds %u aggregators of %" PRIu64 " bytes in total, but %zu aggregators of %zu bytes are registered. Abort...\n", header->aggregator_count, header->aggregator_size, ip_aggregator_count, ip_get_aggregators_size());
+			exit(-1);
+		}
+
+		ip_reset();
+		#pragma omp parallel for default(none) shared(ip_checkpoint_snapshot)
+		for(size_t i = 0; i < ip_get_vertices_count(); i++)
+		{
+			ip_get_vertex_by_location(i)->value = ip_checkpoint_snapshot.values[i];
+			ip_restore_vertex_state(i, ip_checkpoint_snapshot.active[i], ip_checkpoint_snapshot.has_message[i], ip_checkpoint_snapshot.messages[i]);
+		}
+		// The superstep resumed is not the first, so the frontier is not taken for the seeds of a first superstep.
+		// Versions without a frontier save none, and keep the activity of the vertices restored above.
+		if(header->frontier_size > 0)
+		{
+			ip_set_initial_frontier(ip_checkpoint_snapshot.frontier, header->frontier_size);
+		}
+		const char* aggregator_result = ip_checkpoint_snapshot.aggregators;
+		for(size_t i = 0; i < ip_aggregator_count; i++)
+		{
+			ip_set_aggregated_value(i, aggregator_result);
+			aggregator_result += ip_all_aggregators[i].size;
+		}
+		ip_superstep = header->superstep;
+		ip_active_vertices = header->active_vertex_count;
+		ip_checkpoint_pending_resumption = false;
+	}
+
+	ip_checkpoint_last_superstep = ip_get_superstep();
+	ip_checkpoint_last_time = omp_get_wtime();
+	return resumed;
+}
+
+void ip_plan_checkpoint()
+{
+	if(ip_checkpoint_path == NULL || ip_is_computation_halted() || ip_get_active_vertices_count() == 0)
+	{
+		return;
+	}
+	// The snapshot is still being written, the checkpoint waits for the next superstep.
+	if(atomic_load(&ip_checkpoint_writers_left) > 0)
+	{
+		return;
+	}
+	ip_checkpoint_planned = (ip_checkpoint_superstep_interval > 0 && ip_get_superstep() - ip_checkpoint_last_superstep >= ip_checkpoint_superstep_interval)
+	                     || (ip_checkpoint_second_interval > 0 && omp_get_wtime() - ip_checkpoint_last_time >= ip_checkpoint_second_interval);
+}
+
+bool ip_is_checkpoint_planned()
+{
+	return ip_checkpoint_planned;
+}
+
+/**
+ * @brief This function writes the part of the snapshot that the background
+ * thread \p argument is in charge of.
+ * @details The last thread to finish makes the file durable and gives it its
+ * final name.
+ * @param[in] argument The struct ip_checkpoint_writer_t describing the part
+ * to write.
+ * @return NULL.
+ **/
+void* ip_write_checkpoint_part(void* argument)
+{
+	struct ip_checkpoint_writer_t* writer = (struct ip_checkpoint_writer_t*)argument;
+	for(int i = 0; i < IP_CHECKPOINT_SECTION_COUNT && !atomic_load(&ip_checkpoint_write_failed); i++)
+	{
+		struct ip_checkpoint_section_t* section = &ip_checkpoint_snapshot.sections[i];
+		off_t begin = section->offset > writer->begin ? section->offset : writer->begin;
+		off_t end = section->offset + (off_t)section->length < writer->end ? section->offset + (off_t)section->length : writer->end;
+		while(begin < end)
+		{
+			ssize_t result = pwrite(ip_checkpoint_file_descriptor, section->data + (begin - section->offset), end - begin, begin);
+			if(result < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if(result < 0)
+			{
+				perror("Failed to write the checkpoint");
+				atomic_store(&ip_checkpoint_write_failed, true);
+				break;
+			}
+			begin += result;
+		}
+	}
+
+	if(atomic_fetch_sub(&ip_checkpoint_writers_left, 1) == 1)
+	{
+		bool failed = atomic_load(&ip_checkpoint_write_failed);
+		if(!failed && fsync(ip_checkpoint_file_descriptor) != 0)
+		{
+			perror("Failed to flush the checkpoint");
+			failed = true;
+		}
+		close(ip_checkpoint_file_descriptor);
+		if(!failed && rename(ip_checkpoint_temporary_path, ip_checkpoint_path) != 0)
+		{
+			perror("Failed to rename the checkpoint");
+			failed = true;
+		}
+		if(failed)
+		{
+			// The previous checkpoint, if any, is left untouched.
+			unlink(ip_checkpoint_temporary_path);
+			printf("Checkpoint%" PRIu64 "Failed:%s\n", ip_checkpoint_snapshot.header.superstep, ip_checkpoint_path);
+		}
+		else
+		{
+			printf("Checkpoint%" PRIu64 "WriteDuration:%f\n", ip_checkpoint_snapshot.header.superstep, omp_get_wtime() - ip_checkpoint_write_start);
+			printf("Checkpoint%" PRIu64 "Bytes:%" PRIu64 "\n", ip_checkpoint_snapshot.header.superstep, ip_checkpoint_snapshot.header.total_size);
+		}
+	}
+	return NULL;
+}
+
+void ip_wait_for_checkpoint()
+{
+	for(int i = 0; i < IP_CHECKPOINT_WRITER_COUNT; i++)
+	{
+		if(ip_checkpoint_writers[i].started)
+		{
+			pthread_join(ip_checkpoint_writers[i].thread, NULL);
+			ip_checkpoint_writers[i].started = false;
+		}
+	}
+}
+
+/**
+ * @brief This function starts the background threads writing the snapshot.
+ * @details It is called by a single thread once the snapshot is complete.
+ **/
+void ip_start_checkpoint_writers()
+{
+	// The previous writers are done, since a checkpoint is only planned then; this only releases them.
+	ip_wait_for_checkpoint();
+
+	ip_checkpoint_file_descriptor = open(ip_checkpoint_temporary_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(ip_checkpoint_file_descriptor < 0)
+	{
+		perror("Failed to create the checkpoint");
+		printf("Checkpoint%" PRIu64 "Failed:%s\n", ip_checkpoint_snapshot.header.superstep, ip_checkpoint_path);
+		return;
+	}
+
+	ip_checkpoint_write_start = omp_get_wtime();
+	atomic_store(&ip_checkpoint_write_failed, false);
+	atomic_store(&ip_checkpoint_writers_left, IP_CHECKPOINT_WRITER_COUNT);
+	off_t total_size = ip_checkpoint_snapshot.header.total_size;
+	for(int i = 0; i < IP_CHECKPOINT_WRITER_COUNT; i++)
+	{
+		ip_checkpoint_writers[i].begin = total_size / IP_CHECKPOINT_WRITER_COUNT * i;
+		ip_checkpoint_writers[i].end = i == IP_CHECKPOINT_WRITER_COUNT - 1 ? total_size : total_size / IP_CHECKPOINT_WRITER_COUNT * (i + 1);
+		ip_checkpoint_writers[i].started = pthread_create(&ip_checkpoint_writers[i].thread, NULL, ip_write_checkpoint_part, &ip_checkpoint_writers[i]) == 0;
+		if(!ip_checkpoint_writers[i].started)
+		{
+			// Written by the calling thread instead, the superstep waits but the checkpoint is complete.
+			ip_write_checkpoint_part(&ip_checkpoint_writers[i]);
+		}
+	}
+}
+
+void ip_take_checkpoint()
+{
+	#pragma omp single
+	{
+		ip_checkpoint_copy_start = omp_get_wtime();
+		size_t frontier_size = 0;
+		ip_checkpoint_frontier_source = ip_get_frontier(&frontier_size);
+		struct ip_checkpoint_header_t* header = &ip_checkpoint_snapshot.header;
+		header->superstep = ip_get_superstep();
+		header->active_vertex_count = ip_get_active_vertices_count();
+		header->frontier_size = frontier_size;
+		header->aggregator_count = ip_aggregator_count;
+		header->aggregator_size = ip_get_aggregators_size();
+		ip_reserve_checkpoint_snapshot(frontier_size, header->aggregator_size);
+		char* aggregator_result = ip_checkpoint_snapshot.aggregators;
+		for(size_t i = 0; i < ip_aggregator_count; i++)
+		{
+			ip_get_aggregated_value(i, aggregator_result);
+			aggregator_result += ip_all_aggregators[i].size;
+		}
+		ip_lay_out_checkpoint();
+	}
+
+	#pragma omp for schedule(static) nowait
+	for(size_t i = 0; i < ip_get_vertices_count(); i++)
+	{
+		ip_checkpoint_snapshot.values[i] = ip_get_vertex_by_location(i)->value;
+		ip_save_vertex_state(i, &ip_checkpoint_snapshot.active[i], &ip_checkpoint_snapshot.has_message[i], &ip_checkpoint_snapshot.messages[i]);
+	}
+	#pragma omp for schedule(static)
+	for(size_t i = 0; i < ip_checkpoint_snapshot.header.frontier_size; i++)
+	{
+		ip_checkpoint_snapshot.frontier[i] = ip_checkpoint_frontier_source[i];
+	}
+
+	#pragma omp single
+	{
+		printf("Checkpoint%" PRIu64 "CopyDuration:%f\n", ip_checkpoint_snapshot.header.superstep, omp_get_wtime() - ip_checkpoint_copy_start);
+		ip_start_checkpoint_writers();
+		ip_checkpoint_last_superstep = ip_get_superstep();
+		ip_checkpoint_last_time = omp_get_wtime();
+		ip_checkpoint_planned = false;
+	}
+}
+
+#endif // CHECKPOINT_H_INCLUDED
@@ -20,7 +20,74 @@
 
 #include <omp.h>
 #include <string.h>
+#include "message_width.h"
+#ifdef IP_ENABLE_METRICS
+	#include "metrics.h"
+#endif // ifdef IP_ENABLE_METRICS
+#ifdef IP_USE_HUB_MAILBOXES
+	#include "hub_mailbox.h"
+#endif // ifdef IP_USE_HUB_MAILBOXES
+#ifdef IP_USE_SEND_CACHE
+	#include "send_cache.h"
+#endif // ifdef IP_USE_SEND_CACHE
+#ifdef IP_USE_DYNAMIC_GRAPH
+	#include "dynamic_graph.h"
+#endif // ifdef IP_USE_DYNAMIC_GRAPH
+#ifdef IP_USE_BLOCKS
+	#include "block_centric.h"
+#endif // ifdef IP_USE_BLOCKS
 
+#ifdef IP_USE_SOA_LAYOUT
+bool ip_has_message(struct ip_vertex_t* v)
+{
+	return ip_all_has_message[v - ip_all_vertices];
+}
+
+bool ip_get_next_message(struct ip_vertex_t* v, IP_MESSAGE_TYPE* message_value)
+{
+	size_t location = v - ip_all_vertices;
+	if(ip_all_has_message[location])
+	{
+		*message_value = ip_all_messages[location];
+		ip_all_has_message[location] = false;
+		return true;
+	}
+
+	return false;
+}
+
+void ip_send_message_to_mailbox(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message)
+{
+	size_t location = ip_get_vertex_by_id(id) - ip_all_vertices;
+	struct ip_mailbox_t* mailbox = &ip_all_mailboxes[location];
+	if(ip_all_has_message_next[location])
+	{
+		ip_combine_in_mailbox(&mailbox->message_next, &mailbox->lock, message);
+	}
+	else
+	{
+		#ifdef IP_ENABLE_CONTENTION_COUNTERS
+			ip_my_contention_counters->counts[IP_CONTENTION_LOCK_SENDS]++;
+		#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+		ip_lock_acquire(&mailbox->lock);
+		if(ip_all_has_message_next[location])
+		{
+			// Same as in the array of structures layout: someone else wrote the first value while we were waiting for the lock.
+			ip_lock_release(&mailbox->lock);
+			ip_combine_in_mailbox(&mailbox->message_next, &mailbox->lock, message);
+		}
+		else
+		{
+			mailbox->message_next = message;
+			ip_all_has_message_next[location] = true;
+			ip_lock_release(&mailbox->lock);
+			#ifdef IP_ENABLE_CONTENTION_COUNTERS
+				ip_my_contention_counters->counts[IP_CONTENTION_FIRST_WRITE_MESSAGES]++;
+			#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+		}
+	}
+}
+#else // ifndef IP_USE_SOA_LAYOUT
 bool ip_has_message(struct ip_vertex_t* v)
 {
 	return v->has_message;
@@ -38,20 +105,12 @@ bool ip_get_next_message(struct ip_vertex_t* v, IP_MESSAGE_TYPE* message_value)
 	return false;
 }
 
-void ip_cas(struct ip_vertex_t* dest_vertex, IP_VERTEX_ID_TYPE message)
+void ip_cas(struct ip_vertex_t* dest_vertex, IP_MESSAGE_TYPE message)
 {
-	IP_MESSAGE_TYPE old_value = dest_vertex->message_next;
-	IP_MESSAGE_TYPE new_value = old_value;
-	ip_combine(&new_value, message);
-	while(new_value != old_value && !atomic_compare_exchange_strong(&dest_vertex->message_next, &old_value, new_value))
-	{
-		old_value = dest_vertex->message_next;
-		new_value = old_value;
-		ip_combine(&new_value, message);
-	}
+	ip_combine_in_mailbox(&dest_vertex->message_next, &dest_vertex->lock, message);
 }
 
-void ip_send_message(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message)
+void ip_send_message_to_mailbox(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message)
 {
 	struct ip_vertex_t* temp_vertex = ip_get_vertex_by_id(id);
 	if(temp_vertex->has_message_next)
@@ -60,6 +119,9 @@ void ip_send_message(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message)
 	}
 	else
 	{
+		#ifdef IP_ENABLE_CONTENTION_COUNTERS
+			ip_my_contention_counters->counts[IP_CONTENTION_LOCK_SENDS]++;
+		#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
 		ip_lock_acquire(&temp_vertex->lock);
 		if(temp_vertex->has_message_next)
 		{
@@ -74,50 +136,257 @@ void ip_send_message(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message)
 			temp_vertex->message_next = message;
 			temp_vertex->has_message_next = true;
 			ip_lock_release(&temp_vertex->lock);
+			#ifdef IP_ENABLE_CONTENTION_COUNTERS
+				ip_my_contention_counters->counts[IP_CONTENTION_FIRST_WRITE_MESSAGES]++;
+			#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
 		}
 	}
 }
+#endif // if(n)def IP_USE_SOA_LAYOUT
+
+void ip_send_message(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message)
+{
+	#ifdef IP_ENABLE_METRICS
+		ip_my_thread_metrics->message_count++;
+	#endif // ifdef IP_ENABLE_METRICS
+	#ifdef IP_ENABLE_CONTENTION_COUNTERS
+		ip_my_contention_counters->counts[IP_CONTENTION_SENDS]++;
+	#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+	#ifdef IP_USE_BLOCKS
+		if(ip_try_send_message_in_block(id, message))
+		{
+			return;
+		}
+	#endif // ifdef IP_USE_BLOCKS
+	#ifdef IP_USE_HUB_MAILBOXES
+		if(ip_try_send_message_to_hub(id, message))
+		{
+			return;
+		}
+	#endif // ifdef IP_USE_HUB_MAILBOXES
+	#ifdef IP_USE_SEND_CACHE
+		if(ip_cache_message(&id, &message))
+		{
+			return;
+		}
+		// The message has been cached in place of another one, which is sent instead.
+	#endif // ifdef IP_USE_SEND_CACHE
+	ip_send_message_to_mailbox(id, message);
+}
+
+#ifdef IP_USE_HUB_MAILBOXES
+void ip_deliver_hub_message(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message)
+{
+	// Hubs only receive messages through their private mailboxes, so this is the first and only write this superstep.
+	#ifdef IP_USE_SOA_LAYOUT
+		size_t location = ip_get_vertex_by_id(id) - ip_all_vertices;
+		ip_all_mailboxes[location].message_next = message;
+		ip_all_has_message_next[location] = true;
+	#else
+		struct ip_vertex_t* temp_vertex = ip_get_vertex_by_id(id);
+		temp_vertex->message_next = message;
+		temp_vertex->has_message_next = true;
+	#endif // if(n)def IP_USE_SOA_LAYOUT
+	#ifdef IP_ENABLE_CONTENTION_COUNTERS
+		ip_my_contention_counters->counts[IP_CONTENTION_FIRST_WRITE_MESSAGES]++;
+	#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+}
+#endif // ifdef IP_USE_HUB_MAILBOXES
 
 void ip_broadcast(struct ip_vertex_t* v, IP_MESSAGE_TYPE message)
 {
-	for(IP_NEIGHBOUR_COUNT_TYPE i = 0; i < v->out_neighbour_count; i++)
+	IP_VERTEX_ID_TYPE* out_neighbours = ip_get_out_neighbours(v);
+	IP_NEIGHBOUR_COUNT_TYPE out_neighbour_count = ip_get_out_neighbour_count(v);
+	for(IP_NEIGHBOUR_COUNT_TYPE i = 0; i < out_neighbour_count; i++)
 	{
-		ip_send_message(v->out_neighbours[i], message);
+		ip_send_message(out_neighbours[i], message);
 	}
+	#ifdef IP_ENABLE_METRICS
+		ip_my_thread_metrics->edge_count += out_neighbour_count;
+	#endif // ifdef IP_ENABLE_METRICS
+	#ifdef IP_USE_DYNAMIC_GRAPH
+		ip_broadcast_to_delta(v, message);
+	#endif // ifdef IP_USE_DYNAMIC_GRAPH
 }
 
 void ip_init_vertex_range(IP_VERTEX_ID_TYPE first, IP_VERTEX_ID_TYPE last)
 {
 	for(IP_VERTEX_ID_TYPE i = first; i <= last; i++)
 	{
-		ip_all_vertices[i].id = i;
-		ip_all_vertices[i].active = true;
-		ip_all_vertices[i].has_message = false;
-		ip_all_vertices[i].has_message_next = false;
-		#ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
+		#ifndef IP_USE_COMPACT_LAYOUT
+			#if defined(IP_ID_OFFSET) && !defined(IP_FORCE_DIRECT_MAPPING)
+				ip_all_vertices[i].id = i + IP_ID_OFFSET;
+			#else
+				ip_all_vertices[i].id = i;
+			#endif // if defined(IP_ID_OFFSET) && !defined(IP_FORCE_DIRECT_MAPPING)
+		#endif // ifndef IP_USE_COMPACT_LAYOUT
+		#ifdef IP_USE_SOA_LAYOUT
+			ip_all_active[i] = true;
+			ip_all_has_message[i] = false;
+			atomic_init(&ip_all_has_message_next[i], false);
+			ip_lock_init(&ip_all_mailboxes[i].lock);
+		#else
+			ip_all_vertices[i].active = true;
+			ip_all_vertices[i].has_message = false;
+			ip_all_vertices[i].has_message_next = false;
+			ip_lock_init(&ip_all_vertices[i].lock);
+		#endif // if(n)def IP_USE_SOA_LAYOUT
+		#ifdef IP_USE_BLOCKS
+			ip_all_vertices[i].has_message_local = false;
+		#endif // ifdef IP_USE_BLOCKS
+		#if defined(IP_NEEDS_OUT_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 			ip_all_vertices[i].out_neighbour_count = 0;
-		#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
-		#ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+		#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
+		#if defined(IP_NEEDS_OUT_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 			ip_all_vertices[i].out_neighbours = NULL;
-		#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+		#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 		#ifdef IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS
 			ip_all_vertices[i].out_neighbour_weights = NULL;
 		#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS
-		#ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+		#if defined(IP_NEEDS_IN_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 			ip_all_vertices[i].in_neighbours = NULL;
-		#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
-		#ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+		#endif // if defined(IP_NEEDS_IN_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
+		#if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 			ip_all_vertices[i].in_neighbour_count = 0;
-		#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+		#endif // if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 		#ifdef IP_NEEDS_IN_NEIGHBOUR_WEIGHTS
 			ip_all_vertices[i].in_neighbour_weights = NULL;
 		#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_WEIGHT
-		ip_lock_init(&ip_all_vertices[i].lock);
 	}
 }
 
+void ip_set_initial_frontier(const IP_VERTEX_ID_TYPE* ids, size_t count)
+{
+	// Only the vertices of the frontier are active; the others run once they receive a message.
+	#ifdef IP_USE_SOA_LAYOUT
+		#pragma omp parallel for default(none) shared(ip_all_active)
+	#else
+		#pragma omp parallel for default(none)
+	#endif // if(n)def IP_USE_SOA_LAYOUT
+	for(size_t i = 0; i < ip_get_vertices_count(); i++)
+	{
+		#ifdef IP_USE_SOA_LAYOUT
+			ip_all_active[i] = false;
+		#else
+			ip_get_vertex_by_location(i)->active = false;
+		#endif // if(n)def IP_USE_SOA_LAYOUT
+	}
+
+	#ifdef IP_USE_SOA_LAYOUT
+		#pragma omp parallel for default(none) shared(ids, count, ip_all_active, ip_all_vertices)
+	#else
+		#pragma omp parallel for default(none) shared(ids, count)
+	#endif // if(n)def IP_USE_SOA_LAYOUT
+	for(size_t i = 0; i < count; i++)
+	{
+		#ifdef IP_USE_SOA_LAYOUT
+			ip_all_active[ip_get_vertex_by_id(ids[i]) - ip_all_vertices] = true;
+		#else
+			ip_get_vertex_by_id(ids[i])->active = true;
+		#endif // if(n)def IP_USE_SOA_LAYOUT
+	}
+	ip_active_vertices = count;
+}
+
+#ifdef IP_USE_CHECKPOINTS
+void ip_save_vertex_state(size_t location, bool* active, bool* has_message, IP_MESSAGE_TYPE* message)
+{
+	#ifdef IP_USE_SOA_LAYOUT
+		*active = ip_all_active[location];
+		*has_message = ip_all_has_message[location];
+		*message = ip_all_messages[location];
+	#else
+		struct ip_vertex_t* v = ip_get_vertex_by_location(location);
+		*active = v->active;
+		*has_message = v->has_message;
+		*message = v->message;
+	#endif // if(n)def IP_USE_SOA_LAYOUT
+}
+
+void ip_restore_vertex_state(size_t location, bool active, bool has_message, IP_MESSAGE_TYPE message)
+{
+	#ifdef IP_USE_SOA_LAYOUT
+		ip_all_active[location] = active;
+		ip_all_has_message[location] = has_message;
+		ip_all_messages[location] = message;
+	#else
+		struct ip_vertex_t* v = ip_get_vertex_by_location(location);
+		v->active = active;
+		v->has_message = has_message;
+		v->message = message;
+	#endif // if(n)def IP_USE_SOA_LAYOUT
+}
+
+const IP_VERTEX_ID_TYPE* ip_get_frontier(size_t* count)
+{
+	// Every vertex is scanned at every superstep, there is no frontier.
+	*count = 0;
+	return NULL;
+}
+#endif // ifdef IP_USE_CHECKPOINTS
+
 void ip_init_specific()
 {
+	#ifdef IP_USE_SOA_LAYOUT
+		// Vertices are initialised in parallel right after, so each thread touches first the part of these arrays it will scan.
+		ip_all_active = (bool*)ip_safe_tagged_malloc(sizeof(bool) * ip_get_vertices_count(), IP_MEMORY_VERTICES);
+		ip_all_has_message = (bool*)ip_safe_tagged_malloc(sizeof(bool) * ip_get_vertices_count(), IP_MEMORY_MAILBOXES);
+		ip_all_has_message_next = (atomic_bool*)ip_safe_tagged_malloc(sizeof(atomic_bool) * ip_get_vertices_count(), IP_MEMORY_MAILBOXES);
+		ip_all_messages = (IP_MESSAGE_TYPE*)ip_safe_tagged_malloc(sizeof(IP_MESSAGE_TYPE) * ip_get_vertices_count(), IP_MEMORY_MAILBOXES);
+		ip_all_mailboxes = (struct ip_mailbox_t*)ip_safe_tagged_malloc(sizeof(struct ip_mailbox_t) * ip_get_vertices_count(), IP_MEMORY_MAILBOXES);
+		printf("\t- Vertex state split in arrays of %zu bytes per vertex, topology and value in vertices of %zu bytes.\n", sizeof(bool) * 2 + sizeof(atomic_bool) + sizeof(IP_MESSAGE_TYPE) + sizeof(struct ip_mailbox_t), sizeof(struct ip_vertex_t));
+	#endif // ifdef IP_USE_SOA_LAYOUT
+	ip_lock_configure(ip_thread_count);
+	#ifdef IP_USE_SEND_CACHE
+		ip_init_send_cache();
+	#endif // ifdef IP_USE_SEND_CACHE
+}
+
+void ip_predict_memory_specific(size_t bytes[IP_MEMORY_TAG_COUNT])
+{
+	(void)bytes;
+	#ifdef IP_USE_SOA_LAYOUT
+		bytes[IP_MEMORY_VERTICES] += sizeof(bool) * ip_get_vertices_count();
+		bytes[IP_MEMORY_MAILBOXES] += (sizeof(bool) + sizeof(atomic_bool) + sizeof(IP_MESSAGE_TYPE) + sizeof(struct ip_mailbox_t)) * ip_get_vertices_count();
+	#endif // ifdef IP_USE_SOA_LAYOUT
+	#ifdef IP_USE_SEND_CACHE
+		bytes[IP_MEMORY_MAILBOXES] += sizeof(struct ip_send_cache_entry_t) * IP_SEND_CACHE_SIZE * ip_thread_count;
+	#endif // ifdef IP_USE_SEND_CACHE
+	#ifdef IP_USE_DYNAMIC_GRAPH
+		bytes[IP_MEMORY_ADJACENCY] += sizeof(struct ip_delta_t) * ip_get_vertices_count();
+		bytes[IP_MEMORY_FRONTIERS] += (sizeof(atomic_bool) + sizeof(IP_VERTEX_ID_TYPE)) * ip_get_vertices_count();
+	#endif // ifdef IP_USE_DYNAMIC_GRAPH
+	#ifdef IP_USE_BLOCKS
+		// The block of each vertex, the vertices grouped by block, and a queue per thread as large as the largest block, assuming blocks of consecutive vertices.
+		size_t block_count = (ip_get_vertices_count() + IP_BLOCK_SIZE - 1) / IP_BLOCK_SIZE;
+		size_t largest_block_size = ip_get_vertices_count() < IP_BLOCK_SIZE ? ip_get_vertices_count() : IP_BLOCK_SIZE;
+		bytes[IP_MEMORY_OTHER] += sizeof(size_t) * (2 * ip_get_vertices_count() + block_count + 1 + largest_block_size * ip_thread_count);
+	#endif // ifdef IP_USE_BLOCKS
+}
+
+void ip_reset_specific()
+{
+	#ifdef IP_USE_SOA_LAYOUT
+		#pragma omp parallel for default(none) shared(ip_all_active, ip_all_has_message, ip_all_has_message_next)
+	#else
+		#pragma omp parallel for default(none)
+	#endif // if(n)def IP_USE_SOA_LAYOUT
+	for(size_t i = 0; i < ip_get_vertices_count(); i++)
+	{
+		#ifdef IP_USE_SOA_LAYOUT
+			ip_all_active[i] = true;
+			ip_all_has_message[i] = false;
+			ip_all_has_message_next[i] = false;
+		#else
+			struct ip_vertex_t* v = ip_get_vertex_by_location(i);
+			v->active = true;
+			v->has_message = false;
+			v->has_message_next = false;
+		#endif // if(n)def IP_USE_SOA_LAYOUT
+		#ifdef IP_USE_BLOCKS
+			v->has_message_local = false;
+		#endif // ifdef IP_USE_BLOCKS
+	}
 }
 
 int ip_run()
@@ -126,12 +395,32 @@ int ip_run()
 	double timer_superstep_start = 0;
 	double timer_superstep_stop = 0;
 
-	#pragma omp parallel default(none) shared(ip_active_vertices, \
-											  timer_superstep_total, \
-											  timer_superstep_start, \
-											  timer_superstep_stop)
+	#ifdef IP_ENABLE_METRICS
+		ip_start_metrics_run();
+	#endif // ifdef IP_ENABLE_METRICS
+	#ifdef IP_ENABLE_CONTENTION_COUNTERS
+		ip_start_contention_run();
+	#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+	ip_start_run();
+
+	#ifdef IP_USE_SOA_LAYOUT
+		#pragma omp parallel default(none) shared(ip_active_vertices, \
+												  ip_all_active, \
+												  ip_all_has_message, \
+												  ip_all_has_message_next, \
+												  ip_all_messages, \
+												  ip_all_mailboxes, \
+												  timer_superstep_total, \
+												  timer_superstep_start, \
+												  timer_superstep_stop)
+	#else
+		#pragma omp parallel default(none) shared(ip_active_vertices, \
+												  timer_superstep_total, \
+												  timer_superstep_start, \
+												  timer_superstep_stop)
+	#endif // if(n)def IP_USE_SOA_LAYOUT
 	{
-		while(ip_active_vertices != 0)
+		while(!ip_is_computation_halted() && ip_active_vertices != 0)
 		{
 			// This barrier is crucial; otherwise a thread may enter the single, change ip_active_vertices before one other thread has entered the loop. Thus the single would never complete.
 			#pragma omp barrier
@@ -145,80 +434,211 @@ int ip_run()
 				timer_superstep_start = omp_get_wtime();
 				ip_active_vertices = 0;
 			}
+			#ifdef IP_ENABLE_METRICS
+				ip_start_metrics_superstep();
+			#endif // ifdef IP_ENABLE_METRICS
+			#ifdef IP_ENABLE_CONTENTION_COUNTERS
+				ip_start_contention_superstep();
+			#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
 
-			struct ip_vertex_t* temp_vertex = NULL;
+			#ifndef IP_USE_SOA_LAYOUT
+				struct ip_vertex_t* temp_vertex = NULL;
+			#endif // ifndef IP_USE_SOA_LAYOUT
 
-			#pragma omp for reduction(+:ip_active_vertices) schedule(runtime)
-			for(size_t i = 0; i < ip_get_vertices_count(); i++)
-			{
-				temp_vertex = ip_get_vertex_by_location(i);
-				if(temp_vertex->active || ip_has_message(temp_vertex))
+			#ifdef IP_USE_BLOCKS
+				// Blocks differ widely in the number of local runs they need, so they are handed out one at a time.
+				#if defined(IP_USE_SEND_CACHE) || defined(IP_ENABLE_METRICS)
+					#pragma omp for reduction(+:ip_active_vertices) schedule(dynamic, 1) nowait
+				#else
+					#pragma omp for reduction(+:ip_active_vertices) schedule(dynamic, 1)
+				#endif // if defined(IP_USE_SEND_CACHE) || defined(IP_ENABLE_METRICS)
+				for(size_t i = 0; i < ip_get_block_count(); i++)
 				{
-					temp_vertex->active = true;
-					ip_compute(temp_vertex);
-					if(temp_vertex->active)
-					{
-						ip_active_vertices++;
-					}
+					ip_active_vertices += ip_run_block(i);
 				}
-			}
+			#else
+				#if defined(IP_USE_SEND_CACHE) || defined(IP_ENABLE_METRICS)
+					#pragma omp for reduction(+:ip_active_vertices) schedule(runtime) nowait
+				#else
+					#pragma omp for reduction(+:ip_active_vertices) schedule(runtime)
+				#endif // if defined(IP_USE_SEND_CACHE) || defined(IP_ENABLE_METRICS)
+				for(size_t i = 0; i < ip_get_vertices_count(); i++)
+				{
+					#ifdef IP_USE_SOA_LAYOUT
+						// Only the status arrays are scanned; the vertex itself is touched only if it runs.
+						if(ip_all_active[i] || ip_all_has_message[i])
+						{
+							ip_all_active[i] = true;
+							ip_compute(ip_get_vertex_by_location(i));
+							#ifdef IP_ENABLE_METRICS
+								ip_record_metrics_vertex(ip_get_vertex_by_location(i));
+							#endif // ifdef IP_ENABLE_METRICS
+							if(ip_all_active[i])
+							{
+								ip_active_vertices++;
+							}
+						}
+					#else
+						temp_vertex = ip_get_vertex_by_location(i);
+						if(temp_vertex->active || ip_has_message(temp_vertex))
+						{
+							temp_vertex->active = true;
+							ip_compute(temp_vertex);
+							#ifdef IP_ENABLE_METRICS
+								ip_record_metrics_vertex(temp_vertex);
+							#endif // ifdef IP_ENABLE_METRICS
+							if(temp_vertex->active)
+							{
+								ip_active_vertices++;
+							}
+						}
+					#endif // if(n)def IP_USE_SOA_LAYOUT
+				}
+			#endif // if(n)def IP_USE_BLOCKS
+			#if defined(IP_ENABLE_METRICS) && !defined(IP_USE_SEND_CACHE)
+				ip_start_metrics_wait();
+				#pragma omp barrier
+			#endif // if defined(IP_ENABLE_METRICS) && !defined(IP_USE_SEND_CACHE)
+			#ifdef IP_ENABLE_METRICS
+				ip_stop_metrics_phase(IP_METRICS_COMPUTE);
+			#endif // ifdef IP_ENABLE_METRICS
+
+			#ifdef IP_USE_SEND_CACHE
+				// Messages still cached must reach their mailbox before any thread swaps mailboxes.
+				ip_flush_send_cache();
+				#ifdef IP_ENABLE_METRICS
+					ip_start_metrics_wait();
+				#endif // ifdef IP_ENABLE_METRICS
+				#pragma omp barrier
+				#ifdef IP_ENABLE_METRICS
+					ip_stop_metrics_wait();
+				#endif // ifdef IP_ENABLE_METRICS
+			#endif // ifdef IP_USE_SEND_CACHE
+
+			#ifdef IP_USE_HUB_MAILBOXES
+				// Hubs received their messages in private mailboxes, deliver them before the mailboxes are swapped.
+				ip_reduce_hub_mailboxes();
+			#endif // ifdef IP_USE_HUB_MAILBOXES
+			#ifdef IP_ENABLE_METRICS
+				ip_stop_metrics_phase(IP_METRICS_MERGE);
+			#endif // ifdef IP_ENABLE_METRICS
 
 			// Take in account the number of vertices that halted.
 			// Swap the message boxes for next superstep.
-			#pragma omp for reduction(+:ip_active_vertices) schedule(runtime)
+			#ifdef IP_ENABLE_METRICS
+				#pragma omp for reduction(+:ip_active_vertices) schedule(runtime) nowait
+			#else
+				#pragma omp for reduction(+:ip_active_vertices) schedule(runtime)
+			#endif // if(n)def IP_ENABLE_METRICS
 			for(size_t i = 0; i < ip_get_vertices_count(); i++)
 			{
-				temp_vertex = ip_get_vertex_by_location(i);
-				if(temp_vertex->has_message_next)
-				{
-					temp_vertex->has_message = true;
-					temp_vertex->message = temp_vertex->message_next;
-					temp_vertex->has_message_next = false;
-					if(!temp_vertex->active)
+				#ifdef IP_USE_SOA_LAYOUT
+					if(ip_all_has_message_next[i])
 					{
-						temp_vertex->active = true;
-						ip_active_vertices++;
+						ip_all_has_message[i] = true;
+						ip_all_messages[i] = ip_all_mailboxes[i].message_next;
+						ip_all_has_message_next[i] = false;
+						if(!ip_all_active[i])
+						{
+							ip_all_active[i] = true;
+							ip_active_vertices++;
+						}
 					}
-				}
+				#else
+					temp_vertex = ip_get_vertex_by_location(i);
+					if(temp_vertex->has_message_next)
+					{
+						temp_vertex->has_message = true;
+						temp_vertex->message = temp_vertex->message_next;
+						temp_vertex->has_message_next = false;
+						if(!temp_vertex->active)
+						{
+							temp_vertex->active = true;
+							ip_active_vertices++;
+						}
+					}
+				#endif // if(n)def IP_USE_SOA_LAYOUT
 			}
+			#ifdef IP_ENABLE_METRICS
+				ip_start_metrics_wait();
+				#pragma omp barrier
+			#endif // ifdef IP_ENABLE_METRICS
 
+			// The mailbox phase ends after this single, so that the threads waiting for it are counted as waiting.
 			#pragma omp single
 			{
+				#ifdef IP_ENABLE_METRICS
+					ip_stop_metrics_wait();
+				#endif // ifdef IP_ENABLE_METRICS
 				timer_superstep_stop = omp_get_wtime();
 				timer_superstep_total += timer_superstep_stop - timer_superstep_start;
 				printf("Superstep%zuDuration:%f\n", ip_get_superstep(), timer_superstep_stop - timer_superstep_start);
 				printf("Superstep%zuActiveVertexCount:%zu\n", ip_get_superstep(), ip_active_vertices);
+				#ifdef IP_USE_BLOCKS
+					printf("Superstep%zuLocalComputeCount:%zu\n", ip_get_superstep(), ip_collect_local_compute_count());
+				#endif // ifdef IP_USE_BLOCKS
+				#ifdef IP_ENABLE_METRICS
+					ip_end_metrics_superstep(timer_superstep_stop - timer_superstep_start, ip_active_vertices);
+				#endif // ifdef IP_ENABLE_METRICS
+				#ifdef IP_ENABLE_CONTENTION_COUNTERS
+					ip_collect_contention_counters();
+				#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+				#ifdef IP_ENABLE_MEMORY_ACCOUNTING
+					ip_report_superstep_memory();
+				#endif // ifdef IP_ENABLE_MEMORY_ACCOUNTING
+				ip_reduce_aggregators();
 				ip_increment_superstep();
+				#ifdef IP_NEEDS_MASTER_COMPUTE
+					ip_master_compute();
+				#endif // ifdef IP_NEEDS_MASTER_COMPUTE
+				#ifdef IP_USE_CHECKPOINTS
+					ip_plan_checkpoint();
+				#endif // ifdef IP_USE_CHECKPOINTS
+				#ifdef IP_ENABLE_METRICS
+					ip_start_metrics_wait();
+				#endif // ifdef IP_ENABLE_METRICS
  			} // End of OpenMP single region
+			#ifdef IP_ENABLE_METRICS
+				ip_stop_metrics_phase(IP_METRICS_MAILBOX);
+			#endif // ifdef IP_ENABLE_METRICS
+
+			#ifdef IP_USE_CHECKPOINTS
+				// The single above ends with a barrier, so every thread sees the same decision.
+				if(ip_is_checkpoint_planned())
+				{
+					ip_take_checkpoint();
+				}
+			#endif // ifdef IP_USE_CHECKPOINTS
 		} // End of superstep processing loop
  	} // End of OpenMP region
 
+	#ifdef IP_USE_CHECKPOINTS
+		ip_wait_for_checkpoint();
+	#endif // ifdef IP_USE_CHECKPOINTS
 	printf("Total time of supersteps: %fs.\n", timer_superstep_total);
+	#ifdef IP_ENABLE_CAS_STATISTICS
+		ip_report_cas_statistics();
+	#endif // ifdef IP_ENABLE_CAS_STATISTICS
+	#ifdef IP_ENABLE_CONTENTION_COUNTERS
+		ip_report_contention_counters();
+	#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+	#if defined(IP_USE_SEND_CACHE) && defined(IP_ENABLE_THREAD_PROFILING)
+		ip_report_send_cache_statistics();
+	#endif // if defined(IP_USE_SEND_CACHE) && defined(IP_ENABLE_THREAD_PROFILING)
+	#ifdef IP_ENABLE_METRICS
+		ip_stop_metrics_run();
+	#endif // ifdef IP_ENABLE_METRICS
 
 	return 0;
 }
 
 void ip_vote_to_halt(struct ip_vertex_t* v)
 {
-	v->active = false;
-}
-
-
-void ip_lock_init(IP_LOCK_TYPE* lock)
-{
-	*lock = 0;
-}
-
-void ip_lock_acquire(IP_LOCK_TYPE* lock)
-{
-	int zero = 0;
-	while(!atomic_compare_exchange_strong(lock, &zero, 1))
-		zero = 0;
-}
-
-void ip_lock_release(IP_LOCK_TYPE* lock)
-{
-	atomic_store(lock, 0);
+	#ifdef IP_USE_SOA_LAYOUT
+		ip_all_active[v - ip_all_vertices] = false;
+	#else
+		v->active = false;
+	#endif // if(n)def IP_USE_SOA_LAYOUT
 }
 
 #endif // COMBINER_POSTAMBLE_H_INCLUDED
@@ -27,29 +27,28 @@
 #endif // ifndef IP_NEEDS_OUT_NEIGHBOUR_COUNT
 
 #include <stdatomic.h> 
+#include "lock.h"
 
 // Global variables
-/// The data structure representing a lock.
-typedef volatile atomic_int IP_LOCK_TYPE;	
 /// This structure defines the structure of a vertex.
 struct ip_vertex_t
 {
-	#ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+	#if defined(IP_NEEDS_OUT_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 		/// Contains the identifiers of the out-neighbours
 		IP_VERTEX_ID_TYPE* out_neighbours;
-	#endif // IP_NEEDS_OUT_NEIGHBOUR_IDS
-	#ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+	#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
+	#if defined(IP_NEEDS_IN_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 		/// Contains the identifiers of the in-neighbours
 		IP_VERTEX_ID_TYPE* in_neighbours;
-	#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
-	#ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
+	#endif // if defined(IP_NEEDS_IN_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
+	#if defined(IP_NEEDS_OUT_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 		/// Contains the number of out-neighbours
 		IP_NEIGHBOUR_COUNT_TYPE out_neighbour_count;
-	#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
-	#ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+	#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
+	#if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 		/// Contains the number of in-neighbours
 		IP_NEIGHBOUR_COUNT_TYPE in_neighbour_count;
-	#endif // IP_NEEDS_IN_NEIGHBOUR_COUNT
+	#endif // if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 	#ifdef IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS
 		/// Contains the weights of out-edges
 		IP_EDGE_WEIGHT_TYPE* out_neighbour_weights;
@@ -58,38 +57,54 @@ struct ip_vertex_t
 		/// Contains the weights of the in-neighbours
 		IP_EDGE_WEIGHT_TYPE* in_neighbour_weights;
 	#endif // IP_NEEDS_IN_NEIGHBOUR_WEIGHTS
-	/// Contains the vertex status
-	bool active;
-	/// Indicates whether the vertex has received messages during the previous superstep
-	bool has_message;
-	/// Indicates whether the vertex has received message during the current superstep so far
-	atomic_bool has_message_next;
-	/// Mailbox lock
-	IP_LOCK_TYPE lock;
-	/// Contains the vertex identifier
-	IP_VERTEX_ID_TYPE id;
-	/// Contains the combined message resulting from messages received during previous superstep
-	IP_MESSAGE_TYPE message;
-	/// Contains the combined message resulting from messages received during current superstep so far
-	IP_MESSAGE_TYPE message_next;
+	#ifndef IP_USE_SOA_LAYOUT
+		/// Contains the vertex status
+		bool active;
+		/// Indicates whether the vertex has received messages during the previous superstep
+		bool has_message;
+		/// Indicates whether the vertex has received message during the current superstep so far
+		atomic_bool has_message_next;
+		/// Mailbox lock
+		IP_LOCK_TYPE lock;
+	#endif // ifndef IP_USE_SOA_LAYOUT
+	#ifndef IP_USE_COMPACT_LAYOUT
+		/// Contains the vertex identifier
+		IP_VERTEX_ID_TYPE id;
+	#endif // ifndef IP_USE_COMPACT_LAYOUT
+	#ifndef IP_USE_SOA_LAYOUT
+		/// Contains the combined message resulting from messages received during previous superstep
+		IP_MESSAGE_TYPE message;
+		/// Contains the combined message resulting from messages received during current superstep so far
+		_Alignas(IP_MAILBOX_ALIGNMENT) IP_MESSAGE_TYPE message_next;
+	#endif // ifndef IP_USE_SOA_LAYOUT
+	#ifdef IP_USE_BLOCKS
+		/// Indicates whether the vertex has received messages from its block that it has not run on yet
+		bool has_message_local;
+		/// Contains the combined message resulting from the messages received from its block, written by the thread running the block only
+		IP_MESSAGE_TYPE message_local;
+	#endif // ifdef IP_USE_BLOCKS
 	/// Contains the user-defined value
 	IP_VALUE_TYPE value;
 };
-
-/**
- * @brief This function initialises the lock \p lock.
- * @param[in] lock The lock to initialise.
- **/
-void ip_lock_init(IP_LOCK_TYPE* lock);
-/**
- * @brief This function acquires the lock \p lock.
- * @param[in] lock The lock to acquire.
- **/
-void ip_lock_acquire(IP_LOCK_TYPE* lock);
-/**
- * @brief This function releases the lock \p lock.
- * @param[in] lock The lock to release.
- **/
-void ip_lock_release(IP_LOCK_TYPE* lock);
+#ifdef IP_USE_SOA_LAYOUT
+	/// This structure holds the mailbox in which a vertex receives messages during the current superstep.
+	struct ip_mailbox_t
+	{
+		/// Mailbox lock
+		IP_LOCK_TYPE lock;
+		/// Contains the combined message resulting from messages received during current superstep so far
+		_Alignas(IP_MAILBOX_ALIGNMENT) IP_MESSAGE_TYPE message_next;
+	};
+	/// Contains the status of every vertex, indexed by vertex location.
+	bool* ip_all_active = NULL;
+	/// Indicates, for every vertex, whether it has received messages during the previous superstep.
+	bool* ip_all_has_message = NULL;
+	/// Indicates, for every vertex, whether it has received messages during the current superstep so far.
+	atomic_bool* ip_all_has_message_next = NULL;
+	/// Contains, for every vertex, the combined message resulting from messages received during previous superstep.
+	IP_MESSAGE_TYPE* ip_all_messages = NULL;
+	/// Contains the mailbox of every vertex for the current superstep.
+	struct ip_mailbox_t* ip_all_mailboxes = NULL;
+#endif // ifdef IP_USE_SOA_LAYOUT
 
 #endif // COMBINER_PREAMBLE_H_INCLUDED
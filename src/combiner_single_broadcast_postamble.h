@@ -19,6 +19,9 @@
 #define SINGLE_BROADCAST_POSTAMBLE_H_INCLUDED
 
 #include <omp.h>
+#ifdef IP_ENABLE_METRICS
+	#include "metrics.h"
+#endif // ifdef IP_ENABLE_METRICS
 
 int ip_my_thread_num;
 #pragma omp threadprivate(ip_my_thread_num)
@@ -50,19 +53,27 @@ version; only broadcast() should be called, and once per superstep maximum.\n");
 
 void ip_broadcast(struct ip_vertex_t* v, IP_MESSAGE_TYPE message)
 {
-	ip_all_neighbour_extras[v->id].has_broadcast_message = true;
-	ip_all_neighbour_extras[v->id].broadcast_message = message;
+	ip_all_neighbour_extras[v - ip_all_vertices].has_broadcast_message = true;
+	ip_all_neighbour_extras[v - ip_all_vertices].broadcast_message = message;
+	#ifdef IP_ENABLE_METRICS
+		ip_my_thread_metrics->message_count++;
+	#endif // ifdef IP_ENABLE_METRICS
 }
 
 void ip_fetch_broadcast_messages(struct ip_vertex_t* v)
 {
+	IP_VERTEX_ID_TYPE* in_neighbours = ip_get_in_neighbours(v);
+	IP_NEIGHBOUR_COUNT_TYPE in_neighbour_count = ip_get_in_neighbour_count(v);
 	IP_NEIGHBOUR_COUNT_TYPE i = 0;
-	while(i < v->in_neighbour_count && !ip_all_neighbour_extras[v->in_neighbours[i]].has_broadcast_message)
+	#ifdef IP_ENABLE_METRICS
+		ip_record_metrics_fetch(v, in_neighbour_count);
+	#endif // ifdef IP_ENABLE_METRICS
+	while(i < in_neighbour_count && !ip_all_neighbour_extras[ip_get_vertex_by_id(in_neighbours[i]) - ip_all_vertices].has_broadcast_message)
 	{
 		i++;
 	}
 
-	if(i >= v->in_neighbour_count)
+	if(i >= in_neighbour_count)
 	{
 		v->has_message = false;
 	}
@@ -75,13 +86,13 @@ void ip_fetch_broadcast_messages(struct ip_vertex_t* v)
 			v->active = true;
 		}
 		v->has_message = true;
-		v->message = ip_all_neighbour_extras[v->in_neighbours[i]].broadcast_message;
+		v->message = ip_all_neighbour_extras[ip_get_vertex_by_id(in_neighbours[i]) - ip_all_vertices].broadcast_message;
 		i++;
-		while(i < v->in_neighbour_count)
+		while(i < in_neighbour_count)
 		{
-			if(ip_all_neighbour_extras[v->in_neighbours[i]].has_broadcast_message)
+			if(ip_all_neighbour_extras[ip_get_vertex_by_id(in_neighbours[i]) - ip_all_vertices].has_broadcast_message)
 			{
-				ip_combine(&v->message, ip_all_neighbour_extras[v->in_neighbours[i]].broadcast_message);
+				ip_combine(&v->message, ip_all_neighbour_extras[ip_get_vertex_by_id(in_neighbours[i]) - ip_all_vertices].broadcast_message);
 			}
 			i++;
 		}
@@ -92,34 +103,89 @@ void ip_init_vertex_range(IP_VERTEX_ID_TYPE first, IP_VERTEX_ID_TYPE last)
 {
 	for(IP_VERTEX_ID_TYPE i = first; i <= last; i++)
 	{
-		ip_all_vertices[i].id = i;
+		#ifndef IP_USE_COMPACT_LAYOUT
+			#if defined(IP_ID_OFFSET) && !defined(IP_FORCE_DIRECT_MAPPING)
+				ip_all_vertices[i].id = i + IP_ID_OFFSET;
+			#else
+				ip_all_vertices[i].id = i;
+			#endif // if defined(IP_ID_OFFSET) && !defined(IP_FORCE_DIRECT_MAPPING)
+		#endif // ifndef IP_USE_COMPACT_LAYOUT
 		ip_all_vertices[i].active = true;
 		ip_all_vertices[i].has_message = false;
 		ip_all_neighbour_extras[i].has_broadcast_message = false;
-		#ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
+		#if defined(IP_NEEDS_OUT_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 			ip_all_vertices[i].out_neighbour_count = 0;
-		#endif // IP_NEEDS_OUT_NEIGHBOUR_COUNT
-		#ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+		#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
+		#if defined(IP_NEEDS_OUT_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 			ip_all_vertices[i].out_neighbours = NULL;
-		#endif // IP_NEEDS_OUT_NEIGHBOUR_IDS
+		#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 		#ifdef IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS
 			ip_all_vertices[i].out_neighbour_weights = NULL;
 		#endif // IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS
-		#ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+		#if defined(IP_NEEDS_IN_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 			ip_all_vertices[i].in_neighbours = NULL;
-		#endif
-		#ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+		#endif // if defined(IP_NEEDS_IN_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
+		#if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 			ip_all_vertices[i].in_neighbour_count = 0;
-		#endif // IP_NEEDS_IN_NEIGHBOUR_COUNT
+		#endif // if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 		#ifdef IP_NEEDS_IN_NEIGHBOUR_WEIGHTS
 			ip_all_vertices[i].in_neighbour_weights = NULL;
 		#endif // IP_NEEDS_IN_NEIGHBOUR_WEIGHT
 	}
 }
 
+void ip_set_initial_frontier(const IP_VERTEX_ID_TYPE* ids, size_t count)
+{
+	// Without a frontier, every vertex runs the first superstep anyway.
+	(void)(ids);
+	(void)(count);
+}
+
+#ifdef IP_USE_CHECKPOINTS
+void ip_save_vertex_state(size_t location, bool* active, bool* has_message, IP_MESSAGE_TYPE* message)
+{
+	struct ip_vertex_t* v = ip_get_vertex_by_location(location);
+	*active = v->active;
+	*has_message = v->has_message;
+	*message = v->message;
+}
+
+void ip_restore_vertex_state(size_t location, bool active, bool has_message, IP_MESSAGE_TYPE message)
+{
+	struct ip_vertex_t* v = ip_get_vertex_by_location(location);
+	v->active = active;
+	v->has_message = has_message;
+	v->message = message;
+}
+
+const IP_VERTEX_ID_TYPE* ip_get_frontier(size_t* count)
+{
+	// Every vertex is scanned at every superstep, there is no frontier.
+	*count = 0;
+	return NULL;
+}
+#endif // ifdef IP_USE_CHECKPOINTS
+
 void ip_init_specific()
 {
-	ip_all_neighbour_extras = (struct ip_neighbour_extra_t*)ip_safe_malloc(sizeof(struct ip_neighbour_extra_t) * ip_get_vertices_count());
+	ip_all_neighbour_extras = (struct ip_neighbour_extra_t*)ip_safe_tagged_malloc(sizeof(struct ip_neighbour_extra_t) * ip_get_vertices_count(), IP_MEMORY_MAILBOXES);
+}
+
+void ip_predict_memory_specific(size_t bytes[IP_MEMORY_TAG_COUNT])
+{
+	bytes[IP_MEMORY_MAILBOXES] += sizeof(struct ip_neighbour_extra_t) * ip_get_vertices_count();
+}
+
+void ip_reset_specific()
+{
+	#pragma omp parallel for default(none) shared(ip_all_neighbour_extras)
+	for(size_t i = 0; i < ip_get_vertices_count(); i++)
+	{
+		struct ip_vertex_t* v = ip_get_vertex_by_location(i);
+		v->active = true;
+		v->has_message = false;
+		ip_all_neighbour_extras[i].has_broadcast_message = false;
+	}
 }
 
 int ip_run()
@@ -137,6 +203,11 @@ int ip_run()
 		double* timer_fetching_total = malloc(sizeof(double) * ip_thread_count);
 	#endif
 
+	#ifdef IP_ENABLE_METRICS
+		ip_start_metrics_run();
+	#endif // ifdef IP_ENABLE_METRICS
+	ip_start_run();
+
 	#ifdef IP_ENABLE_THREAD_PROFILING
 		#pragma omp parallel default(none) shared(ip_active_vertices, \
 												  ip_all_neighbour_extras, \
@@ -160,7 +231,7 @@ int ip_run()
 	#endif
 	{
 		ip_my_thread_num = omp_get_thread_num();
-		while(ip_active_vertices != 0)
+		while(!ip_is_computation_halted() && ip_active_vertices != 0)
 		{
 			// This barrier is crucial; otherwise a thread may enter the single, change ip_active_vertices before one other thread has entered the loop. Thus the single would never complete.
 			#pragma omp barrier
@@ -174,6 +245,9 @@ int ip_run()
 				timer_superstep_start = omp_get_wtime();
 				ip_active_vertices = 0;
 			}
+			#ifdef IP_ENABLE_METRICS
+				ip_start_metrics_superstep();
+			#endif // ifdef IP_ENABLE_METRICS
 
 			////////////////////
 			// COMPUTE PHASE //
@@ -182,14 +256,21 @@ int ip_run()
 				timer_compute_start[ip_my_thread_num] = omp_get_wtime();
 			#endif
 			struct ip_vertex_t* temp_vertex = NULL;
-			#pragma omp for reduction(+:ip_active_vertices) schedule(runtime)
+			#ifdef IP_ENABLE_METRICS
+				#pragma omp for reduction(+:ip_active_vertices) schedule(runtime) nowait
+			#else
+				#pragma omp for reduction(+:ip_active_vertices) schedule(runtime)
+			#endif // if(n)def IP_ENABLE_METRICS
 			for(size_t i = 0; i < ip_get_vertices_count(); i++)
 			{
 				temp_vertex = ip_get_vertex_by_location(i);	
-				ip_all_neighbour_extras[temp_vertex->id].has_broadcast_message = false;
+				ip_all_neighbour_extras[i].has_broadcast_message = false;
 				if(temp_vertex->active)
 				{
 					ip_compute(temp_vertex);
+					#ifdef IP_ENABLE_METRICS
+						ip_record_metrics_vertex(temp_vertex);
+					#endif // ifdef IP_ENABLE_METRICS
 					if(temp_vertex->active)
 					{
 						ip_active_vertices++;
@@ -202,6 +283,11 @@ int ip_run()
 			#ifdef IP_ENABLE_THREAD_PROFILING
 				timer_compute_total[ip_my_thread_num] = timer_compute_stop[ip_my_thread_num] - timer_compute_start[ip_my_thread_num];
 			#endif
+			#ifdef IP_ENABLE_METRICS
+				ip_start_metrics_wait();
+				#pragma omp barrier
+				ip_stop_metrics_phase(IP_METRICS_COMPUTE);
+			#endif // ifdef IP_ENABLE_METRICS
 
 			/////////////////////////////
 			// MESSAGE FETCHING PHASE //
@@ -210,7 +296,11 @@ int ip_run()
 			#ifdef IP_ENABLE_THREAD_PROFILING
 				timer_fetching_start[ip_my_thread_num] = omp_get_wtime();
 			#endif
-			#pragma omp for schedule(runtime)
+			#ifdef IP_ENABLE_METRICS
+				#pragma omp for schedule(runtime) nowait
+			#else
+				#pragma omp for schedule(runtime)
+			#endif // if(n)def IP_ENABLE_METRICS
 			for(size_t i = 0; i < ip_get_vertices_count(); i++)
 			{
 				ip_fetch_broadcast_messages(ip_get_vertex_by_location(i));
@@ -221,6 +311,11 @@ int ip_run()
 			#ifdef IP_ENABLE_THREAD_PROFILING
 				timer_fetching_total[ip_my_thread_num] = timer_fetching_stop[ip_my_thread_num] - timer_fetching_start[ip_my_thread_num];
 			#endif
+			#ifdef IP_ENABLE_METRICS
+				ip_start_metrics_wait();
+				#pragma omp barrier
+				ip_stop_metrics_phase(IP_METRICS_FETCH);
+			#endif // ifdef IP_ENABLE_METRICS
 			
 			#pragma omp single
 			{
@@ -228,6 +323,9 @@ int ip_run()
 				timer_superstep_total += timer_superstep_stop - timer_superstep_start;
 				printf("Superstep%zuDuration:%f\n", ip_get_superstep(), timer_superstep_stop - timer_superstep_start);
 				printf("Superstep%zuActiveVertexCount:%zu\n", ip_get_superstep(), ip_active_vertices);
+				#ifdef IP_ENABLE_METRICS
+					ip_end_metrics_superstep(timer_superstep_stop - timer_superstep_start, ip_active_vertices);
+				#endif // ifdef IP_ENABLE_METRICS
 				#ifdef IP_ENABLE_THREAD_PROFILING
 					printf("      +------------+----------+-----------+\n");
 					printf("      | Processing | Fetching |   Total   |\n");
@@ -238,12 +336,36 @@ int ip_run()
 					}
 					printf("+-----+------------+----------+-----------+\n");
 				#endif
+				#ifdef IP_ENABLE_MEMORY_ACCOUNTING
+					ip_report_superstep_memory();
+				#endif // ifdef IP_ENABLE_MEMORY_ACCOUNTING
+				ip_reduce_aggregators();
 				ip_increment_superstep();
+				#ifdef IP_NEEDS_MASTER_COMPUTE
+					ip_master_compute();
+				#endif // ifdef IP_NEEDS_MASTER_COMPUTE
+				#ifdef IP_USE_CHECKPOINTS
+					ip_plan_checkpoint();
+				#endif // ifdef IP_USE_CHECKPOINTS
  			} // End of OpenMP single region
+
+			#ifdef IP_USE_CHECKPOINTS
+				// The single above ends with a barrier, so every thread sees the same decision.
+				if(ip_is_checkpoint_planned())
+				{
+					ip_take_checkpoint();
+				}
+			#endif // ifdef IP_USE_CHECKPOINTS
 		} // End of superstep processing loop
  	} // End of OpenMP region
 
+	#ifdef IP_USE_CHECKPOINTS
+		ip_wait_for_checkpoint();
+	#endif // ifdef IP_USE_CHECKPOINTS
 	printf("Total time of supersteps: %fs.\n", timer_superstep_total);
+	#ifdef IP_ENABLE_METRICS
+		ip_stop_metrics_run();
+	#endif // ifdef IP_ENABLE_METRICS
 
 	#ifdef IP_ENABLE_THREAD_PROFILING
 		free(timer_compute_start);
@@ -253,7 +375,7 @@ int ip_run()
 		free(timer_fetching_stop);
 		free(timer_fetching_total);
 	#endif
-	free(ip_all_neighbour_extras);
+	// The broadcast messages are kept for the next run, see ip_reset().
 	
 	return 0;
 }
@@ -55,22 +55,22 @@ struct ip_neighbour_extra_t* ip_all_neighbour_extras = NULL;
  **/
 struct ip_vertex_t
 {
-	#ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+	#if defined(IP_NEEDS_OUT_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 		/// Contains the identifiers of the out-neighbours
 		IP_VERTEX_ID_TYPE* out_neighbours;
-	#endif // IP_NEEDS_OUT_NEIGHBOUR_IDS
-	#ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+	#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
+	#if defined(IP_NEEDS_IN_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 		/// Contains the identifiers of the in-neighbours
 		IP_VERTEX_ID_TYPE* in_neighbours;
-	#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
-	#ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
+	#endif // if defined(IP_NEEDS_IN_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
+	#if defined(IP_NEEDS_OUT_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 		/// Contains the number of out-neighbours
 		IP_NEIGHBOUR_COUNT_TYPE out_neighbour_count;
-	#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
-	#ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+	#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
+	#if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 		/// Contains the number of in-neighbours
 		IP_NEIGHBOUR_COUNT_TYPE in_neighbour_count;
-	#endif // IP_UNUSED_IN_NEIGHBOURS
+	#endif // if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 	#ifdef IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS
 		/// Contains the weights of out-edges
 		IP_EDGE_WEIGHT_TYPE* out_neighbour_weights;
@@ -83,8 +83,10 @@ struct ip_vertex_t
 	bool active;
 	/// Indicate whether the vertex has received messages from last superstep
 	bool has_message;
-	/// Contains the vertex identifier
-	IP_VERTEX_ID_TYPE id;
+	#ifndef IP_USE_COMPACT_LAYOUT
+		/// Contains the vertex identifier
+		IP_VERTEX_ID_TYPE id;
+	#endif // ifndef IP_USE_COMPACT_LAYOUT
 	/// Contains the combined message made from messages received from last superstep
 	IP_MESSAGE_TYPE message;
 	/// Contains the user-defined value
@@ -20,6 +20,22 @@
 
 #include <omp.h>
 #include <string.h>
+#include "message_width.h"
+#ifdef IP_ENABLE_METRICS
+	#include "metrics.h"
+#endif // ifdef IP_ENABLE_METRICS
+#ifdef IP_USE_HUB_MAILBOXES
+	#include "hub_mailbox.h"
+#endif // ifdef IP_USE_HUB_MAILBOXES
+#ifdef IP_USE_SEND_CACHE
+	#include "send_cache.h"
+#endif // ifdef IP_USE_SEND_CACHE
+#ifdef IP_USE_DYNAMIC_GRAPH
+	#include "dynamic_graph.h"
+#endif // ifdef IP_USE_DYNAMIC_GRAPH
+#ifdef IP_USE_LIGHT_SUPERSTEP
+	#include "superstep_driver.h"
+#endif // ifdef IP_USE_LIGHT_SUPERSTEP
 
 #define IP_CACHE_LINE_LENGTH sizeof(void*)
 
@@ -56,21 +72,12 @@ void ip_add_spread_vertex(IP_VERTEX_ID_TYPE id)
 	my_list->size++;
 }
 
-void ip_cas(IP_VERTEX_ID_TYPE id, IP_VERTEX_ID_TYPE message)
+void ip_cas(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message)
 {
-	IP_MESSAGE_TYPE old_value = ip_all_externalised_structures[id].message_next;
-	IP_MESSAGE_TYPE new_value = old_value;
-	ip_combine(&new_value, message);
-	while(new_value != old_value && !atomic_compare_exchange_strong(&ip_all_externalised_structures[id].message_next, &old_value, new_value))
-	{
-		old_value = ip_all_externalised_structures[id].message_next;
-		new_value = old_value;
-		ip_combine(&new_value, message);
-	}
+	ip_combine_in_mailbox(&ip_all_externalised_structures[id].message_next, &ip_all_externalised_structures[id].lock, message);
 }
 
-
-void ip_send_message(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message)
+void ip_send_message_to_mailbox(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message)
 {
 	if(ip_all_externalised_structures[id].has_message_next)
 	{
@@ -78,6 +85,9 @@ void ip_send_message(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message)
 	}
 	else
 	{
+		#ifdef IP_ENABLE_CONTENTION_COUNTERS
+			ip_my_contention_counters->counts[IP_CONTENTION_LOCK_SENDS]++;
+		#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
 		ip_lock_acquire(&ip_all_externalised_structures[id].lock);
 		if(ip_all_externalised_structures[id].has_message_next)
 		{
@@ -93,40 +103,117 @@ void ip_send_message(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message)
 			ip_all_externalised_structures[id].has_message_next = true;
 			ip_lock_release(&ip_all_externalised_structures[id].lock);
 			ip_add_spread_vertex(id);
+			#ifdef IP_ENABLE_CONTENTION_COUNTERS
+				ip_my_contention_counters->counts[IP_CONTENTION_FIRST_WRITE_MESSAGES]++;
+			#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
 		}
 	}
 }
 
+void ip_send_message(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message)
+{
+	#ifdef IP_ENABLE_METRICS
+		ip_my_thread_metrics->message_count++;
+	#endif // ifdef IP_ENABLE_METRICS
+	#ifdef IP_ENABLE_CONTENTION_COUNTERS
+		ip_my_contention_counters->counts[IP_CONTENTION_SENDS]++;
+	#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+	#ifdef IP_USE_SEQUENTIAL_FAST_PATH
+		if(ip_sequential_superstep)
+		{
+			// Only one thread is running, relaxed accesses compile to plain loads and stores.
+			if(atomic_load_explicit(&ip_all_externalised_structures[id].has_message_next, memory_order_relaxed))
+			{
+				ip_combine(&ip_all_externalised_structures[id].message_next, message);
+				#ifdef IP_ENABLE_CONTENTION_COUNTERS
+					ip_my_contention_counters->counts[IP_CONTENTION_COMBINED_MESSAGES]++;
+				#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+			}
+			else
+			{
+				ip_all_externalised_structures[id].message_next = message;
+				atomic_store_explicit(&ip_all_externalised_structures[id].has_message_next, true, memory_order_relaxed);
+				ip_add_spread_vertex(id);
+				#ifdef IP_ENABLE_CONTENTION_COUNTERS
+					ip_my_contention_counters->counts[IP_CONTENTION_FIRST_WRITE_MESSAGES]++;
+				#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+			}
+			return;
+		}
+	#endif // ifdef IP_USE_SEQUENTIAL_FAST_PATH
+	#ifdef IP_USE_HUB_MAILBOXES
+		if(ip_try_send_message_to_hub(id, message))
+		{
+			return;
+		}
+	#endif // ifdef IP_USE_HUB_MAILBOXES
+	#ifdef IP_USE_SEND_CACHE
+		if(ip_cache_message(&id, &message))
+		{
+			return;
+		}
+		// The message has been cached in place of another one, which is sent instead.
+	#endif // ifdef IP_USE_SEND_CACHE
+	ip_send_message_to_mailbox(id, message);
+}
+
+#ifdef IP_USE_HUB_MAILBOXES
+void ip_deliver_hub_message(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message)
+{
+	// Hubs only receive messages through their private mailboxes, so this is the first and only write this superstep.
+	ip_all_externalised_structures[id].message_next = message;
+	ip_all_externalised_structures[id].has_message_next = true;
+	ip_add_spread_vertex(id);
+	#ifdef IP_ENABLE_CONTENTION_COUNTERS
+		ip_my_contention_counters->counts[IP_CONTENTION_FIRST_WRITE_MESSAGES]++;
+	#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+}
+#endif // ifdef IP_USE_HUB_MAILBOXES
+
 void ip_broadcast(struct ip_vertex_t* v, IP_MESSAGE_TYPE message)
 {
-	for(IP_NEIGHBOUR_COUNT_TYPE i = 0; i < v->out_neighbour_count; i++)
+	IP_VERTEX_ID_TYPE* out_neighbours = ip_get_out_neighbours(v);
+	IP_NEIGHBOUR_COUNT_TYPE out_neighbour_count = ip_get_out_neighbour_count(v);
+	for(IP_NEIGHBOUR_COUNT_TYPE i = 0; i < out_neighbour_count; i++)
 	{
-		ip_send_message(v->out_neighbours[i], message);
+		ip_send_message(out_neighbours[i], message);
 	}
+	#ifdef IP_ENABLE_METRICS
+		ip_my_thread_metrics->edge_count += out_neighbour_count;
+	#endif // ifdef IP_ENABLE_METRICS
+	#ifdef IP_USE_DYNAMIC_GRAPH
+		ip_broadcast_to_delta(v, message);
+	#endif // ifdef IP_USE_DYNAMIC_GRAPH
 }
 
 void ip_init_vertex_range(IP_VERTEX_ID_TYPE first, IP_VERTEX_ID_TYPE last)
 {
 	for(IP_VERTEX_ID_TYPE i = first; i <= last; i++)
 	{
-		ip_all_vertices[i].id = i;
+		#ifndef IP_USE_COMPACT_LAYOUT
+			#if defined(IP_ID_OFFSET) && !defined(IP_FORCE_DIRECT_MAPPING)
+				ip_all_vertices[i].id = i + IP_ID_OFFSET;
+			#else
+				ip_all_vertices[i].id = i;
+			#endif // if defined(IP_ID_OFFSET) && !defined(IP_FORCE_DIRECT_MAPPING)
+		#endif // ifndef IP_USE_COMPACT_LAYOUT
 		ip_all_vertices[i].has_message = false;
 		ip_all_externalised_structures[i].has_message_next = false;
-		#ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
+		#if defined(IP_NEEDS_OUT_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 			ip_all_vertices[i].out_neighbour_count = 0;
-		#endif // IP_NEEDS_OUT_NEIGHBOUR_COUNT
-		#ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+		#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
+		#if defined(IP_NEEDS_OUT_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 			ip_all_vertices[i].out_neighbours = NULL;
-		#endif // IP_NEEDS_OUT_NEIGHBOUR_IDS
+		#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 		#ifdef IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS
 			ip_all_vertices[i].out_neighbour_weights = NULL;
 		#endif // IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS
-		#ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+		#if defined(IP_NEEDS_IN_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 			ip_all_vertices[i].in_neighbours = NULL;
-		#endif
-		#ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+		#endif // if defined(IP_NEEDS_IN_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
+		#if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 			ip_all_vertices[i].in_neighbour_count = 0;
-		#endif // IP_NEEDS_IN_NEIGHBOUR_COUNT
+		#endif // if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 		#ifdef IP_NEEDS_IN_NEIGHBOUR_WEIGHTS
 			ip_all_vertices[i].in_neighbour_weights = NULL;
 		#endif // IP_NEEDS_IN_NEIGHBOUR_WEIGHT
@@ -141,22 +228,413 @@ void ip_init_specific()
 	{
 		#pragma omp master
 		{
-			ip_all_spread_vertices_omp = (struct ip_vertex_list_t*)ip_safe_malloc(sizeof(struct ip_vertex_list_t) * ip_thread_count * IP_CACHE_LINE_LENGTH);
+			ip_all_spread_vertices_omp = (struct ip_vertex_list_t*)ip_safe_tagged_malloc(sizeof(struct ip_vertex_list_t) * ip_thread_count * IP_CACHE_LINE_LENGTH, IP_MEMORY_FRONTIERS);
 		}
 	}
 
 	ip_all_spread_vertices.max_size = 1;
 	ip_all_spread_vertices.size = 0;
-	ip_all_spread_vertices.data = ip_safe_malloc(sizeof(IP_VERTEX_ID_TYPE) * ip_all_spread_vertices.max_size);
+	ip_all_spread_vertices.data = ip_safe_tagged_malloc(sizeof(IP_VERTEX_ID_TYPE) * ip_all_spread_vertices.max_size, IP_MEMORY_FRONTIERS);
 	#pragma omp parallel default(none) shared(ip_all_spread_vertices_omp)
 	{
 		ip_all_spread_vertices_omp[omp_get_thread_num() * IP_CACHE_LINE_LENGTH].max_size = 1;
 		ip_all_spread_vertices_omp[omp_get_thread_num() * IP_CACHE_LINE_LENGTH].size = 0;
-		ip_all_spread_vertices_omp[omp_get_thread_num() * IP_CACHE_LINE_LENGTH].data = ip_safe_malloc(sizeof(IP_VERTEX_ID_TYPE) * ip_all_spread_vertices_omp[omp_get_thread_num() * IP_CACHE_LINE_LENGTH].max_size);
+		ip_all_spread_vertices_omp[omp_get_thread_num() * IP_CACHE_LINE_LENGTH].data = ip_safe_tagged_malloc(sizeof(IP_VERTEX_ID_TYPE) * ip_all_spread_vertices_omp[omp_get_thread_num() * IP_CACHE_LINE_LENGTH].max_size, IP_MEMORY_FRONTIERS);
 	}
-	ip_all_externalised_structures = (struct ip_externalised_structure_t*)ip_safe_malloc(sizeof(struct ip_externalised_structure_t) * ip_get_vertices_count());
+	ip_all_externalised_structures = (struct ip_externalised_structure_t*)ip_safe_tagged_malloc(sizeof(struct ip_externalised_structure_t) * ip_get_vertices_count(), IP_MEMORY_MAILBOXES);
+	ip_lock_configure(ip_thread_count);
+	#ifdef IP_USE_SEND_CACHE
+		ip_init_send_cache();
+	#endif // ifdef IP_USE_SEND_CACHE
 }
 
+void ip_predict_memory_specific(size_t bytes[IP_MEMORY_TAG_COUNT])
+{
+	bytes[IP_MEMORY_MAILBOXES] += sizeof(struct ip_externalised_structure_t) * ip_get_vertices_count();
+	#ifdef IP_USE_SEND_CACHE
+		bytes[IP_MEMORY_MAILBOXES] += sizeof(struct ip_send_cache_entry_t) * IP_SEND_CACHE_SIZE * ip_thread_count;
+	#endif // ifdef IP_USE_SEND_CACHE
+	#ifdef IP_USE_DYNAMIC_GRAPH
+		bytes[IP_MEMORY_ADJACENCY] += sizeof(struct ip_delta_t) * ip_get_vertices_count();
+		bytes[IP_MEMORY_FRONTIERS] += (sizeof(atomic_bool) + sizeof(IP_VERTEX_ID_TYPE)) * ip_get_vertices_count();
+	#endif // ifdef IP_USE_DYNAMIC_GRAPH
+	// The thread lists and the list they are merged into hold every vertex at most.
+	bytes[IP_MEMORY_FRONTIERS] += sizeof(struct ip_vertex_list_t) * ip_thread_count * IP_CACHE_LINE_LENGTH + 2 * sizeof(IP_VERTEX_ID_TYPE) * ip_get_vertices_count();
+}
+
+void ip_reset_specific()
+{
+	#pragma omp parallel default(none) shared(ip_all_spread_vertices_omp, ip_all_externalised_structures)
+	{
+		ip_all_spread_vertices_omp[omp_get_thread_num() * IP_CACHE_LINE_LENGTH].size = 0;
+		#pragma omp for
+		for(size_t i = 0; i < ip_get_vertices_count(); i++)
+		{
+			ip_get_vertex_by_location(i)->has_message = false;
+			ip_all_externalised_structures[i].has_message_next = false;
+		}
+	}
+	ip_all_spread_vertices.size = 0;
+	ip_has_initial_frontier = false;
+}
+
+void ip_set_initial_frontier(const IP_VERTEX_ID_TYPE* ids, size_t count)
+{
+	if(ip_all_spread_vertices.max_size < count)
+	{
+		ip_all_spread_vertices.data = ip_safe_realloc(ip_all_spread_vertices.data, sizeof(IP_VERTEX_ID_TYPE) * count);
+		ip_all_spread_vertices.max_size = count;
+	}
+	memcpy(ip_all_spread_vertices.data, ids, sizeof(IP_VERTEX_ID_TYPE) * count);
+	ip_all_spread_vertices.size = count;
+	ip_has_initial_frontier = true;
+}
+
+#ifdef IP_USE_CHECKPOINTS
+void ip_save_vertex_state(size_t location, bool* active, bool* has_message, IP_MESSAGE_TYPE* message)
+{
+	struct ip_vertex_t* v = ip_get_vertex_by_location(location);
+	// Vertices do not halt in this version, only those in the frontier run.
+	*active = false;
+	*has_message = v->has_message;
+	*message = v->message;
+}
+
+void ip_restore_vertex_state(size_t location, bool active, bool has_message, IP_MESSAGE_TYPE message)
+{
+	struct ip_vertex_t* v = ip_get_vertex_by_location(location);
+	(void)(active);
+	v->has_message = has_message;
+	v->message = message;
+}
+
+const IP_VERTEX_ID_TYPE* ip_get_frontier(size_t* count)
+{
+	*count = ip_all_spread_vertices.size;
+	return ip_all_spread_vertices.data;
+}
+#endif // ifdef IP_USE_CHECKPOINTS
+
+#ifdef IP_USE_SEQUENTIAL_FAST_PATH
+/**
+ * @brief This function runs supersteps on the calling thread alone, as long as
+ * the frontier remains small.
+ * @details Compute, frontier and mailbox update phases follow each other with
+ * no barrier, and messages are delivered with neither lock nor atomic
+ * operation. It returns as soon as the frontier grows beyond the thresholds,
+ * becomes empty or the computation is halted.
+ * @param[inout] timer_superstep_total The total time spent in supersteps, to
+ * which the duration of the supersteps run is added.
+ * @pre The other threads are waiting and will not access the frontier or the
+ * mailboxes until this function returns.
+ **/
+void ip_run_sequential_supersteps(double* timer_superstep_total)
+{
+	struct ip_vertex_list_t* my_list = &ip_all_spread_vertices_omp[ip_my_thread_num * IP_CACHE_LINE_LENGTH];
+	struct ip_vertex_t* temp_vertex = NULL;
+	IP_VERTEX_ID_TYPE spread_vertex_id;
+	double timer_superstep_start = 0;
+	double timer_superstep_stop = 0;
+
+	ip_sequential_superstep = true;
+	while(!ip_is_computation_halted() && ip_all_spread_vertices.size > 0 && ip_is_frontier_small(ip_all_spread_vertices.data, ip_all_spread_vertices.size))
+	{
+		timer_superstep_start = omp_get_wtime();
+		#ifdef IP_ENABLE_METRICS
+			ip_start_metrics_superstep();
+		#endif // ifdef IP_ENABLE_METRICS
+		#ifdef IP_ENABLE_CONTENTION_COUNTERS
+			ip_start_contention_superstep();
+		#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+
+		for(size_t i = 0; i < ip_all_spread_vertices.size; i++)
+		{
+			temp_vertex = ip_get_vertex_by_id(ip_all_spread_vertices.data[i]);
+			ip_compute(temp_vertex);
+			#ifdef IP_ENABLE_METRICS
+				ip_record_metrics_vertex(temp_vertex);
+			#endif // ifdef IP_ENABLE_METRICS
+		}
+		#ifdef IP_ENABLE_METRICS
+			ip_stop_metrics_phase(IP_METRICS_COMPUTE);
+		#endif // ifdef IP_ENABLE_METRICS
+
+		if(ip_all_spread_vertices.max_size < my_list->size)
+		{
+			ip_all_spread_vertices.data = ip_safe_realloc(ip_all_spread_vertices.data, sizeof(IP_VERTEX_ID_TYPE) * my_list->size);
+			ip_all_spread_vertices.max_size = my_list->size;
+		}
+		for(size_t i = 0; i < my_list->size; i++)
+		{
+			spread_vertex_id = my_list->data[i];
+			temp_vertex = ip_get_vertex_by_id(spread_vertex_id);
+			temp_vertex->has_message = true;
+			temp_vertex->message = ip_all_externalised_structures[spread_vertex_id].message_next;
+			atomic_store_explicit(&ip_all_externalised_structures[spread_vertex_id].has_message_next, false, memory_order_relaxed);
+			ip_all_spread_vertices.data[i] = spread_vertex_id;
+		}
+		ip_all_spread_vertices.size = my_list->size;
+		my_list->size = 0;
+		ip_active_vertices = ip_all_spread_vertices.size;
+		#ifdef IP_ENABLE_METRICS
+			ip_stop_metrics_phase(IP_METRICS_MAILBOX);
+		#endif // ifdef IP_ENABLE_METRICS
+
+		timer_superstep_stop = omp_get_wtime();
+		*timer_superstep_total += timer_superstep_stop - timer_superstep_start;
+		#ifdef IP_ENABLE_METRICS
+			ip_end_metrics_superstep(timer_superstep_stop - timer_superstep_start, ip_active_vertices);
+		#endif // ifdef IP_ENABLE_METRICS
+		#ifdef IP_ENABLE_CONTENTION_COUNTERS
+			ip_collect_contention_counters();
+		#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+		#ifdef IP_USE_LIGHT_SUPERSTEP
+			ip_record_superstep_statistics(timer_superstep_stop - timer_superstep_start, ip_active_vertices);
+		#else // ifndef IP_USE_LIGHT_SUPERSTEP
+			printf("Superstep%zuDuration:%f\n", ip_get_superstep(), timer_superstep_stop - timer_superstep_start);
+			printf("Superstep%zuActiveVertexCount:%zu\n", ip_get_superstep(), ip_active_vertices);
+		#endif // if(n)def IP_USE_LIGHT_SUPERSTEP
+		#ifdef IP_ENABLE_MEMORY_ACCOUNTING
+			ip_report_superstep_memory();
+		#endif // ifdef IP_ENABLE_MEMORY_ACCOUNTING
+		ip_reduce_aggregators();
+		ip_increment_superstep();
+		#ifdef IP_NEEDS_MASTER_COMPUTE
+			ip_master_compute();
+		#endif // ifdef IP_NEEDS_MASTER_COMPUTE
+	}
+	ip_sequential_superstep = false;
+}
+#endif // ifdef IP_USE_SEQUENTIAL_FAST_PATH
+
+#ifdef IP_USE_LIGHT_SUPERSTEP
+int ip_run()
+{
+	double timer_superstep_total = 0;
+	double timer_superstep_start = 0;
+	double timer_superstep_stop = 0;
+	size_t first_superstep = ip_get_superstep();
+	struct ip_barrier_t barrier;
+	ip_barrier_init(&barrier, ip_thread_count);
+
+	// Threads copy their list straight into the global one, which therefore cannot be reallocated on the fly.
+	if(ip_all_spread_vertices.max_size < ip_get_vertices_count())
+	{
+		ip_all_spread_vertices.data = ip_safe_realloc(ip_all_spread_vertices.data, sizeof(IP_VERTEX_ID_TYPE) * ip_get_vertices_count());
+		ip_all_spread_vertices.max_size = ip_get_vertices_count();
+	}
+
+	#ifdef IP_ENABLE_METRICS
+		ip_start_metrics_run();
+	#endif // ifdef IP_ENABLE_METRICS
+	#ifdef IP_ENABLE_CONTENTION_COUNTERS
+		ip_start_contention_run();
+	#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+	ip_start_run();
+
+	timer_superstep_start = omp_get_wtime();
+	#pragma omp parallel default(none) shared(ip_active_vertices, \
+											  ip_all_spread_vertices, \
+											  ip_has_initial_frontier, \
+											  ip_all_spread_vertices_omp, \
+											  ip_thread_count, \
+											  ip_all_externalised_structures, \
+											  barrier, \
+											  timer_superstep_total, \
+											  timer_superstep_start, \
+											  timer_superstep_stop)
+	{
+		ip_my_thread_num = omp_get_thread_num();
+		bool my_sense = false;
+		struct ip_vertex_list_t* my_list = &ip_all_spread_vertices_omp[ip_my_thread_num * IP_CACHE_LINE_LENGTH];
+		while(!ip_is_computation_halted() && (ip_is_first_superstep() || ip_all_spread_vertices.size > 0))
+		{
+			#ifdef IP_ENABLE_METRICS
+				ip_start_metrics_superstep();
+			#endif // ifdef IP_ENABLE_METRICS
+			#ifdef IP_ENABLE_CONTENTION_COUNTERS
+				ip_start_contention_superstep();
+			#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+
+			////////////////////
+			// COMPUTE PHASE //
+			//////////////////
+			struct ip_vertex_t* temp_vertex = NULL;
+			if(ip_is_first_superstep() && !ip_has_initial_frontier)
+			{
+				#pragma omp for schedule(runtime) nowait
+				for(size_t i = 0; i < ip_get_vertices_count(); i++)
+				{
+					temp_vertex = ip_get_vertex_by_location(i);
+					ip_compute(temp_vertex);
+					#ifdef IP_ENABLE_METRICS
+						ip_record_metrics_vertex(temp_vertex);
+					#endif // ifdef IP_ENABLE_METRICS
+				}
+			}
+			else
+			{
+				#pragma omp for schedule(runtime) nowait
+				for(size_t i = 0; i < ip_all_spread_vertices.size; i++)
+				{
+					temp_vertex = ip_get_vertex_by_id(ip_all_spread_vertices.data[i]);
+					ip_compute(temp_vertex);
+					#ifdef IP_ENABLE_METRICS
+						ip_record_metrics_vertex(temp_vertex);
+					#endif // ifdef IP_ENABLE_METRICS
+				}
+			}
+			#ifdef IP_ENABLE_METRICS
+				ip_stop_metrics_phase(IP_METRICS_COMPUTE);
+			#endif // ifdef IP_ENABLE_METRICS
+
+			#ifdef IP_USE_SEND_CACHE
+				ip_flush_send_cache();
+			#endif // ifdef IP_USE_SEND_CACHE
+			// All messages must have been delivered before mailboxes are swapped.
+			#ifdef IP_ENABLE_METRICS
+				ip_start_metrics_wait();
+			#endif // ifdef IP_ENABLE_METRICS
+			ip_barrier_wait(&barrier, ip_my_thread_num, &my_sense);
+			#ifdef IP_ENABLE_METRICS
+				ip_stop_metrics_wait();
+			#endif // ifdef IP_ENABLE_METRICS
+			#ifdef IP_USE_HUB_MAILBOXES
+				// Hubs are added to the lists of the threads that deliver them, so this must complete before lists are counted.
+				ip_reduce_hub_mailboxes();
+			#endif // ifdef IP_USE_HUB_MAILBOXES
+			#ifdef IP_ENABLE_METRICS
+				ip_stop_metrics_phase(IP_METRICS_MERGE);
+			#endif // ifdef IP_ENABLE_METRICS
+
+			///////////////////////////////////////
+			// COUNT, MERGE AND MAILBOX UPDATE //
+			/////////////////////////////////////
+			// Every thread computes the prefix sum of the list sizes on its own rather than waiting for one thread to do it.
+			size_t my_offset = 0;
+			size_t total = 0;
+			for(int i = 0; i < ip_thread_count; i++)
+			{
+				if(i == ip_my_thread_num)
+				{
+					my_offset = total;
+				}
+				total += ip_all_spread_vertices_omp[i * IP_CACHE_LINE_LENGTH].size;
+			}
+
+			IP_VERTEX_ID_TYPE spread_vertex_id;
+			for(size_t i = 0; i < my_list->size; i++)
+			{
+				spread_vertex_id = my_list->data[i];
+				temp_vertex = ip_get_vertex_by_id(spread_vertex_id);
+				temp_vertex->has_message = true;
+				temp_vertex->message = ip_all_externalised_structures[spread_vertex_id].message_next;
+				ip_all_externalised_structures[spread_vertex_id].has_message_next = false;
+			}
+			memcpy(&ip_all_spread_vertices.data[my_offset], my_list->data, my_list->size * sizeof(IP_VERTEX_ID_TYPE));
+			#ifdef IP_ENABLE_METRICS
+				ip_stop_metrics_phase(IP_METRICS_MAILBOX);
+			#endif // ifdef IP_ENABLE_METRICS
+
+			#ifdef IP_USE_SEQUENTIAL_FAST_PATH
+				// Thread lists are not modified before the next barrier, so all threads reach the same decision.
+				bool run_sequentially = false;
+				if(total <= IP_SEQUENTIAL_VERTEX_THRESHOLD)
+				{
+					run_sequentially = true;
+					size_t edge_count = 0;
+					for(int i = 0; i < ip_thread_count && run_sequentially; i++)
+					{
+						for(size_t j = 0; j < ip_all_spread_vertices_omp[i * IP_CACHE_LINE_LENGTH].size; j++)
+						{
+							edge_count += ip_get_out_neighbour_count(ip_get_vertex_by_id(ip_all_spread_vertices_omp[i * IP_CACHE_LINE_LENGTH].data[j]));
+						}
+						run_sequentially = edge_count <= IP_SEQUENTIAL_EDGE_THRESHOLD;
+					}
+				}
+			#endif // ifdef IP_USE_SEQUENTIAL_FAST_PATH
+
+			if(ip_my_thread_num == 0)
+			{
+				ip_all_spread_vertices.size = total;
+				ip_active_vertices = total;
+				timer_superstep_stop = omp_get_wtime();
+				timer_superstep_total += timer_superstep_stop - timer_superstep_start;
+				ip_record_superstep_statistics(timer_superstep_stop - timer_superstep_start, ip_active_vertices);
+				#ifdef IP_ENABLE_METRICS
+					ip_end_metrics_superstep(timer_superstep_stop - timer_superstep_start, ip_active_vertices);
+				#endif // ifdef IP_ENABLE_METRICS
+				#ifdef IP_ENABLE_CONTENTION_COUNTERS
+					ip_collect_contention_counters();
+				#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+				#ifdef IP_ENABLE_MEMORY_ACCOUNTING
+					ip_report_superstep_memory();
+				#endif // ifdef IP_ENABLE_MEMORY_ACCOUNTING
+				ip_reduce_aggregators();
+				ip_increment_superstep();
+				#ifdef IP_NEEDS_MASTER_COMPUTE
+					ip_master_compute();
+				#endif // ifdef IP_NEEDS_MASTER_COMPUTE
+				#ifdef IP_USE_CHECKPOINTS
+					ip_plan_checkpoint();
+				#endif // ifdef IP_USE_CHECKPOINTS
+				timer_superstep_start = omp_get_wtime();
+			}
+
+			ip_barrier_wait(&barrier, ip_my_thread_num, &my_sense);
+			// Only now that every thread has read the list sizes can they be reset.
+			my_list->size = 0;
+
+			#ifdef IP_USE_CHECKPOINTS
+				// Thread 0 planned it before the barrier above, so every thread sees the same decision.
+				if(ip_is_checkpoint_planned())
+				{
+					ip_take_checkpoint();
+					if(ip_my_thread_num == 0)
+					{
+						timer_superstep_start = omp_get_wtime();
+					}
+				}
+			#endif // ifdef IP_USE_CHECKPOINTS
+
+			#ifdef IP_USE_SEQUENTIAL_FAST_PATH
+				if(run_sequentially)
+				{
+					if(ip_my_thread_num == 0)
+					{
+						ip_run_sequential_supersteps(&timer_superstep_total);
+						timer_superstep_start = omp_get_wtime();
+					}
+					ip_barrier_wait(&barrier, ip_my_thread_num, &my_sense);
+				}
+			#endif // ifdef IP_USE_SEQUENTIAL_FAST_PATH
+		} // End of superstep processing loop
+	} // End of OpenMP region
+
+	ip_flush_superstep_statistics(first_superstep);
+	#ifdef IP_USE_CHECKPOINTS
+		ip_wait_for_checkpoint();
+	#endif // ifdef IP_USE_CHECKPOINTS
+	printf("Total time of supersteps: %fs.\n", timer_superstep_total);
+	#ifdef IP_ENABLE_CAS_STATISTICS
+		ip_report_cas_statistics();
+	#endif // ifdef IP_ENABLE_CAS_STATISTICS
+	#ifdef IP_ENABLE_CONTENTION_COUNTERS
+		ip_report_contention_counters();
+	#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+	#if defined(IP_USE_SEND_CACHE) && defined(IP_ENABLE_THREAD_PROFILING)
+		ip_report_send_cache_statistics();
+	#endif // if defined(IP_USE_SEND_CACHE) && defined(IP_ENABLE_THREAD_PROFILING)
+	#ifdef IP_ENABLE_METRICS
+		ip_stop_metrics_run();
+	#endif // ifdef IP_ENABLE_METRICS
+
+	// The spread lists and mailboxes are kept for the next run, see ip_reset().
+	ip_barrier_destroy(&barrier);
+
+	return 0;
+}
+#else // ifndef IP_USE_LIGHT_SUPERSTEP
 int ip_run()
 {
 	double timer_superstep_total = 0;
@@ -177,9 +655,18 @@ int ip_run()
 		size_t timer_edge_count_total = 0;
 	#endif
 
+	#ifdef IP_ENABLE_METRICS
+		ip_start_metrics_run();
+	#endif // ifdef IP_ENABLE_METRICS
+	#ifdef IP_ENABLE_CONTENTION_COUNTERS
+		ip_start_contention_run();
+	#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+	ip_start_run();
+
 	#ifdef IP_ENABLE_THREAD_PROFILING
 		#pragma omp parallel default(none) shared(ip_active_vertices, \
 												  ip_all_spread_vertices, \
+												  ip_has_initial_frontier, \
 												  ip_all_spread_vertices_omp, \
 												  ip_thread_count, \
 												  ip_all_externalised_structures, \
@@ -200,6 +687,7 @@ int ip_run()
 	#else
 		#pragma omp parallel default(none) shared(ip_active_vertices, \
 												  ip_all_spread_vertices, \
+												  ip_has_initial_frontier, \
 												  ip_all_spread_vertices_omp, \
 												  ip_thread_count, \
 												  ip_all_externalised_structures, \
@@ -209,7 +697,7 @@ int ip_run()
 	#endif
 	{
 		ip_my_thread_num = omp_get_thread_num();
-		while(ip_is_first_superstep() || ip_active_vertices > 0)
+		while(!ip_is_computation_halted() && (ip_is_first_superstep() || ip_active_vertices > 0))
 		{
 			// This barrier is crucial; otherwise a thread may enter the single, change ip_active_vertices before one other thread has entered the loop. Thus the single would never complete.
 			#pragma omp barrier
@@ -223,6 +711,12 @@ int ip_run()
 				ip_active_vertices = 0;
 				timer_superstep_start = omp_get_wtime();
 			}
+			#ifdef IP_ENABLE_METRICS
+				ip_start_metrics_superstep();
+			#endif // ifdef IP_ENABLE_METRICS
+			#ifdef IP_ENABLE_CONTENTION_COUNTERS
+				ip_start_contention_superstep();
+			#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
 			
 			////////////////////
 			// COMPUTE PHASE //
@@ -232,10 +726,14 @@ int ip_run()
 				timer_edge_count[ip_my_thread_num] = 0;
 			#endif
 			struct ip_vertex_t* temp_vertex = NULL;
-			if(ip_is_first_superstep())
+			if(ip_is_first_superstep() && !ip_has_initial_frontier)
 			{
-				#ifdef IP_ENABLE_THREAD_PROFILING
+				#if defined(IP_ENABLE_THREAD_PROFILING) && defined(IP_ENABLE_METRICS)
+					#pragma omp for reduction(+:timer_edge_count_total) schedule(runtime) nowait
+				#elif defined(IP_ENABLE_THREAD_PROFILING)
 					#pragma omp for reduction(+:timer_edge_count_total) schedule(runtime)
+				#elif defined(IP_ENABLE_METRICS)
+					#pragma omp for schedule(runtime) nowait
 				#else
 					#pragma omp for schedule(runtime)
 				#endif
@@ -243,18 +741,25 @@ int ip_run()
 				{
 					temp_vertex = ip_get_vertex_by_location(i);
 					ip_compute(temp_vertex);
+					#ifdef IP_ENABLE_METRICS
+						ip_record_metrics_vertex(temp_vertex);
+					#endif // ifdef IP_ENABLE_METRICS
 					#ifdef IP_ENABLE_THREAD_PROFILING
 						timer_compute_stop[ip_my_thread_num] = omp_get_wtime();
-						timer_edge_count[ip_my_thread_num] += temp_vertex->out_neighbour_count;
-						timer_edge_count_total += temp_vertex->out_neighbour_count;
+						timer_edge_count[ip_my_thread_num] += ip_get_out_neighbour_count(temp_vertex);
+						timer_edge_count_total += ip_get_out_neighbour_count(temp_vertex);
 					#endif
 				}
 			}
 			else
 			{
 				IP_VERTEX_ID_TYPE spread_neighbour_id;
-				#ifdef IP_ENABLE_THREAD_PROFILING
+				#if defined(IP_ENABLE_THREAD_PROFILING) && defined(IP_ENABLE_METRICS)
+					#pragma omp for reduction(+:timer_edge_count_total) schedule(runtime) nowait
+				#elif defined(IP_ENABLE_THREAD_PROFILING)
 					#pragma omp for reduction(+:timer_edge_count_total) schedule(runtime)
+				#elif defined(IP_ENABLE_METRICS)
+					#pragma omp for schedule(runtime) nowait
 				#else
 					#pragma omp for schedule(runtime)
 				#endif
@@ -263,16 +768,34 @@ int ip_run()
 					spread_neighbour_id = ip_all_spread_vertices.data[i];
 					temp_vertex = ip_get_vertex_by_id(spread_neighbour_id);
 					ip_compute(temp_vertex);
+					#ifdef IP_ENABLE_METRICS
+						ip_record_metrics_vertex(temp_vertex);
+					#endif // ifdef IP_ENABLE_METRICS
 					#ifdef IP_ENABLE_THREAD_PROFILING
 						timer_compute_stop[ip_my_thread_num] = omp_get_wtime();
-						timer_edge_count[ip_my_thread_num] += temp_vertex->out_neighbour_count;
-						timer_edge_count_total += temp_vertex->out_neighbour_count;
+						timer_edge_count[ip_my_thread_num] += ip_get_out_neighbour_count(temp_vertex);
+						timer_edge_count_total += ip_get_out_neighbour_count(temp_vertex);
 					#endif
 				}
 			}
 			#ifdef IP_ENABLE_THREAD_PROFILING
 				timer_compute_total[ip_my_thread_num] = timer_compute_stop[ip_my_thread_num] - timer_compute_start[ip_my_thread_num];
 			#endif
+			#ifdef IP_ENABLE_METRICS
+				ip_start_metrics_wait();
+				#pragma omp barrier
+				ip_stop_metrics_phase(IP_METRICS_COMPUTE);
+			#endif // ifdef IP_ENABLE_METRICS
+
+			#ifdef IP_USE_SEND_CACHE
+				// A thread flushing its cache only writes to mailboxes that are not hubs and to its own spread list, which it counts itself below.
+				ip_flush_send_cache();
+			#endif // ifdef IP_USE_SEND_CACHE
+
+			#ifdef IP_USE_HUB_MAILBOXES
+				// Hubs received their messages in private mailboxes, deliver them before the spread vertices are counted.
+				ip_reduce_hub_mailboxes();
+			#endif // ifdef IP_USE_HUB_MAILBOXES
 			
 			////////////////////////////
 			// ACTIVE VERTICES COUNT //
@@ -282,6 +805,9 @@ int ip_run()
 			ip_active_vertices += ip_all_spread_vertices_omp[ip_my_thread_num * IP_CACHE_LINE_LENGTH].size;
 
 			// This barrier is crucial; it makes sure that no thread can enter the single below, which uses ip_active_vertices, before every thread incremented it ip_active_vertices with their own value.
+			#ifdef IP_ENABLE_METRICS
+				ip_start_metrics_wait();
+			#endif // ifdef IP_ENABLE_METRICS
 			#pragma omp barrier
 			
 			//////////////////////////////////
@@ -293,6 +819,9 @@ int ip_run()
 			#endif
 			#pragma omp single
 			{
+				#ifdef IP_ENABLE_METRICS
+					ip_stop_metrics_wait();
+				#endif // ifdef IP_ENABLE_METRICS
 				if(ip_all_spread_vertices.max_size < ip_active_vertices)
 				{
 					ip_all_spread_vertices.data = ip_safe_realloc(ip_all_spread_vertices.data, sizeof(IP_VERTEX_ID_TYPE) * ip_active_vertices);
@@ -313,10 +842,16 @@ int ip_run()
 				#ifdef IP_ENABLE_THREAD_PROFILING
 					timer_spread_merge_stop[ip_my_thread_num] = omp_get_wtime();
 				#endif
+				#ifdef IP_ENABLE_METRICS
+					ip_start_metrics_wait();
+				#endif // ifdef IP_ENABLE_METRICS
 			}
 			#ifdef IP_ENABLE_THREAD_PROFILING
 				timer_spread_merge_total[ip_my_thread_num] = timer_spread_merge_stop[ip_my_thread_num] - timer_spread_merge_start[ip_my_thread_num];
 			#endif
+			#ifdef IP_ENABLE_METRICS
+				ip_stop_metrics_phase(IP_METRICS_MERGE);
+			#endif // ifdef IP_ENABLE_METRICS
 
 			///////////////////////////
 			// MAILBOX UPDATE PHASE //
@@ -328,7 +863,11 @@ int ip_run()
 				timer_mailbox_update_stop[ip_my_thread_num] = timer_mailbox_update_start[ip_my_thread_num];
 			#endif
 			IP_VERTEX_ID_TYPE spread_vertex_id;
-			#pragma omp for schedule(runtime)
+			#ifdef IP_ENABLE_METRICS
+				#pragma omp for schedule(runtime) nowait
+			#else
+				#pragma omp for schedule(runtime)
+			#endif // if(n)def IP_ENABLE_METRICS
 			for(size_t i = 0; i < ip_all_spread_vertices.size; i++)
 			{
 				spread_vertex_id = ip_all_spread_vertices.data[i];
@@ -343,6 +882,16 @@ int ip_run()
 			#ifdef IP_ENABLE_THREAD_PROFILING
 				timer_mailbox_update_total[ip_my_thread_num] = timer_mailbox_update_stop[ip_my_thread_num] - timer_mailbox_update_start[ip_my_thread_num];
 			#endif
+			#ifdef IP_ENABLE_METRICS
+				ip_start_metrics_wait();
+				#pragma omp barrier
+				ip_stop_metrics_phase(IP_METRICS_MAILBOX);
+			#endif // ifdef IP_ENABLE_METRICS
+
+			#ifdef IP_USE_SEQUENTIAL_FAST_PATH
+				// Decided by every thread before the single below, after which the frontier may change.
+				bool run_sequentially = ip_is_frontier_small(ip_all_spread_vertices.data, ip_all_spread_vertices.size);
+			#endif // ifdef IP_USE_SEQUENTIAL_FAST_PATH
 		
 			#pragma omp single
 			{
@@ -350,6 +899,12 @@ int ip_run()
 				timer_superstep_total += (timer_superstep_stop - timer_superstep_start);
 				printf("Superstep%zuDuration:%f\n", ip_get_superstep(), timer_superstep_stop - timer_superstep_start);
 				printf("Superstep%zuActiveVertexCount:%zu\n", ip_get_superstep(), ip_active_vertices);
+				#ifdef IP_ENABLE_METRICS
+					ip_end_metrics_superstep(timer_superstep_stop - timer_superstep_start, ip_active_vertices);
+				#endif // ifdef IP_ENABLE_METRICS
+				#ifdef IP_ENABLE_CONTENTION_COUNTERS
+					ip_collect_contention_counters();
+				#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
 				#ifdef IP_ENABLE_THREAD_PROFILING
 					printf("            +");
 					for(int i = 0; i < ip_thread_count; i++)
@@ -399,19 +954,56 @@ int ip_run()
 					printf("\n");
 					timer_edge_count_total = 0;
 				#endif
+				#ifdef IP_ENABLE_MEMORY_ACCOUNTING
+					ip_report_superstep_memory();
+				#endif // ifdef IP_ENABLE_MEMORY_ACCOUNTING
+				ip_reduce_aggregators();
 				ip_increment_superstep();
+				#ifdef IP_NEEDS_MASTER_COMPUTE
+					ip_master_compute();
+				#endif // ifdef IP_NEEDS_MASTER_COMPUTE
+				#ifdef IP_USE_CHECKPOINTS
+					ip_plan_checkpoint();
+				#endif // ifdef IP_USE_CHECKPOINTS
  			} // End of OpenMP single region
+
+			#ifdef IP_USE_CHECKPOINTS
+				// The single above ends with a barrier, so every thread sees the same decision.
+				if(ip_is_checkpoint_planned())
+				{
+					ip_take_checkpoint();
+				}
+			#endif // ifdef IP_USE_CHECKPOINTS
+
+			#ifdef IP_USE_SEQUENTIAL_FAST_PATH
+				if(run_sequentially)
+				{
+					#pragma omp master
+					{
+						ip_run_sequential_supersteps(&timer_superstep_total);
+					}
+					#pragma omp barrier
+				}
+			#endif // ifdef IP_USE_SEQUENTIAL_FAST_PATH
 		} // End of superstep processing loop
  	} // End of OpenMP region
 
+	#ifdef IP_USE_CHECKPOINTS
+		ip_wait_for_checkpoint();
+	#endif // ifdef IP_USE_CHECKPOINTS
 	printf("Total time of supersteps: %fs.\n", timer_superstep_total);
-
-	// Free and clean program.	
-	#pragma omp parallel
-	{
-		ip_safe_free(ip_all_spread_vertices_omp[omp_get_thread_num() * IP_CACHE_LINE_LENGTH].data);
-	}
-	ip_safe_free(ip_all_spread_vertices.data);
+	#ifdef IP_ENABLE_CAS_STATISTICS
+		ip_report_cas_statistics();
+	#endif // ifdef IP_ENABLE_CAS_STATISTICS
+	#ifdef IP_ENABLE_CONTENTION_COUNTERS
+		ip_report_contention_counters();
+	#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+	#if defined(IP_USE_SEND_CACHE) && defined(IP_ENABLE_THREAD_PROFILING)
+		ip_report_send_cache_statistics();
+	#endif // if defined(IP_USE_SEND_CACHE) && defined(IP_ENABLE_THREAD_PROFILING)
+	#ifdef IP_ENABLE_METRICS
+		ip_stop_metrics_run();
+	#endif // ifdef IP_ENABLE_METRICS
 
 	#ifdef IP_ENABLE_THREAD_PROFILING
 		free(timer_compute_start);
@@ -425,31 +1017,15 @@ int ip_run()
 		free(timer_mailbox_update_total);
 		free(timer_edge_count);
 	#endif
-	free(ip_all_externalised_structures);
+	// The spread lists and mailboxes are kept for the next run, see ip_reset().
 
 	return 0;
 }
+#endif // if(n)def IP_USE_LIGHT_SUPERSTEP
 
 void ip_vote_to_halt(struct ip_vertex_t* v)
 {
 	(void)(v);
 }
 
-void ip_lock_init(IP_LOCK_TYPE* lock)
-{
-	*lock = 0;
-}
-
-void ip_lock_acquire(IP_LOCK_TYPE* lock)
-{
-	int zero = 0;
-	while(!atomic_compare_exchange_strong(lock, &zero, 1))
-		zero = 0;
-}
-
-void ip_lock_release(IP_LOCK_TYPE* lock)
-{
-	atomic_store(lock, 0);
-}
-
 #endif // COMBINER_SPREAD_POSTAMBLE_H_INCLUDED
@@ -24,6 +24,7 @@
 #define COMBINER_SPREAD_PREAMBLE_H_INCLUDED
 
 #include <stdatomic.h> 
+#include "lock.h"
 
 #ifndef IP_NEEDS_OUT_NEIGHBOUR_IDS
 	#define IP_NEEDS_OUT_NEIGHBOUR_IDS
@@ -34,8 +35,6 @@
 #endif // ifndef IP_NEEDS_OUT_NEIGHBOUR_COUNT
 
 // Global variables
-/// The data type used to implement locks.
-typedef volatile atomic_int IP_LOCK_TYPE;	
 /// This structure holds a list of vertex identifiers.
 struct ip_vertex_list_t
 {
@@ -52,6 +51,8 @@ size_t ip_spread_vertices_count = 0;
 struct ip_vertex_list_t ip_all_spread_vertices;
 /// This contains the vertices that threads found to be executed next superstep.
 struct ip_vertex_list_t* ip_all_spread_vertices_omp = NULL;
+/// Indicates whether ip_set_initial_frontier() placed the vertices to run first in ip_all_spread_vertices, in which case the first superstep runs only them.
+bool ip_has_initial_frontier = false;
 /// Contains active broadcast attributes
 struct ip_externalised_structure_t
 {
@@ -60,29 +61,29 @@ struct ip_externalised_structure_t
 	/// The lock used for mailbox thread-safe accesses
 	IP_LOCK_TYPE lock;
 	/// Contains the combined message made from message received from current superstep so far
-	IP_MESSAGE_TYPE message_next;
+	_Alignas(IP_MAILBOX_ALIGNMENT) IP_MESSAGE_TYPE message_next;
 };
 /// Contains the active broadcast attributes for all vertices
 struct ip_externalised_structure_t* ip_all_externalised_structures = NULL;
 /// This structure defines the structure of a vertex.
 struct ip_vertex_t
 {
-	#ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+	#if defined(IP_NEEDS_OUT_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 		/// Contains the identifiers of the out-neighbours
 		IP_VERTEX_ID_TYPE* out_neighbours;
-	#endif // IP_NEEDS_OUT_NEIGHBOUR_IDS
-	#ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+	#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
+	#if defined(IP_NEEDS_IN_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 		/// Contains the identifiers of the in-neighbours
 		IP_VERTEX_ID_TYPE* in_neighbours;
-	#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
-	#ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
+	#endif // if defined(IP_NEEDS_IN_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
+	#if defined(IP_NEEDS_OUT_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 		/// Contains the number of out-neighbours
 		IP_NEIGHBOUR_COUNT_TYPE out_neighbour_count;
-	#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
-	#ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+	#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
+	#if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 		/// Contains the number of in-neighbours
 		IP_NEIGHBOUR_COUNT_TYPE in_neighbour_count;
-	#endif // IP_UNUSED_IN_NEIGHBOURS
+	#endif // if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 	#ifdef IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS
 		/// Contains the weights of out-edges
 		IP_EDGE_WEIGHT_TYPE* out_neighbour_weights;
@@ -95,8 +96,10 @@ struct ip_vertex_t
 	bool active;
 	/// Indicates whether the vertex has received messages from last superstep
 	bool has_message;
-	/// The vertex identifier
-	IP_VERTEX_ID_TYPE id;
+	#ifndef IP_USE_COMPACT_LAYOUT
+		/// The vertex identifier
+		IP_VERTEX_ID_TYPE id;
+	#endif // ifndef IP_USE_COMPACT_LAYOUT
 	/// Contains the combined message made from messages received from last superstep
 	IP_MESSAGE_TYPE message;
 	/// Contains the user-defined value
@@ -110,20 +113,5 @@ struct ip_vertex_t
  * @post The vertex identifier by \p id will be executed at next superstep.
  **/
 void ip_add_spread_vertex(IP_VERTEX_ID_TYPE id);
-/**
- * @brief This function initialises the lock \p lock.
- * @param[in] lock The lock to initialise.
- **/
-void ip_lock_init(IP_LOCK_TYPE* lock);
-/**
- * @brief This function acquires the lock \p lock.
- * @param[in] lock The lock to acquire.
- **/
-void ip_lock_acquire(IP_LOCK_TYPE* lock);
-/**
- * @brief This function releases the lock \p lock.
- * @param[in] lock The lock to release.
- **/
-void ip_lock_release(IP_LOCK_TYPE* lock);
 
 #endif // COMBINER_SPREAD_PREAMBLE_H_INCLUDED
@@ -20,20 +20,28 @@
 
 #include <omp.h>
 #include <string.h>
+#ifdef IP_ENABLE_METRICS
+	#include "metrics.h"
+#endif // ifdef IP_ENABLE_METRICS
 
 int ip_my_thread_num;
 #pragma omp threadprivate(ip_my_thread_num)
 
-void ip_add_target(IP_VERTEX_ID_TYPE id)
+void ip_add_to_targets(struct ip_targets_t* targets, IP_VERTEX_ID_TYPE id)
 {
-	if(ip_all_targets.size == ip_all_targets.max_size)
+	if(targets->size == targets->max_size)
 	{
-		ip_all_targets.max_size++;
-		ip_all_targets.data = ip_safe_realloc(ip_all_targets.data, sizeof(IP_VERTEX_ID_TYPE) * ip_all_targets.max_size);
+		targets->max_size++;
+		targets->data = ip_safe_tagged_realloc(targets->data, sizeof(IP_VERTEX_ID_TYPE) * targets->max_size, IP_MEMORY_FRONTIERS);
 	}
 
-	ip_all_targets.data[ip_all_targets.size] = id;
-	ip_all_targets.size++;
+	targets->data[targets->size] = id;
+	targets->size++;
+}
+
+void ip_add_target(IP_VERTEX_ID_TYPE id)
+{
+	ip_add_to_targets(&ip_all_targets, id);
 }
 
 bool ip_has_message(struct ip_vertex_t* v)
@@ -63,40 +71,68 @@ version; only broadcast() should be called, and once per superstep maximum.\n");
 
 void ip_broadcast(struct ip_vertex_t* v, IP_MESSAGE_TYPE message)
 {
-	ip_all_externalised_structures_1[v->id].has_broadcast_message = true;
-	ip_all_externalised_structures_1[v->id].broadcast_message = message;
-	for(IP_NEIGHBOUR_COUNT_TYPE i = 0; i < v->out_neighbour_count; i++)
+	IP_VERTEX_ID_TYPE* out_neighbours = ip_get_out_neighbours(v);
+	IP_NEIGHBOUR_COUNT_TYPE out_neighbour_count = ip_get_out_neighbour_count(v);
+	ip_all_externalised_structures_1[v - ip_all_vertices].has_broadcast_message = true;
+	ip_all_externalised_structures_1[v - ip_all_vertices].broadcast_message = message;
+	#ifdef IP_ENABLE_METRICS
+		ip_my_thread_metrics->message_count++;
+		ip_my_thread_metrics->edge_count += out_neighbour_count;
+	#endif // ifdef IP_ENABLE_METRICS
+	#ifdef IP_USE_SEQUENTIAL_FAST_PATH
+		if(ip_sequential_superstep)
+		{
+			// Keep track of the broadcasters and targets so that the next superstep does not have to scan all vertices to find them.
+			ip_add_to_targets(&ip_sequential_broadcasters, ip_get_vertex_id(v));
+			for(IP_NEIGHBOUR_COUNT_TYPE i = 0; i < out_neighbour_count; i++)
+			{
+				struct ip_externalised_structure_2_t* target = &ip_all_externalised_structures_2[ip_get_vertex_by_id(out_neighbours[i]) - ip_all_vertices];
+				if(!target->broadcast_target)
+				{
+					target->broadcast_target = true;
+					ip_add_to_targets(&ip_sequential_targets, out_neighbours[i]);
+				}
+			}
+			return;
+		}
+	#endif // ifdef IP_USE_SEQUENTIAL_FAST_PATH
+	for(IP_NEIGHBOUR_COUNT_TYPE i = 0; i < out_neighbour_count; i++)
 	{
 		/* Should use "#pragma omp atomic write" to protect the data race, but
 		 * since all threads would race to put the same value in the variable,
 		 * it has been purposely left unprotected.
 		 */
-		ip_all_externalised_structures_2[v->out_neighbours[i]].broadcast_target = true;
+		ip_all_externalised_structures_2[ip_get_vertex_by_id(out_neighbours[i]) - ip_all_vertices].broadcast_target = true;
 	}
 }
 
 void ip_fetch_broadcast_messages(struct ip_vertex_t* v)
 {
+	IP_VERTEX_ID_TYPE* in_neighbours = ip_get_in_neighbours(v);
+	IP_NEIGHBOUR_COUNT_TYPE in_neighbour_count = ip_get_in_neighbour_count(v);
 	IP_NEIGHBOUR_COUNT_TYPE i = 0;
-	while(i < v->in_neighbour_count && !ip_all_externalised_structures_1[v->in_neighbours[i]].has_broadcast_message)
+	#ifdef IP_ENABLE_METRICS
+		ip_record_metrics_fetch(v, in_neighbour_count);
+	#endif // ifdef IP_ENABLE_METRICS
+	while(i < in_neighbour_count && !ip_all_externalised_structures_1[ip_get_vertex_by_id(in_neighbours[i]) - ip_all_vertices].has_broadcast_message)
 	{
 		i++;
 	}
 
-	if(i >= v->in_neighbour_count)
+	if(i >= in_neighbour_count)
 	{
 		v->has_message = false;
 	}
 	else
 	{
 		v->has_message = true;
-		v->message = ip_all_externalised_structures_1[v->in_neighbours[i]].broadcast_message;
+		v->message = ip_all_externalised_structures_1[ip_get_vertex_by_id(in_neighbours[i]) - ip_all_vertices].broadcast_message;
 		i++;
-		while(i < v->in_neighbour_count)
+		while(i < in_neighbour_count)
 		{
-			if(ip_all_externalised_structures_1[v->in_neighbours[i]].has_broadcast_message)
+			if(ip_all_externalised_structures_1[ip_get_vertex_by_id(in_neighbours[i]) - ip_all_vertices].has_broadcast_message)
 			{
-				ip_combine(&v->message, ip_all_externalised_structures_1[v->in_neighbours[i]].broadcast_message);
+				ip_combine(&v->message, ip_all_externalised_structures_1[ip_get_vertex_by_id(in_neighbours[i]) - ip_all_vertices].broadcast_message);
 			}
 			i++;
 		}
@@ -107,29 +143,35 @@ void ip_init_vertex_range(IP_VERTEX_ID_TYPE first, IP_VERTEX_ID_TYPE last)
 {
 	for(IP_VERTEX_ID_TYPE i = first; i <= last; i++)
 	{
-		ip_all_vertices[i].id = i;
+		#ifndef IP_USE_COMPACT_LAYOUT
+			#if defined(IP_ID_OFFSET) && !defined(IP_FORCE_DIRECT_MAPPING)
+				ip_all_vertices[i].id = i + IP_ID_OFFSET;
+			#else
+				ip_all_vertices[i].id = i;
+			#endif // if defined(IP_ID_OFFSET) && !defined(IP_FORCE_DIRECT_MAPPING)
+		#endif // ifndef IP_USE_COMPACT_LAYOUT
 		ip_all_externalised_structures_2[i].broadcast_target = false;
 		ip_all_vertices[i].has_message = false;
 		ip_all_externalised_structures_1[i].has_broadcast_message = false;
-		#ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
+		#if defined(IP_NEEDS_OUT_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 			ip_all_vertices[i].out_neighbour_count = 0;
-		#endif // IP_NEEDS_OUT_NEIGHBOUR_COUNT
-		#ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+		#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
+		#if defined(IP_NEEDS_OUT_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 			ip_all_vertices[i].out_neighbours = NULL;
-		#endif // IP_NEEDS_OUT_NEIGHBOUR_IDS
+		#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 		#ifdef IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS
 			ip_all_vertices[i].out_neighbour_weights = NULL;
 		#endif // IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS
-		#ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+		#if defined(IP_NEEDS_IN_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 			ip_all_vertices[i].in_neighbours = NULL;
-		#endif
-		#ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+		#endif // if defined(IP_NEEDS_IN_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
+		#if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 			ip_all_vertices[i].in_neighbour_count = 0;
-		#endif // IP_NEEDS_IN_NEIGHBOUR_COUNT
+		#endif // if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 		#ifdef IP_NEEDS_IN_NEIGHBOUR_WEIGHTS
 			ip_all_vertices[i].in_neighbour_weights = NULL;
 		#endif // IP_NEEDS_IN_NEIGHBOUR_WEIGHT
-		ip_all_targets.data[i] = ip_all_vertices[i].id;
+		ip_all_targets.data[i] = ip_get_vertex_id(ip_get_vertex_by_location(i));
 	}
 }
 
@@ -137,10 +179,155 @@ void ip_init_specific()
 {
 	ip_all_targets.max_size = ip_get_vertices_count();
 	ip_all_targets.size = ip_get_vertices_count();
-	ip_all_targets.data = ip_safe_malloc(sizeof(IP_VERTEX_ID_TYPE) * ip_all_targets.max_size);
-	ip_all_externalised_structures_1 = (struct ip_externalised_structure_1_t*)ip_safe_malloc(sizeof(struct ip_externalised_structure_1_t) * ip_get_vertices_count());
-	ip_all_externalised_structures_2 = (struct ip_externalised_structure_2_t*)ip_safe_malloc(sizeof(struct ip_externalised_structure_2_t) * ip_get_vertices_count());
+	ip_all_targets.data = ip_safe_tagged_malloc(sizeof(IP_VERTEX_ID_TYPE) * ip_all_targets.max_size, IP_MEMORY_FRONTIERS);
+	ip_all_externalised_structures_1 = (struct ip_externalised_structure_1_t*)ip_safe_tagged_malloc(sizeof(struct ip_externalised_structure_1_t) * ip_get_vertices_count(), IP_MEMORY_MAILBOXES);
+	ip_all_externalised_structures_2 = (struct ip_externalised_structure_2_t*)ip_safe_tagged_malloc(sizeof(struct ip_externalised_structure_2_t) * ip_get_vertices_count(), IP_MEMORY_FRONTIERS);
+}
+
+void ip_predict_memory_specific(size_t bytes[IP_MEMORY_TAG_COUNT])
+{
+	bytes[IP_MEMORY_MAILBOXES] += sizeof(struct ip_externalised_structure_1_t) * ip_get_vertices_count();
+	bytes[IP_MEMORY_FRONTIERS] += (sizeof(IP_VERTEX_ID_TYPE) + sizeof(struct ip_externalised_structure_2_t)) * ip_get_vertices_count();
+}
+
+void ip_reset_specific()
+{
+	// The sequential fast path swaps the targets with buffers sized for small frontiers.
+	if(ip_all_targets.max_size < ip_get_vertices_count())
+	{
+		ip_all_targets.data = ip_safe_realloc(ip_all_targets.data, sizeof(IP_VERTEX_ID_TYPE) * ip_get_vertices_count());
+		ip_all_targets.max_size = ip_get_vertices_count();
+	}
+	#pragma omp parallel for default(none) shared(ip_all_targets, ip_all_externalised_structures_1, ip_all_externalised_structures_2)
+	for(size_t i = 0; i < ip_get_vertices_count(); i++)
+	{
+		ip_get_vertex_by_location(i)->has_message = false;
+		ip_all_externalised_structures_1[i].has_broadcast_message = false;
+		ip_all_externalised_structures_2[i].broadcast_target = false;
+		ip_all_targets.data[i] = ip_get_vertex_id(ip_get_vertex_by_location(i));
+	}
+	ip_all_targets.size = ip_get_vertices_count();
+}
+
+void ip_set_initial_frontier(const IP_VERTEX_ID_TYPE* ids, size_t count)
+{
+	// Before a run, after loading or ip_reset(), the targets hold every vertex, so there is always room for the seeds.
+	memcpy(ip_all_targets.data, ids, sizeof(IP_VERTEX_ID_TYPE) * count);
+	ip_all_targets.size = count;
+}
+
+#ifdef IP_USE_CHECKPOINTS
+void ip_save_vertex_state(size_t location, bool* active, bool* has_message, IP_MESSAGE_TYPE* message)
+{
+	struct ip_vertex_t* v = ip_get_vertex_by_location(location);
+	// Vertices have no status in this version, only the targets run.
+	*active = false;
+	*has_message = v->has_message;
+	*message = v->message;
+}
+
+void ip_restore_vertex_state(size_t location, bool active, bool has_message, IP_MESSAGE_TYPE message)
+{
+	struct ip_vertex_t* v = ip_get_vertex_by_location(location);
+	(void)(active);
+	v->has_message = has_message;
+	v->message = message;
+}
+
+const IP_VERTEX_ID_TYPE* ip_get_frontier(size_t* count)
+{
+	*count = ip_all_targets.size;
+	return ip_all_targets.data;
+}
+#endif // ifdef IP_USE_CHECKPOINTS
+
+#ifdef IP_USE_SEQUENTIAL_FAST_PATH
+/**
+ * @brief This function runs supersteps on the calling thread alone, as long as
+ * the set of targets remains small.
+ * @details Unlike parallel supersteps, which scan all vertices to find the
+ * targets and reset the broadcast flags, the broadcasters and targets are
+ * recorded as they appear so that a superstep costs in proportion to the
+ * edges of the vertices it runs. It returns as soon as the targets grow beyond
+ * the thresholds, run out or the computation is halted.
+ * @param[inout] timer_superstep_total The total time spent in supersteps, to
+ * which the duration of the supersteps run is added.
+ * @pre The other threads are waiting and will not access the targets or the
+ * broadcast flags until this function returns.
+ **/
+void ip_run_sequential_supersteps(double* timer_superstep_total)
+{
+	struct ip_vertex_t* temp_vertex = NULL;
+	struct ip_targets_t swap_targets;
+	double timer_superstep_start = 0;
+	double timer_superstep_stop = 0;
+
+	ip_sequential_superstep = true;
+	while(!ip_is_computation_halted() && ip_all_targets.size > 0 && ip_is_frontier_small(ip_all_targets.data, ip_all_targets.size))
+	{
+		timer_superstep_start = omp_get_wtime();
+		#ifdef IP_ENABLE_METRICS
+			ip_start_metrics_superstep();
+		#endif // ifdef IP_ENABLE_METRICS
+
+		ip_sequential_targets.size = 0;
+		ip_sequential_broadcasters.size = 0;
+		for(size_t i = 0; i < ip_all_targets.size; i++)
+		{
+			temp_vertex = ip_get_vertex_by_id(ip_all_targets.data[i]);
+			ip_compute(temp_vertex);
+			#ifdef IP_ENABLE_METRICS
+				ip_record_metrics_vertex(temp_vertex);
+			#endif // ifdef IP_ENABLE_METRICS
+		}
+		#ifdef IP_ENABLE_METRICS
+			ip_stop_metrics_phase(IP_METRICS_COMPUTE);
+		#endif // ifdef IP_ENABLE_METRICS
+
+		swap_targets = ip_all_targets;
+		ip_all_targets = ip_sequential_targets;
+		ip_sequential_targets = swap_targets;
+		ip_active_vertices = ip_all_targets.size;
+		#ifdef IP_ENABLE_METRICS
+			ip_stop_metrics_phase(IP_METRICS_MERGE);
+		#endif // ifdef IP_ENABLE_METRICS
+
+		for(size_t i = 0; i < ip_all_targets.size; i++)
+		{
+			temp_vertex = ip_get_vertex_by_id(ip_all_targets.data[i]);
+			ip_fetch_broadcast_messages(temp_vertex);
+			ip_all_externalised_structures_2[temp_vertex - ip_all_vertices].broadcast_target = false;
+		}
+		#ifdef IP_ENABLE_METRICS
+			ip_stop_metrics_phase(IP_METRICS_FETCH);
+		#endif // ifdef IP_ENABLE_METRICS
+		for(size_t i = 0; i < ip_sequential_broadcasters.size; i++)
+		{
+			ip_all_externalised_structures_1[ip_sequential_broadcasters.data[i]].has_broadcast_message = false;
+		}
+		#ifdef IP_ENABLE_METRICS
+			ip_stop_metrics_phase(IP_METRICS_RESET);
+		#endif // ifdef IP_ENABLE_METRICS
+
+		timer_superstep_stop = omp_get_wtime();
+		*timer_superstep_total += timer_superstep_stop - timer_superstep_start;
+		printf("Superstep%zuDuration:%f\n", ip_get_superstep(), timer_superstep_stop - timer_superstep_start);
+		printf("Superstep%zuActiveVertexCount:%zu\n", ip_get_superstep(), ip_active_vertices);
+		#ifdef IP_ENABLE_METRICS
+			ip_end_metrics_superstep(timer_superstep_stop - timer_superstep_start, ip_active_vertices);
+		#endif // ifdef IP_ENABLE_METRICS
+		#ifdef IP_ENABLE_MEMORY_ACCOUNTING
+			ip_report_superstep_memory();
+		#endif // ifdef IP_ENABLE_MEMORY_ACCOUNTING
+		ip_reduce_aggregators();
+		ip_increment_superstep();
+		#ifdef IP_NEEDS_MASTER_COMPUTE
+			ip_master_compute();
+		#endif // ifdef IP_NEEDS_MASTER_COMPUTE
+	}
+	ip_sequential_superstep = false;
 }
+#endif // ifdef IP_USE_SEQUENTIAL_FAST_PATH
 
 int ip_run()
 {
@@ -165,11 +352,17 @@ int ip_run()
 		size_t timer_edge_count_total = 0;
 	#endif
 
+	#ifdef IP_ENABLE_METRICS
+		ip_start_metrics_run();
+	#endif // ifdef IP_ENABLE_METRICS
+	ip_start_run();
+
 	#ifdef IP_ENABLE_THREAD_PROFILING
 		#pragma omp parallel default(none) shared(ip_all_targets, \
 												  ip_thread_count, \
 												  ip_all_externalised_structures_1, \
 												  ip_all_externalised_structures_2, \
+												  ip_all_vertices, \
 												  ip_active_vertices, \
 												  timer_compute_start, \
 												  timer_compute_stop, \
@@ -193,6 +386,7 @@ int ip_run()
 												  ip_thread_count, \
 												  ip_all_externalised_structures_1, \
 												  ip_all_externalised_structures_2, \
+												  ip_all_vertices, \
 												  ip_active_vertices, \
 												  timer_superstep_total, \
 												  timer_superstep_start, \
@@ -200,7 +394,7 @@ int ip_run()
 	#endif
 	{	
 		ip_my_thread_num = omp_get_thread_num();
-		while(ip_is_first_superstep() || ip_all_targets.size > 0)
+		while(!ip_is_computation_halted() && (ip_is_first_superstep() || ip_all_targets.size > 0))
 		{
 			/////////////////
 			// START TIME //
@@ -210,6 +404,9 @@ int ip_run()
 			{
 				timer_superstep_start = omp_get_wtime();
 			}
+			#ifdef IP_ENABLE_METRICS
+				ip_start_metrics_superstep();
+			#endif // ifdef IP_ENABLE_METRICS
 
 			////////////////////
 			// COMPUTE PHASE //
@@ -220,8 +417,12 @@ int ip_run()
 				timer_edge_count[ip_my_thread_num] = 0;
 			#endif
 			struct ip_vertex_t* temp_vertex = NULL;
-			#ifdef IP_ENABLE_THREAD_PROFILING
+			#if defined(IP_ENABLE_THREAD_PROFILING) && defined(IP_ENABLE_METRICS)
+				#pragma omp for reduction(+:timer_edge_count_total) schedule(runtime) nowait
+			#elif defined(IP_ENABLE_THREAD_PROFILING)
 				#pragma omp for reduction(+:timer_edge_count_total) schedule(runtime)
+			#elif defined(IP_ENABLE_METRICS)
+				#pragma omp for schedule(runtime) nowait
 			#else
 				#pragma omp for schedule(runtime)
 			#endif
@@ -229,15 +430,23 @@ int ip_run()
 			{
 				temp_vertex = ip_get_vertex_by_id(ip_all_targets.data[i]);
 				ip_compute(temp_vertex);
+				#ifdef IP_ENABLE_METRICS
+					ip_record_metrics_vertex(temp_vertex);
+				#endif // ifdef IP_ENABLE_METRICS
 				#ifdef IP_ENABLE_THREAD_PROFILING
 					timer_compute_stop[ip_my_thread_num] = omp_get_wtime();
-					timer_edge_count[ip_my_thread_num] += temp_vertex->in_neighbour_count;
-					timer_edge_count_total += temp_vertex->out_neighbour_count;
+					timer_edge_count[ip_my_thread_num] += ip_get_in_neighbour_count(temp_vertex);
+					timer_edge_count_total += ip_get_out_neighbour_count(temp_vertex);
 				#endif
 			}
 			#ifdef IP_ENABLE_THREAD_PROFILING
 				timer_compute_total[ip_my_thread_num] = timer_compute_stop[ip_my_thread_num] - timer_compute_start[ip_my_thread_num];
 			#endif
+			#ifdef IP_ENABLE_METRICS
+				ip_start_metrics_wait();
+				#pragma omp barrier
+				ip_stop_metrics_phase(IP_METRICS_COMPUTE);
+			#endif // ifdef IP_ENABLE_METRICS
 		
 			/////////////////////////////
 			// TARGET FILTERING PHASE //
@@ -246,25 +455,37 @@ int ip_run()
 				timer_target_filtering_start[ip_my_thread_num] = omp_get_wtime();
 				timer_target_filtering_stop[ip_my_thread_num] = timer_target_filtering_start[ip_my_thread_num];
 			#endif
+			#ifdef IP_ENABLE_METRICS
+				ip_start_metrics_wait();
+			#endif // ifdef IP_ENABLE_METRICS
 			#pragma omp single
 			{
+				#ifdef IP_ENABLE_METRICS
+					ip_stop_metrics_wait();
+				#endif // ifdef IP_ENABLE_METRICS
 				ip_all_targets.size = 0;
 				for(size_t i = 0; i < ip_get_vertices_count(); i++)
 				{
 					temp_vertex = ip_get_vertex_by_location(i);
 					if(ip_all_externalised_structures_2[i].broadcast_target)
 					{
-						ip_add_target(temp_vertex->id);
+						ip_add_target(ip_get_vertex_id(temp_vertex));
 					}
 				}
 				#ifdef IP_ENABLE_THREAD_PROFILING
 					timer_target_filtering_stop[ip_my_thread_num] = omp_get_wtime();
 				#endif
+				#ifdef IP_ENABLE_METRICS
+					ip_start_metrics_wait();
+				#endif // ifdef IP_ENABLE_METRICS
 			}
 			ip_active_vertices = ip_all_targets.size;
 			#ifdef IP_ENABLE_THREAD_PROFILING
 				timer_target_filtering_total[ip_my_thread_num] = timer_target_filtering_stop[ip_my_thread_num] - timer_target_filtering_start[ip_my_thread_num];
 			#endif
+			#ifdef IP_ENABLE_METRICS
+				ip_stop_metrics_phase(IP_METRICS_MERGE);
+			#endif // ifdef IP_ENABLE_METRICS
 	
 			/////////////////////////////
 			// MESSAGE FETCHING PHASE //
@@ -275,14 +496,18 @@ int ip_run()
 				timer_message_fetching_start[ip_my_thread_num] = omp_get_wtime();
 				timer_message_fetching_stop[ip_my_thread_num] = timer_message_fetching_start[ip_my_thread_num];
 			#endif
-			#pragma omp for schedule(runtime)
+			#ifdef IP_ENABLE_METRICS
+				#pragma omp for schedule(runtime) nowait
+			#else
+				#pragma omp for schedule(runtime)
+			#endif // if(n)def IP_ENABLE_METRICS
 			for(size_t i = 0; i < ip_all_targets.size; i++)
 			{
 				temp_vertex = ip_get_vertex_by_id(ip_all_targets.data[i]);
-				if(ip_all_externalised_structures_2[temp_vertex->id].broadcast_target)
+				if(ip_all_externalised_structures_2[temp_vertex - ip_all_vertices].broadcast_target)
 				{
 					ip_fetch_broadcast_messages(temp_vertex);
-					ip_all_externalised_structures_2[temp_vertex->id].broadcast_target = false;
+					ip_all_externalised_structures_2[temp_vertex - ip_all_vertices].broadcast_target = false;
 				}
 				#ifdef IP_ENABLE_THREAD_PROFILING
 					timer_message_fetching_stop[ip_my_thread_num] = omp_get_wtime();
@@ -291,6 +516,11 @@ int ip_run()
 			#ifdef IP_ENABLE_THREAD_PROFILING
 				timer_message_fetching_total[ip_my_thread_num] = timer_message_fetching_stop[ip_my_thread_num] - timer_message_fetching_start[ip_my_thread_num];
 			#endif
+			#ifdef IP_ENABLE_METRICS
+				ip_start_metrics_wait();
+				#pragma omp barrier
+				ip_stop_metrics_phase(IP_METRICS_FETCH);
+			#endif // ifdef IP_ENABLE_METRICS
 
 			///////////////////////////
 			// STATE RESETING PHASE //
@@ -299,7 +529,11 @@ int ip_run()
 				timer_state_reseting_start[ip_my_thread_num] = omp_get_wtime();
 				timer_state_reseting_stop[ip_my_thread_num] = timer_state_reseting_start[ip_my_thread_num];
 			#endif
-			#pragma omp for schedule(runtime)
+			#ifdef IP_ENABLE_METRICS
+				#pragma omp for schedule(runtime) nowait
+			#else
+				#pragma omp for schedule(runtime)
+			#endif // if(n)def IP_ENABLE_METRICS
 			for(size_t i = 0; i < ip_get_vertices_count(); i++)
 			{
 				ip_all_externalised_structures_1[i].has_broadcast_message = false;
@@ -310,6 +544,16 @@ int ip_run()
 			#ifdef IP_ENABLE_THREAD_PROFILING
 				timer_state_reseting_total[ip_my_thread_num] = timer_state_reseting_stop[ip_my_thread_num] - timer_state_reseting_start[ip_my_thread_num];
 			#endif
+			#ifdef IP_ENABLE_METRICS
+				ip_start_metrics_wait();
+				#pragma omp barrier
+				ip_stop_metrics_phase(IP_METRICS_RESET);
+			#endif // ifdef IP_ENABLE_METRICS
+
+			#ifdef IP_USE_SEQUENTIAL_FAST_PATH
+				// Decided by every thread before the single below, after which the targets may change.
+				bool run_sequentially = ip_is_frontier_small(ip_all_targets.data, ip_all_targets.size);
+			#endif // ifdef IP_USE_SEQUENTIAL_FAST_PATH
 			
 			#pragma omp single
 			{
@@ -317,6 +561,9 @@ int ip_run()
 				timer_superstep_total += timer_superstep_stop - timer_superstep_start;
 				printf("Superstep%zuDuration:%f\n", ip_get_superstep(), timer_superstep_stop - timer_superstep_start);
 				printf("Superstep%zuActiveVertexCount:%zu\n", ip_get_superstep(), ip_active_vertices);
+				#ifdef IP_ENABLE_METRICS
+					ip_end_metrics_superstep(timer_superstep_stop - timer_superstep_start, ip_active_vertices);
+				#endif // ifdef IP_ENABLE_METRICS
 				#ifdef IP_ENABLE_THREAD_PROFILING
 					printf("            +");
 					for(int i = 0; i < ip_thread_count; i++)
@@ -371,12 +618,47 @@ int ip_run()
 					printf("\n");
 					timer_edge_count_total = 0;
 				#endif
+				#ifdef IP_ENABLE_MEMORY_ACCOUNTING
+					ip_report_superstep_memory();
+				#endif // ifdef IP_ENABLE_MEMORY_ACCOUNTING
+				ip_reduce_aggregators();
 				ip_increment_superstep();
+				#ifdef IP_NEEDS_MASTER_COMPUTE
+					ip_master_compute();
+				#endif // ifdef IP_NEEDS_MASTER_COMPUTE
+				#ifdef IP_USE_CHECKPOINTS
+					ip_plan_checkpoint();
+				#endif // ifdef IP_USE_CHECKPOINTS
  			} // End of OpenMP single region
+
+			#ifdef IP_USE_CHECKPOINTS
+				// The single above ends with a barrier, so every thread sees the same decision.
+				if(ip_is_checkpoint_planned())
+				{
+					ip_take_checkpoint();
+				}
+			#endif // ifdef IP_USE_CHECKPOINTS
+
+			#ifdef IP_USE_SEQUENTIAL_FAST_PATH
+				if(run_sequentially)
+				{
+					#pragma omp master
+					{
+						ip_run_sequential_supersteps(&timer_superstep_total);
+					}
+					#pragma omp barrier
+				}
+			#endif // ifdef IP_USE_SEQUENTIAL_FAST_PATH
 		} // End of superstep processing loop
  	} // End of OpenMP region
 
+	#ifdef IP_USE_CHECKPOINTS
+		ip_wait_for_checkpoint();
+	#endif // ifdef IP_USE_CHECKPOINTS
 	printf("Total time of supersteps: %fs.\n", timer_superstep_total);
+	#ifdef IP_ENABLE_METRICS
+		ip_stop_metrics_run();
+	#endif // ifdef IP_ENABLE_METRICS
 
 	#ifdef IP_ENABLE_THREAD_PROFILING
 		free(timer_compute_start);
@@ -392,8 +674,7 @@ int ip_run()
 		free(timer_state_reseting_stop);
 		free(timer_state_reseting_total);
 	#endif
-	free(ip_all_externalised_structures_1);
-	free(ip_all_externalised_structures_2);
+	// The targets and broadcast messages are kept for the next run, see ip_reset().
 	
 	return 0;
 }
@@ -68,25 +68,31 @@ struct ip_externalised_structure_1_t* ip_all_externalised_structures_1 = NULL;
 struct ip_externalised_structure_2_t* ip_all_externalised_structures_2 = NULL;
 /// This variable contains the targets.
 struct ip_targets_t ip_all_targets;
+#ifdef IP_USE_SEQUENTIAL_FAST_PATH
+	/// This variable contains the targets found during a sequential superstep.
+	struct ip_targets_t ip_sequential_targets = {0, 0, NULL};
+	/// This variable contains the vertices that broadcasted during a sequential superstep.
+	struct ip_targets_t ip_sequential_broadcasters = {0, 0, NULL};
+#endif // ifdef IP_USE_SEQUENTIAL_FAST_PATH
 /// This structure defines the structure of a vertex.
 struct ip_vertex_t
 {
-	#ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+	#if defined(IP_NEEDS_OUT_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 		/// Contains the identifiers of the out-neighbours
 		IP_VERTEX_ID_TYPE* out_neighbours;
-	#endif // IP_NEEDS_OUT_NEIGHBOUR_IDS
-	#ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+	#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
+	#if defined(IP_NEEDS_IN_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
 		/// Contains the identifiers of the in-neighbours
 		IP_VERTEX_ID_TYPE* in_neighbours;
-	#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
-	#ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
+	#endif // if defined(IP_NEEDS_IN_NEIGHBOUR_IDS) && !defined(IP_USE_COMPACT_LAYOUT)
+	#if defined(IP_NEEDS_OUT_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 		/// Contains the number of out-neighbours
 		IP_NEIGHBOUR_COUNT_TYPE out_neighbour_count;
-	#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
-	#ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+	#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
+	#if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 		/// Contains the number of in-neighbours
 		IP_NEIGHBOUR_COUNT_TYPE in_neighbour_count;
-	#endif // IP_UNUSED_IN_NEIGHBOURS
+	#endif // if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) && !defined(IP_USE_COMPACT_LAYOUT)
 	#ifdef IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS
 		/// Contains the weights of out-edges
 		IP_EDGE_WEIGHT_TYPE* out_neighbour_weights;
@@ -97,8 +103,10 @@ struct ip_vertex_t
 	#endif // IP_WEIGHTED_EDGES
 	/// Indicates whether the vertex received messages from last superstep
 	bool has_message;
-	/// The vertex identifier
-	IP_VERTEX_ID_TYPE id;
+	#ifndef IP_USE_COMPACT_LAYOUT
+		/// The vertex identifier
+		IP_VERTEX_ID_TYPE id;
+	#endif // ifndef IP_USE_COMPACT_LAYOUT
 	/// The combined message made from messages received from last superstep
 	IP_MESSAGE_TYPE message;
 	/// The user-defined value
@@ -0,0 +1,154 @@
+/**
+ * @file contention_counters.h
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This file contains the counters of the message path enabled with
+ * IP_ENABLE_CONTENTION_COUNTERS, for the versions that push messages.
+ * @details Every thread counts, in a slot of its own, the messages it sends,
+ * how many of them found the mailbox empty and took its lock, how long it
+ * waited for locks, the compare-and-swaps it made and how many failed, and how
+ * many messages were combined into a mailbox rather than written into an empty
+ * one. The thread ending a superstep sums the slots, prints the sums and
+ * clears the slots; every message has been delivered by then and no thread
+ * sends the next ones until it is done.
+ *
+ * Lock waits are counted in pauses for the TTAS and ticket locks and in failed
+ * attempts for the default lock; the OpenMP and POSIX locks wait internally
+ * and are not counted.
+ *
+ * This file must be included by lock.h.
+ **/
+
+#ifndef CONTENTION_COUNTERS_H_INCLUDED
+#define CONTENTION_COUNTERS_H_INCLUDED
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// The counters of the message path.
+enum ip_contention_counter_t
+{
+	/// The messages sent with ip_send_message.
+	IP_CONTENTION_SENDS,
+	/// The messages that found the mailbox empty and took its lock to write it.
+	IP_CONTENTION_LOCK_SENDS,
+	/// The pauses, or failed attempts, made while waiting for a lock.
+	IP_CONTENTION_LOCK_SPINS,
+	/// The compare-and-swaps made to combine a message into a mailbox.
+	IP_CONTENTION_CAS_ATTEMPTS,
+	/// The compare-and-swaps that failed because another thread updated the mailbox first.
+	IP_CONTENTION_CAS_FAILURES,
+	/// The messages combined with the message already in a mailbox.
+	IP_CONTENTION_COMBINED_MESSAGES,
+	/// The messages written into an empty mailbox.
+	IP_CONTENTION_FIRST_WRITE_MESSAGES,
+	/// The number of counters.
+	IP_CONTENTION_COUNTER_COUNT
+};
+/// The names of the counters, as printed.
+const char* ip_contention_counter_names[IP_CONTENTION_COUNTER_COUNT] = { "SendCount", "LockSendCount", "LockSpinCount", "CasAttemptCount", "CasFailureCount", "CombinedMessageCount", "FirstWriteMessageCount" };
+
+/// This structure holds the counters of a thread, alone on its cache lines.
+struct ip_contention_counters_t
+{
+	/// The value of each counter since the last superstep ended.
+	_Alignas(IP_CACHE_LINE_SIZE) size_t counts[IP_CONTENTION_COUNTER_COUNT];
+};
+
+/// The slots of all threads, one per thread.
+struct ip_contention_counters_t* ip_all_contention_counters = NULL;
+/// The slot of the calling thread.
+struct ip_contention_counters_t* ip_my_contention_counters = NULL;
+#pragma omp threadprivate(ip_my_contention_counters)
+/// The sums of the counters over the supersteps of the current ip_run().
+size_t ip_contention_run_counts[IP_CONTENTION_COUNTER_COUNT];
+
+/**
+ * @brief This function allocates the slots of all threads, the first time it
+ * is called, and clears them.
+ * @details It must be called at the start of ip_run(), before the parallel
+ * region.
+ **/
+void ip_start_contention_run()
+{
+	if(ip_all_contention_counters == NULL)
+	{
+		ip_all_contention_counters = aligned_alloc(IP_CACHE_LINE_SIZE, sizeof(struct ip_contention_counters_t) * ip_thread_count);
+		if(ip_all_contention_counters == NULL)
+		{
+			printf("Failed to allocate the contention counters of %d threads.\n", ip_thread_count);
+			exit(-1);
+		}
+	}
+	memset(ip_all_contention_counters, 0, sizeof(struct ip_contention_counters_t) * ip_thread_count);
+	memset(ip_contention_run_counts, 0, sizeof(ip_contention_run_counts));
+}
+
+/**
+ * @brief This function points the calling thread to its slot.
+ * @details It must be called by every thread at the start of every superstep,
+ * before it sends any message.
+ **/
+void ip_start_contention_superstep()
+{
+	ip_my_contention_counters = &ip_all_contention_counters[omp_get_thread_num()];
+}
+
+/**
+ * @brief This function prints the sums of the counters of all threads for the
+ * current superstep, then clears the slots.
+ * @details It must be called by a single thread, before the superstep number
+ * is incremented, once every message of the superstep has been delivered and
+ * before any message of the next superstep is sent.
+ **/
+void ip_collect_contention_counters()
+{
+	size_t counts[IP_CONTENTION_COUNTER_COUNT] = { 0 };
+	for(int i = 0; i < ip_thread_count; i++)
+	{
+		for(int j = 0; j < IP_CONTENTION_COUNTER_COUNT; j++)
+		{
+			counts[j] += ip_all_contention_counters[i].counts[j];
+		}
+	}
+	memset(ip_all_contention_counters, 0, sizeof(struct ip_contention_counters_t) * ip_thread_count);
+	for(int j = 0; j < IP_CONTENTION_COUNTER_COUNT; j++)
+	{
+		ip_contention_run_counts[j] += counts[j];
+		printf("Superstep%zu%s:%zu\n", ip_get_superstep(), ip_contention_counter_names[j], counts[j]);
+	}
+}
+
+/**
+ * @brief This function prints the sums of the counters over the supersteps of
+ * the run, along with the share of compare-and-swaps that failed and the
+ * number of lock waits per message that took the lock.
+ * @details It must be called at the end of ip_run(), after the parallel
+ * region.
+ **/
+void ip_report_contention_counters()
+{
+	for(int j = 0; j < IP_CONTENTION_COUNTER_COUNT; j++)
+	{
+		printf("Contention%s:%zu\n", ip_contention_counter_names[j], ip_contention_run_counts[j]);
+	}
+	size_t cas_attempts = ip_contention_run_counts[IP_CONTENTION_CAS_ATTEMPTS];
+	size_t lock_sends = ip_contention_run_counts[IP_CONTENTION_LOCK_SENDS];
+	printf("ContentionCasFailureRate:%f\n", cas_attempts > 0 ? ((double)ip_contention_run_counts[IP_CONTENTION_CAS_FAILURES]) / cas_attempts : 0.0);
+	printf("ContentionLockSpinsPerLockSend:%f\n", lock_sends > 0 ? ((double)ip_contention_run_counts[IP_CONTENTION_LOCK_SPINS]) / lock_sends : 0.0);
+}
+
+#endif // CONTENTION_COUNTERS_H_INCLUDED
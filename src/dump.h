@@ -0,0 +1,527 @@
+/**
+ * @file dump.h
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This file implements the dumps written by all threads, on which
+ * ip_dump() relies with IP_USE_PARALLEL_DUMP or IP_USE_BINARY_DUMP, and the
+ * selection of the vertices to dump by ip_dump_if() and ip_dump_top_k().
+ * @details Both dumps write at the position of the file given to ip_dump()
+ * with pwrite, or through a memory mapping of the file with
+ * IP_USE_MMAP_DUMP, and leave the file after what they wrote, as a
+ * sequential dump would.
+ * This file must be included by the iPregel postamble.
+ **/
+
+#ifndef DUMP_H_INCLUDED
+#define DUMP_H_INCLUDED
+
+#include <omp.h>
+
+/**
+ * @brief This function writes the serialised representation of the vertex
+ * \p v in the file \p f, with the serialisation function defined by the
+ * user.
+ * @param[in] f The file to write into.
+ * @param[in] v The vertex to serialise.
+ **/
+void ip_write_vertex(FILE* f, struct ip_vertex_t* v)
+{
+	#ifdef IP_USE_PARALLEL_DUMP
+		char buffer[256];
+		size_t length = ip_serialise_vertex_to_buffer(buffer, sizeof(buffer), v);
+		if(length < sizeof(buffer))
+		{
+			fwrite(buffer, sizeof(char), length, f);
+		}
+		else
+		{
+			char* large_buffer = (char*)ip_safe_malloc(length + 1);
+			ip_serialise_vertex_to_buffer(large_buffer, length + 1, v);
+			fwrite(large_buffer, sizeof(char), length, f);
+			ip_safe_free(large_buffer);
+		}
+	#else // ifndef IP_USE_PARALLEL_DUMP
+		ip_serialise_vertex(f, v);
+	#endif // if(n)def IP_USE_PARALLEL_DUMP
+}
+
+#if defined(IP_USE_PARALLEL_DUMP) || defined(IP_USE_BINARY_DUMP)
+	#include <errno.h>
+	#include <unistd.h> // pwrite
+	/// The number of consecutive vertices a thread serialises before writing them.
+	#ifndef IP_DUMP_CHUNK_SIZE
+		#define IP_DUMP_CHUNK_SIZE 65536
+	#endif // ifndef IP_DUMP_CHUNK_SIZE
+
+	/**
+	 * @brief This function writes the \p length bytes of \p buffer at the
+	 * offset \p offset of the file \p file_descriptor.
+	 * @details It can be called by several threads at once, on different
+	 * parts of the file. The program stops if the write fails.
+	 * @param[in] file_descriptor The file to write into.
+	 * @param[in] buffer The bytes to write.
+	 * @param[in] length The number of bytes to write.
+	 * @param[in] offset The position in the file at which write.
+	 **/
+	void ip_write_at(int file_descriptor, const char* buffer, size_t length, off_t offset)
+	{
+		size_t written = 0;
+		while(written < length)
+		{
+			ssize_t result = pwrite(file_descriptor, buffer + written, length - written, offset + written);
+			if(result < 0)
+			{
+				if(errno == EINTR)
+				{
+					continue;
+				}
+				perror("Failed to write the dump");
+				exit(-1);
+			}
+			written += result;
+		}
+	}
+
+	/**
+	 * @brief This function flushes the file \p f and returns the position at
+	 * which a dump must start in it.
+	 * @param[in] f The file to dump into.
+	 * @return The position of \p f, what was written through \p f included.
+	 **/
+	off_t ip_get_dump_start(FILE* f)
+	{
+		// What was written through f before must reach the file before threads write after it.
+		fflush(f);
+		off_t dump_start = ftello(f);
+		if(dump_start < 0)
+		{
+			printf("Dumping in parallel needs a file supporting positional writes, such as a regular file. Abort...\n");
+			exit(-1);
+		}
+		return dump_start;
+	}
+#endif // if defined(IP_USE_PARALLEL_DUMP) || defined(IP_USE_BINARY_DUMP)
+
+#ifdef IP_USE_PARALLEL_DUMP
+	/// The initial size in bytes of the buffer of every thread, doubled whenever a vertex does not fit.
+	#ifndef IP_DUMP_BUFFER_SIZE
+		#define IP_DUMP_BUFFER_SIZE (1 << 20)
+	#endif // ifndef IP_DUMP_BUFFER_SIZE
+
+	/**
+	 * @brief This function writes the serialised representation of all
+	 * vertices, or of those satisfying \p predicate, in the file \p f, from
+	 * all threads.
+	 * @details Threads work in rounds. Every round, they serialise
+	 * consecutive chunks of IP_DUMP_CHUNK_SIZE vertices, in thread order, with
+	 * ip_serialise_vertex_to_buffer(), and each thread writes its buffer after
+	 * the buffers of the threads before it, so the file is that of a
+	 * sequential dump while memory used does not grow with the graph. Files
+	 * that cannot tell their position, such as pipes, are written
+	 * sequentially with ip_write_vertex() and reported empty.
+	 * @param[in] f The file to dump into.
+	 * @param[in] predicate The predicate selecting the vertices to dump, or
+	 * NULL to dump them all.
+	 * @return The number of bytes written.
+	 **/
+	size_t ip_dump_text_in_parallel(FILE* f, ip_vertex_predicate_t predicate)
+	{
+		fflush(f);
+		if(ftello(f) < 0)
+		{
+			// Pipes and terminals cannot be written at a position, so vertices are written one after the other instead.
+			for(size_t i = 0; i < ip_get_vertices_count(); i++)
+			{
+				struct ip_vertex_t* v = ip_get_vertex_by_location(i);
+				if(predicate == NULL || predicate(v))
+				{
+					ip_write_vertex(f, v);
+				}
+			}
+			return 0;
+		}
+		int file_descriptor = fileno(f);
+		off_t dump_start = ip_get_dump_start(f);
+		off_t dump_end = dump_start;
+		size_t* buffer_lengths = (size_t*)ip_safe_malloc(sizeof(size_t) * ip_thread_count);
+		#pragma omp parallel default(none) shared(file_descriptor, dump_start, dump_end, buffer_lengths, predicate)
+		{
+			int thread_id = omp_get_thread_num();
+			int thread_count = omp_get_num_threads();
+			size_t buffer_size = IP_DUMP_BUFFER_SIZE;
+			char* buffer = (char*)ip_safe_malloc(buffer_size);
+			off_t round_offset = dump_start;
+
+			for(size_t round_start = 0; round_start < ip_get_vertices_count(); round_start += (size_t)thread_count * IP_DUMP_CHUNK_SIZE)
+			{
+				size_t chunk_start = round_start + (size_t)thread_id * IP_DUMP_CHUNK_SIZE;
+				size_t chunk_end = chunk_start + IP_DUMP_CHUNK_SIZE;
+				if(chunk_end > ip_get_vertices_count())
+				{
+					chunk_end = ip_get_vertices_count();
+				}
+				size_t length = 0;
+				for(size_t i = chunk_start; i < chunk_end; i++)
+				{
+					struct ip_vertex_t* v = ip_get_vertex_by_location(i);
+					if(predicate != NULL && !predicate(v))
+					{
+						continue;
+					}
+					size_t vertex_length = ip_serialise_vertex_to_buffer(buffer + length, buffer_size - length, v);
+					if(vertex_length >= buffer_size - length)
+					{
+						while(vertex_length >= buffer_size - length)
+						{
+							buffer_size *= 2;
+						}
+						buffer = (char*)ip_safe_realloc(buffer, buffer_size);
+						vertex_length = ip_serialise_vertex_to_buffer(buffer + length, buffer_size - length, v);
+					}
+					length += vertex_length;
+				}
+				buffer_lengths[thread_id] = length;
+				#pragma omp barrier
+
+				off_t offset = round_offset;
+				for(int j = 0; j < thread_count; j++)
+				{
+					if(j < thread_id)
+					{
+						offset += buffer_lengths[j];
+					}
+					round_offset += buffer_lengths[j];
+				}
+				ip_write_at(file_descriptor, buffer, length, offset);
+				// Threads must have read the lengths of this round before they are overwritten.
+				#pragma omp barrier
+			}
+			ip_safe_free(buffer);
+
+			if(thread_id == 0)
+			{
+				dump_end = round_offset;
+			}
+		}
+		ip_safe_free(buffer_lengths);
+		fseeko(f, dump_end, SEEK_SET);
+		return dump_end - dump_start;
+	}
+#endif // ifdef IP_USE_PARALLEL_DUMP
+
+/**
+ * @brief This function prints the duration of a dump, the number of bytes
+ * written and the resulting throughput.
+ * @param[in] duration The duration of the dump, in seconds.
+ * @param[in] dump_size The number of bytes written.
+ **/
+void ip_report_dump(double duration, size_t dump_size)
+{
+	printf("DumpingTime:%f\n", duration);
+	printf("DumpingBytes:%zu\n", dump_size);
+	printf("DumpingMegabytesPerSecond:%f\n", dump_size / duration / 1e6);
+}
+
+/**
+ * @brief This function returns the number of bytes written through \p f
+ * since the position \p start.
+ * @details Files that cannot tell their position, such as pipes, are
+ * reported empty.
+ * @param[in] f The file written.
+ * @param[in] start The position of \p f before writing.
+ * @return The number of bytes written.
+ **/
+size_t ip_get_bytes_written(FILE* f, long start)
+{
+	fflush(f);
+	long end = ftell(f);
+	return (start >= 0 && end >= start) ? (size_t)(end - start) : 0;
+}
+
+/// This structure holds the locations of the best vertices found so far, in a heap whose root is the worst of them.
+struct ip_top_k_heap_t
+{
+	/// The locations of the vertices kept.
+	size_t* locations;
+	/// The number of vertices kept.
+	size_t size;
+	/// The maximum number of vertices kept.
+	size_t capacity;
+};
+
+/**
+ * @brief This function tells whether the vertex at location \p a ranks before
+ * the vertex at location \p b.
+ * @details Vertices whose values tie rank in location order, so that the
+ * selection does not depend on the number of threads.
+ * @param[in] a The location of the first vertex.
+ * @param[in] b The location of the second vertex.
+ * @param[in] comes_before The comparator ranking values.
+ * @retval true \p a ranks before \p b.
+ * @retval false \p a ranks after \p b.
+ **/
+bool ip_ranks_before(size_t a, size_t b, ip_value_comparator_t comes_before)
+{
+	const IP_VALUE_TYPE* value_a = &ip_get_vertex_by_location(a)->value;
+	const IP_VALUE_TYPE* value_b = &ip_get_vertex_by_location(b)->value;
+	if(comes_before(value_a, value_b))
+	{
+		return true;
+	}
+	if(comes_before(value_b, value_a))
+	{
+		return false;
+	}
+	return a < b;
+}
+
+/**
+ * @brief This function moves down the vertex at position \p i of the heap
+ * \p heap until it ranks before its children.
+ * @param[inout] heap The heap to repair.
+ * @param[in] i The position of the vertex to move.
+ * @param[in] comes_before The comparator ranking values.
+ **/
+void ip_top_k_sift_down(struct ip_top_k_heap_t* heap, size_t i, ip_value_comparator_t comes_before)
+{
+	while(true)
+	{
+		size_t worst = i;
+		size_t left = 2 * i + 1;
+		size_t right = left + 1;
+		if(left < heap->size && ip_ranks_before(heap->locations[worst], heap->locations[left], comes_before))
+		{
+			worst = left;
+		}
+		if(right < heap->size && ip_ranks_before(heap->locations[worst], heap->locations[right], comes_before))
+		{
+			worst = right;
+		}
+		if(worst == i)
+		{
+			return;
+		}
+		size_t temp = heap->locations[i];
+		heap->locations[i] = heap->locations[worst];
+		heap->locations[worst] = temp;
+		i = worst;
+	}
+}
+
+/**
+ * @brief This function keeps the vertex at location \p location in the heap
+ * \p heap if the heap is not full or if the vertex ranks before the worst
+ * vertex kept, which it then replaces.
+ * @param[inout] heap The heap to offer the vertex to.
+ * @param[in] location The location of the vertex.
+ * @param[in] comes_before The comparator ranking values.
+ **/
+void ip_top_k_offer(struct ip_top_k_heap_t* heap, size_t location, ip_value_comparator_t comes_before)
+{
+	if(heap->size < heap->capacity)
+	{
+		size_t i = heap->size;
+		heap->locations[i] = location;
+		heap->size++;
+		while(i > 0 && ip_ranks_before(heap->locations[(i - 1) / 2], heap->locations[i], comes_before))
+		{
+			size_t temp = heap->locations[i];
+			heap->locations[i] = heap->locations[(i - 1) / 2];
+			heap->locations[(i - 1) / 2] = temp;
+			i = (i - 1) / 2;
+		}
+	}
+	else if(heap->capacity > 0 && ip_ranks_before(location, heap->locations[0], comes_before))
+	{
+		heap->locations[0] = location;
+		ip_top_k_sift_down(heap, 0, comes_before);
+	}
+}
+
+/**
+ * @brief This function selects the \p k vertices whose values rank first.
+ * @details Every thread offers the vertices it scans to a heap of its own,
+ * without synchronisation, then a single thread offers the vertices kept by
+ * all threads to a last heap, and empties it from the worst vertex to the
+ * best.
+ * @param[in] k The number of vertices to select.
+ * @param[in] comes_before The comparator ranking values.
+ * @param[out] count The number of vertices selected, which is lower than
+ * \p k if the graph has fewer vertices.
+ * @return The locations of the vertices selected, best first, to free by the
+ * caller.
+ **/
+size_t* ip_select_top_k(size_t k, ip_value_comparator_t comes_before, size_t* count)
+{
+	if(k > ip_get_vertices_count())
+	{
+		k = ip_get_vertices_count();
+	}
+	struct ip_top_k_heap_t* thread_heaps = (struct ip_top_k_heap_t*)ip_safe_malloc(sizeof(struct ip_top_k_heap_t) * ip_thread_count);
+	int heap_count = 0;
+	#pragma omp parallel default(none) shared(k, comes_before, thread_heaps, heap_count)
+	{
+		struct ip_top_k_heap_t* heap = &thread_heaps[omp_get_thread_num()];
+		heap->locations = (size_t*)ip_safe_malloc(sizeof(size_t) * (k > 0 ? k : 1));
+		heap->size = 0;
+		heap->capacity = k;
+		#pragma omp single
+		{
+			heap_count = omp_get_num_threads();
+		}
+
+		#pragma omp for
+		for(size_t i = 0; i < ip_get_vertices_count(); i++)
+		{
+			ip_top_k_offer(heap, i, comes_before);
+		}
+	}
+
+	struct ip_top_k_heap_t merged;
+	merged.locations = (size_t*)ip_safe_malloc(sizeof(size_t) * (k > 0 ? k : 1));
+	merged.size = 0;
+	merged.capacity = k;
+	for(int i = 0; i < heap_count; i++)
+	{
+		for(size_t j = 0; j < thread_heaps[i].size; j++)
+		{
+			ip_top_k_offer(&merged, thread_heaps[i].locations[j], comes_before);
+		}
+		ip_safe_free(thread_heaps[i].locations);
+	}
+	ip_safe_free(thread_heaps);
+
+	*count = merged.size;
+	size_t* selected = (size_t*)ip_safe_malloc(sizeof(size_t) * (k > 0 ? k : 1));
+	while(merged.size > 0)
+	{
+		selected[merged.size - 1] = merged.locations[0];
+		merged.size--;
+		merged.locations[0] = merged.locations[merged.size];
+		ip_top_k_sift_down(&merged, 0, comes_before);
+	}
+	ip_safe_free(merged.locations);
+	return selected;
+}
+
+#ifdef IP_USE_BINARY_DUMP
+	#include "binary_dump_format.h"
+	#ifdef IP_USE_MMAP_DUMP
+		#include <sys/mman.h>
+	#endif // ifdef IP_USE_MMAP_DUMP
+
+	/// The kind of IP_VALUE_TYPE, told from the type of the value of a vertex, which is not evaluated.
+	#define IP_BINARY_DUMP_VALUE_KIND _Generic(((struct ip_vertex_t*)NULL)->value, \
+		_Bool: IP_BINARY_DUMP_KIND_UNSIGNED, \
+		unsigned char: IP_BINARY_DUMP_KIND_UNSIGNED, \
+		unsigned short: IP_BINARY_DUMP_KIND_UNSIGNED, \
+		unsigned int: IP_BINARY_DUMP_KIND_UNSIGNED, \
+		unsigned long: IP_BINARY_DUMP_KIND_UNSIGNED, \
+		unsigned long long: IP_BINARY_DUMP_KIND_UNSIGNED, \
+		char: IP_BINARY_DUMP_KIND_SIGNED, \
+		signed char: IP_BINARY_DUMP_KIND_SIGNED, \
+		short: IP_BINARY_DUMP_KIND_SIGNED, \
+		int: IP_BINARY_DUMP_KIND_SIGNED, \
+		long: IP_BINARY_DUMP_KIND_SIGNED, \
+		long long: IP_BINARY_DUMP_KIND_SIGNED, \
+		float: IP_BINARY_DUMP_KIND_FLOATING, \
+		double: IP_BINARY_DUMP_KIND_FLOATING, \
+		long double: IP_BINARY_DUMP_KIND_FLOATING, \
+		default: IP_BINARY_DUMP_KIND_RAW)
+
+	/**
+	 * @brief This function writes the value of every vertex, preceded by a
+	 * header, in the file \p f, from all threads.
+	 * @details The layout is described in binary_dump_format.h. Since values
+	 * have a fixed size, every chunk of IP_DUMP_CHUNK_SIZE vertices knows its
+	 * place in the file, so threads write chunks as they gather them. With
+	 * IP_USE_MMAP_DUMP, the file is extended and mapped in memory instead, and
+	 * threads copy values straight into the mapping, which needs \p f to be
+	 * open in read-write mode, such as "w+".
+	 * @param[in] f The file to dump into.
+	 * @return The number of bytes written.
+	 **/
+	size_t ip_dump_binary(FILE* f)
+	{
+		int file_descriptor = fileno(f);
+		off_t dump_start = ip_get_dump_start(f);
+
+		struct ip_binary_dump_header_t header;
+		memset(&header, 0, sizeof(struct ip_binary_dump_header_t));
+		memcpy(header.magic, IP_BINARY_DUMP_MAGIC, sizeof(header.magic));
+		header.version = IP_BINARY_DUMP_VERSION;
+		header.vertex_count = ip_get_vertices_count();
+		header.first_id = ip_get_vertices_count() > 0 ? ip_get_vertex_id(ip_get_vertex_by_location(0)) : 0;
+		header.id_size = sizeof(IP_VERTEX_ID_TYPE);
+		header.value_size = sizeof(IP_VALUE_TYPE);
+		header.value_kind = IP_BINARY_DUMP_VALUE_KIND;
+		header.header_size = sizeof(struct ip_binary_dump_header_t);
+		size_t dump_size = sizeof(struct ip_binary_dump_header_t) + sizeof(IP_VALUE_TYPE) * ip_get_vertices_count();
+
+		#ifdef IP_USE_MMAP_DUMP
+			// Mappings start on a page boundary, which the dump may not.
+			off_t map_start = dump_start - dump_start % sysconf(_SC_PAGESIZE);
+			size_t map_size = dump_start - map_start + dump_size;
+			if(ftruncate(file_descriptor, dump_start + dump_size) != 0)
+			{
+				perror("Failed to extend the file to dump into");
+				exit(-1);
+			}
+			char* map = (char*)mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor, map_start);
+			if(map == MAP_FAILED)
+			{
+				perror("Failed to map the file to dump into, which must be open in read-write mode");
+				exit(-1);
+			}
+			char* dump = map + (dump_start - map_start);
+			memcpy(dump, &header, sizeof(struct ip_binary_dump_header_t));
+			char* values = dump + sizeof(struct ip_binary_dump_header_t);
+			#pragma omp parallel for default(none) shared(values)
+			for(size_t i = 0; i < ip_get_vertices_count(); i++)
+			{
+				memcpy(values + sizeof(IP_VALUE_TYPE) * i, &ip_get_vertex_by_location(i)->value, sizeof(IP_VALUE_TYPE));
+			}
+			munmap(map, map_size);
+		#else // ifndef IP_USE_MMAP_DUMP
+			ip_write_at(file_descriptor, (const char*)&header, sizeof(struct ip_binary_dump_header_t), dump_start);
+			off_t values_start = dump_start + sizeof(struct ip_binary_dump_header_t);
+			size_t chunk_count = (ip_get_vertices_count() + IP_DUMP_CHUNK_SIZE - 1) / IP_DUMP_CHUNK_SIZE;
+			#pragma omp parallel default(none) shared(file_descriptor, values_start, chunk_count)
+			{
+				IP_VALUE_TYPE* buffer = (IP_VALUE_TYPE*)ip_safe_malloc(sizeof(IP_VALUE_TYPE) * IP_DUMP_CHUNK_SIZE);
+				#pragma omp for schedule(dynamic, 1)
+				for(size_t chunk = 0; chunk < chunk_count; chunk++)
+				{
+					size_t chunk_start = chunk * IP_DUMP_CHUNK_SIZE;
+					size_t chunk_end = chunk_start + IP_DUMP_CHUNK_SIZE;
+					if(chunk_end > ip_get_vertices_count())
+					{
+						chunk_end = ip_get_vertices_count();
+					}
+					for(size_t i = chunk_start; i < chunk_end; i++)
+					{
+						buffer[i - chunk_start] = ip_get_vertex_by_location(i)->value;
+					}
+					ip_write_at(file_descriptor, (const char*)buffer, sizeof(IP_VALUE_TYPE) * (chunk_end - chunk_start), values_start + sizeof(IP_VALUE_TYPE) * chunk_start);
+				}
+				ip_safe_free(buffer);
+			}
+		#endif // if(n)def IP_USE_MMAP_DUMP
+
+		fseeko(f, dump_start + dump_size, SEEK_SET);
+		return dump_size;
+	}
+#endif // ifdef IP_USE_BINARY_DUMP
+
+#endif // DUMP_H_INCLUDED
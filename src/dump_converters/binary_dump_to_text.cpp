@@ -0,0 +1,181 @@
+/**
+ * @file binary_dump_to_text.cpp
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This program renders a binary dump, written by ip_dump() with
+ * IP_USE_BINARY_DUMP, in the text format of the benchmarks: one line
+ * "<id>: <value>" per vertex.
+ * @details Integers are printed in decimal, floating-point numbers with 20
+ * decimals and values of any other type in hexadecimal, most significant byte
+ * first, which for bitsets made of 64-bit words gives the format of msbfs.
+ **/
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cinttypes>
+#include "../binary_dump_format.h"
+
+/// The number of values read at once.
+const size_t VALUES_PER_READ = 1 << 16;
+
+/**
+ * @brief This function writes the value held in \p value in the file
+ * \p output.
+ * @param[in] output The file to write into.
+ * @param[in] header The header of the dump, which tells the type of values.
+ * @param[in] value The bytes of the value.
+ * @retval true The value has been written.
+ * @retval false The type of values is not supported.
+ **/
+bool write_value(FILE* output, const struct ip_binary_dump_header_t& header, const unsigned char* value)
+{
+	switch(header.value_kind)
+	{
+		case IP_BINARY_DUMP_KIND_UNSIGNED:
+		{
+			uint64_t v = 0;
+			switch(header.value_size)
+			{
+				case 1: { uint8_t x; memcpy(&x, value, 1); v = x; break; }
+				case 2: { uint16_t x; memcpy(&x, value, 2); v = x; break; }
+				case 4: { uint32_t x; memcpy(&x, value, 4); v = x; break; }
+				case 8: { memcpy(&v, value, 8); break; }
+				default: return false;
+			}
+			fprintf(output, "%" PRIu64, v);
+			return true;
+		}
+		case IP_BINARY_DUMP_KIND_SIGNED:
+		{
+			int64_t v = 0;
+			switch(header.value_size)
+			{
+				case 1: { int8_t x; memcpy(&x, value, 1); v = x; break; }
+				case 2: { int16_t x; memcpy(&x, value, 2); v = x; break; }
+				case 4: { int32_t x; memcpy(&x, value, 4); v = x; break; }
+				case 8: { memcpy(&v, value, 8); break; }
+				default: return false;
+			}
+			fprintf(output, "%" PRId64, v);
+			return true;
+		}
+		case IP_BINARY_DUMP_KIND_FLOATING:
+			if(header.value_size == sizeof(float))
+			{
+				float v;
+				memcpy(&v, value, sizeof(float));
+				fprintf(output, "%0.20f", v);
+			}
+			else if(header.value_size == sizeof(double))
+			{
+				double v;
+				memcpy(&v, value, sizeof(double));
+				fprintf(output, "%0.20f", v);
+			}
+			else if(header.value_size == sizeof(long double))
+			{
+				long double v;
+				memcpy(&v, value, sizeof(long double));
+				fprintf(output, "%0.20Lf", v);
+			}
+			else
+			{
+				return false;
+			}
+			return true;
+		case IP_BINARY_DUMP_KIND_RAW:
+			for(uint32_t i = header.value_size; i > 0; i--)
+			{
+				fprintf(output, "%02x", value[i - 1]);
+			}
+			return true;
+		default:
+			return false;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc != 3)
+	{
+		std::cerr << "Incorrect number of arguments, please invoke this program"
+			      << " like: " << argv[0] << " <binary_dump> <output_file>"
+				  << std::endl;
+		return -1;
+	}
+
+	FILE* input = fopen(argv[1], "rb");
+	if(input == NULL)
+	{
+		std::cerr << "Failure in opening the binary dump \"" << argv[1] << "\"." << std::endl;
+		return -1;
+	}
+
+	struct ip_binary_dump_header_t header;
+	if(fread(&header, sizeof(struct ip_binary_dump_header_t), 1, input) != 1
+	|| memcmp(header.magic, IP_BINARY_DUMP_MAGIC, sizeof(header.magic)) != 0)
+	{
+		std::cerr << "\"" << argv[1] << "\" is not a binary dump." << std::endl;
+		return -1;
+	}
+	if(header.version != IP_BINARY_DUMP_VERSION)
+	{
+		std::cerr << "Unsupported binary dump version " << header.version << ", expecting " << IP_BINARY_DUMP_VERSION << "." << std::endl;
+		return -1;
+	}
+	if(fseek(input, header.header_size, SEEK_SET) != 0)
+	{
+		std::cerr << "Failure in reaching the values of the binary dump." << std::endl;
+		return -1;
+	}
+	std::cout << header.vertex_count << " vertices" << std::endl;
+	std::cout << header.value_size << "-byte values of kind '" << (char)header.value_kind << "'" << std::endl;
+
+	FILE* output = fopen(argv[2], "w");
+	if(output == NULL)
+	{
+		std::cerr << "Failure in opening the output file." << std::endl;
+		return -1;
+	}
+
+	std::vector<unsigned char> values(VALUES_PER_READ * header.value_size);
+	uint64_t id = header.first_id;
+	uint64_t remaining = header.vertex_count;
+	while(remaining > 0)
+	{
+		size_t count = remaining < VALUES_PER_READ ? remaining : VALUES_PER_READ;
+		if(fread(values.data(), header.value_size, count, input) != count)
+		{
+			std::cerr << "The binary dump is truncated, " << remaining << " values are missing." << std::endl;
+			return -1;
+		}
+		for(size_t i = 0; i < count; i++)
+		{
+			fprintf(output, "%" PRIu64 ": ", id);
+			if(!write_value(output, header, &values[i * header.value_size]))
+			{
+				std::cerr << "Unsupported " << header.value_size << "-byte values of kind '" << (char)header.value_kind << "'." << std::endl;
+				return -1;
+			}
+			fprintf(output, "\n");
+			id++;
+		}
+		remaining -= count;
+	}
+
+	fclose(output);
+	fclose(input);
+	return 0;
+}
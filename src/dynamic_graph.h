@@ -0,0 +1,266 @@
+/**
+ * @file dynamic_graph.h
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This file implements the insertion of edges in a graph already
+ * loaded, enabled with IP_USE_DYNAMIC_GRAPH in the versions that push
+ * messages.
+ * @details The graph loaded stays in its CSR, the offsets and adjacency
+ * arrays read from the graph files. Edges inserted afterwards go to a delta
+ * beside it: each vertex has a small array of the out-neighbours it gained,
+ * which ip_broadcast() walks after its CSR range. Once the delta holds more
+ * than IP_DELTA_COMPACTION_PERCENTAGE percent of the edges of the CSR, both
+ * are merged, in parallel, into a new CSR and the delta is emptied.
+ * The sources of the edges inserted, which in undirected graphs are both
+ * endpoints, are recorded so that ip_run_incremental() only runs them in its
+ * first superstep, on top of the values left by the previous run. This is
+ * correct for monotone algorithms, such as connected components with HashMin
+ * or SSSP, where inserting an edge can only improve the value of a vertex.
+ * This file must be included by the version postambles.
+ **/
+
+#ifndef DYNAMIC_GRAPH_H_INCLUDED
+#define DYNAMIC_GRAPH_H_INCLUDED
+
+#include <stdatomic.h>
+#include <omp.h>
+
+/// The size of the delta, in percent of the edges in the CSR, beyond which it is merged into the CSR.
+#ifndef IP_DELTA_COMPACTION_PERCENTAGE
+	#define IP_DELTA_COMPACTION_PERCENTAGE 10
+#endif // ifndef IP_DELTA_COMPACTION_PERCENTAGE
+
+/// This structure holds the out-neighbours a vertex gained since the last compaction.
+struct ip_delta_t
+{
+	/// The identifiers of the out-neighbours inserted.
+	IP_VERTEX_ID_TYPE* neighbours;
+	/// The number of out-neighbours inserted.
+	IP_NEIGHBOUR_COUNT_TYPE count;
+	/// The number of out-neighbours that fit in neighbours.
+	IP_NEIGHBOUR_COUNT_TYPE capacity;
+	/// The number of out-neighbours of the batch being inserted, used to grow neighbours once per batch.
+	IP_NEIGHBOUR_COUNT_TYPE pending;
+};
+/// The delta of every vertex, indexed by vertex location.
+struct ip_delta_t* ip_all_deltas = NULL;
+/// The number of edges in the delta.
+size_t ip_delta_edges_count = 0;
+/// The offset of the out-neighbours of each vertex in ip_csr_neighbours, followed by the number of edges in the CSR.
+IP_NEIGHBOUR_COUNT_TYPE* ip_csr_offsets = NULL;
+/// The out-neighbours of all vertices in the CSR.
+IP_VERTEX_ID_TYPE* ip_csr_neighbours = NULL;
+/// Tells whether edges inserted are directed, otherwise each one is inserted in both directions.
+bool ip_dynamic_graph_directed = false;
+/// Tells, for each vertex location, whether the vertex is a source of an edge inserted since the last incremental run.
+atomic_bool* ip_all_touched = NULL;
+/// The identifiers of the vertices that are a source of an edge inserted since the last incremental run.
+IP_VERTEX_ID_TYPE* ip_touched_vertices = NULL;
+/// The number of identifiers in ip_touched_vertices.
+atomic_size_t ip_touched_count;
+/// Tells whether the run in progress is incremental.
+bool ip_incremental_run = false;
+
+/**
+ * @brief This function takes over the CSR of the graph loaded and allocates
+ * an empty delta.
+ * @param[in] offsets The offset of the out-neighbours of each vertex in \p
+ * out_neighbours, followed by the number of edges.
+ * @param[in] out_neighbours The out-neighbours of all vertices.
+ * @param[in] directed Tells whether the graph loaded is directed.
+ **/
+void ip_init_dynamic_graph(IP_NEIGHBOUR_COUNT_TYPE* offsets, IP_VERTEX_ID_TYPE* out_neighbours, bool directed)
+{
+	ip_csr_offsets = offsets;
+	ip_csr_neighbours = out_neighbours;
+	ip_dynamic_graph_directed = directed;
+	ip_all_deltas = (struct ip_delta_t*)ip_safe_tagged_malloc(sizeof(struct ip_delta_t) * ip_get_vertices_count(), IP_MEMORY_ADJACENCY);
+	ip_all_touched = (atomic_bool*)ip_safe_tagged_malloc(sizeof(atomic_bool) * ip_get_vertices_count(), IP_MEMORY_FRONTIERS);
+	ip_touched_vertices = (IP_VERTEX_ID_TYPE*)ip_safe_tagged_malloc(sizeof(IP_VERTEX_ID_TYPE) * ip_get_vertices_count(), IP_MEMORY_FRONTIERS);
+	atomic_init(&ip_touched_count, 0);
+	#pragma omp parallel for default(none) shared(ip_all_deltas, ip_all_touched)
+	for(size_t i = 0; i < ip_get_vertices_count(); i++)
+	{
+		ip_all_deltas[i].neighbours = NULL;
+		ip_all_deltas[i].count = 0;
+		ip_all_deltas[i].capacity = 0;
+		ip_all_deltas[i].pending = 0;
+		atomic_init(&ip_all_touched[i], false);
+	}
+	printf("\t- Dynamic graph, compacted once the delta exceeds %d%% of the edges.\n", IP_DELTA_COMPACTION_PERCENTAGE);
+}
+
+/**
+ * @brief This function sends the message \p message to the out-neighbours
+ * the vertex \p v gained since the last compaction.
+ * @param[in] v The vertex broadcasting.
+ * @param[in] message The message to broadcast.
+ **/
+void ip_broadcast_to_delta(struct ip_vertex_t* v, IP_MESSAGE_TYPE message)
+{
+	struct ip_delta_t* delta = &ip_all_deltas[v - ip_all_vertices];
+	for(IP_NEIGHBOUR_COUNT_TYPE i = 0; i < delta->count; i++)
+	{
+		ip_send_message(delta->neighbours[i], message);
+	}
+}
+
+/**
+ * @brief This function appends the edge from \p source to \p destination to
+ * the delta of \p source and records \p source for the next incremental run.
+ * @details The delta of \p source has already been grown for the batch, so
+ * threads only compete for a slot in it.
+ * @param[in] source The identifier of the source vertex.
+ * @param[in] destination The identifier of the destination vertex.
+ **/
+void ip_append_to_delta(IP_VERTEX_ID_TYPE source, IP_VERTEX_ID_TYPE destination)
+{
+	size_t location = ip_get_vertex_by_id(source) - ip_all_vertices;
+	struct ip_delta_t* delta = &ip_all_deltas[location];
+	IP_NEIGHBOUR_COUNT_TYPE slot;
+	#pragma omp atomic capture
+	slot = delta->count++;
+	delta->neighbours[slot] = destination;
+	if(!atomic_exchange_explicit(&ip_all_touched[location], true, memory_order_relaxed))
+	{
+		ip_touched_vertices[atomic_fetch_add_explicit(&ip_touched_count, 1, memory_order_relaxed)] = source;
+	}
+}
+
+void ip_insert_edges(const IP_VERTEX_ID_TYPE* sources, const IP_VERTEX_ID_TYPE* destinations, size_t count)
+{
+	double timer_insertion_start = omp_get_wtime();
+
+	// Count the edges each vertex gains so that its delta grows once for the whole batch.
+	#pragma omp parallel for default(none) shared(sources, destinations, count, ip_all_deltas, ip_all_vertices, ip_dynamic_graph_directed)
+	for(size_t i = 0; i < count; i++)
+	{
+		#pragma omp atomic
+		ip_all_deltas[ip_get_vertex_by_id(sources[i]) - ip_all_vertices].pending++;
+		if(!ip_dynamic_graph_directed)
+		{
+			#pragma omp atomic
+			ip_all_deltas[ip_get_vertex_by_id(destinations[i]) - ip_all_vertices].pending++;
+		}
+	}
+
+	#pragma omp parallel for default(none) shared(ip_all_deltas)
+	for(size_t i = 0; i < ip_get_vertices_count(); i++)
+	{
+		struct ip_delta_t* delta = &ip_all_deltas[i];
+		if(delta->count + delta->pending > delta->capacity)
+		{
+			delta->capacity = delta->count + delta->pending > delta->capacity * 2 ? delta->count + delta->pending : delta->capacity * 2;
+			delta->neighbours = (IP_VERTEX_ID_TYPE*)ip_safe_tagged_realloc(delta->neighbours, sizeof(IP_VERTEX_ID_TYPE) * delta->capacity, IP_MEMORY_ADJACENCY);
+		}
+		delta->pending = 0;
+	}
+
+	#pragma omp parallel for default(none) shared(sources, destinations, count, ip_dynamic_graph_directed)
+	for(size_t i = 0; i < count; i++)
+	{
+		ip_append_to_delta(sources[i], destinations[i]);
+		if(!ip_dynamic_graph_directed)
+		{
+			ip_append_to_delta(destinations[i], sources[i]);
+		}
+	}
+
+	size_t edges_inserted = ip_dynamic_graph_directed ? count : count * 2;
+	ip_delta_edges_count += edges_inserted;
+	ip_set_edges_count(ip_get_edges_count() + edges_inserted);
+	printf("InsertionTime:%f\n", omp_get_wtime() - timer_insertion_start);
+	printf("DeltaEdgeCount:%zu\n", ip_delta_edges_count);
+
+	if(ip_delta_edges_count * 100 > (size_t)ip_csr_offsets[ip_get_vertices_count()] * IP_DELTA_COMPACTION_PERCENTAGE)
+	{
+		ip_compact_graph();
+	}
+}
+
+void ip_compact_graph()
+{
+	double timer_compaction_start = omp_get_wtime();
+
+	// The degree of each vertex is stored one slot ahead, so that the prefix sum below turns degrees into offsets in place.
+	IP_NEIGHBOUR_COUNT_TYPE* offsets = (IP_NEIGHBOUR_COUNT_TYPE*)ip_safe_tagged_malloc(sizeof(IP_NEIGHBOUR_COUNT_TYPE) * (ip_get_vertices_count() + 1), IP_MEMORY_OFFSETS);
+	offsets[0] = 0;
+	#pragma omp parallel for default(none) shared(offsets, ip_csr_offsets, ip_all_deltas)
+	for(size_t i = 0; i < ip_get_vertices_count(); i++)
+	{
+		offsets[i + 1] = ip_csr_offsets[i + 1] - ip_csr_offsets[i] + ip_all_deltas[i].count;
+	}
+	for(size_t i = 0; i < ip_get_vertices_count(); i++)
+	{
+		offsets[i + 1] += offsets[i];
+	}
+
+	IP_VERTEX_ID_TYPE* neighbours = (IP_VERTEX_ID_TYPE*)ip_safe_tagged_malloc(sizeof(IP_VERTEX_ID_TYPE) * offsets[ip_get_vertices_count()], IP_MEMORY_ADJACENCY);
+	// Degrees are skewed, so vertices are handed out in small chunks.
+	#pragma omp parallel for default(none) shared(offsets, neighbours, ip_csr_offsets, ip_csr_neighbours, ip_all_deltas, ip_all_vertices) schedule(dynamic, 256)
+	for(size_t i = 0; i < ip_get_vertices_count(); i++)
+	{
+		IP_NEIGHBOUR_COUNT_TYPE csr_count = ip_csr_offsets[i + 1] - ip_csr_offsets[i];
+		memcpy(&neighbours[offsets[i]], &ip_csr_neighbours[ip_csr_offsets[i]], sizeof(IP_VERTEX_ID_TYPE) * csr_count);
+		memcpy(&neighbours[offsets[i] + csr_count], ip_all_deltas[i].neighbours, sizeof(IP_VERTEX_ID_TYPE) * ip_all_deltas[i].count);
+		#ifndef IP_USE_COMPACT_LAYOUT
+			ip_all_vertices[i].out_neighbours = &neighbours[offsets[i]];
+			ip_all_vertices[i].out_neighbour_count = offsets[i + 1] - offsets[i];
+		#endif // ifndef IP_USE_COMPACT_LAYOUT
+		ip_safe_free(ip_all_deltas[i].neighbours);
+		ip_all_deltas[i].neighbours = NULL;
+		ip_all_deltas[i].count = 0;
+		ip_all_deltas[i].capacity = 0;
+	}
+
+	ip_safe_free(ip_csr_offsets);
+	ip_safe_free(ip_csr_neighbours);
+	ip_csr_offsets = offsets;
+	ip_csr_neighbours = neighbours;
+	#ifdef IP_USE_COMPACT_LAYOUT
+		ip_all_out_offsets = offsets;
+		ip_all_out_neighbour_ids = neighbours;
+		if(!ip_dynamic_graph_directed)
+		{
+			ip_all_in_offsets = offsets;
+			ip_all_in_neighbour_ids = neighbours;
+		}
+	#endif // ifdef IP_USE_COMPACT_LAYOUT
+	ip_delta_edges_count = 0;
+	printf("CompactionTime:%f\n", omp_get_wtime() - timer_compaction_start);
+}
+
+bool ip_is_incremental_run()
+{
+	return ip_incremental_run;
+}
+
+int ip_run_incremental()
+{
+	ip_reset();
+	ip_set_initial_frontier(ip_touched_vertices, atomic_load(&ip_touched_count));
+	ip_incremental_run = true;
+	int result = ip_run();
+	ip_incremental_run = false;
+
+	#pragma omp parallel for default(none) shared(ip_all_touched, ip_touched_vertices, ip_all_vertices, ip_touched_count)
+	for(size_t i = 0; i < atomic_load(&ip_touched_count); i++)
+	{
+		atomic_store_explicit(&ip_all_touched[ip_get_vertex_by_id(ip_touched_vertices[i]) - ip_all_vertices], false, memory_order_relaxed);
+	}
+	atomic_store(&ip_touched_count, 0);
+	return result;
+}
+
+#endif // DYNAMIC_GRAPH_H_INCLUDED
@@ -0,0 +1,501 @@
+/**
+ * @file graph_image.h
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This file implements the graph images, enabled with
+ * IP_USE_GRAPH_IMAGE: files holding a graph as loaded in memory, which later
+ * runs map instead of loading the graph again.
+ * @details An image holds the out-neighbour offsets and identifiers of every
+ * vertex and, in directed graphs whose in-neighbours are needed, the
+ * in-neighbour offsets and identifiers built by the mirroring. Vertices refer
+ * to their neighbours by offset in these arrays, so the image does not depend
+ * on the address at which it is mapped: once mapped, the neighbour pointers
+ * and counts of the vertices are set from the offsets, in parallel, and the
+ * arrays are used in place. Pages are read from the file when first touched.
+ * An image is tagged with the topology the compiled version keeps, that is,
+ * the IP_NEEDS_* defines, the layout of vertices and the width of types, and
+ * with the iPregel version, and is rejected by a run compiled differently.
+ * This file must be included by the iPregel postamble.
+ **/
+
+#ifndef GRAPH_IMAGE_H_INCLUDED
+#define GRAPH_IMAGE_H_INCLUDED
+
+#include <errno.h>
+#include <fcntl.h> // open
+#include <inttypes.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h> // getenv
+#include <string.h>
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <unistd.h> // pread, pwrite, fsync
+
+/// The first 4 bytes of a graph image.
+#define IP_GRAPH_IMAGE_MAGIC "IPGI"
+/// The version of the layout described by struct ip_graph_image_header_t.
+#define IP_GRAPH_IMAGE_VERSION 1
+/// The alignment, in bytes, of every section of a graph image.
+#define IP_GRAPH_IMAGE_SECTION_ALIGNMENT 64
+/// The number of bytes a thread writes at once when writing a graph image.
+#ifndef IP_GRAPH_IMAGE_CHUNK_SIZE
+	#define IP_GRAPH_IMAGE_CHUNK_SIZE (64 << 20)
+#endif // ifndef IP_GRAPH_IMAGE_CHUNK_SIZE
+
+/**
+ * @name Layout flags
+ * The bits of ip_graph_image_header_t::layout, one per compile-time choice
+ * that changes what the image holds or how vertices refer to it.
+ * @{
+ **/
+#define IP_GRAPH_IMAGE_OUT_NEIGHBOUR_COUNT (1u << 0)
+#define IP_GRAPH_IMAGE_OUT_NEIGHBOUR_IDS (1u << 1)
+#define IP_GRAPH_IMAGE_OUT_NEIGHBOUR_WEIGHTS (1u << 2)
+#define IP_GRAPH_IMAGE_IN_NEIGHBOUR_COUNT (1u << 3)
+#define IP_GRAPH_IMAGE_IN_NEIGHBOUR_IDS (1u << 4)
+#define IP_GRAPH_IMAGE_IN_NEIGHBOUR_WEIGHTS (1u << 5)
+#define IP_GRAPH_IMAGE_COMPACT_LAYOUT (1u << 6)
+/** @} */
+
+/**
+ * @brief This structure is the header of a graph image.
+ * @details It is followed by the sections it gives the offsets of: the
+ * out-neighbour offsets of every vertex plus a last one equal to the number of
+ * edges, the out-neighbour identifiers and, if present, the same two arrays
+ * for in-neighbours. Numbers are in the byte order of the machine that wrote
+ * the file.
+ **/
+struct ip_graph_image_header_t
+{
+	/// IP_GRAPH_IMAGE_MAGIC, not null-terminated.
+	char magic[4];
+	/// IP_GRAPH_IMAGE_VERSION.
+	uint32_t version;
+	/// The version of iPregel that wrote the image, IP_ENGINE_NAME.
+	char engine[32];
+	/// The name of the graph the image was built from, without its directories.
+	char graph[64];
+	/// The layout flags of the version that wrote the image.
+	uint32_t layout;
+	/// 1 if the graph is directed, 0 otherwise.
+	uint32_t directed;
+	/// The size in bytes of vertex identifiers.
+	uint32_t id_size;
+	/// The size in bytes of neighbour counts and offsets.
+	uint32_t neighbour_count_size;
+	/// The identifier of the vertex stored first.
+	uint64_t id_offset;
+	/// The number of vertices of the graph.
+	uint64_t vertex_count;
+	/// The number of edges of the graph.
+	uint64_t edge_count;
+	/// The number of in-neighbour identifiers.
+	uint64_t in_edge_count;
+	/// The offset of the out-neighbour offsets.
+	uint64_t out_offsets_offset;
+	/// The offset of the out-neighbour identifiers.
+	uint64_t out_neighbours_offset;
+	/// The offset of the in-neighbour offsets, 0 if absent.
+	uint64_t in_offsets_offset;
+	/// The offset of the in-neighbour identifiers, 0 if absent.
+	uint64_t in_neighbours_offset;
+	/// The size in bytes of the whole image.
+	uint64_t total_size;
+};
+
+/// The path of the graph image, NULL when graph images are not used.
+char* ip_graph_image_path = NULL;
+/// The header of the graph image opened, valid once ip_open_graph_image() returned true.
+struct ip_graph_image_header_t ip_graph_image_header;
+/// The file descriptor of the graph image opened, until it is mapped.
+int ip_graph_image_file_descriptor = -1;
+/// The address at which the graph image is mapped, NULL if it is not.
+char* ip_graph_image_base = NULL;
+
+/**
+ * @brief This function gives the layout flags of the version compiled.
+ * @return The IP_GRAPH_IMAGE_* flags matching the defines.
+ **/
+uint32_t ip_get_graph_image_layout()
+{
+	uint32_t layout = 0;
+	#ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
+		layout |= IP_GRAPH_IMAGE_OUT_NEIGHBOUR_COUNT;
+	#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
+	#ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+		layout |= IP_GRAPH_IMAGE_OUT_NEIGHBOUR_IDS;
+	#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+	#ifdef IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS
+		layout |= IP_GRAPH_IMAGE_OUT_NEIGHBOUR_WEIGHTS;
+	#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS
+	#ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+		layout |= IP_GRAPH_IMAGE_IN_NEIGHBOUR_COUNT;
+	#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+	#ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+		layout |= IP_GRAPH_IMAGE_IN_NEIGHBOUR_IDS;
+	#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+	#ifdef IP_NEEDS_IN_NEIGHBOUR_WEIGHTS
+		layout |= IP_GRAPH_IMAGE_IN_NEIGHBOUR_WEIGHTS;
+	#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_WEIGHTS
+	#ifdef IP_USE_COMPACT_LAYOUT
+		layout |= IP_GRAPH_IMAGE_COMPACT_LAYOUT;
+	#endif // ifdef IP_USE_COMPACT_LAYOUT
+	return layout;
+}
+
+/**
+ * @brief This function gives the identifier of the vertex stored first.
+ * @return The identifier mapped to the location 0.
+ **/
+uint64_t ip_get_graph_image_id_offset()
+{
+	#if defined(IP_FORCE_DIRECT_MAPPING) || !defined(IP_ID_OFFSET)
+		return 0;
+	#else
+		return IP_ID_OFFSET;
+	#endif // if defined(IP_FORCE_DIRECT_MAPPING) || !defined(IP_ID_OFFSET)
+}
+
+/**
+ * @brief This function gives the name of the graph at \p file_path, without
+ * its directories, as ip_init() reports it.
+ * @param[in] file_path The path of the graph.
+ * @return The name of the graph, within \p file_path.
+ **/
+const char* ip_get_graph_name(const char* file_path)
+{
+	const char* graph_name = strrchr(file_path, '/');
+	return graph_name == NULL ? file_path : graph_name + 1;
+}
+
+/**
+ * @brief This function rounds \p offset up to the alignment of sections.
+ * @param[in] offset The offset to align.
+ * @return The aligned offset.
+ **/
+uint64_t ip_align_graph_image_offset(uint64_t offset)
+{
+	return (offset + IP_GRAPH_IMAGE_SECTION_ALIGNMENT - 1) / IP_GRAPH_IMAGE_SECTION_ALIGNMENT * IP_GRAPH_IMAGE_SECTION_ALIGNMENT;
+}
+
+/**
+ * @brief This function places the sections of a graph image after its header.
+ * @param[in,out] header The header, whose counts are set and whose offsets are
+ * filled in.
+ * @param[in] has_in_neighbours Whether the image holds in-neighbours.
+ **/
+void ip_lay_out_graph_image(struct ip_graph_image_header_t* header, bool has_in_neighbours)
+{
+	uint64_t offsets_size = (header->vertex_count + 1) * header->neighbour_count_size;
+	uint64_t offset = ip_align_graph_image_offset(sizeof(struct ip_graph_image_header_t));
+	header->out_offsets_offset = offset;
+	offset = ip_align_graph_image_offset(offset + offsets_size);
+	header->out_neighbours_offset = offset;
+	offset += header->edge_count * header->id_size;
+	header->in_offsets_offset = 0;
+	header->in_neighbours_offset = 0;
+	if(has_in_neighbours)
+	{
+		offset = ip_align_graph_image_offset(offset);
+		header->in_offsets_offset = offset;
+		offset = ip_align_graph_image_offset(offset + offsets_size);
+		header->in_neighbours_offset = offset;
+		offset += header->in_edge_count * header->id_size;
+	}
+	header->total_size = offset;
+}
+
+/**
+ * @brief This function writes the \p length bytes of \p buffer at the offset
+ * \p offset of the file \p file_descriptor, from all threads.
+ * @param[in] file_descriptor The file to write.
+ * @param[in] buffer The bytes to write.
+ * @param[in] length The number of bytes to write.
+ * @param[in] offset The position in the file at which write.
+ * @retval true The bytes have been written.
+ * @retval false The file could not be written.
+ **/
+bool ip_write_graph_image_section(int file_descriptor, const char* buffer, size_t length, off_t offset)
+{
+	size_t chunk_count = (length + IP_GRAPH_IMAGE_CHUNK_SIZE - 1) / IP_GRAPH_IMAGE_CHUNK_SIZE;
+	bool failed = false;
+	#pragma omp parallel for default(none) shared(file_descriptor, buffer, length, offset, chunk_count) reduction(||:failed) schedule(dynamic, 1)
+	for(size_t i = 0; i < chunk_count; i++)
+	{
+		size_t begin = i * IP_GRAPH_IMAGE_CHUNK_SIZE;
+		size_t end = begin + IP_GRAPH_IMAGE_CHUNK_SIZE < length ? begin + IP_GRAPH_IMAGE_CHUNK_SIZE : length;
+		while(begin < end && !failed)
+		{
+			ssize_t result = pwrite(file_descriptor, buffer + begin, end - begin, offset + begin);
+			if(result < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if(result <= 0)
+			{
+				failed = true;
+			}
+			else
+			{
+				begin += result;
+			}
+		}
+	}
+	return !failed;
+}
+
+bool ip_open_graph_image(const char* file_path, bool directed)
+{
+	const char* path = getenv("IP_GRAPH_IMAGE");
+	if(path == NULL || path[0] == '\0')
+	{
+		return false;
+	}
+	ip_safe_free(ip_graph_image_path);
+	ip_graph_image_path = (char*)ip_safe_malloc(strlen(path) + 1);
+	strcpy(ip_graph_image_path, path);
+
+	ip_graph_image_file_descriptor = open(ip_graph_image_path, O_RDONLY);
+	if(ip_graph_image_file_descriptor < 0)
+	{
+		if(errno != ENOENT)
+		{
+			perror("Failed to open the graph image");
+			exit(-1);
+		}
+		printf("\t- No graph image at \"%s\", it will be written once the graph is loaded.\n", ip_graph_image_path);
+		return false;
+	}
+
+	struct ip_graph_image_header_t* header = &ip_graph_image_header;
+	struct stat image_status;
+	if(pread(ip_graph_image_file_descriptor, header, sizeof(struct ip_graph_image_header_t), 0) != (ssize_t)sizeof(struct ip_graph_image_header_t)
+	|| memcmp(header->magic, IP_GRAPH_IMAGE_MAGIC, sizeof(header->magic)) != 0
+	|| header->version != IP_GRAPH_IMAGE_VERSION)
+	{
+		printf("\"%s\" is not a graph image of this version of iPregel. Abort...\n", ip_graph_image_path);
+		exit(-1);
+	}
+	header->engine[sizeof(header->engine) - 1] = '\0';
+	header->graph[sizeof(header->graph) - 1] = '\0';
+	char graph_name[sizeof(header->graph)];
+	strncpy(graph_name, ip_get_graph_name(file_path), sizeof(graph_name) - 1);
+	graph_name[sizeof(graph_name) - 1] = '\0';
+	if(strcmp(header->engine, IP_ENGINE_NAME) != 0
+	|| header->layout != ip_get_graph_image_layout()
+	|| header->id_size != sizeof(IP_VERTEX_ID_TYPE)
+	|| header->neighbour_count_size != sizeof(IP_NEIGHBOUR_COUNT_TYPE)
+	|| header->id_offset != ip_get_graph_image_id_offset())
+	{
+		printf("The graph image \"%s\" was written by version %s, with layout flags 0x%" PRIx32 ", %" PRIu32 "-byte identifiers, %" PRIu32 "-byte neighbour counts and a first identifier of %" PRIu64 ". It cannot be used by version %s, with layout flags 0x%" PRIx32 ", %zu-byte identifiers, %zu-byte neighbour counts and a first identifier of %" PRIu64 ". Abort...\n", ip_graph_image_path, header->engine, header->layout, header->id_size, header->neighbour_count_size, header->id_offset, IP_ENGINE_NAME, ip_get_graph_image_layout(), sizeof(IP_VERTEX_ID_TYPE), sizeof(IP_NEIGHBOUR_COUNT_TYPE), ip_get_graph_image_id_offset());
+		exit(-1);
+	}
+	if(strcmp(header->graph, graph_name) != 0 || header->directed != (directed ? 1 : 0))
+	{
+		printf("The graph image \"%s\" holds the %sdirected graph %s, not the %sdirected graph %s. Abort...\n", ip_graph_image_path, header->directed ? "" : "un", header->graph, directed ? "" : "un", graph_name);
+		exit(-1);
+	}
+	struct ip_graph_image_header_t expected_layout = *header;
+	ip_lay_out_graph_image(&expected_layout, header->in_offsets_offset != 0);
+	if(expected_layout.total_size != header->total_size
+	|| expected_layout.in_neighbours_offset != header->in_neighbours_offset
+	|| fstat(ip_graph_image_file_descriptor, &image_status) != 0
+	|| (uint64_t)image_status.st_size < header->total_size)
+	{
+		printf("The graph image \"%s\" is truncated or inconsistent. Abort...\n", ip_graph_image_path);
+		exit(-1);
+	}
+
+	printf("\t- Graph image found at: \"%s\".\n", ip_graph_image_path);
+	ip_set_vertices_count(header->vertex_count);
+	ip_set_edges_count(header->edge_count);
+	printf("\t\t- %zu vertices\n\t\t- %zu edges\n", ip_get_vertices_count(), ip_get_edges_count());
+	return true;
+}
+
+void ip_map_graph_image(IP_NEIGHBOUR_COUNT_TYPE** all_offsets, IP_VERTEX_ID_TYPE** all_out_neighbours, bool directed)
+{
+	(void)directed;
+	double timer_map_start = omp_get_wtime();
+	printf("\t- Mapping graph image from: \"%s\".\n", ip_graph_image_path);
+	// Private and writable, so that the arrays behave as if they had been allocated, although nothing writes them.
+	void* base = mmap(NULL, ip_graph_image_header.total_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, ip_graph_image_file_descriptor, 0);
+	if(base == MAP_FAILED)
+	{
+		perror("Failed to map the graph image");
+		exit(-1);
+	}
+	close(ip_graph_image_file_descriptor);
+	ip_graph_image_file_descriptor = -1;
+	ip_graph_image_base = (char*)base;
+
+	IP_NEIGHBOUR_COUNT_TYPE* out_offsets = (IP_NEIGHBOUR_COUNT_TYPE*)(ip_graph_image_base + ip_graph_image_header.out_offsets_offset);
+	IP_VERTEX_ID_TYPE* out_neighbours = (IP_VERTEX_ID_TYPE*)(ip_graph_image_base + ip_graph_image_header.out_neighbours_offset);
+	// In undirected graphs, the in-neighbours of a vertex are its out-neighbours.
+	IP_NEIGHBOUR_COUNT_TYPE* in_offsets = out_offsets;
+	IP_VERTEX_ID_TYPE* in_neighbours = out_neighbours;
+	if(ip_graph_image_header.in_offsets_offset != 0)
+	{
+		in_offsets = (IP_NEIGHBOUR_COUNT_TYPE*)(ip_graph_image_base + ip_graph_image_header.in_offsets_offset);
+		in_neighbours = (IP_VERTEX_ID_TYPE*)(ip_graph_image_base + ip_graph_image_header.in_neighbours_offset);
+	}
+	else if(directed)
+	{
+		in_offsets = NULL;
+		in_neighbours = NULL;
+	}
+	*all_offsets = out_offsets;
+	*all_out_neighbours = out_neighbours;
+
+	#ifdef IP_USE_COMPACT_LAYOUT
+		ip_all_out_offsets = out_offsets;
+		ip_all_out_neighbour_ids = out_neighbours;
+		ip_all_in_offsets = in_offsets;
+		ip_all_in_neighbour_ids = in_neighbours;
+	#else
+		// Turn the offsets back into the pointers and counts held by vertices.
+		#pragma omp parallel for default(none) shared(out_offsets, out_neighbours, in_offsets, in_neighbours)
+		for(size_t i = 0; i < ip_get_vertices_count(); i++)
+		{
+			struct ip_vertex_t* v = ip_get_vertex_by_location(i);
+			#ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+				v->out_neighbours = &out_neighbours[out_offsets[i]];
+			#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+			#ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
+				v->out_neighbour_count = out_offsets[i + 1] - out_offsets[i];
+			#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
+			#ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+				if(in_neighbours != NULL)
+				{
+					v->in_neighbours = &in_neighbours[in_offsets[i]];
+				}
+			#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+			#ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+				if(in_offsets != NULL)
+				{
+					v->in_neighbour_count = in_offsets[i + 1] - in_offsets[i];
+				}
+			#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+			(void)v;
+		}
+		(void)in_offsets;
+		(void)in_neighbours;
+	#endif // if(n)def IP_USE_COMPACT_LAYOUT
+	printf("GraphImage:%s\n", ip_graph_image_path);
+	printf("GraphImageMapTime:%f\n", omp_get_wtime() - timer_map_start);
+}
+
+void ip_write_graph_image(const char* file_path, const IP_NEIGHBOUR_COUNT_TYPE* all_offsets, const IP_VERTEX_ID_TYPE* all_out_neighbours, bool directed)
+{
+	if(ip_graph_image_path == NULL)
+	{
+		return;
+	}
+	double timer_write_start = omp_get_wtime();
+	printf("\t- Writing graph image to: \"%s\".\n", ip_graph_image_path);
+
+	struct ip_graph_image_header_t header;
+	memset(&header, 0, sizeof(struct ip_graph_image_header_t));
+	memcpy(header.magic, IP_GRAPH_IMAGE_MAGIC, sizeof(header.magic));
+	header.version = IP_GRAPH_IMAGE_VERSION;
+	strncpy(header.engine, IP_ENGINE_NAME, sizeof(header.engine) - 1);
+	strncpy(header.graph, ip_get_graph_name(file_path), sizeof(header.graph) - 1);
+	header.layout = ip_get_graph_image_layout();
+	header.directed = directed ? 1 : 0;
+	header.id_size = sizeof(IP_VERTEX_ID_TYPE);
+	header.neighbour_count_size = sizeof(IP_NEIGHBOUR_COUNT_TYPE);
+	header.id_offset = ip_get_graph_image_id_offset();
+	header.vertex_count = ip_get_vertices_count();
+	header.edge_count = ip_get_edges_count();
+
+	// Directed graphs keep their in-neighbours apart from their out-neighbours, they are written as offsets too.
+	const IP_NEIGHBOUR_COUNT_TYPE* in_offsets = NULL;
+	const IP_VERTEX_ID_TYPE* in_neighbours = NULL;
+	IP_NEIGHBOUR_COUNT_TYPE* gathered_in_offsets = NULL;
+	IP_VERTEX_ID_TYPE* gathered_in_neighbours = NULL;
+	#if defined(IP_USE_COMPACT_LAYOUT) && defined(IP_NEEDS_IN_NEIGHBOUR_COUNT)
+		if(directed)
+		{
+			in_offsets = ip_all_in_offsets;
+			in_neighbours = ip_all_in_neighbour_ids;
+		}
+	#elif defined(IP_NEEDS_IN_NEIGHBOUR_COUNT)
+		if(directed)
+		{
+			gathered_in_offsets = (IP_NEIGHBOUR_COUNT_TYPE*)ip_safe_tagged_malloc(sizeof(IP_NEIGHBOUR_COUNT_TYPE) * (ip_get_vertices_count() + 1), IP_MEMORY_IN_NEIGHBOURS);
+			gathered_in_offsets[0] = 0;
+			for(size_t i = 0; i < ip_get_vertices_count(); i++)
+			{
+				gathered_in_offsets[i + 1] = gathered_in_offsets[i] + ip_get_in_neighbour_count(ip_get_vertex_by_location(i));
+			}
+			in_offsets = gathered_in_offsets;
+			#ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+				gathered_in_neighbours = (IP_VERTEX_ID_TYPE*)ip_safe_tagged_malloc(sizeof(IP_VERTEX_ID_TYPE) * gathered_in_offsets[ip_get_vertices_count()], IP_MEMORY_IN_NEIGHBOURS);
+				#pragma omp parallel for default(none) shared(gathered_in_offsets, gathered_in_neighbours)
+				for(size_t i = 0; i < ip_get_vertices_count(); i++)
+				{
+					IP_NEIGHBOUR_COUNT_TYPE count = gathered_in_offsets[i + 1] - gathered_in_offsets[i];
+					if(count > 0)
+					{
+						memcpy(&gathered_in_neighbours[gathered_in_offsets[i]], ip_get_in_neighbours(ip_get_vertex_by_location(i)), sizeof(IP_VERTEX_ID_TYPE) * count);
+					}
+				}
+			#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+			in_neighbours = gathered_in_neighbours;
+		}
+	#endif // if defined(IP_USE_COMPACT_LAYOUT) && defined(IP_NEEDS_IN_NEIGHBOUR_COUNT)
+	header.in_edge_count = in_neighbours == NULL ? 0 : in_offsets[ip_get_vertices_count()];
+	ip_lay_out_graph_image(&header, in_offsets != NULL);
+
+	const char temporary_extension[] = ".tmp";
+	char temporary_path[strlen(ip_graph_image_path) + strlen(temporary_extension) + 1];
+	strcpy(temporary_path, ip_graph_image_path);
+	strcat(temporary_path, temporary_extension);
+	int file_descriptor = open(temporary_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	bool failed = file_descriptor < 0;
+	size_t offsets_size = (ip_get_vertices_count() + 1) * sizeof(IP_NEIGHBOUR_COUNT_TYPE);
+	failed = failed || !ip_write_graph_image_section(file_descriptor, (const char*)&header, sizeof(struct ip_graph_image_header_t), 0);
+	failed = failed || !ip_write_graph_image_section(file_descriptor, (const char*)all_offsets, offsets_size, header.out_offsets_offset);
+	failed = failed || !ip_write_graph_image_section(file_descriptor, (const char*)all_out_neighbours, ip_get_edges_count() * sizeof(IP_VERTEX_ID_TYPE), header.out_neighbours_offset);
+	if(in_offsets != NULL)
+	{
+		failed = failed || !ip_write_graph_image_section(file_descriptor, (const char*)in_offsets, offsets_size, header.in_offsets_offset);
+		failed = failed || (in_neighbours != NULL && !ip_write_graph_image_section(file_descriptor, (const char*)in_neighbours, header.in_edge_count * sizeof(IP_VERTEX_ID_TYPE), header.in_neighbours_offset));
+	}
+	failed = failed || ftruncate(file_descriptor, header.total_size) != 0;
+	failed = failed || fsync(file_descriptor) != 0;
+	if(file_descriptor >= 0)
+	{
+		close(file_descriptor);
+	}
+	failed = failed || rename(temporary_path, ip_graph_image_path) != 0;
+	ip_safe_free(gathered_in_offsets);
+	ip_safe_free(gathered_in_neighbours);
+
+	if(failed)
+	{
+		// The run goes on, the graph is loaded already; the next run loads it again.
+		perror("Failed to write the graph image");
+		unlink(temporary_path);
+		printf("GraphImageFailed:%s\n", ip_graph_image_path);
+	}
+	else
+	{
+		printf("GraphImageBytes:%" PRIu64 "\n", header.total_size);
+		printf("GraphImageWriteTime:%f\n", omp_get_wtime() - timer_write_start);
+	}
+}
+
+#endif // GRAPH_IMAGE_H_INCLUDED
@@ -0,0 +1,163 @@
+/**
+ * @file hardware_counters.h
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This file contains the hardware counters enabled with
+ * IP_ENABLE_HARDWARE_COUNTERS.
+ * @details Every thread opens, the first time it starts a superstep, a group
+ * of counters with perf_event_open, restricted to itself and to user space.
+ * The group is read with a single system call at every phase boundary and the
+ * differences are added to the phase that just ended, in the metrics slot of
+ * the thread. A counter that cannot be open, because the processor does not
+ * have it or because the kernel forbids it, is reported once and left out of
+ * the group; the others are still counted.
+ *
+ * This file must be included by metrics.h.
+ **/
+
+#ifndef HARDWARE_COUNTERS_H_INCLUDED
+#define HARDWARE_COUNTERS_H_INCLUDED
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h> // SYS_perf_event_open
+#include <unistd.h> // syscall, read
+
+/// The hardware counters read by every thread.
+enum ip_hardware_counter_t
+{
+	/// The processor cycles.
+	IP_HARDWARE_COUNTER_CYCLES,
+	/// The instructions retired.
+	IP_HARDWARE_COUNTER_INSTRUCTIONS,
+	/// The loads that missed the last level cache.
+	IP_HARDWARE_COUNTER_LLC_MISSES,
+	/// The loads that missed the data translation lookaside buffer.
+	IP_HARDWARE_COUNTER_DTLB_MISSES,
+	/// The loads served by the memory of another NUMA node.
+	IP_HARDWARE_COUNTER_REMOTE_ACCESSES,
+	/// The number of hardware counters.
+	IP_HARDWARE_COUNTER_COUNT
+};
+/// The names of the hardware counters, as written in the metrics file.
+const char* ip_hardware_counter_names[IP_HARDWARE_COUNTER_COUNT] = { "cycles", "instructions", "llc_misses", "dtlb_misses", "remote_accesses" };
+/// The perf_event_open type of each hardware counter.
+const uint32_t ip_hardware_counter_types[IP_HARDWARE_COUNTER_COUNT] =
+{
+	PERF_TYPE_HARDWARE,
+	PERF_TYPE_HARDWARE,
+	PERF_TYPE_HW_CACHE,
+	PERF_TYPE_HW_CACHE,
+	PERF_TYPE_HW_CACHE
+};
+/// The perf_event_open configuration of each hardware counter.
+const uint64_t ip_hardware_counter_configs[IP_HARDWARE_COUNTER_COUNT] =
+{
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+	PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+	PERF_COUNT_HW_CACHE_NODE | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+};
+
+/// Whether the calling thread has tried to open its counters already.
+bool ip_my_hardware_counters_open = false;
+/// The file descriptor of the counter leading the group of the calling thread, -1 if no counter could be open.
+int ip_my_hardware_counter_leader = -1;
+/// The counters open by the calling thread, one bit per counter, in the order of ip_hardware_counter_t.
+unsigned int ip_my_hardware_counter_mask = 0;
+#pragma omp threadprivate(ip_my_hardware_counters_open, ip_my_hardware_counter_leader, ip_my_hardware_counter_mask)
+/// Whether the failure to open each counter has been reported already.
+bool ip_hardware_counter_failure_reported[IP_HARDWARE_COUNTER_COUNT] = { false };
+
+/**
+ * @brief This function opens the counters of the calling thread, if it has
+ * not tried already.
+ * @details The first counter open leads the group, so that all counters are
+ * scheduled on the processor together and read at once. Counters keep
+ * counting until the program ends.
+ **/
+void ip_open_hardware_counters()
+{
+	if(ip_my_hardware_counters_open)
+	{
+		return;
+	}
+	ip_my_hardware_counters_open = true;
+
+	for(int i = 0; i < IP_HARDWARE_COUNTER_COUNT; i++)
+	{
+		struct perf_event_attr attributes;
+		memset(&attributes, 0, sizeof(struct perf_event_attr));
+		attributes.size = sizeof(struct perf_event_attr);
+		attributes.type = ip_hardware_counter_types[i];
+		attributes.config = ip_hardware_counter_configs[i];
+		attributes.read_format = PERF_FORMAT_GROUP;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		int fd = syscall(SYS_perf_event_open, &attributes, 0, -1, ip_my_hardware_counter_leader, 0);
+		if(fd == -1)
+		{
+			int error = errno;
+			#pragma omp critical(ip_hardware_counter_failure)
+			{
+				if(!ip_hardware_counter_failure_reported[i])
+				{
+					ip_hardware_counter_failure_reported[i] = true;
+					printf("HardwareCounterUnavailable:%s:%s\n", ip_hardware_counter_names[i], strerror(error));
+				}
+			}
+			continue;
+		}
+		if(ip_my_hardware_counter_leader == -1)
+		{
+			ip_my_hardware_counter_leader = fd;
+		}
+		ip_my_hardware_counter_mask |= 1u << i;
+	}
+}
+
+/**
+ * @brief This function reads the counters of the calling thread.
+ * @param[out] values The value of each counter; counters not open are left
+ * untouched.
+ **/
+void ip_read_hardware_counters(uint64_t values[IP_HARDWARE_COUNTER_COUNT])
+{
+	if(ip_my_hardware_counter_leader == -1)
+	{
+		return;
+	}
+
+	// The group is read as the number of counters followed by their values, in the order they were open.
+	uint64_t buffer[1 + IP_HARDWARE_COUNTER_COUNT];
+	if(read(ip_my_hardware_counter_leader, buffer, sizeof(buffer)) <= 0)
+	{
+		return;
+	}
+	uint64_t j = 0;
+	for(int i = 0; i < IP_HARDWARE_COUNTER_COUNT && j < buffer[0]; i++)
+	{
+		if(ip_my_hardware_counter_mask & (1u << i))
+		{
+			values[i] = buffer[1 + j];
+			j++;
+		}
+	}
+}
+
+#endif // HARDWARE_COUNTERS_H_INCLUDED
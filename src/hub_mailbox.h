@@ -0,0 +1,228 @@
+/**
+ * @file hub_mailbox.h
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This file implements the replicated mailboxes of hubs, enabled with
+ * IP_USE_HUB_MAILBOXES in the versions that push messages.
+ * @details On power-law graphs, a handful of vertices receive a large share
+ * of all messages, and every thread combining into their mailbox contends on
+ * the same cache line. Vertices whose in-degree exceeds
+ * IP_HUB_IN_DEGREE_THRESHOLD are detected when the graph is loaded; each
+ * thread then gets a private mailbox per hub, which it combines into without
+ * any atomic operation. Once the compute phase is over, the private mailboxes
+ * of each hub are reduced and the result is delivered to the actual mailbox of
+ * the hub through ip_deliver_hub_message, which each version defines.
+ * This file must be included by the version postambles.
+ **/
+
+#ifndef HUB_MAILBOX_H_INCLUDED
+#define HUB_MAILBOX_H_INCLUDED
+
+#include <stdint.h>
+#include <omp.h>
+
+/// The in-degree above which a vertex is considered a hub.
+#ifndef IP_HUB_IN_DEGREE_THRESHOLD
+	#define IP_HUB_IN_DEGREE_THRESHOLD 4096
+#endif // ifndef IP_HUB_IN_DEGREE_THRESHOLD
+
+/// This structure holds the mailbox of a hub private to a thread.
+struct ip_hub_mailbox_t
+{
+	/// Indicates whether the thread has sent a message to the hub during the current superstep.
+	bool has_message;
+	/// Contains the combination of the messages the thread has sent to the hub during the current superstep.
+	IP_MESSAGE_TYPE message;
+};
+/// The number of hubs.
+size_t ip_hub_count = 0;
+/// The identifiers of the hubs, in increasing order.
+IP_VERTEX_ID_TYPE* ip_all_hubs = NULL;
+/// One bit per vertex location, set for hubs, so that telling whether a destination is a hub rarely misses in cache.
+unsigned char* ip_all_hub_bits = NULL;
+/// The private mailboxes of hubs, one row of ip_hub_mailbox_row_length elements per thread.
+struct ip_hub_mailbox_t* ip_all_hub_mailboxes = NULL;
+/// The number of elements in a row of ip_all_hub_mailboxes, rounded up so that rows do not share cache lines.
+size_t ip_hub_mailbox_row_length = 0;
+
+/**
+ * @brief This function delivers to the hub \p id the combination of the
+ * messages sent to it during the current superstep.
+ * @details It is defined by each version that pushes messages. It is called
+ * once per hub and superstep at most, after the compute phase, when no other
+ * thread accesses the mailbox of the hub.
+ * @param[in] id The identifier of the hub.
+ * @param[in] message The combined message.
+ **/
+void ip_deliver_hub_message(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message);
+
+/**
+ * @brief This function detects the hubs of the graph and allocates their
+ * private mailboxes.
+ * @param[in] offsets The offset of the out-neighbours of each vertex in \p
+ * out_neighbours, followed by the number of edges.
+ * @param[in] out_neighbours The out-neighbours of all vertices.
+ * @param[in] directed Tells whether edges are directed, in which case
+ * in-degrees are counted from \p out_neighbours.
+ * @pre The number of threads is known.
+ **/
+void ip_detect_hubs(const IP_NEIGHBOUR_COUNT_TYPE* offsets, const IP_VERTEX_ID_TYPE* out_neighbours, bool directed)
+{
+	size_t hub_in_edge_count = 0;
+	IP_NEIGHBOUR_COUNT_TYPE* in_degrees = NULL;
+	if(directed)
+	{
+		in_degrees = (IP_NEIGHBOUR_COUNT_TYPE*)ip_safe_malloc(sizeof(IP_NEIGHBOUR_COUNT_TYPE) * ip_get_vertices_count());
+		memset(in_degrees, 0, sizeof(IP_NEIGHBOUR_COUNT_TYPE) * ip_get_vertices_count());
+		for(size_t i = 0; i < ip_get_edges_count(); i++)
+		{
+			in_degrees[ip_get_vertex_by_id(out_neighbours[i]) - ip_all_vertices]++;
+		}
+	}
+
+	ip_all_hub_bits = (unsigned char*)ip_safe_malloc((ip_get_vertices_count() + 7) / 8);
+	memset(ip_all_hub_bits, 0, (ip_get_vertices_count() + 7) / 8);
+	ip_hub_count = 0;
+	for(size_t i = 0; i < ip_get_vertices_count(); i++)
+	{
+		// In undirected graphs, the in-degree of a vertex is its out-degree.
+		IP_NEIGHBOUR_COUNT_TYPE in_degree = directed ? in_degrees[i] : offsets[i + 1] - offsets[i];
+		if(in_degree > IP_HUB_IN_DEGREE_THRESHOLD)
+		{
+			ip_all_hub_bits[i / 8] |= (unsigned char)(1 << (i % 8));
+			ip_all_hubs = (IP_VERTEX_ID_TYPE*)ip_safe_realloc(ip_all_hubs, sizeof(IP_VERTEX_ID_TYPE) * (ip_hub_count + 1));
+			ip_all_hubs[ip_hub_count] = ip_get_vertex_id(ip_get_vertex_by_location(i));
+			ip_hub_count++;
+			hub_in_edge_count += in_degree;
+		}
+	}
+	ip_safe_free(in_degrees);
+
+	size_t elements_per_cache_line = (IP_CACHE_LINE_SIZE + sizeof(struct ip_hub_mailbox_t) - 1) / sizeof(struct ip_hub_mailbox_t);
+	ip_hub_mailbox_row_length = ((ip_hub_count + elements_per_cache_line - 1) / elements_per_cache_line) * elements_per_cache_line;
+	if(ip_hub_count > 0)
+	{
+		size_t mailboxes_size = ((sizeof(struct ip_hub_mailbox_t) * ip_hub_mailbox_row_length * ip_thread_count + IP_CACHE_LINE_SIZE - 1) / IP_CACHE_LINE_SIZE) * IP_CACHE_LINE_SIZE;
+		ip_all_hub_mailboxes = (struct ip_hub_mailbox_t*)aligned_alloc(IP_CACHE_LINE_SIZE, mailboxes_size);
+		if(ip_all_hub_mailboxes == NULL)
+		{
+			printf("Failed to allocate the hub mailboxes.\n");
+			exit(-1);
+		}
+		memset(ip_all_hub_mailboxes, 0, mailboxes_size);
+	}
+	printf("HubInDegreeThreshold:%d\n", IP_HUB_IN_DEGREE_THRESHOLD);
+	printf("HubCount:%zu\n", ip_hub_count);
+	printf("HubInEdgeRatio:%f\n", ip_get_edges_count() > 0 ? ((double)hub_in_edge_count) / ip_get_edges_count() : 0.0);
+}
+
+/**
+ * @brief This function sends the message \p message to the vertex \p id in the
+ * private mailbox of the calling thread if that vertex is a hub.
+ * @param[in] id The identifier of the destination vertex.
+ * @param[in] message The message to send.
+ * @retval true The destination is a hub and the message has been stored.
+ * @retval false The destination is not a hub; the message must be sent
+ * normally.
+ **/
+bool ip_try_send_message_to_hub(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message)
+{
+	size_t location = ip_get_vertex_by_id(id) - ip_all_vertices;
+	if(!(ip_all_hub_bits[location / 8] & (1 << (location % 8))))
+	{
+		return false;
+	}
+
+	// Hubs are few, the binary search stays in cache. Identifiers grow with
+	// locations, so the hubs are sorted by identifier too.
+	size_t first = 0;
+	size_t last = ip_hub_count;
+	while(last - first > 1)
+	{
+		size_t middle = first + (last - first) / 2;
+		if(ip_all_hubs[middle] <= id)
+		{
+			first = middle;
+		}
+		else
+		{
+			last = middle;
+		}
+	}
+
+	struct ip_hub_mailbox_t* mailbox = &ip_all_hub_mailboxes[omp_get_thread_num() * ip_hub_mailbox_row_length + first];
+	if(mailbox->has_message)
+	{
+		ip_combine(&mailbox->message, message);
+	}
+	else
+	{
+		mailbox->message = message;
+		mailbox->has_message = true;
+	}
+	return true;
+}
+
+/**
+ * @brief This function reduces the private mailboxes of every hub and
+ * delivers the result to the hubs that received messages.
+ * @details It must be encountered by all the threads of the parallel region,
+ * after the compute phase. It ends with an implicit barrier, unless there is
+ * no hub.
+ **/
+void ip_reduce_hub_mailboxes()
+{
+	if(ip_hub_count == 0)
+	{
+		return;
+	}
+
+	#ifdef IP_ENABLE_METRICS
+		#pragma omp for schedule(static) nowait
+	#else
+		#pragma omp for schedule(static)
+	#endif // if(n)def IP_ENABLE_METRICS
+	for(size_t i = 0; i < ip_hub_count; i++)
+	{
+		struct ip_hub_mailbox_t combined = { .has_message = false };
+		for(int j = 0; j < ip_thread_count; j++)
+		{
+			struct ip_hub_mailbox_t* mailbox = &ip_all_hub_mailboxes[j * ip_hub_mailbox_row_length + i];
+			if(mailbox->has_message)
+			{
+				if(combined.has_message)
+				{
+					ip_combine(&combined.message, mailbox->message);
+				}
+				else
+				{
+					combined.message = mailbox->message;
+					combined.has_message = true;
+				}
+				mailbox->has_message = false;
+			}
+		}
+		if(combined.has_message)
+		{
+			ip_deliver_hub_message(ip_all_hubs[i], combined.message);
+		}
+	}
+	#ifdef IP_ENABLE_METRICS
+		ip_start_metrics_wait();
+		#pragma omp barrier
+		ip_stop_metrics_wait();
+	#endif // ifdef IP_ENABLE_METRICS
+}
+
+#endif // HUB_MAILBOX_H_INCLUDED
@@ -22,10 +22,12 @@
 	#include <xthi.h> // To report thread placement
 #endif
 #include <omp.h> // omp_set_schedule
+#include <stdlib.h> // aligned_alloc
 #include <string.h>
 #define STRINGIFY(x) STRINGIFY_LITERAL(x)
 #define STRINGIFY_LITERAL(x) # x
 
+#include "memory_accounting.h"
 #ifdef IP_USE_SPREAD
 	#ifdef IP_USE_SINGLE_BROADCAST
 		#include "combiner_spread_single_broadcast_postamble.h"
@@ -39,6 +41,13 @@
 		#include "combiner_postamble.h"
 	#endif // if(n)def IP_USE_SINGLE_BROADCAST
 #endif // if(n)def IP_USE_SPREAD
+#include "dump.h"
+#ifdef IP_USE_CHECKPOINTS
+	#include "checkpoint.h"
+#endif // ifdef IP_USE_CHECKPOINTS
+#ifdef IP_USE_GRAPH_IMAGE
+	#include "graph_image.h"
+#endif // ifdef IP_USE_GRAPH_IMAGE
 
 size_t ip_get_superstep()
 {
@@ -55,6 +64,38 @@ bool ip_is_first_superstep()
 	return ip_get_superstep() == 0;
 }
 
+size_t ip_get_active_vertices_count()
+{
+	return ip_active_vertices;
+}
+
+void ip_halt_computation()
+{
+	ip_computation_halted = true;
+}
+
+bool ip_is_computation_halted()
+{
+	return ip_computation_halted;
+}
+
+#ifdef IP_USE_SEQUENTIAL_FAST_PATH
+bool ip_is_frontier_small(const IP_VERTEX_ID_TYPE* ids, size_t count)
+{
+	if(count > IP_SEQUENTIAL_VERTEX_THRESHOLD)
+	{
+		return false;
+	}
+
+	size_t edge_count = 0;
+	for(size_t i = 0; i < count; i++)
+	{
+		edge_count += ip_get_out_neighbour_count(ip_get_vertex_by_id(ids[i]));
+	}
+	return edge_count <= IP_SEQUENTIAL_EDGE_THRESHOLD;
+}
+#endif // ifdef IP_USE_SEQUENTIAL_FAST_PATH
+
 void ip_set_vertices_count(size_t vertices_count)
 {
 	ip_vertices_count = vertices_count;
@@ -100,39 +141,316 @@ struct ip_vertex_t* ip_get_vertex_by_id(IP_VERTEX_ID_TYPE id)
 	#endif
 }
 
+IP_VERTEX_ID_TYPE ip_get_vertex_id(struct ip_vertex_t* v)
+{
+	#ifdef IP_USE_COMPACT_LAYOUT
+		// Identifiers are assigned in the order vertices are stored.
+		#if defined(IP_ID_OFFSET) && !defined(IP_FORCE_DIRECT_MAPPING)
+			return (IP_VERTEX_ID_TYPE)((v - ip_all_vertices) + IP_ID_OFFSET);
+		#else
+			return (IP_VERTEX_ID_TYPE)(v - ip_all_vertices);
+		#endif // if defined(IP_ID_OFFSET) && !defined(IP_FORCE_DIRECT_MAPPING)
+	#else
+		return v->id;
+	#endif // if(n)def IP_USE_COMPACT_LAYOUT
+}
+
+#ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
+IP_NEIGHBOUR_COUNT_TYPE ip_get_out_neighbour_count(struct ip_vertex_t* v)
+{
+	#ifdef IP_USE_COMPACT_LAYOUT
+		size_t location = v - ip_all_vertices;
+		return ip_all_out_offsets[location + 1] - ip_all_out_offsets[location];
+	#else
+		return v->out_neighbour_count;
+	#endif // if(n)def IP_USE_COMPACT_LAYOUT
+}
+#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
+
+#ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+IP_VERTEX_ID_TYPE* ip_get_out_neighbours(struct ip_vertex_t* v)
+{
+	#ifdef IP_USE_COMPACT_LAYOUT
+		return &ip_all_out_neighbour_ids[ip_all_out_offsets[v - ip_all_vertices]];
+	#else
+		return v->out_neighbours;
+	#endif // if(n)def IP_USE_COMPACT_LAYOUT
+}
+
+IP_VERTEX_ID_TYPE ip_get_out_neighbour_id(struct ip_vertex_t* v, IP_NEIGHBOUR_COUNT_TYPE i)
+{
+	return ip_get_out_neighbours(v)[i];
+}
+#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+
+#ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+IP_NEIGHBOUR_COUNT_TYPE ip_get_in_neighbour_count(struct ip_vertex_t* v)
+{
+	#ifdef IP_USE_COMPACT_LAYOUT
+		size_t location = v - ip_all_vertices;
+		return ip_all_in_offsets[location + 1] - ip_all_in_offsets[location];
+	#else
+		return v->in_neighbour_count;
+	#endif // if(n)def IP_USE_COMPACT_LAYOUT
+}
+#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+
+#ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+IP_VERTEX_ID_TYPE* ip_get_in_neighbours(struct ip_vertex_t* v)
+{
+	#ifdef IP_USE_COMPACT_LAYOUT
+		return &ip_all_in_neighbour_ids[ip_all_in_offsets[v - ip_all_vertices]];
+	#else
+		return v->in_neighbours;
+	#endif // if(n)def IP_USE_COMPACT_LAYOUT
+}
+
+IP_VERTEX_ID_TYPE ip_get_in_neighbour_id(struct ip_vertex_t* v, IP_NEIGHBOUR_COUNT_TYPE i)
+{
+	return ip_get_in_neighbours(v)[i];
+}
+#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+
+void ip_set_initial_value(IP_VALUE_TYPE value)
+{
+	#pragma omp parallel for default(none) shared(value)
+	for(size_t i = 0; i < ip_get_vertices_count(); i++)
+	{
+		ip_get_vertex_by_location(i)->value = value;
+	}
+}
+
+void ip_reset()
+{
+	ip_superstep = 0;
+	ip_computation_halted = false;
+	ip_active_vertices = ip_get_vertices_count();
+	ip_aggregator_registered_since_reset = 0;
+	for(size_t i = 0; i < ip_aggregator_count; i++)
+	{
+		struct ip_aggregator_t* aggregator = &ip_all_aggregators[i];
+		memcpy(aggregator->result, aggregator->identity, aggregator->size);
+		for(int j = 0; j < ip_thread_count; j++)
+		{
+			memcpy(&aggregator->thread_slots[j * aggregator->slot_size], aggregator->identity, aggregator->size);
+		}
+	}
+	ip_reset_specific();
+}
+
+void ip_start_run()
+{
+	#ifdef IP_USE_CHECKPOINTS
+		if(ip_start_checkpoints())
+		{
+			return;
+		}
+	#endif // ifdef IP_USE_CHECKPOINTS
+	#ifdef IP_NEEDS_MASTER_COMPUTE
+		ip_master_compute();
+	#endif // ifdef IP_NEEDS_MASTER_COMPUTE
+}
+
 void ip_dump(FILE* f)
 {
 	double timer_dump_start = omp_get_wtime();
-	double timer_dump_stop = 0;
 
-	for(IP_VERTEX_ID_TYPE i = 0; i < ip_get_vertices_count(); i++)
+	#ifdef IP_USE_BINARY_DUMP
+		size_t dump_size = ip_dump_binary(f);
+	#elif defined(IP_USE_PARALLEL_DUMP)
+		size_t dump_size = ip_dump_text_in_parallel(f, NULL);
+	#else // if !defined(IP_USE_BINARY_DUMP) && !defined(IP_USE_PARALLEL_DUMP)
+		long dump_start = ftell(f);
+		for(IP_VERTEX_ID_TYPE i = 0; i < ip_get_vertices_count(); i++)
+		{
+			ip_serialise_vertex(f, ip_get_vertex_by_location(i));
+		}
+		size_t dump_size = ip_get_bytes_written(f, dump_start);
+	#endif // if defined(IP_USE_BINARY_DUMP)
+
+	ip_report_dump(omp_get_wtime() - timer_dump_start, dump_size);
+}
+
+void ip_dump_if(FILE* f, ip_vertex_predicate_t predicate)
+{
+	double timer_dump_start = omp_get_wtime();
+
+	#ifdef IP_USE_PARALLEL_DUMP
+		size_t dump_size = ip_dump_text_in_parallel(f, predicate);
+	#else // ifndef IP_USE_PARALLEL_DUMP
+		// The predicate is evaluated in parallel, the serialisation into f cannot be.
+		bool* selected = (bool*)ip_safe_malloc(sizeof(bool) * ip_get_vertices_count());
+		#pragma omp parallel for default(none) shared(selected, predicate)
+		for(size_t i = 0; i < ip_get_vertices_count(); i++)
+		{
+			selected[i] = predicate(ip_get_vertex_by_location(i));
+		}
+		long dump_start = ftell(f);
+		for(size_t i = 0; i < ip_get_vertices_count(); i++)
+		{
+			if(selected[i])
+			{
+				ip_serialise_vertex(f, ip_get_vertex_by_location(i));
+			}
+		}
+		ip_safe_free(selected);
+		size_t dump_size = ip_get_bytes_written(f, dump_start);
+	#endif // if(n)def IP_USE_PARALLEL_DUMP
+
+	ip_report_dump(omp_get_wtime() - timer_dump_start, dump_size);
+}
+
+void ip_dump_top_k(FILE* f, size_t k, ip_value_comparator_t comes_before)
+{
+	double timer_dump_start = omp_get_wtime();
+
+	size_t selected_count = 0;
+	size_t* selected = ip_select_top_k(k, comes_before, &selected_count);
+	long dump_start = ftell(f);
+	for(size_t i = 0; i < selected_count; i++)
+	{
+		ip_write_vertex(f, ip_get_vertex_by_location(selected[i]));
+	}
+	ip_safe_free(selected);
+	size_t dump_size = ip_get_bytes_written(f, dump_start);
+
+	ip_report_dump(omp_get_wtime() - timer_dump_start, dump_size);
+}
+
+size_t ip_register_aggregator(size_t size, const void* identity, ip_aggregator_reduction_t reduction)
+{
+	if(ip_thread_count == 0)
+	{
+		printf("Aggregators must be registered after ip_init.\n");
+		exit(-1);
+	}
+	if(ip_aggregator_registered_since_reset == IP_MAX_AGGREGATOR_COUNT)
+	{
+		printf("Cannot register more than %d aggregators; increase IP_MAX_AGGREGATOR_COUNT.\n", IP_MAX_AGGREGATOR_COUNT);
+		exit(-1);
+	}
+
+	// After ip_reset(), the aggregators registered before are reused in order rather than allocated again.
+	size_t id = ip_aggregator_registered_since_reset;
+	struct ip_aggregator_t* aggregator = &ip_all_aggregators[id];
+	bool reused = id < ip_aggregator_count;
+	size_t slot_size = ((size + IP_CACHE_LINE_SIZE - 1) / IP_CACHE_LINE_SIZE) * IP_CACHE_LINE_SIZE;
+	if(!reused || aggregator->slot_size != slot_size)
 	{
-		ip_serialise_vertex(f, ip_get_vertex_by_location(i));
+		if(reused)
+		{
+			free(aggregator->thread_slots);
+		}
+		aggregator->slot_size = slot_size;
+		aggregator->thread_slots = aligned_alloc(IP_CACHE_LINE_SIZE, aggregator->slot_size * ip_thread_count);
+		if(aggregator->thread_slots == NULL)
+		{
+			printf("Failed to allocate the thread slots of an aggregator.\n");
+			exit(-1);
+		}
+	}
+	aggregator->size = size;
+	aggregator->reduction = reduction;
+	aggregator->identity = reused ? ip_safe_realloc(aggregator->identity, size) : ip_safe_malloc(size);
+	memcpy(aggregator->identity, identity, size);
+	aggregator->result = reused ? ip_safe_realloc(aggregator->result, size) : ip_safe_malloc(size);
+	memcpy(aggregator->result, identity, size);
+	for(int i = 0; i < ip_thread_count; i++)
+	{
+		memcpy(&aggregator->thread_slots[i * aggregator->slot_size], identity, size);
+	}
+
+	ip_aggregator_registered_since_reset++;
+	if(!reused)
+	{
+		ip_aggregator_count++;
 	}
+	return id;
+}
+
+void ip_aggregate(size_t id, const void* value)
+{
+	struct ip_aggregator_t* aggregator = &ip_all_aggregators[id];
+	aggregator->reduction(&aggregator->thread_slots[omp_get_thread_num() * aggregator->slot_size], value);
+}
 
-	timer_dump_stop = omp_get_wtime();
-	printf("DumpingTime:%f\n", timer_dump_stop - timer_dump_start);
+void ip_get_aggregated_value(size_t id, void* value)
+{
+	memcpy(value, ip_all_aggregators[id].result, ip_all_aggregators[id].size);
+}
+
+void ip_reduce_aggregators()
+{
+	for(size_t i = 0; i < ip_aggregator_count; i++)
+	{
+		struct ip_aggregator_t* aggregator = &ip_all_aggregators[i];
+		memcpy(aggregator->result, aggregator->identity, aggregator->size);
+		for(int j = 0; j < ip_thread_count; j++)
+		{
+			aggregator->reduction(aggregator->result, &aggregator->thread_slots[j * aggregator->slot_size]);
+			memcpy(&aggregator->thread_slots[j * aggregator->slot_size], aggregator->identity, aggregator->size);
+		}
+	}
+}
+
+void ip_set_aggregated_value(size_t id, const void* value)
+{
+	memcpy(ip_all_aggregators[id].result, value, ip_all_aggregators[id].size);
 }
 
 void* ip_safe_malloc(size_t size_to_malloc)
 {
-	void* ptr = malloc(size_to_malloc);
+	return ip_safe_tagged_malloc(size_to_malloc, IP_MEMORY_OTHER);
+}
+
+void* ip_safe_tagged_malloc(size_t size_to_malloc, enum ip_memory_tag_t tag)
+{
+	#ifdef IP_ENABLE_MEMORY_ACCOUNTING
+		void* ptr = malloc(sizeof(union ip_memory_header_t) + size_to_malloc);
+	#else
+		(void)tag;
+		void* ptr = malloc(size_to_malloc);
+	#endif // if(n)def IP_ENABLE_MEMORY_ACCOUNTING
 	if(ptr == NULL)
 	{
 		printf("Failed to allocate %zu bytes.\n", size_to_malloc);
 		exit(-1);
 	}
+	#ifdef IP_ENABLE_MEMORY_ACCOUNTING
+		ptr = ip_attach_memory_header(ptr, size_to_malloc, tag, 0);
+	#endif // ifdef IP_ENABLE_MEMORY_ACCOUNTING
 	return ptr;
 }
 
 void* ip_safe_realloc(void* ptr, size_t size_to_realloc)
 {
-	ptr = realloc(ptr, size_to_realloc);
+	return ip_safe_tagged_realloc(ptr, size_to_realloc, IP_MEMORY_OTHER);
+}
+
+void* ip_safe_tagged_realloc(void* ptr, size_t size_to_realloc, enum ip_memory_tag_t tag)
+{
+	#ifdef IP_ENABLE_MEMORY_ACCOUNTING
+		size_t old_size = 0;
+		if(ptr != NULL)
+		{
+			union ip_memory_header_t* header = ip_get_memory_header(ptr);
+			old_size = header->block.size;
+			tag = header->block.tag;
+			ptr = header;
+		}
+		ptr = realloc(ptr, sizeof(union ip_memory_header_t) + size_to_realloc);
+	#else
+		(void)tag;
+		ptr = realloc(ptr, size_to_realloc);
+	#endif // if(n)def IP_ENABLE_MEMORY_ACCOUNTING
 	if(ptr == NULL)
 	{
 		printf("Failed to reallocate to %zu bytes.\n", size_to_realloc);
 		exit(-1);
 	}
+	#ifdef IP_ENABLE_MEMORY_ACCOUNTING
+		ptr = ip_attach_memory_header(ptr, size_to_realloc, tag, old_size);
+	#endif // ifdef IP_ENABLE_MEMORY_ACCOUNTING
 	return ptr;
 }
 
@@ -140,6 +458,11 @@ void ip_safe_free(void* ptr)
 {
 	if(ptr != NULL)
 	{
+		#ifdef IP_ENABLE_MEMORY_ACCOUNTING
+			union ip_memory_header_t* header = ip_get_memory_header(ptr);
+			ip_account_memory(header->block.tag, 0, header->block.size);
+			ptr = header;
+		#endif // ifdef IP_ENABLE_MEMORY_ACCOUNTING
 		free(ptr);
 		ptr = NULL;
 	}
@@ -192,6 +515,31 @@ void tmp_extract_runtime_schedule(const char* schedule, int chunk_size)
 	}
 }
 
+void tmp_load_graph_config(const char* file_path)
+{
+	char config_file_extension[] = ".config";
+	char config_file_name[strlen(file_path) + strlen(config_file_extension) + 1];
+	memcpy(config_file_name, file_path, sizeof(char) * strlen(file_path));
+	memcpy(config_file_name + strlen(file_path), config_file_extension, sizeof(char) * strlen(config_file_extension));
+	config_file_name[strlen(file_path) + strlen(config_file_extension)] = '\0';
+	printf("\t- Loading configuration file from: \"%s\".\n", config_file_name);
+	FILE* config_file = ip_safe_fopen(config_file_name, "r");
+
+	size_t vertices_count = 0;
+	size_t edges_count = 0;
+
+	if(fscanf(config_file, "%zu %zu", &vertices_count, &edges_count) != 2)
+	{
+		printf("\t- Failure in reading the number of vertices and edges. Abort...\n");
+		fclose(config_file);
+		exit(-1);
+	}
+	fclose(config_file);
+	ip_set_vertices_count(vertices_count);
+	ip_set_edges_count(edges_count);
+	printf("\t\t- %zu vertices\n\t\t- %zu edges\n", ip_get_vertices_count(), ip_get_edges_count());
+}
+
 void ip_init(const char* file_path, int number_of_threads, const char* schedule, int chunk_size, bool directed, bool weighted)
 {
 	tmp_extract_runtime_schedule(schedule, chunk_size);
@@ -234,38 +582,24 @@ void ip_init(const char* file_path, int number_of_threads, const char* schedule,
 		}
 	}
 
+	// A dry run only needs the number of vertices and edges to predict the memory footprint
+	if(ip_dry_run)
+	{
+		tmp_load_graph_config(file_path);
+		ip_report_predicted_memory(directed);
+		exit(EXIT_SUCCESS);
+	}
+
 	// Load the graph
 	ip_load_graph(file_path, directed, weighted);
+	#ifdef IP_USE_CHECKPOINTS
+		ip_configure_checkpoints_from_environment();
+	#endif // ifdef IP_USE_CHECKPOINTS
 		
 	timer_init_stop = omp_get_wtime();
 	printf("InitialisationTime:%f\n", timer_init_stop - timer_init_start);
 }
 
-void tmp_load_graph_config(const char* file_path)
-{
-	char config_file_extension[] = ".config";
-	char config_file_name[strlen(file_path) + strlen(config_file_extension) + 1];
-	memcpy(config_file_name, file_path, sizeof(char) * strlen(file_path));
-	memcpy(config_file_name + strlen(file_path), config_file_extension, sizeof(char) * strlen(config_file_extension));
-	config_file_name[strlen(file_path) + strlen(config_file_extension)] = '\0';
-	printf("\t- Loading configuration file from: \"%s\".\n", config_file_name);
-	FILE* config_file = ip_safe_fopen(config_file_name, "r");
-
-	size_t vertices_count = 0;
-	size_t edges_count = 0;
-
-	if(fscanf(config_file, "%zu %zu", &vertices_count, &edges_count) != 2)
-	{
-		printf("\t- Failure in reading the number of vertices and edges. Abort...\n");
-		fclose(config_file);
-		exit(-1);
-	}
-	fclose(config_file);
-	ip_set_vertices_count(vertices_count);
-	ip_set_edges_count(edges_count);
-	printf("\t\t- %zu vertices\n\t\t- %zu edges\n", ip_get_vertices_count(), ip_get_edges_count());
-}
-
 void tmp_init_vertices()
 {
 	printf("\t- Initialising vertices\n");
@@ -358,66 +692,72 @@ void tmp_load_graph_edges(const char* file_path, IP_NEIGHBOUR_COUNT_TYPE* all_of
 		fseek(adjacency_file, edge_start * sizeof(IP_VERTEX_ID_TYPE), SEEK_SET);
 		ip_safe_fread(&all_out_neighbours[edge_start], sizeof(IP_VERTEX_ID_TYPE), edge_chunk, adjacency_file);
 		}
-		// If the framework needs the out-neighbours, we connect the out-neighbours that we just loaded to their source vertex.
-		IP_VERTEX_ID_TYPE j = vertex_start;
-		if(i_am_first_thread)
-		{
-			#ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
-				ip_get_vertex_by_location(vertex_start)->out_neighbours = &all_out_neighbours[0];
-			#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
-			#ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
-				if(!directed)
-				{
-					ip_get_vertex_by_location(vertex_start)->in_neighbours = &all_out_neighbours[0];
-				}
-			#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
-
-			vertex_start++;
-		}
-		for(j = vertex_start; j < vertex_end; j++)
-		{
-			#ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
-				ip_get_vertex_by_location(j)->out_neighbours = &all_out_neighbours[all_offsets[j]];
-			#endif // ifdef IP_UNUSED_OUT_NEIGHBOUR_IDS
-			#ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
-				if(!directed)
-				{
-					ip_get_vertex_by_location(j)->in_neighbours = &all_out_neighbours[all_offsets[j]];
-				}
-			#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
-			#ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
-				ip_get_vertex_by_location(j-1)->out_neighbour_count = all_offsets[j] - all_offsets[j-1];
-			#endif // IP_NEEDS_OUT_NEIGHBOUR_COUNT
-			#ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
-				if(!directed)
-				{
-					ip_get_vertex_by_location(j-1)->in_neighbour_count = all_offsets[j] - all_offsets[j-1];
-				}
-			#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
-		}
-		#ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
-			if(i_am_last_thread)
+		#ifndef IP_USE_COMPACT_LAYOUT
+			// If the framework needs the out-neighbours, we connect the out-neighbours that we just loaded to their source vertex.
+			IP_VERTEX_ID_TYPE j = vertex_start;
+			if(i_am_first_thread)
 			{
-				ip_get_vertex_by_location(j-1)->out_neighbour_count = ip_get_edges_count() - all_offsets[j-1];
+				#ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+					ip_get_vertex_by_location(vertex_start)->out_neighbours = &all_out_neighbours[0];
+				#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+				#ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+					if(!directed)
+					{
+						ip_get_vertex_by_location(vertex_start)->in_neighbours = &all_out_neighbours[0];
+					}
+				#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+
+				vertex_start++;
 			}
-			else
+			for(j = vertex_start; j < vertex_end; j++)
 			{
-				ip_get_vertex_by_location(j-1)->out_neighbour_count = all_offsets[j] - all_offsets[j-1];
+				#ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+					ip_get_vertex_by_location(j)->out_neighbours = &all_out_neighbours[all_offsets[j]];
+				#endif // ifdef IP_UNUSED_OUT_NEIGHBOUR_IDS
+				#ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+					if(!directed)
+					{
+						ip_get_vertex_by_location(j)->in_neighbours = &all_out_neighbours[all_offsets[j]];
+					}
+				#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_IDS
+				#ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
+					ip_get_vertex_by_location(j-1)->out_neighbour_count = all_offsets[j] - all_offsets[j-1];
+				#endif // IP_NEEDS_OUT_NEIGHBOUR_COUNT
+				#ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+					if(!directed)
+					{
+						ip_get_vertex_by_location(j-1)->in_neighbour_count = all_offsets[j] - all_offsets[j-1];
+					}
+				#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
 			}
-		#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
-		#ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
-			if(!directed)
-			{
+			#ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
 				if(i_am_last_thread)
 				{
-					ip_get_vertex_by_location(j-1)->in_neighbour_count = ip_get_edges_count() - all_offsets[j-1];
+					ip_get_vertex_by_location(j-1)->out_neighbour_count = ip_get_edges_count() - all_offsets[j-1];
 				}
 				else
 				{
-					ip_get_vertex_by_location(j-1)->in_neighbour_count = all_offsets[j] - all_offsets[j-1];
+					ip_get_vertex_by_location(j-1)->out_neighbour_count = all_offsets[j] - all_offsets[j-1];
 				}
-			}
-		#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+			#endif // ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
+			#ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+				if(!directed)
+				{
+					if(i_am_last_thread)
+					{
+						ip_get_vertex_by_location(j-1)->in_neighbour_count = ip_get_edges_count() - all_offsets[j-1];
+					}
+					else
+					{
+						ip_get_vertex_by_location(j-1)->in_neighbour_count = all_offsets[j] - all_offsets[j-1];
+					}
+				}
+			#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+		#else
+			// Neighbour ranges are read from the offsets directly, there is nothing to connect.
+			(void)i_am_first_thread;
+			(void)vertex_end;
+		#endif // if(n)def IP_USE_COMPACT_LAYOUT
 	}
 		// Now that edges are loaded in memory, the file is no longer needed.
 		fclose(adjacency_file);
@@ -433,7 +773,33 @@ void tmp_load_graph_edges(const char* file_path, IP_NEIGHBOUR_COUNT_TYPE* all_of
 	}
 	else
 	{
-		#if defined(IP_NEEDS_IN_NEIGHBOUR_IDS) || defined(IP_NEEDS_IN_NEIGHBOURS_COUNT)
+		#if defined(IP_USE_COMPACT_LAYOUT) && defined(IP_NEEDS_IN_NEIGHBOUR_COUNT)
+			// Build the in-neighbour CSR: count the in-degrees, turn them into offsets, then scatter the sources.
+			ip_all_in_offsets = (IP_NEIGHBOUR_COUNT_TYPE*)ip_safe_tagged_malloc(sizeof(IP_NEIGHBOUR_COUNT_TYPE) * (ip_get_vertices_count() + 1), IP_MEMORY_IN_NEIGHBOURS);
+			ip_all_in_neighbour_ids = (IP_VERTEX_ID_TYPE*)ip_safe_tagged_malloc(sizeof(IP_VERTEX_ID_TYPE) * ip_get_edges_count(), IP_MEMORY_IN_NEIGHBOURS);
+			memset(ip_all_in_offsets, 0, sizeof(IP_NEIGHBOUR_COUNT_TYPE) * (ip_get_vertices_count() + 1));
+			for(size_t j = 0; j < ip_get_edges_count(); j++)
+			{
+				ip_all_in_offsets[ip_get_vertex_by_id(all_out_neighbours[j]) - ip_all_vertices + 1]++;
+			}
+			for(size_t i = 0; i < ip_get_vertices_count(); i++)
+			{
+				ip_all_in_offsets[i + 1] += ip_all_in_offsets[i];
+			}
+			// Each vertex writes its next in-neighbour at its cursor, which ends up at the offset of the vertex after it; shifting them back restores the offsets.
+			for(size_t i = 0; i < ip_get_vertices_count(); i++)
+			{
+				IP_VERTEX_ID_TYPE source_id = ip_get_vertex_id(ip_get_vertex_by_location(i));
+				for(size_t j = all_offsets[i]; j < all_offsets[i + 1]; j++)
+				{
+					size_t dest_location = ip_get_vertex_by_id(all_out_neighbours[j]) - ip_all_vertices;
+					ip_all_in_neighbour_ids[ip_all_in_offsets[dest_location]++] = source_id;
+				}
+			}
+			memmove(&ip_all_in_offsets[1], &ip_all_in_offsets[0], sizeof(IP_NEIGHBOUR_COUNT_TYPE) * ip_get_vertices_count());
+			ip_all_in_offsets[0] = 0;
+			printf("\t\t- %zu in neighbours created.\n", (size_t)ip_all_in_offsets[ip_get_vertices_count()]);
+		#elif defined(IP_NEEDS_IN_NEIGHBOUR_IDS) || defined(IP_NEEDS_IN_NEIGHBOURS_COUNT)
 			size_t total_in_neighbours = 0;
 			struct ip_vertex_t* source_vertex;
 			struct ip_vertex_t* dest_vertex;
@@ -446,7 +812,7 @@ void tmp_load_graph_edges(const char* file_path, IP_NEIGHBOUR_COUNT_TYPE* all_of
 					dest_vertex->in_neighbour_count++;
 					if(dest_vertex->in_neighbour_count == 1)
 					{
-						dest_vertex->in_neighbours = (IP_VERTEX_ID_TYPE*)ip_safe_malloc(sizeof(IP_VERTEX_ID_TYPE));
+						dest_vertex->in_neighbours = (IP_VERTEX_ID_TYPE*)ip_safe_tagged_malloc(sizeof(IP_VERTEX_ID_TYPE), IP_MEMORY_IN_NEIGHBOURS);
 					}
 					else
 					{
@@ -463,7 +829,7 @@ void tmp_load_graph_edges(const char* file_path, IP_NEIGHBOUR_COUNT_TYPE* all_of
 				dest_vertex->in_neighbour_count++;
 				if(dest_vertex->in_neighbour_count == 1)
 				{
-					dest_vertex->in_neighbours = (IP_VERTEX_ID_TYPE*)ip_safe_malloc(sizeof(IP_VERTEX_ID_TYPE));
+					dest_vertex->in_neighbours = (IP_VERTEX_ID_TYPE*)ip_safe_tagged_malloc(sizeof(IP_VERTEX_ID_TYPE), IP_MEMORY_IN_NEIGHBOURS);
 				}
 				else
 				{
@@ -483,7 +849,7 @@ void tmp_load_graph_edges(const char* file_path, IP_NEIGHBOUR_COUNT_TYPE* all_of
 				printf("\t\t- Different from the number of out-neighbours. There is a bug in the in-neighbour mirroring.\n");
 				exit(-1);
 			}
-		#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_IDS) || defined(IP_NEEDS_OUT_NEIGHBOUR_COUNT)
+		#endif // if defined(IP_USE_COMPACT_LAYOUT) && defined(IP_NEEDS_IN_NEIGHBOUR_COUNT)
 	}
 }
 
@@ -496,15 +862,31 @@ void tmp_load_graph_free_memory(bool directed, IP_VERTEX_ID_TYPE* ip_all_out_nei
 	{
 		#ifndef IP_NEEDS_OUT_NEIGHBOUR_IDS
 			printf("\t\t- Out neighbour identifiers: %zu bytes freed.\n", ip_get_edges_count() * sizeof(IP_VERTEX_ID_TYPE));
-			free(ip_all_out_neighbours);
+			ip_safe_free(ip_all_out_neighbours);
+			#ifdef IP_USE_COMPACT_LAYOUT
+				ip_all_out_neighbour_ids = NULL;
+			#endif // ifdef IP_USE_COMPACT_LAYOUT
 		#endif // ifndef IP_NEEDS_OUT_NEIGHBOUR_IDS
 		#ifndef IP_NEEDS_OUT_NEIGHBOUR_COUNT
 			printf("\t\t- Offsets loaded: %zu bytes saved.\n", ip_get_vertices_count() * sizeof(IP_VERTEX_ID_TYPE)); 
-			free(ip_all_offsets);
+			ip_safe_free(ip_all_offsets);
+			#ifdef IP_USE_COMPACT_LAYOUT
+				ip_all_out_offsets = NULL;
+			#endif // ifdef IP_USE_COMPACT_LAYOUT
 		#endif // ifndef IP_NEEDS_OUT_NEIGHBOUR_COUNT
 	}
 }
 
+void tmp_report_bytes_per_vertex(bool directed)
+{
+	size_t bytes[IP_MEMORY_TAG_COUNT] = { 0 };
+	ip_predict_topology_memory(directed, bytes);
+	size_t topology_size = bytes[IP_MEMORY_OFFSETS] + bytes[IP_MEMORY_ADJACENCY] + bytes[IP_MEMORY_IN_NEIGHBOURS];
+	printf("VertexStructureSize:%zu\n", sizeof(struct ip_vertex_t));
+	printf("TopologyBytesPerVertex:%f\n", (double)topology_size / ip_get_vertices_count());
+	printf("BytesPerVertex:%f\n", sizeof(struct ip_vertex_t) + (double)topology_size / ip_get_vertices_count());
+}
+
 void ip_load_graph(const char* file_path, bool directed, bool weighted)
 {
 	double start = omp_get_wtime();
@@ -512,12 +894,21 @@ void ip_load_graph(const char* file_path, bool directed, bool weighted)
 
 	printf("[INFO] Starting graph loading.\n");
 
+	// A graph image, if any, gives the number of vertices and edges in place of the config file
+	bool from_graph_image = false;
+	#ifdef IP_USE_GRAPH_IMAGE
+		from_graph_image = ip_open_graph_image(file_path, directed);
+	#endif // ifdef IP_USE_GRAPH_IMAGE
+
 	// Open config file to get number of vertices and edges
-	tmp_load_graph_config(file_path);
+	if(!from_graph_image)
+	{
+		tmp_load_graph_config(file_path);
+	}
 	
 	// Allocate vertices
 	ip_active_vertices = ip_get_vertices_count();
-	ip_all_vertices = (struct ip_vertex_t*)ip_safe_malloc(sizeof(struct ip_vertex_t) * ip_get_vertices_count());
+	ip_all_vertices = (struct ip_vertex_t*)ip_safe_tagged_malloc(sizeof(struct ip_vertex_t) * ip_get_vertices_count(), IP_MEMORY_VERTICES);
 	
 	// The number of vertices and edges are known, the vertices are allocated so tell whatever version used to launch its own initialisation.
 	ip_init_specific();
@@ -525,21 +916,76 @@ void ip_load_graph(const char* file_path, bool directed, bool weighted)
 	// Initialise vertices
 	tmp_init_vertices();
 
-	// Open offset file and load them in parallel
-	IP_NEIGHBOUR_COUNT_TYPE* ip_all_offsets = (IP_NEIGHBOUR_COUNT_TYPE*)ip_safe_malloc(sizeof(IP_NEIGHBOUR_COUNT_TYPE) * ip_get_vertices_count()); 
-	tmp_load_graph_offsets(file_path, ip_all_offsets);
+	IP_NEIGHBOUR_COUNT_TYPE* ip_all_offsets = NULL;
+	IP_VERTEX_ID_TYPE* ip_all_out_neighbours = NULL;
+	#ifdef IP_USE_GRAPH_IMAGE
+		if(from_graph_image)
+		{
+			// The image holds the offsets and neighbours as they are at the end of the loading.
+			ip_map_graph_image(&ip_all_offsets, &ip_all_out_neighbours, directed);
+		}
+	#endif // ifdef IP_USE_GRAPH_IMAGE
+	if(!from_graph_image)
+	{
+		// Open offset file and load them in parallel
+		// The extra last offset, set to the number of edges, gives the end of the range of the last vertex.
+		ip_all_offsets = (IP_NEIGHBOUR_COUNT_TYPE*)ip_safe_tagged_malloc(sizeof(IP_NEIGHBOUR_COUNT_TYPE) * (ip_get_vertices_count() + 1), IP_MEMORY_OFFSETS);
+		tmp_load_graph_offsets(file_path, ip_all_offsets);
+		ip_all_offsets[ip_get_vertices_count()] = ip_get_edges_count();
+
+		// Open adjacency file and load out neighbours in parallel
+		ip_all_out_neighbours = (IP_VERTEX_ID_TYPE*)ip_safe_tagged_malloc(sizeof(IP_VERTEX_ID_TYPE) * ip_get_edges_count(), IP_MEMORY_ADJACENCY);
+		#ifdef IP_USE_COMPACT_LAYOUT
+			ip_all_out_offsets = ip_all_offsets;
+			ip_all_out_neighbour_ids = ip_all_out_neighbours;
+			if(!directed)
+			{
+				ip_all_in_offsets = ip_all_offsets;
+				ip_all_in_neighbour_ids = ip_all_out_neighbours;
+			}
+		#endif // ifdef IP_USE_COMPACT_LAYOUT
+		tmp_load_graph_edges(file_path, ip_all_offsets, ip_all_out_neighbours, directed);
+	}
+
+	#ifdef IP_USE_HUB_MAILBOXES
+		// Find the vertices with the highest in-degrees while the adjacency is still available.
+		ip_detect_hubs(ip_all_offsets, ip_all_out_neighbours, directed);
+	#endif // ifdef IP_USE_HUB_MAILBOXES
 
-	// Open adjacency file and load out neighbours in parallel
-	IP_VERTEX_ID_TYPE* ip_all_out_neighbours = (IP_VERTEX_ID_TYPE*)ip_safe_malloc(sizeof(IP_VERTEX_ID_TYPE) * ip_get_edges_count());
-	tmp_load_graph_edges(file_path, ip_all_offsets, ip_all_out_neighbours, directed);
+	#ifdef IP_USE_BLOCKS
+		ip_init_blocks(file_path);
+	#endif // ifdef IP_USE_BLOCKS
+
+	#ifdef IP_USE_DYNAMIC_GRAPH
+		// Edges inserted later go to a delta beside the CSR, which is merged into it once large enough.
+		ip_init_dynamic_graph(ip_all_offsets, ip_all_out_neighbours, directed);
+	#endif // ifdef IP_USE_DYNAMIC_GRAPH
 
 	//////////
 	// TODO //
 	//////////
 	// Check that offsets are read and manipulated as long because the number of edges may be far beyond the maximum value encodable on the type used to encode vertex identifiers.
 
-	// Free unused memory
-	tmp_load_graph_free_memory(directed, ip_all_out_neighbours, ip_all_offsets);
+	#ifdef IP_USE_GRAPH_IMAGE
+		// The image is written while the out-neighbours are still in memory, even if they are freed below.
+		if(!from_graph_image)
+		{
+			ip_write_graph_image(file_path, ip_all_offsets, ip_all_out_neighbours, directed);
+		}
+	#endif // ifdef IP_USE_GRAPH_IMAGE
+
+	// Free unused memory, unless it belongs to the graph image
+	if(!from_graph_image)
+	{
+		tmp_load_graph_free_memory(directed, ip_all_out_neighbours, ip_all_offsets);
+	}
+
+	// Report the memory used per vertex
+	tmp_report_bytes_per_vertex(directed);
+	#ifdef IP_ENABLE_MEMORY_ACCOUNTING
+		ip_report_memory("Loaded");
+		atexit(ip_report_teardown_memory);
+	#endif // ifdef IP_ENABLE_MEMORY_ACCOUNTING
 
 	double end = omp_get_wtime();
 	printf("LoadingTime:%f\n", end - start);
@@ -41,6 +41,118 @@
 #include <stdbool.h>
 #include <time.h>
 
+#if defined(IP_USE_WIDE_MESSAGE_CMPXCHG16B) && defined(IP_USE_WIDE_MESSAGE_LOCK)
+	#error "IP_USE_WIDE_MESSAGE_CMPXCHG16B and IP_USE_WIDE_MESSAGE_LOCK are mutually exclusive."
+#endif // if defined(IP_USE_WIDE_MESSAGE_CMPXCHG16B) && defined(IP_USE_WIDE_MESSAGE_LOCK)
+
+#ifdef IP_USE_LIGHT_SUPERSTEP
+	#if !defined(IP_USE_SPREAD) || defined(IP_USE_SINGLE_BROADCAST)
+		#error "IP_USE_LIGHT_SUPERSTEP is only available in the spread version, that is, with IP_USE_SPREAD and without IP_USE_SINGLE_BROADCAST."
+	#endif // if !defined(IP_USE_SPREAD) || defined(IP_USE_SINGLE_BROADCAST)
+	#ifdef IP_ENABLE_THREAD_PROFILING
+		#error "IP_USE_LIGHT_SUPERSTEP does not support IP_ENABLE_THREAD_PROFILING."
+	#endif // ifdef IP_ENABLE_THREAD_PROFILING
+#endif // ifdef IP_USE_LIGHT_SUPERSTEP
+
+#ifdef IP_USE_SEQUENTIAL_FAST_PATH
+	#ifndef IP_USE_SPREAD
+		#error "IP_USE_SEQUENTIAL_FAST_PATH is only available in the spread versions, that is, with IP_USE_SPREAD."
+	#endif // ifndef IP_USE_SPREAD
+	/// The number of vertices in the frontier up to which a superstep is run by a single thread.
+	#ifndef IP_SEQUENTIAL_VERTEX_THRESHOLD
+		#define IP_SEQUENTIAL_VERTEX_THRESHOLD 64
+	#endif // ifndef IP_SEQUENTIAL_VERTEX_THRESHOLD
+	/// The number of out-edges of the frontier up to which a superstep is run by a single thread.
+	#ifndef IP_SEQUENTIAL_EDGE_THRESHOLD
+		#define IP_SEQUENTIAL_EDGE_THRESHOLD 4096
+	#endif // ifndef IP_SEQUENTIAL_EDGE_THRESHOLD
+#endif // ifdef IP_USE_SEQUENTIAL_FAST_PATH
+
+#if defined(IP_USE_SOA_LAYOUT) && (defined(IP_USE_SPREAD) || defined(IP_USE_SINGLE_BROADCAST))
+	#error "IP_USE_SOA_LAYOUT is only available in the combiner version, that is, without IP_USE_SPREAD and IP_USE_SINGLE_BROADCAST."
+#endif // if defined(IP_USE_SOA_LAYOUT) && (defined(IP_USE_SPREAD) || defined(IP_USE_SINGLE_BROADCAST))
+
+#if defined(IP_USE_HUB_MAILBOXES) && defined(IP_USE_SINGLE_BROADCAST)
+	#error "IP_USE_HUB_MAILBOXES is only available in the versions that push messages, that is, without IP_USE_SINGLE_BROADCAST."
+#endif // if defined(IP_USE_HUB_MAILBOXES) && defined(IP_USE_SINGLE_BROADCAST)
+
+#if defined(IP_ENABLE_CONTENTION_COUNTERS) && defined(IP_USE_SINGLE_BROADCAST)
+	#error "IP_ENABLE_CONTENTION_COUNTERS counts the locks and compare-and-swaps of the versions that push messages, that is, without IP_USE_SINGLE_BROADCAST."
+#endif // if defined(IP_ENABLE_CONTENTION_COUNTERS) && defined(IP_USE_SINGLE_BROADCAST)
+
+#if defined(IP_USE_SEND_CACHE) && defined(IP_USE_SINGLE_BROADCAST)
+	#error "IP_USE_SEND_CACHE is only available in the versions that push messages, that is, without IP_USE_SINGLE_BROADCAST."
+#endif // if defined(IP_USE_SEND_CACHE) && defined(IP_USE_SINGLE_BROADCAST)
+
+#if defined(IP_USE_BLOCKS) && (defined(IP_USE_SPREAD) || defined(IP_USE_SINGLE_BROADCAST) || defined(IP_USE_SOA_LAYOUT))
+	#error "IP_USE_BLOCKS is only available in the combiner version, that is, without IP_USE_SPREAD and IP_USE_SINGLE_BROADCAST, and with vertices stored as structures, that is, without IP_USE_SOA_LAYOUT."
+#endif // if defined(IP_USE_BLOCKS) && (defined(IP_USE_SPREAD) || defined(IP_USE_SINGLE_BROADCAST) || defined(IP_USE_SOA_LAYOUT))
+
+#if defined(IP_USE_MMAP_DUMP) && !defined(IP_USE_BINARY_DUMP)
+	#error "IP_USE_MMAP_DUMP maps binary dumps in memory, so it needs IP_USE_BINARY_DUMP."
+#endif // if defined(IP_USE_MMAP_DUMP) && !defined(IP_USE_BINARY_DUMP)
+
+#if defined(IP_USE_CHECKPOINTS) && defined(IP_USE_DYNAMIC_GRAPH)
+	#error "IP_USE_CHECKPOINTS saves the state of vertices but not the edges inserted with IP_USE_DYNAMIC_GRAPH."
+#endif // if defined(IP_USE_CHECKPOINTS) && defined(IP_USE_DYNAMIC_GRAPH)
+
+#if defined(IP_USE_GRAPH_IMAGE) && defined(IP_USE_DYNAMIC_GRAPH)
+	#error "IP_USE_GRAPH_IMAGE maps the adjacency arrays from the image, which IP_USE_DYNAMIC_GRAPH would have to reallocate and free."
+#endif // if defined(IP_USE_GRAPH_IMAGE) && defined(IP_USE_DYNAMIC_GRAPH)
+
+#ifdef IP_ENABLE_HARDWARE_COUNTERS
+	#ifndef IP_ENABLE_METRICS
+		#error "IP_ENABLE_HARDWARE_COUNTERS attributes hardware counters to the phases recorded by IP_ENABLE_METRICS, so it needs IP_ENABLE_METRICS."
+	#endif // ifndef IP_ENABLE_METRICS
+	#ifndef __linux__
+		#error "IP_ENABLE_HARDWARE_COUNTERS reads hardware counters with perf_event_open, which is only available on Linux."
+	#endif // ifndef __linux__
+#endif // ifdef IP_ENABLE_HARDWARE_COUNTERS
+
+#ifdef IP_USE_DYNAMIC_GRAPH
+	#ifdef IP_USE_SINGLE_BROADCAST
+		#error "IP_USE_DYNAMIC_GRAPH is only available in the versions that push messages, that is, without IP_USE_SINGLE_BROADCAST."
+	#endif // ifdef IP_USE_SINGLE_BROADCAST
+	#if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) || defined(IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS) || defined(IP_NEEDS_IN_NEIGHBOUR_WEIGHTS)
+		#error "IP_USE_DYNAMIC_GRAPH only maintains out-neighbour identifiers, so it supports neither in-neighbours nor edge weights."
+	#endif // if defined(IP_NEEDS_IN_NEIGHBOUR_COUNT) || defined(IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS) || defined(IP_NEEDS_IN_NEIGHBOUR_WEIGHTS)
+#endif // ifdef IP_USE_DYNAMIC_GRAPH
+
+#ifdef IP_USE_COMPACT_LAYOUT
+	#if defined(IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS) || defined(IP_NEEDS_IN_NEIGHBOUR_WEIGHTS)
+		#error "IP_USE_COMPACT_LAYOUT does not support edge weights."
+	#endif // if defined(IP_NEEDS_OUT_NEIGHBOUR_WEIGHTS) || defined(IP_NEEDS_IN_NEIGHBOUR_WEIGHTS)
+#endif // ifdef IP_USE_COMPACT_LAYOUT
+
+/// The name of the iPregel version compiled, recorded in the files that only this version can read back.
+#ifdef IP_USE_SPREAD
+	#ifdef IP_USE_SINGLE_BROADCAST
+		#define IP_ENGINE_NAME "spread_single_broadcast"
+	#else // ifndef IP_USE_SINGLE_BROADCAST
+		#define IP_ENGINE_NAME "spread"
+	#endif // if(n)def IP_USE_SINGLE_BROADCAST
+#else // ifndef IP_USE_SPREAD
+	#ifdef IP_USE_SINGLE_BROADCAST
+		#define IP_ENGINE_NAME "single_broadcast"
+	#else // ifndef IP_USE_SINGLE_BROADCAST
+		#define IP_ENGINE_NAME "combiner"
+	#endif // if(n)def IP_USE_SINGLE_BROADCAST
+#endif // if(n)def IP_USE_SPREAD
+
+/**
+ * @brief The alignment of the mailboxes that are combined in place.
+ * @details Compare-and-swap based combinations need the mailbox aligned on its
+ * own size, otherwise the hardware instruction may straddle two cache lines
+ * (8-byte messages) or fault (16-byte messages). Lock-based combinations only
+ * need the natural alignment of the message type.
+ **/
+#ifdef IP_USE_WIDE_MESSAGE_LOCK
+	#define IP_MAILBOX_ALIGNMENT _Alignof(IP_MESSAGE_TYPE)
+#else // ifndef IP_USE_WIDE_MESSAGE_LOCK
+	// Sizes that are not a power of 2 are rejected later, with a clearer message than an invalid alignment.
+	#define IP_MAILBOX_ALIGNMENT ((sizeof(IP_MESSAGE_TYPE) & (sizeof(IP_MESSAGE_TYPE) - 1)) == 0 ? sizeof(IP_MESSAGE_TYPE) : _Alignof(IP_MESSAGE_TYPE))
+#endif // if(n)def IP_USE_WIDE_MESSAGE_LOCK
+
 /// This variable contains the current superstep number. It is 0-indexed.
 size_t ip_superstep = 0;
 /// This variable contains the total number of edges.
@@ -49,12 +161,32 @@ size_t ip_edges_count = 0;
 size_t ip_vertices_count = 0;
 /// This variable contains the number of active vertices at an instant t.
 size_t ip_active_vertices = 0;
+/// This variable tells whether the master compute requested the computation to stop.
+bool ip_computation_halted = false;
+#ifdef IP_USE_SEQUENTIAL_FAST_PATH
+	/// This variable tells whether the current superstep is run by a single thread, in which case messages are delivered without synchronisation.
+	bool ip_sequential_superstep = false;
+#endif // ifdef IP_USE_SEQUENTIAL_FAST_PATH
 /// Forward declaration of the vertex structure to not raise warnings
 struct ip_vertex_t;
 /// This variable contains all the vertices.
 struct ip_vertex_t* ip_all_vertices = NULL;
+#ifdef IP_USE_COMPACT_LAYOUT
+	/// The offset of the first out-neighbour of each vertex in ip_all_out_neighbour_ids, plus a last element equal to the number of edges.
+	IP_NEIGHBOUR_COUNT_TYPE* ip_all_out_offsets = NULL;
+	/// The identifiers of the out-neighbours of all vertices, vertex after vertex.
+	IP_VERTEX_ID_TYPE* ip_all_out_neighbour_ids = NULL;
+	/// The offset of the first in-neighbour of each vertex in ip_all_in_neighbour_ids, plus a last element equal to the number of edges.
+	IP_NEIGHBOUR_COUNT_TYPE* ip_all_in_offsets = NULL;
+	/// The identifiers of the in-neighbours of all vertices, vertex after vertex. In undirected graphs, it is the same array as ip_all_out_neighbour_ids.
+	IP_VERTEX_ID_TYPE* ip_all_in_neighbour_ids = NULL;
+#endif // ifdef IP_USE_COMPACT_LAYOUT
 /// The number of threads available for processing.
 int ip_thread_count;
+/// The size of a cache line, in bytes, used to pad per-thread data.
+#ifndef IP_CACHE_LINE_SIZE
+	#define IP_CACHE_LINE_SIZE 64
+#endif // ifndef IP_CACHE_LINE_SIZE
 
 // Functions to access global variables.
 /**
@@ -74,6 +206,40 @@ bool ip_is_first_superstep();
  * @brief This function increments the current superstep index.
  **/
 void ip_increment_superstep();
+/**
+ * @brief This function returns the number of vertices that will be active in
+ * the next superstep.
+ * @details It is meant to be called from ip_master_compute(), where it gives
+ * the number of vertices active for the superstep about to start.
+ * @return The number of active vertices.
+ **/
+size_t ip_get_active_vertices_count();
+/**
+ * @brief This function stops the computation at the end of the current
+ * superstep, regardless of the number of vertices still active.
+ * @details It is meant to be called from ip_master_compute(); when called
+ * there, the superstep about to start is not run.
+ **/
+void ip_halt_computation();
+/**
+ * @brief This function tells whether the computation has been halted with
+ * ip_halt_computation().
+ * @retval true The computation has been halted.
+ * @retval false The computation has not been halted.
+ **/
+bool ip_is_computation_halted();
+#ifdef IP_USE_SEQUENTIAL_FAST_PATH
+	/**
+	 * @brief This function tells whether a frontier is small enough for the
+	 * superstep processing it to be run by a single thread.
+	 * @param[in] ids The identifiers of the vertices in the frontier.
+	 * @param[in] count The number of vertices in the frontier.
+	 * @retval true The frontier has at most IP_SEQUENTIAL_VERTEX_THRESHOLD
+	 * vertices and IP_SEQUENTIAL_EDGE_THRESHOLD out-edges.
+	 * @retval false The frontier is too large.
+	 **/
+	bool ip_is_frontier_small(const IP_VERTEX_ID_TYPE* ids, size_t count);
+#endif // ifdef IP_USE_SEQUENTIAL_FAST_PATH
 /**
  * @brief This function sets the number of vertices to \p vertices_count.
  * @param[in] vertices_count The number of vertices.
@@ -108,6 +274,68 @@ struct ip_vertex_t* ip_get_vertex_by_location(size_t location);
  * @return The vertex identified by \p id.
  **/
 struct ip_vertex_t* ip_get_vertex_by_id(IP_VERTEX_ID_TYPE id);
+/**
+ * @brief This function returns the identifier of the vertex \p v.
+ * @details With IP_USE_COMPACT_LAYOUT, the identifier is not stored in the
+ * vertex but deduced from its location in the global vertex structure.
+ * @param[in] v The vertex to identify.
+ * @return The identifier of the vertex \p v.
+ **/
+IP_VERTEX_ID_TYPE ip_get_vertex_id(struct ip_vertex_t* v);
+/**
+ * @brief This function returns the number of out-neighbours of the vertex
+ * \p v.
+ * @param[in] v The vertex to inspect.
+ * @return The number of out-neighbours of the vertex \p v.
+ * @pre IP_NEEDS_OUT_NEIGHBOUR_COUNT is defined.
+ **/
+IP_NEIGHBOUR_COUNT_TYPE ip_get_out_neighbour_count(struct ip_vertex_t* v);
+/**
+ * @brief This function returns the identifiers of the out-neighbours of the
+ * vertex \p v.
+ * @param[in] v The vertex to inspect.
+ * @return A pointer to the ip_get_out_neighbour_count(\p v) identifiers of
+ * the out-neighbours of the vertex \p v.
+ * @pre IP_NEEDS_OUT_NEIGHBOUR_IDS is defined.
+ **/
+IP_VERTEX_ID_TYPE* ip_get_out_neighbours(struct ip_vertex_t* v);
+/**
+ * @brief This function returns the identifier of the \p i-th out-neighbour of
+ * the vertex \p v.
+ * @param[in] v The vertex to inspect.
+ * @param[in] i The index of the out-neighbour, in [0;
+ * ip_get_out_neighbour_count(\p v)).
+ * @return The identifier of the \p i-th out-neighbour of the vertex \p v.
+ * @pre IP_NEEDS_OUT_NEIGHBOUR_IDS is defined.
+ **/
+IP_VERTEX_ID_TYPE ip_get_out_neighbour_id(struct ip_vertex_t* v, IP_NEIGHBOUR_COUNT_TYPE i);
+/**
+ * @brief This function returns the number of in-neighbours of the vertex
+ * \p v.
+ * @param[in] v The vertex to inspect.
+ * @return The number of in-neighbours of the vertex \p v.
+ * @pre IP_NEEDS_IN_NEIGHBOUR_COUNT is defined.
+ **/
+IP_NEIGHBOUR_COUNT_TYPE ip_get_in_neighbour_count(struct ip_vertex_t* v);
+/**
+ * @brief This function returns the identifiers of the in-neighbours of the
+ * vertex \p v.
+ * @param[in] v The vertex to inspect.
+ * @return A pointer to the ip_get_in_neighbour_count(\p v) identifiers of
+ * the in-neighbours of the vertex \p v.
+ * @pre IP_NEEDS_IN_NEIGHBOUR_IDS is defined.
+ **/
+IP_VERTEX_ID_TYPE* ip_get_in_neighbours(struct ip_vertex_t* v);
+/**
+ * @brief This function returns the identifier of the \p i-th in-neighbour of
+ * the vertex \p v.
+ * @param[in] v The vertex to inspect.
+ * @param[in] i The index of the in-neighbour, in [0;
+ * ip_get_in_neighbour_count(\p v)).
+ * @return The identifier of the \p i-th in-neighbour of the vertex \p v.
+ * @pre IP_NEEDS_IN_NEIGHBOUR_IDS is defined.
+ **/
+IP_VERTEX_ID_TYPE ip_get_in_neighbour_id(struct ip_vertex_t* v, IP_NEIGHBOUR_COUNT_TYPE i);
 
 // Functions for the user
 /**
@@ -164,6 +392,33 @@ void ip_broadcast(struct ip_vertex_t* v, IP_MESSAGE_TYPE message);
  * @post The vertex \p v is inactive.
  **/
 void ip_vote_to_halt(struct ip_vertex_t* v);
+/**
+ * @brief This function sets the value of every vertex to \p value.
+ * @details It is meant for algorithms that seed an initial frontier with
+ * ip_set_initial_frontier(), in which the vertices outside the frontier do not
+ * run the first superstep and must therefore be initialised beforehand. The
+ * vertices are initialised in parallel.
+ * @param[in] value The value to give to every vertex.
+ * @pre ip_init() has been called.
+ **/
+void ip_set_initial_value(IP_VALUE_TYPE value);
+/**
+ * @brief This function restricts the first superstep to the \p count vertices
+ * whose identifiers are in \p ids.
+ * @details In the spread versions, only these vertices run the first
+ * superstep, in parallel, instead of every vertex of the graph. In the
+ * combiner version, they are the only active vertices, so the others are
+ * skipped until they receive a message. The single-broadcast version has no
+ * frontier and still runs every vertex, so the first superstep of
+ * ip_compute() must leave the vertices outside \p ids as
+ * ip_set_initial_value() did.
+ * @param[in] ids The identifiers of the vertices to run first. They are
+ * copied.
+ * @param[in] count The number of identifiers in \p ids.
+ * @pre ip_init() has been called and ip_run() has not.
+ * @pre \p ids contains no duplicate.
+ **/
+void ip_set_initial_frontier(const IP_VERTEX_ID_TYPE* ids, size_t count);
 /**
  * @brief This function is called by the underlying implementation version to initialise each vertex attribute according to the vertex structure used by that implementation version.
  * @param[in] first The ID of the first vertex to initialise.
@@ -179,9 +434,118 @@ extern void ip_init_vertex_range(IP_VERTEX_ID_TYPE first, IP_VERTEX_ID_TYPE last
  **/
 void ip_load_graph(const char* file_path, bool directed, bool weighted);
 
+/***************
+ * AGGREGATORS *
+ ***************/
+/// The maximum number of aggregators that can be registered.
+#ifndef IP_MAX_AGGREGATOR_COUNT
+	#define IP_MAX_AGGREGATOR_COUNT 16
+#endif // ifndef IP_MAX_AGGREGATOR_COUNT
+/**
+ * @brief The signature of the reduction operation of an aggregator.
+ * @details The reduction folds \p value into \p accumulator. It must be
+ * associative and commutative since the order in which threads contributions
+ * are reduced is not specified.
+ * @param[inout] accumulator The value to update.
+ * @param[in] value The value to fold in.
+ **/
+typedef void (*ip_aggregator_reduction_t)(void* accumulator, const void* value);
+/// This structure describes an aggregator.
+struct ip_aggregator_t
+{
+	/// The size of the aggregated type, in bytes.
+	size_t size;
+	/// The size of a per-thread slot, rounded up to a multiple of the cache line size.
+	size_t slot_size;
+	/// The reduction operation.
+	ip_aggregator_reduction_t reduction;
+	/// The identity element of the reduction.
+	void* identity;
+	/// The value aggregated during the previous superstep.
+	void* result;
+	/// The per-thread partial reductions, one cache-line padded slot per thread.
+	char* thread_slots;
+};
+/// This variable contains all the aggregators registered.
+struct ip_aggregator_t ip_all_aggregators[IP_MAX_AGGREGATOR_COUNT];
+/// This variable contains the number of aggregators registered.
+size_t ip_aggregator_count = 0;
+/// This variable contains the number of aggregators registered since the last ip_reset(), or ever if it was never called.
+size_t ip_aggregator_registered_since_reset = 0;
+/**
+ * @brief This function registers a new aggregator.
+ * @details Vertices contribute to an aggregator with ip_aggregate() during a
+ * superstep, and all contributions are reduced at the end of that superstep.
+ * The result is readable with ip_get_aggregated_value() during the next
+ * superstep. After ip_reset(), aggregators registered again reuse, in
+ * order, the identifiers and storage of those registered before, so that a
+ * program registering its aggregators before every run does not leak them.
+ * @param[in] size The size of the aggregated type, in bytes.
+ * @param[in] identity A pointer on the identity element of the reduction.
+ * @param[in] reduction The reduction operation.
+ * @return The identifier of the aggregator registered.
+ * @pre ip_init() has been called, so that the number of threads is known.
+ * @pre Less than IP_MAX_AGGREGATOR_COUNT aggregators have been registered
+ * since the last call to ip_reset(), if any.
+ **/
+size_t ip_register_aggregator(size_t size, const void* identity, ip_aggregator_reduction_t reduction);
+/**
+ * @brief This function contributes \p value to the aggregator \p id.
+ * @details It only touches the slot of the calling thread, there is no
+ * synchronisation involved.
+ * @param[in] id The identifier of the aggregator.
+ * @param[in] value A pointer on the value to contribute.
+ **/
+void ip_aggregate(size_t id, const void* value);
+/**
+ * @brief This function copies the value aggregated by \p id during the
+ * previous superstep into \p value.
+ * @details During the first superstep, the identity element is returned.
+ * @param[in] id The identifier of the aggregator.
+ * @param[out] value A pointer on the memory area where to store the value.
+ **/
+void ip_get_aggregated_value(size_t id, void* value);
+/**
+ * @brief This function reduces the per-thread contributions of all
+ * aggregators and resets them to the identity element.
+ * @details It is called by the underlying iPregel version at the end of every
+ * superstep, from a single thread.
+ **/
+void ip_reduce_aggregators();
+/**
+ * @brief This function overwrites the value of the aggregator \p id that
+ * vertices will read during the next superstep.
+ * @details It is meant to be called from ip_master_compute() to broadcast a
+ * global value to all vertices. The per-thread contributions of the current
+ * superstep are not affected.
+ * @param[in] id The identifier of the aggregator.
+ * @param[in] value A pointer on the value to broadcast.
+ **/
+void ip_set_aggregated_value(size_t id, const void* value);
+
 /******************
  * SAFE FUNCTIONS *
  ******************/
+/// The kinds of memory told apart in the footprint, see ip_safe_tagged_malloc().
+enum ip_memory_tag_t
+{
+	/// Anything not tagged otherwise.
+	IP_MEMORY_OTHER,
+	/// The vertex structures and the vertex status kept beside them.
+	IP_MEMORY_VERTICES,
+	/// The offsets of the out-neighbours of every vertex.
+	IP_MEMORY_OFFSETS,
+	/// The identifiers of the out-neighbours of every vertex.
+	IP_MEMORY_ADJACENCY,
+	/// The in-neighbours of every vertex, along with their offsets.
+	IP_MEMORY_IN_NEIGHBOURS,
+	/// The messages received or broadcast, and the flags telling whether there is one.
+	IP_MEMORY_MAILBOXES,
+	/// The lists of the vertices to run at the next superstep.
+	IP_MEMORY_FRONTIERS,
+	/// The number of tags.
+	IP_MEMORY_TAG_COUNT
+};
 /**
  * @brief This function executes a malloc and checks the memory area was
  * successfully allocated, otherwise exits the program.
@@ -192,22 +556,48 @@ void ip_load_graph(const char* file_path, bool directed, bool weighted);
  * bytes.
  **/
 void* ip_safe_malloc(size_t size_to_malloc);
+/**
+ * @brief This function executes a malloc like ip_safe_malloc(), and tells
+ * what the memory area holds.
+ * @details With IP_ENABLE_MEMORY_ACCOUNTING, the memory area is counted under
+ * \p tag until it is freed with ip_safe_free(), reallocations included;
+ * ip_safe_malloc() counts it under IP_MEMORY_OTHER. Otherwise, \p tag is
+ * ignored.
+ * @param[in] size_to_malloc The size to allocate, in bytes.
+ * @param[in] tag What the memory area holds.
+ * @return A pointer on the memory area allocated.
+ **/
+void* ip_safe_tagged_malloc(size_t size_to_malloc, enum ip_memory_tag_t tag);
 /**
  * @brief This function executes a realloc and checks that it succeeded, 
  * otherwise exits the program.
  * @param[in] ptr A pointer on the memory area to reallocate.
  * @param[in] size_to_realloc The size of reallocate.
  * @return A pointer on the memory area reallocated.
- * @pre \p ptr points to a memory area already allocated by a malloc or realloc.
+ * @pre \p ptr is NULL or points to a memory area allocated by one of the safe
+ * functions.
  * @post If the function call completes, the pointer returns is guaranteed to
  * point to a memory area successfully reallocated and containing \p
  * size_of_realloc bytes.
  **/
 void* ip_safe_realloc(void* ptr, size_t size_to_realloc);
+/**
+ * @brief This function executes a realloc like ip_safe_realloc(), and tells
+ * what the memory area holds if \p ptr is NULL.
+ * @details A memory area already allocated keeps the tag it was allocated
+ * with.
+ * @param[in] ptr A pointer on the memory area to reallocate, or NULL.
+ * @param[in] size_to_realloc The size of reallocate.
+ * @param[in] tag What the memory area holds.
+ * @return A pointer on the memory area reallocated.
+ **/
+void* ip_safe_tagged_realloc(void* ptr, size_t size_to_realloc, enum ip_memory_tag_t tag);
 /**
  * @brief This function frees the memory allocated by a pointer.
  * @details In case the pointer is NULL, nothing is done. It avoids double-free
  * problems. It also sets the pointer to NULL once the free is finished.
+ * Memory allocated by the safe functions must be freed by this function, since
+ * IP_ENABLE_MEMORY_ACCOUNTING places a header before it.
  * @pre Either \p ptr is a valid non-NULL pointer, either it is a NULL pointer.
  * @post ptr == NULL
  **/
@@ -260,19 +650,55 @@ void ip_safe_fwrite(void * ptr, size_t size, size_t count, FILE * stream);
  * @post \p message_a contains the combined value.
  **/
 extern void ip_combine(IP_MESSAGE_TYPE* message_a, IP_MESSAGE_TYPE message_b);
-/**
- * @brief This function writes in a file the serialised representation of a
- * vertex.
- * @details IMPORTANT: This function being defined by the user, the post
- * conditions that can be given at this stage are limited.
- * @param[out] f The file into which write.
- * @param[in] v The vertex to serialise.
- * @pre f points to a file already successfully open.
- * @pre f points to a file open in read mode or read-write mode.
- * @pre \p v points to an allocated memory area containing a vertex.
- * @post f is still open.
- **/
-extern void ip_serialise_vertex(FILE* f, struct ip_vertex_t* v);
+#ifdef IP_USE_MESSAGE_EQUALITY
+	/**
+	 * @brief This function tells whether two messages are equal.
+	 * @details It is used to skip the atomic update of a mailbox when the
+	 * combination left it unchanged. Without IP_USE_MESSAGE_EQUALITY, messages
+	 * are compared bitwise, which is correct for any type but may see two
+	 * equal structures as different if their padding bytes differ.
+	 * @param[in] message_a The first message.
+	 * @param[in] message_b The second message.
+	 * @retval true The messages are equal.
+	 * @retval false The messages are different.
+	 **/
+	extern bool ip_message_equals(IP_MESSAGE_TYPE message_a, IP_MESSAGE_TYPE message_b);
+#endif // ifdef IP_USE_MESSAGE_EQUALITY
+#ifdef IP_USE_PARALLEL_DUMP
+	/**
+	 * @brief This function writes in a buffer the serialised representation
+	 * of a vertex.
+	 * @details This function must be defined by the user when
+	 * IP_USE_PARALLEL_DUMP is defined, in place of ip_serialise_vertex(). It
+	 * is called by several threads at once, on different vertices, and
+	 * follows the semantics of snprintf: at most \p size characters,
+	 * terminating null character included, are written, and the length of the
+	 * whole representation is returned. If that length is not below
+	 * \p size, the representation is discarded and this function is called
+	 * again on the same vertex with a larger buffer.
+	 * @param[out] buffer The buffer into which write.
+	 * @param[in] size The number of characters available in \p buffer.
+	 * @param[in] v The vertex to serialise.
+	 * @return The number of characters of the representation, terminating
+	 * null character excluded.
+	 * @pre \p v points to an allocated memory area containing a vertex.
+	 **/
+	extern size_t ip_serialise_vertex_to_buffer(char* buffer, size_t size, struct ip_vertex_t* v);
+#else // ifndef IP_USE_PARALLEL_DUMP
+	/**
+	 * @brief This function writes in a file the serialised representation of a
+	 * vertex.
+	 * @details IMPORTANT: This function being defined by the user, the post
+	 * conditions that can be given at this stage are limited.
+	 * @param[out] f The file into which write.
+	 * @param[in] v The vertex to serialise.
+	 * @pre f points to a file already successfully open.
+	 * @pre f points to a file open in read mode or read-write mode.
+	 * @pre \p v points to an allocated memory area containing a vertex.
+	 * @post f is still open.
+	 **/
+	extern void ip_serialise_vertex(FILE* f, struct ip_vertex_t* v);
+#endif // if(n)def IP_USE_PARALLEL_DUMP
 /**
  * @brief This function performs the actual superstep calculations of a vertex.
  * @details This function must be defined by the user.
@@ -281,6 +707,22 @@ extern void ip_serialise_vertex(FILE* f, struct ip_vertex_t* v);
  * @post The vertex \p v has finished his work for the current superstep.
  **/
 extern void ip_compute(struct ip_vertex_t* v);
+#ifdef IP_NEEDS_MASTER_COMPUTE
+	/**
+	 * @brief This function performs the calculations that are global to the
+	 * graph rather than specific to a vertex.
+	 * @details This function must be defined by the user when
+	 * IP_NEEDS_MASTER_COMPUTE is defined. It is called by a single thread
+	 * before the first superstep and then between every two supersteps, after
+	 * aggregators have been reduced. At that point, ip_get_superstep() returns
+	 * the superstep about to start, ip_get_active_vertices_count() the number
+	 * of vertices active in it and ip_get_aggregated_value() the values
+	 * aggregated during the superstep that just finished. It may stop the
+	 * computation with ip_halt_computation() and broadcast values to vertices
+	 * with ip_set_aggregated_value().
+	 **/
+	extern void ip_master_compute();
+#endif // ifdef IP_NEEDS_MASTER_COMPUTE
 
 /****************************
  * FUNCTIONS TO RUN IPREGEL *
@@ -296,25 +738,319 @@ extern void ip_compute(struct ip_vertex_t* v);
  * @param[in] weighted Indicates whether the graph to load contains weighted or unweighted edges.
  **/
 void ip_init(const char* file_path, int number_of_threads, const char* schedule, int chunk_size, bool directed, bool weighted);
+/**
+ * @brief This function looks for the option "--dry-run" among the command
+ * line arguments and removes it from them.
+ * @details If found, the next call to ip_init() reads the number of vertices
+ * and edges in the config file of the graph, prints the memory footprint
+ * predicted from them and from the compilation flags, then exits the program
+ * without loading the graph. It must be called before the arguments are
+ * checked.
+ * @param[inout] argc The number of arguments, decremented if the option is
+ * found.
+ * @param[inout] argv The arguments, from which the option is removed.
+ * @return Whether the option was found.
+ **/
+bool ip_parse_dry_run(int* argc, char* argv[]);
+/**
+ * @brief This function prepares the run started by ip_run(), before the first
+ * superstep.
+ * @details It runs the master compute of the first superstep or, with
+ * IP_USE_CHECKPOINTS, restores the checkpoint given to
+ * ip_resume_from_checkpoint() if any, since the checkpoint was taken after the
+ * master compute of the superstep it resumes at. It is called by the
+ * underlying iPregel version at the start of ip_run(), from a single thread.
+ **/
+void ip_start_run();
 /**
  * @brief This function is implemented by underlying iPregel version to do their own initialisation.
  * @details This function is distinct from the global initialisation ip_init().
  **/
 extern void ip_init_specific();
+/**
+ * @brief This function is implemented by underlying iPregel version to add the
+ * memory their own structures need to the prediction of a dry run.
+ * @details Lists that grow during the computation are predicted at their
+ * largest, holding every vertex.
+ * @param[inout] bytes The bytes predicted so far for each tag.
+ **/
+extern void ip_predict_memory_specific(size_t bytes[IP_MEMORY_TAG_COUNT]);
 /**
  * @brief This function acts as the start point of the iPregel simulation.
+ * @details It leaves the structures of the version used allocated, so that
+ * ip_reset() can prepare another run on the graph already loaded.
  * @return The error code.
  * @retval 0 Success.
  **/
 extern int ip_run();
+/**
+ * @brief This function brings iPregel back to the state it was in before the
+ * first run, so that ip_run() can be called again on the graph already loaded.
+ * @details The superstep counter, the halting of the computation, the
+ * aggregators and the state of every vertex are reset, in parallel. Vertex
+ * values are left untouched: they are set by the first superstep or by
+ * ip_set_initial_value(). Aggregators remain registered, and the next
+ * ones registered reuse their storage, see ip_register_aggregator().
+ * @pre ip_init() has been called.
+ **/
+void ip_reset();
+/**
+ * @brief This function is implemented by underlying iPregel version to reset
+ * their own vertex state and structures.
+ * @details It is called by ip_reset().
+ **/
+extern void ip_reset_specific();
+#ifdef IP_USE_DYNAMIC_GRAPH
+	/**
+	 * @brief This function inserts the \p count edges going from \p sources[i]
+	 * to \p destinations[i].
+	 * @details Edges are added, in parallel, to a delta kept beside the graph
+	 * loaded, and the sources of the edges are recorded for the next call to
+	 * ip_run_incremental(). In undirected graphs, each edge is inserted in both
+	 * directions. Once the delta holds more than IP_DELTA_COMPACTION_PERCENTAGE
+	 * percent of the edges of the graph loaded, ip_compact_graph() is called.
+	 * Broadcasts reach the edges of the delta, but ip_get_out_neighbour_count()
+	 * and ip_get_out_neighbours() only see them once compacted.
+	 * @param[in] sources The identifiers of the source vertices.
+	 * @param[in] destinations The identifiers of the destination vertices.
+	 * @param[in] count The number of edges to insert.
+	 * @pre ip_init() has been called and no run is in progress.
+	 * @pre Every identifier is an existing vertex identifier.
+	 **/
+	void ip_insert_edges(const IP_VERTEX_ID_TYPE* sources, const IP_VERTEX_ID_TYPE* destinations, size_t count);
+	/**
+	 * @brief This function merges, in parallel, the edges inserted into a new
+	 * CSR and empties the delta.
+	 * @pre No run is in progress.
+	 **/
+	void ip_compact_graph();
+	/**
+	 * @brief This function runs iPregel again, starting from the values left by
+	 * the previous run and from the sources of the edges inserted since.
+	 * @details It resets iPregel with ip_reset() and restricts the first
+	 * superstep to the sources of the edges inserted since the previous
+	 * incremental run, as ip_set_initial_frontier() does. During that run, ip_is_incremental_run()
+	 * returns true, so that the first superstep of ip_compute() broadcasts the
+	 * value of the vertex instead of initialising it. This is only correct for
+	 * monotone algorithms, such as connected components or SSSP.
+	 * @return The error code of ip_run().
+	 * @pre ip_run() has been run at least once on the same algorithm.
+	 **/
+	int ip_run_incremental();
+	/**
+	 * @brief This function tells whether the run in progress was started by
+	 * ip_run_incremental().
+	 * @retval true The run is incremental.
+	 * @retval false The run starts from scratch.
+	 **/
+	bool ip_is_incremental_run();
+#endif // ifdef IP_USE_DYNAMIC_GRAPH
 /**
  * @brief This function writes the serialised representation of all vertices
  * in the file \p f.
+ * @details With IP_USE_PARALLEL_DUMP, threads serialise consecutive ranges of
+ * vertices into buffers of their own with ip_serialise_vertex_to_buffer(),
+ * and write them at their place in the file with pwrite, so that the file
+ * holds vertices in the same order as a sequential dump. With
+ * IP_USE_BINARY_DUMP, the file holds instead a header followed by the value
+ * of every vertex in identifier order, as described in binary_dump_format.h,
+ * and no serialisation function is called.
  * @param[out] f The file to dump into.
  * @pre f points to a file already successfully open.
  * @pre f points to a file open in write mode or read-write mode.
+ * @pre With IP_USE_PARALLEL_DUMP or IP_USE_BINARY_DUMP, f is not open in
+ * append mode.
+ * @pre With IP_USE_MMAP_DUMP, f is open in read-write mode.
  **/
 void ip_dump(FILE* f);
+/**
+ * @brief The signature of the predicates selecting the vertices to dump.
+ * @details Predicates are called by several threads at once, on different
+ * vertices.
+ * @param[in] v The vertex to consider.
+ * @retval true The vertex must be dumped.
+ * @retval false The vertex must not be dumped.
+ **/
+typedef bool (*ip_vertex_predicate_t)(struct ip_vertex_t* v);
+/**
+ * @brief The signature of the comparators ranking the values of vertices.
+ * @details Comparators are called by several threads at once.
+ * @param[in] a The first value.
+ * @param[in] b The second value.
+ * @retval true \p a ranks before \p b.
+ * @retval false \p a ranks after \p b, or ties with it.
+ **/
+typedef bool (*ip_value_comparator_t)(const IP_VALUE_TYPE* a, const IP_VALUE_TYPE* b);
+/**
+ * @brief This function writes the serialised representation of the vertices
+ * satisfying the predicate \p predicate in the file \p f, in identifier
+ * order.
+ * @details The predicate is evaluated on all vertices in parallel. Vertices
+ * are serialised as in ip_dump(), with ip_serialise_vertex_to_buffer() from
+ * all threads with IP_USE_PARALLEL_DUMP, and with ip_serialise_vertex()
+ * otherwise; IP_USE_BINARY_DUMP does not apply.
+ * @param[out] f The file to dump into.
+ * @param[in] predicate The predicate telling whether to dump a vertex.
+ * @pre f points to a file already successfully open.
+ * @pre f points to a file open in write mode or read-write mode.
+ * @pre With IP_USE_PARALLEL_DUMP, f is not open in append mode.
+ **/
+void ip_dump_if(FILE* f, ip_vertex_predicate_t predicate);
+/**
+ * @brief This function writes the serialised representation of the \p k
+ * vertices whose values rank first according to \p comes_before in the file
+ * \p f, in rank order.
+ * @details Each thread keeps the best \p k vertices of those it scans in a
+ * heap, and the heaps of all threads are merged once the scan is over, so the
+ * selection costs a pass over the values and no sort of the graph. Vertices
+ * whose values tie rank in identifier order. Vertices are serialised as in
+ * ip_dump_if().
+ * @param[out] f The file to dump into.
+ * @param[in] k The number of vertices to dump, all of them if there are
+ * fewer.
+ * @param[in] comes_before The comparator ranking values.
+ * @pre f points to a file already successfully open.
+ * @pre f points to a file open in write mode or read-write mode.
+ **/
+void ip_dump_top_k(FILE* f, size_t k, ip_value_comparator_t comes_before);
+#ifdef IP_USE_CHECKPOINTS
+	/**
+	 * @brief This function makes ip_run() write a checkpoint in the file
+	 * \p path every \p superstep_interval supersteps or every
+	 * \p second_interval seconds, whichever comes first.
+	 * @details A checkpoint holds the state of the run between two supersteps;
+	 * it is copied by all threads, and written by background threads while the
+	 * supersteps go on. The file only ever holds a complete checkpoint. No
+	 * checkpoint is taken before the first superstep nor once the run is over.
+	 * ip_init() calls this function when the environment variable
+	 * IP_CHECKPOINT_PATH is set, with the intervals given by
+	 * IP_CHECKPOINT_SUPERSTEPS and IP_CHECKPOINT_SECONDS, or every
+	 * IP_CHECKPOINT_DEFAULT_SECONDS seconds if neither is set.
+	 * @param[in] path The file to write checkpoints into. It is copied.
+	 * @param[in] superstep_interval The number of supersteps between two
+	 * checkpoints, 0 for no limit.
+	 * @param[in] second_interval The number of seconds between two
+	 * checkpoints, 0 for no limit.
+	 **/
+	void ip_enable_checkpoints(const char* path, size_t superstep_interval, double second_interval);
+	/**
+	 * @brief This function reads the checkpoint \p path, from all threads, so
+	 * that the next call to ip_run() resumes from it.
+	 * @details The state of the run is restored at the start of ip_run(),
+	 * once aggregators are registered, in place of the superstep 0 and of what
+	 * the application prepared for it, such as ip_set_initial_frontier(). The
+	 * program stops if the checkpoint was written by another application or
+	 * version of iPregel, or on a graph of another size. ip_init() calls this
+	 * function when the environment variable IP_CHECKPOINT_RESUME is set.
+	 * @param[in] path The checkpoint to resume from.
+	 * @pre ip_init() has loaded the graph on which the checkpoint was taken.
+	 **/
+	void ip_resume_from_checkpoint(const char* path);
+	/**
+	 * @brief This function configures checkpoints and resumption from the
+	 * environment variables IP_CHECKPOINT_PATH, IP_CHECKPOINT_SUPERSTEPS,
+	 * IP_CHECKPOINT_SECONDS and IP_CHECKPOINT_RESUME.
+	 * @details It is called by ip_init() once the graph is loaded.
+	 **/
+	void ip_configure_checkpoints_from_environment();
+	/**
+	 * @brief This function restores the checkpoint read by
+	 * ip_resume_from_checkpoint(), if any, and starts counting the intervals
+	 * between checkpoints.
+	 * @retval true A checkpoint has been restored.
+	 * @retval false There was no checkpoint to restore.
+	 **/
+	bool ip_start_checkpoints();
+	/**
+	 * @brief This function decides whether a checkpoint must be taken before
+	 * the next superstep.
+	 * @details It is called by the underlying iPregel version at the end of
+	 * every superstep, from a single thread, after the master compute.
+	 **/
+	void ip_plan_checkpoint();
+	/**
+	 * @brief This function tells whether ip_plan_checkpoint() decided to take
+	 * a checkpoint.
+	 * @retval true All threads must call ip_take_checkpoint().
+	 * @retval false No checkpoint is due.
+	 **/
+	bool ip_is_checkpoint_planned();
+	/**
+	 * @brief This function copies the state of the run into the snapshot and
+	 * starts the background threads writing it.
+	 * @details It must be called by all threads of the team running the
+	 * supersteps, after ip_plan_checkpoint() and a barrier.
+	 **/
+	void ip_take_checkpoint();
+	/**
+	 * @brief This function waits for the background threads writing the last
+	 * checkpoint, if any.
+	 **/
+	void ip_wait_for_checkpoint();
+	/**
+	 * @brief This function is implemented by underlying iPregel version to
+	 * give the status and message of a vertex to save in a checkpoint.
+	 * @param[in] location The location of the vertex.
+	 * @param[out] active The status of the vertex.
+	 * @param[out] has_message Whether the vertex has a message to read.
+	 * @param[out] message The message of the vertex, if it has one.
+	 **/
+	extern void ip_save_vertex_state(size_t location, bool* active, bool* has_message, IP_MESSAGE_TYPE* message);
+	/**
+	 * @brief This function is implemented by underlying iPregel version to
+	 * give back to a vertex the status and message saved in a checkpoint.
+	 * @param[in] location The location of the vertex.
+	 * @param[in] active The status of the vertex.
+	 * @param[in] has_message Whether the vertex has a message to read.
+	 * @param[in] message The message of the vertex, if it has one.
+	 **/
+	extern void ip_restore_vertex_state(size_t location, bool active, bool has_message, IP_MESSAGE_TYPE message);
+	/**
+	 * @brief This function is implemented by underlying iPregel version to
+	 * give the vertices that run the next superstep, if it keeps a list of
+	 * them. It is restored with ip_set_initial_frontier().
+	 * @param[out] count The number of identifiers in the frontier.
+	 * @return The identifiers of the frontier, NULL if the version has none.
+	 **/
+	extern const IP_VERTEX_ID_TYPE* ip_get_frontier(size_t* count);
+#endif // ifdef IP_USE_CHECKPOINTS
+
+#ifdef IP_USE_GRAPH_IMAGE
+	/**
+	 * @brief This function opens the graph image named by the environment
+	 * variable IP_GRAPH_IMAGE, if it exists, and checks that it can be used.
+	 * @details An image written by a version compiled differently, or built
+	 * from another graph, is rejected and the program exits. On success, the
+	 * number of vertices and edges are set.
+	 * @param[in] file_path The path of the graph, as passed to ip_init().
+	 * @param[in] directed Whether the graph is directed.
+	 * @retval true The image is open, to be mapped by ip_map_graph_image().
+	 * @retval false There is no image, the graph must be loaded from its files.
+	 **/
+	bool ip_open_graph_image(const char* file_path, bool directed);
+	/**
+	 * @brief This function maps the graph image opened and connects the
+	 * vertices, already initialised, to the neighbours it holds.
+	 * @param[out] all_offsets The out-neighbour offsets, within the image.
+	 * @param[out] all_out_neighbours The out-neighbour identifiers, within the
+	 * image.
+	 * @param[in] directed Whether the graph is directed.
+	 **/
+	void ip_map_graph_image(IP_NEIGHBOUR_COUNT_TYPE** all_offsets, IP_VERTEX_ID_TYPE** all_out_neighbours, bool directed);
+	/**
+	 * @brief This function writes the graph just loaded in the graph image
+	 * named by IP_GRAPH_IMAGE, if set.
+	 * @details The image is written under a temporary name and renamed once
+	 * complete. A failure is reported but does not stop the run.
+	 * @param[in] file_path The path of the graph, as passed to ip_init().
+	 * @param[in] all_offsets The out-neighbour offsets of all vertices, plus a
+	 * last one equal to the number of edges.
+	 * @param[in] all_out_neighbours The out-neighbour identifiers of all
+	 * vertices.
+	 * @param[in] directed Whether the graph is directed.
+	 **/
+	void ip_write_graph_image(const char* file_path, const IP_NEIGHBOUR_COUNT_TYPE* all_offsets, const IP_VERTEX_ID_TYPE* all_out_neighbours, bool directed);
+#endif // ifdef IP_USE_GRAPH_IMAGE
 	
 #ifdef IP_USE_SPREAD
 	#ifdef IP_USE_SINGLE_BROADCAST
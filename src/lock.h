@@ -0,0 +1,217 @@
+/**
+ * @file lock.h
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This file implements the locks protecting the mailboxes of the
+ * versions that push messages.
+ * @details The implementation is selected at compile time:
+ * - By default, a compare-and-swap loop on an integer.
+ * - With IP_USE_LOCK_TTAS, a test-and-test-and-set lock: waiting threads read
+ * the lock until it looks free before trying to take it, and back off
+ * exponentially, from IP_LOCK_BACKOFF_MIN to IP_LOCK_BACKOFF_MAX pauses, when
+ * they fail.
+ * - With IP_USE_LOCK_TICKET, a ticket lock, which grants the lock in arrival
+ * order.
+ * - With IP_USE_LOCK_OMP, the OpenMP lock, omp_lock_t.
+ * - With IP_USE_LOCK_PTHREAD_SPINLOCK, or IP_USE_SPINLOCK, the POSIX spinlock,
+ * pthread_spinlock_t.
+ * Threads waiting for a TTAS or ticket lock yield their core every
+ * IP_LOCK_SPIN_COUNT pauses, or after every pause when threads outnumber
+ * processors, since the thread they wait for may then not be running; a
+ * ticket lock would otherwise wait a full time slice per handover.
+ * The benchmark mailbox_contention.c measures them under different contention
+ * patterns. With IP_ENABLE_CONTENTION_COUNTERS, the time spent waiting for a
+ * TTAS, ticket or default lock is counted, in pauses or failed attempts.
+ * This file must be included by the version preambles, before the lock type
+ * is used.
+ **/
+
+#ifndef LOCK_H_INCLUDED
+#define LOCK_H_INCLUDED
+
+#include <stdatomic.h>
+#include <sched.h>
+#include <omp.h>
+#ifdef IP_ENABLE_CONTENTION_COUNTERS
+	#include "contention_counters.h"
+#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+
+#if defined(IP_USE_SPINLOCK) && !defined(IP_USE_LOCK_PTHREAD_SPINLOCK)
+	#define IP_USE_LOCK_PTHREAD_SPINLOCK
+#endif // if defined(IP_USE_SPINLOCK) && !defined(IP_USE_LOCK_PTHREAD_SPINLOCK)
+
+#if defined(IP_USE_LOCK_TTAS) + defined(IP_USE_LOCK_TICKET) + defined(IP_USE_LOCK_OMP) + defined(IP_USE_LOCK_PTHREAD_SPINLOCK) > 1
+	#error "Only one of IP_USE_LOCK_TTAS, IP_USE_LOCK_TICKET, IP_USE_LOCK_OMP and IP_USE_LOCK_PTHREAD_SPINLOCK can be defined."
+#endif
+
+/// The number of pauses a thread waits after its first failed attempt to take a TTAS lock.
+#ifndef IP_LOCK_BACKOFF_MIN
+	#define IP_LOCK_BACKOFF_MIN 4
+#endif // ifndef IP_LOCK_BACKOFF_MIN
+/// The maximum number of pauses a thread waits between two attempts to take a TTAS lock.
+#ifndef IP_LOCK_BACKOFF_MAX
+	#define IP_LOCK_BACKOFF_MAX 1024
+#endif // ifndef IP_LOCK_BACKOFF_MAX
+/// The number of pauses after which a thread waiting for a TTAS or ticket lock yields.
+#ifndef IP_LOCK_SPIN_COUNT
+	#define IP_LOCK_SPIN_COUNT 4096
+#endif // ifndef IP_LOCK_SPIN_COUNT
+
+#if defined(IP_USE_LOCK_TICKET)
+	/// This structure describes a ticket lock.
+	struct ip_ticket_lock_t
+	{
+		/// The ticket the next thread to arrive will take.
+		atomic_ushort next;
+		/// The ticket of the thread allowed to hold the lock.
+		atomic_ushort serving;
+	};
+	/// The data type used to implement locks.
+	typedef struct ip_ticket_lock_t IP_LOCK_TYPE;
+#elif defined(IP_USE_LOCK_OMP)
+	/// The data type used to implement locks.
+	typedef omp_lock_t IP_LOCK_TYPE;
+#elif defined(IP_USE_LOCK_PTHREAD_SPINLOCK)
+	#include <pthread.h>
+	/// The data type used to implement locks.
+	typedef pthread_spinlock_t IP_LOCK_TYPE;
+#else
+	/// The data type used to implement locks.
+	typedef volatile atomic_int IP_LOCK_TYPE;
+#endif
+/// The number of pauses after which a thread waiting for a lock yields, set by ip_lock_configure.
+unsigned int ip_lock_spin_count = IP_LOCK_SPIN_COUNT;
+
+/**
+ * @brief This function adapts the way threads wait for locks to the number of
+ * threads that will use them.
+ * @param[in] thread_count The number of threads.
+ **/
+void ip_lock_configure(int thread_count)
+{
+	ip_lock_spin_count = (thread_count > omp_get_num_procs()) ? 1 : IP_LOCK_SPIN_COUNT;
+}
+
+/**
+ * @brief This function tells the processor that the calling thread is
+ * spinning, and leaves the core to other threads every ip_lock_spin_count
+ * calls.
+ * @param[inout] spins The number of pauses made since the last yield.
+ **/
+void ip_lock_pause(unsigned int* spins)
+{
+	#ifdef IP_ENABLE_CONTENTION_COUNTERS
+		ip_my_contention_counters->counts[IP_CONTENTION_LOCK_SPINS]++;
+	#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+	if(++(*spins) >= ip_lock_spin_count)
+	{
+		*spins = 0;
+		sched_yield();
+	}
+	#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+	#endif
+}
+
+/**
+ * @brief This function initialises the lock \p lock.
+ * @param[in] lock The lock to initialise.
+ **/
+void ip_lock_init(IP_LOCK_TYPE* lock)
+{
+	#if defined(IP_USE_LOCK_TICKET)
+		atomic_init(&lock->next, 0);
+		atomic_init(&lock->serving, 0);
+	#elif defined(IP_USE_LOCK_OMP)
+		omp_init_lock(lock);
+	#elif defined(IP_USE_LOCK_PTHREAD_SPINLOCK)
+		pthread_spin_init(lock, PTHREAD_PROCESS_PRIVATE);
+	#else
+		*lock = 0;
+	#endif
+}
+
+/**
+ * @brief This function acquires the lock \p lock.
+ * @param[in] lock The lock to acquire.
+ **/
+void ip_lock_acquire(IP_LOCK_TYPE* lock)
+{
+	#if defined(IP_USE_LOCK_TTAS)
+		unsigned int backoff = IP_LOCK_BACKOFF_MIN;
+		unsigned int spins = 0;
+		while(true)
+		{
+			while(atomic_load_explicit(lock, memory_order_relaxed) != 0)
+			{
+				ip_lock_pause(&spins);
+			}
+			if(atomic_exchange_explicit(lock, 1, memory_order_acquire) == 0)
+			{
+				return;
+			}
+			// Another thread took it between the read and the exchange; let the line settle before reading it again.
+			for(unsigned int i = 0; i < backoff; i++)
+			{
+				ip_lock_pause(&spins);
+			}
+			if(backoff < IP_LOCK_BACKOFF_MAX)
+			{
+				backoff *= 2;
+			}
+		}
+	#elif defined(IP_USE_LOCK_TICKET)
+		unsigned short ticket = atomic_fetch_add_explicit(&lock->next, 1, memory_order_relaxed);
+		unsigned int spins = 0;
+		while(atomic_load_explicit(&lock->serving, memory_order_acquire) != ticket)
+		{
+			ip_lock_pause(&spins);
+		}
+	#elif defined(IP_USE_LOCK_OMP)
+		omp_set_lock(lock);
+	#elif defined(IP_USE_LOCK_PTHREAD_SPINLOCK)
+		pthread_spin_lock(lock);
+	#else
+		int zero = 0;
+		while(!atomic_compare_exchange_strong(lock, &zero, 1))
+		{
+			#ifdef IP_ENABLE_CONTENTION_COUNTERS
+				ip_my_contention_counters->counts[IP_CONTENTION_LOCK_SPINS]++;
+			#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+			zero = 0;
+		}
+	#endif
+}
+
+/**
+ * @brief This function releases the lock \p lock.
+ * @param[in] lock The lock to release.
+ **/
+void ip_lock_release(IP_LOCK_TYPE* lock)
+{
+	#if defined(IP_USE_LOCK_TTAS)
+		atomic_store_explicit(lock, 0, memory_order_release);
+	#elif defined(IP_USE_LOCK_TICKET)
+		// Only the holder writes this field, so a plain increment is enough.
+		atomic_store_explicit(&lock->serving, (unsigned short)(atomic_load_explicit(&lock->serving, memory_order_relaxed) + 1), memory_order_release);
+	#elif defined(IP_USE_LOCK_OMP)
+		omp_unset_lock(lock);
+	#elif defined(IP_USE_LOCK_PTHREAD_SPINLOCK)
+		pthread_spin_unlock(lock);
+	#else
+		atomic_store(lock, 0);
+	#endif
+}
+
+#endif // LOCK_H_INCLUDED
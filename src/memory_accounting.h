@@ -0,0 +1,287 @@
+/**
+ * @file memory_accounting.h
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This file contains the memory footprint of the graph, as counted with
+ * IP_ENABLE_MEMORY_ACCOUNTING and as predicted by a dry run.
+ * @details With IP_ENABLE_MEMORY_ACCOUNTING, every memory area allocated by
+ * the safe functions is preceded by a header holding its size and its tag, so
+ * that the bytes of each tag can be counted as areas are allocated,
+ * reallocated and freed. The bytes of each tag, the bytes per vertex and per
+ * edge, and the peak resident set size are printed once the graph is loaded
+ * and when the program exits; the bytes counted and the peak resident set
+ * size are also printed at the end of every superstep.
+ *
+ * The per-thread structures allocated with aligned_alloc and the graph images
+ * mapped in memory do not go through the safe functions; they only show in
+ * the resident set size.
+ *
+ * A dry run, requested with the option "--dry-run", predicts the same bytes
+ * per tag from the number of vertices and edges in the config file of the
+ * graph and from the compilation flags, without loading the graph.
+ *
+ * This file must be included by iPregel_postamble.h, before the version
+ * postamble.
+ **/
+
+#ifndef MEMORY_ACCOUNTING_H_INCLUDED
+#define MEMORY_ACCOUNTING_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef IP_ENABLE_MEMORY_ACCOUNTING
+	#include <stdatomic.h>
+	#include <sys/resource.h> // getrusage
+#endif // ifdef IP_ENABLE_MEMORY_ACCOUNTING
+
+/// The names of the tags, as printed.
+const char* ip_memory_tag_names[IP_MEMORY_TAG_COUNT] = { "Other", "Vertices", "Offsets", "Adjacency", "InNeighbours", "Mailboxes", "Frontiers" };
+/// Tells whether ip_init() must predict the memory footprint instead of loading the graph.
+bool ip_dry_run = false;
+
+bool ip_parse_dry_run(int* argc, char* argv[])
+{
+	for(int i = 1; i < *argc; i++)
+	{
+		if(strcmp(argv[i], "--dry-run") == 0)
+		{
+			memmove(&argv[i], &argv[i + 1], sizeof(char*) * (*argc - i));
+			(*argc)--;
+			ip_dry_run = true;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * @brief This function adds the bytes the offsets, out-neighbours and
+ * in-neighbours kept once the graph is loaded take to \p bytes.
+ * @details The offsets and out-neighbours loaded are kept for undirected
+ * graphs, where they double as in-neighbours, or when the application needs
+ * them. Directed graphs hold their in-neighbours separately.
+ * @param[in] directed Tells whether the graph is directed.
+ * @param[inout] bytes The bytes of each tag.
+ **/
+void ip_predict_topology_memory(bool directed, size_t bytes[IP_MEMORY_TAG_COUNT])
+{
+	(void)directed;
+	size_t offsets_size = (ip_get_vertices_count() + 1) * sizeof(IP_NEIGHBOUR_COUNT_TYPE);
+	size_t neighbours_size = ip_get_edges_count() * sizeof(IP_VERTEX_ID_TYPE);
+	#ifdef IP_NEEDS_OUT_NEIGHBOUR_IDS
+		bytes[IP_MEMORY_ADJACENCY] += neighbours_size;
+	#else
+		bytes[IP_MEMORY_ADJACENCY] += directed ? 0 : neighbours_size;
+	#endif // if(n)def IP_NEEDS_OUT_NEIGHBOUR_IDS
+	#ifdef IP_NEEDS_OUT_NEIGHBOUR_COUNT
+		bytes[IP_MEMORY_OFFSETS] += offsets_size;
+	#else
+		bytes[IP_MEMORY_OFFSETS] += directed ? 0 : offsets_size;
+	#endif // if(n)def IP_NEEDS_OUT_NEIGHBOUR_COUNT
+	#ifdef IP_USE_COMPACT_LAYOUT
+		#ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+			bytes[IP_MEMORY_IN_NEIGHBOURS] += directed ? neighbours_size + offsets_size : 0;
+		#endif // ifdef IP_NEEDS_IN_NEIGHBOUR_COUNT
+	#elif defined(IP_NEEDS_IN_NEIGHBOUR_IDS) || defined(IP_NEEDS_IN_NEIGHBOURS_COUNT)
+		bytes[IP_MEMORY_IN_NEIGHBOURS] += directed ? neighbours_size : 0;
+	#endif // if defined(IP_USE_COMPACT_LAYOUT)
+}
+
+/**
+ * @brief This function predicts the bytes of each tag once the graph is
+ * loaded, from the number of vertices and edges.
+ * @details Lists that grow during the computation are predicted at their
+ * largest, holding every vertex.
+ * @param[in] directed Tells whether the graph is directed.
+ * @param[out] bytes The bytes of each tag.
+ **/
+void ip_predict_memory(bool directed, size_t bytes[IP_MEMORY_TAG_COUNT])
+{
+	memset(bytes, 0, sizeof(size_t) * IP_MEMORY_TAG_COUNT);
+	bytes[IP_MEMORY_VERTICES] += sizeof(struct ip_vertex_t) * ip_get_vertices_count();
+	ip_predict_topology_memory(directed, bytes);
+	#ifdef IP_USE_HUB_MAILBOXES
+		bytes[IP_MEMORY_OTHER] += (ip_get_vertices_count() + 7) / 8;
+	#endif // ifdef IP_USE_HUB_MAILBOXES
+	ip_predict_memory_specific(bytes);
+}
+
+/**
+ * @brief This function prints the bytes of each tag predicted for the graph
+ * whose config file has been read, along with the peak reached while
+ * loading it.
+ * @details The offsets and out-neighbours are all in memory while the graph
+ * is loaded, even those freed once it is loaded.
+ * @param[in] directed Tells whether the graph is directed.
+ **/
+void ip_report_predicted_memory(bool directed)
+{
+	size_t bytes[IP_MEMORY_TAG_COUNT];
+	ip_predict_memory(directed, bytes);
+	size_t total = 0;
+	for(int i = 0; i < IP_MEMORY_TAG_COUNT; i++)
+	{
+		printf("MemoryPredicted%sBytes:%zu\n", ip_memory_tag_names[i], bytes[i]);
+		total += bytes[i];
+	}
+	size_t offsets_size = (ip_get_vertices_count() + 1) * sizeof(IP_NEIGHBOUR_COUNT_TYPE);
+	size_t neighbours_size = ip_get_edges_count() * sizeof(IP_VERTEX_ID_TYPE);
+	size_t loading_peak = total;
+	loading_peak += bytes[IP_MEMORY_OFFSETS] < offsets_size ? offsets_size - bytes[IP_MEMORY_OFFSETS] : 0;
+	loading_peak += bytes[IP_MEMORY_ADJACENCY] < neighbours_size ? neighbours_size - bytes[IP_MEMORY_ADJACENCY] : 0;
+	printf("MemoryPredictedBytes:%zu\n", total);
+	printf("MemoryPredictedLoadingPeakBytes:%zu\n", loading_peak);
+	printf("MemoryPredictedBytesPerVertex:%f\n", ip_get_vertices_count() > 0 ? (double)total / ip_get_vertices_count() : 0.0);
+	printf("MemoryPredictedBytesPerEdge:%f\n", ip_get_edges_count() > 0 ? (double)total / ip_get_edges_count() : 0.0);
+}
+
+#ifdef IP_ENABLE_MEMORY_ACCOUNTING
+/// The header placed before every memory area allocated by the safe functions, keeping the area aligned like malloc does.
+union ip_memory_header_t
+{
+	struct
+	{
+		/// The size of the memory area, header excluded.
+		size_t size;
+		/// What the memory area holds.
+		enum ip_memory_tag_t tag;
+	} block;
+	/// Unused, gives the header the alignment of malloc.
+	max_align_t alignment;
+};
+/// The bytes currently allocated under each tag.
+atomic_size_t ip_memory_bytes[IP_MEMORY_TAG_COUNT];
+/// The bytes currently allocated under all tags.
+atomic_size_t ip_memory_total_bytes;
+/// The highest value ip_memory_total_bytes reached.
+atomic_size_t ip_memory_peak_bytes;
+
+/**
+ * @brief This function counts a memory area allocated, reallocated or freed.
+ * @param[in] tag What the memory area holds.
+ * @param[in] added The bytes the memory area has now.
+ * @param[in] removed The bytes the memory area had before.
+ **/
+void ip_account_memory(enum ip_memory_tag_t tag, size_t added, size_t removed)
+{
+	size_t total;
+	if(added >= removed)
+	{
+		atomic_fetch_add(&ip_memory_bytes[tag], added - removed);
+		total = atomic_fetch_add(&ip_memory_total_bytes, added - removed) + (added - removed);
+	}
+	else
+	{
+		atomic_fetch_sub(&ip_memory_bytes[tag], removed - added);
+		total = atomic_fetch_sub(&ip_memory_total_bytes, removed - added) - (removed - added);
+	}
+	size_t peak = atomic_load(&ip_memory_peak_bytes);
+	// On failure, peak is updated with the current peak.
+	while(total > peak && !atomic_compare_exchange_weak(&ip_memory_peak_bytes, &peak, total))
+	{
+	}
+}
+
+/**
+ * @brief This function fills the header of a memory area freshly
+ * (re)allocated and counts it.
+ * @param[in] header The memory area allocated, header included.
+ * @param[in] size The size of the memory area, header excluded.
+ * @param[in] tag What the memory area holds.
+ * @param[in] old_size The size the memory area had before being reallocated,
+ * 0 if it has just been allocated.
+ * @return A pointer on the memory area, after the header.
+ **/
+void* ip_attach_memory_header(union ip_memory_header_t* header, size_t size, enum ip_memory_tag_t tag, size_t old_size)
+{
+	header->block.size = size;
+	header->block.tag = tag;
+	ip_account_memory(tag, size, old_size);
+	return header + 1;
+}
+
+/**
+ * @brief This function gets the header of a memory area allocated by the safe
+ * functions.
+ * @param[in] ptr A pointer on the memory area, as returned by the safe
+ * functions.
+ * @return The header of the memory area.
+ **/
+union ip_memory_header_t* ip_get_memory_header(void* ptr)
+{
+	return ((union ip_memory_header_t*)ptr) - 1;
+}
+
+/**
+ * @brief This function gets the peak resident set size of the program.
+ * @return The peak resident set size, in bytes.
+ **/
+size_t ip_get_peak_rss()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	#ifdef __APPLE__
+		return (size_t)usage.ru_maxrss;
+	#else
+		// Linux reports kilobytes.
+		return (size_t)usage.ru_maxrss * 1024;
+	#endif // if(n)def __APPLE__
+}
+
+/**
+ * @brief This function prints the bytes currently allocated under each tag,
+ * their total, the highest total reached, the bytes per vertex and per edge,
+ * and the peak resident set size.
+ * @param[in] moment The name of the moment, which prefixes every line.
+ **/
+void ip_report_memory(const char* moment)
+{
+	size_t total = atomic_load(&ip_memory_total_bytes);
+	for(int i = 0; i < IP_MEMORY_TAG_COUNT; i++)
+	{
+		printf("Memory%s%sBytes:%zu\n", moment, ip_memory_tag_names[i], atomic_load(&ip_memory_bytes[i]));
+	}
+	printf("Memory%sTrackedBytes:%zu\n", moment, total);
+	printf("Memory%sPeakTrackedBytes:%zu\n", moment, atomic_load(&ip_memory_peak_bytes));
+	printf("Memory%sBytesPerVertex:%f\n", moment, ip_get_vertices_count() > 0 ? (double)total / ip_get_vertices_count() : 0.0);
+	printf("Memory%sBytesPerEdge:%f\n", moment, ip_get_edges_count() > 0 ? (double)total / ip_get_edges_count() : 0.0);
+	printf("Memory%sPeakRss:%zu\n", moment, ip_get_peak_rss());
+}
+
+/**
+ * @brief This function prints the bytes currently allocated and the peak
+ * resident set size at the end of the current superstep.
+ * @details It must be called by a single thread, before the superstep number
+ * is incremented.
+ **/
+void ip_report_superstep_memory()
+{
+	printf("Superstep%zuTrackedBytes:%zu\n", ip_get_superstep(), atomic_load(&ip_memory_total_bytes));
+	printf("Superstep%zuPeakRss:%zu\n", ip_get_superstep(), ip_get_peak_rss());
+}
+
+/**
+ * @brief This function prints the memory footprint when the program exits.
+ * @details It is registered with atexit once the graph is loaded.
+ **/
+void ip_report_teardown_memory()
+{
+	ip_report_memory("Teardown");
+}
+#endif // ifdef IP_ENABLE_MEMORY_ACCOUNTING
+
+#endif // MEMORY_ACCOUNTING_H_INCLUDED
@@ -0,0 +1,177 @@
+/**
+ * @file message_width.h
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This file implements the thread-safe combination of a message into a
+ * mailbox that already holds one, for the versions that push messages.
+ * @details The strategy depends on the width of the message type:
+ * - By default, messages of 1, 2, 4 or 8 bytes are combined with a native
+ * compare-and-swap.
+ * - With IP_USE_WIDE_MESSAGE_CMPXCHG16B, 16-byte messages are combined with a
+ * 16-byte compare-and-swap (cmpxchg16b on x86-64, which requires -mcx16).
+ * - With IP_USE_WIDE_MESSAGE_LOCK, messages of any size are combined while
+ * holding the mailbox lock of the destination vertex. The lock is already
+ * there for the first write, so this costs no memory and contention stays
+ * per-vertex instead of going through a global lock.
+ * With IP_ENABLE_CAS_STATISTICS, every thread counts the combinations it makes
+ * with a compare-and-swap and the compare-and-swaps that fail, which
+ * ip_report_cas_statistics prints once the computation is over. With
+ * IP_ENABLE_CONTENTION_COUNTERS, every combination, compare-and-swap and
+ * failed compare-and-swap is also counted in the superstep it happens.
+ * This file must be included by the version postambles, after the lock
+ * functions have been declared.
+ **/
+
+#ifndef MESSAGE_WIDTH_H_INCLUDED
+#define MESSAGE_WIDTH_H_INCLUDED
+
+#include <string.h>
+
+#ifdef IP_ENABLE_CAS_STATISTICS
+	/// The number of combinations the calling thread made with a compare-and-swap since the last report.
+	size_t ip_cas_combination_count = 0;
+	/// The number of compare-and-swaps of the calling thread that failed since the last report.
+	size_t ip_cas_retry_count = 0;
+	#pragma omp threadprivate(ip_cas_combination_count, ip_cas_retry_count)
+
+/**
+ * @brief This function prints the number of combinations made with a
+ * compare-and-swap, the number of compare-and-swaps that had to be retried and
+ * the ratio between the two, then resets the counters.
+ * @details It must be called outside of any parallel region, with the same
+ * number of threads as the parallel regions that made the combinations.
+ **/
+void ip_report_cas_statistics()
+{
+	size_t combination_count = 0;
+	size_t retry_count = 0;
+	#pragma omp parallel reduction(+:combination_count, retry_count)
+	{
+		combination_count += ip_cas_combination_count;
+		retry_count += ip_cas_retry_count;
+		ip_cas_combination_count = 0;
+		ip_cas_retry_count = 0;
+	}
+	printf("CasCombinationCount:%zu\n", combination_count);
+	printf("CasRetryCount:%zu\n", retry_count);
+	printf("CasRetryRate:%f\n", combination_count > 0 ? ((double)retry_count) / combination_count : 0.0);
+}
+#endif // ifdef IP_ENABLE_CAS_STATISTICS
+
+/**
+ * @brief This function tells whether the messages \p a and \p b are equal.
+ * @param[in] a The first message.
+ * @param[in] b The second message.
+ * @retval true The messages are equal.
+ * @retval false The messages are different.
+ **/
+bool ip_messages_equal(const IP_MESSAGE_TYPE* a, const IP_MESSAGE_TYPE* b)
+{
+	#ifdef IP_USE_MESSAGE_EQUALITY
+		return ip_message_equals(*a, *b);
+	#else
+		return memcmp(a, b, sizeof(IP_MESSAGE_TYPE)) == 0;
+	#endif // if(n)def IP_USE_MESSAGE_EQUALITY
+}
+
+/**
+ * @brief This function combines the message \p message into the mailbox \p
+ * mailbox, which must already contain a message.
+ * @param[inout] mailbox The mailbox to update.
+ * @param[in] lock The lock protecting the mailbox.
+ * @param[in] message The message to combine.
+ * @pre \p mailbox is aligned on IP_MAILBOX_ALIGNMENT.
+ * @post \p mailbox contains the combination of its previous content and \p
+ * message.
+ **/
+void ip_combine_in_mailbox(IP_MESSAGE_TYPE* mailbox, IP_LOCK_TYPE* lock, IP_MESSAGE_TYPE message)
+{
+	#ifdef IP_ENABLE_CONTENTION_COUNTERS
+		ip_my_contention_counters->counts[IP_CONTENTION_COMBINED_MESSAGES]++;
+	#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+	#if defined(IP_USE_WIDE_MESSAGE_LOCK)
+		ip_lock_acquire(lock);
+		ip_combine(mailbox, message);
+		ip_lock_release(lock);
+	#elif defined(IP_USE_WIDE_MESSAGE_CMPXCHG16B)
+		(void)(lock);
+		#ifndef __GCC_HAVE_SYNC_COMPARE_AND_SWAP_16
+			#error "IP_USE_WIDE_MESSAGE_CMPXCHG16B requires a 16-byte compare-and-swap; compile with -mcx16."
+		#endif // ifndef __GCC_HAVE_SYNC_COMPARE_AND_SWAP_16
+		_Static_assert(sizeof(IP_MESSAGE_TYPE) == 16, "IP_USE_WIDE_MESSAGE_CMPXCHG16B requires a 16-byte IP_MESSAGE_TYPE.");
+		union ip_wide_message_t
+		{
+			IP_MESSAGE_TYPE message;
+			unsigned __int128 raw;
+		} old_value, new_value;
+		unsigned __int128 current_value;
+		// A torn read is harmless here: the compare-and-swap will fail and return the actual content.
+		memcpy(&old_value.raw, mailbox, sizeof(IP_MESSAGE_TYPE));
+		new_value = old_value;
+		ip_combine(&new_value.message, message);
+		#ifdef IP_ENABLE_CAS_STATISTICS
+			ip_cas_combination_count++;
+		#endif // ifdef IP_ENABLE_CAS_STATISTICS
+		while(!ip_messages_equal(&new_value.message, &old_value.message))
+		{
+			#ifdef IP_ENABLE_CONTENTION_COUNTERS
+				ip_my_contention_counters->counts[IP_CONTENTION_CAS_ATTEMPTS]++;
+			#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+			if((current_value = __sync_val_compare_and_swap((unsigned __int128*)mailbox, old_value.raw, new_value.raw)) == old_value.raw)
+			{
+				break;
+			}
+			#ifdef IP_ENABLE_CAS_STATISTICS
+				ip_cas_retry_count++;
+			#endif // ifdef IP_ENABLE_CAS_STATISTICS
+			#ifdef IP_ENABLE_CONTENTION_COUNTERS
+				ip_my_contention_counters->counts[IP_CONTENTION_CAS_FAILURES]++;
+			#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+			old_value.raw = current_value;
+			new_value = old_value;
+			ip_combine(&new_value.message, message);
+		}
+	#else
+		(void)(lock);
+		_Static_assert(sizeof(IP_MESSAGE_TYPE) == 1 || sizeof(IP_MESSAGE_TYPE) == 2 || sizeof(IP_MESSAGE_TYPE) == 4 || sizeof(IP_MESSAGE_TYPE) == 8,
+					   "Messages that are not 1, 2, 4 or 8 bytes wide require IP_USE_WIDE_MESSAGE_CMPXCHG16B or IP_USE_WIDE_MESSAGE_LOCK.");
+		IP_MESSAGE_TYPE old_value = *mailbox;
+		IP_MESSAGE_TYPE new_value = old_value;
+		ip_combine(&new_value, message);
+		#ifdef IP_ENABLE_CAS_STATISTICS
+			ip_cas_combination_count++;
+		#endif // ifdef IP_ENABLE_CAS_STATISTICS
+		// On failure, old_value is updated with the current content of the mailbox.
+		while(!ip_messages_equal(&new_value, &old_value))
+		{
+			#ifdef IP_ENABLE_CONTENTION_COUNTERS
+				ip_my_contention_counters->counts[IP_CONTENTION_CAS_ATTEMPTS]++;
+			#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+			if(__atomic_compare_exchange(mailbox, &old_value, &new_value, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+			{
+				break;
+			}
+			#ifdef IP_ENABLE_CAS_STATISTICS
+				ip_cas_retry_count++;
+			#endif // ifdef IP_ENABLE_CAS_STATISTICS
+			#ifdef IP_ENABLE_CONTENTION_COUNTERS
+				ip_my_contention_counters->counts[IP_CONTENTION_CAS_FAILURES]++;
+			#endif // ifdef IP_ENABLE_CONTENTION_COUNTERS
+			new_value = old_value;
+			ip_combine(&new_value, message);
+		}
+	#endif
+}
+
+#endif // MESSAGE_WIDTH_H_INCLUDED
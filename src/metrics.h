@@ -0,0 +1,712 @@
+/**
+ * @file metrics.h
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This file contains the per-superstep metrics enabled with
+ * IP_ENABLE_METRICS.
+ * @details Every thread accumulates, in a slot of its own, the time it spends
+ * in each phase of a superstep, along with the vertices it computes, the
+ * messages it sends and the edges it traverses. At the end of a superstep, the
+ * slots are copied into a ring buffer allocated once, which keeps the last
+ * IP_METRICS_RING_SIZE supersteps. At the end of every ip_run(), the ring
+ * buffer is written to the file named by the environment variable
+ * IP_METRICS_PATH, in JSON if the name ends with ".json" and in CSV otherwise.
+ *
+ * Threads may still write in their slot for a superstep while the single
+ * region that ends it runs, so a superstep is only copied when the next one
+ * ends, or when the run is over. Meanwhile, threads write in a second set of
+ * slots: slots alternate between two sets with the parity of the superstep.
+ *
+ * The time a thread spends in a phase is split between the time it works and
+ * the time it waits at barriers, or outside single regions, for the other
+ * threads.
+ * Every superstep gets an imbalance factor: the longest working time of a
+ * thread over the mean working time of all threads. Every thread also ranks,
+ * over all runs, the vertices that processed the most edges at once, which are
+ * the vertices most likely to keep the others waiting.
+ *
+ * With IP_ENABLE_HARDWARE_COUNTERS, the hardware counters of every thread
+ * are read at the same phase boundaries, and attributed to the same phases.
+ **/
+
+#ifndef METRICS_H_INCLUDED
+#define METRICS_H_INCLUDED
+
+#include <inttypes.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef IP_ENABLE_HARDWARE_COUNTERS
+	#include "hardware_counters.h"
+#endif // ifdef IP_ENABLE_HARDWARE_COUNTERS
+
+/// The number of supersteps kept in the ring buffer, the oldest being overwritten first.
+#ifndef IP_METRICS_RING_SIZE
+	#define IP_METRICS_RING_SIZE 4096
+#endif // ifndef IP_METRICS_RING_SIZE
+
+/// The number of vertices kept in the ranking of the vertices that processed the most edges.
+#ifndef IP_METRICS_SLOWEST_VERTEX_COUNT
+	#define IP_METRICS_SLOWEST_VERTEX_COUNT 10
+#endif // ifndef IP_METRICS_SLOWEST_VERTEX_COUNT
+
+/// The phases of a superstep; each version of iPregel only goes through some of them.
+enum ip_metrics_phase_t
+{
+	/// The vertices run ip_compute().
+	IP_METRICS_COMPUTE,
+	/// The messages held aside, in send caches, hub mailboxes or thread lists, are gathered.
+	IP_METRICS_MERGE,
+	/// The messages received are moved into the mailboxes read at the next superstep.
+	IP_METRICS_MAILBOX,
+	/// The vertices fetch the messages broadcast by their in-neighbours.
+	IP_METRICS_FETCH,
+	/// The broadcast messages are cleared.
+	IP_METRICS_RESET,
+	/// The number of phases.
+	IP_METRICS_PHASE_COUNT
+};
+/// The names of the phases, as written in the metrics file.
+const char* ip_metrics_phase_names[IP_METRICS_PHASE_COUNT] = { "compute", "merge", "mailbox", "fetch", "reset" };
+
+/// This structure holds what a thread did during a superstep, alone on its cache lines.
+struct ip_thread_metrics_t
+{
+	/// The time spent in each phase, in seconds.
+	_Alignas(IP_CACHE_LINE_SIZE) double phase_durations[IP_METRICS_PHASE_COUNT];
+	/// The time at which the current phase started.
+	double phase_start;
+	/// The time spent working, in seconds: the time spent in phases minus the barrier waits.
+	double busy_duration;
+	/// The time spent waiting at barriers for the other threads, in seconds.
+	double wait_duration;
+	/// The time at which the thread started to wait for the other threads, 0 if it is not waiting.
+	double wait_start;
+	/// The time spent waiting since the current phase started, in seconds.
+	double phase_wait_duration;
+	/// The number of vertices computed.
+	size_t vertex_count;
+	/// The number of messages sent; a single broadcast counts as one.
+	size_t message_count;
+	/// The number of edges traversed to send or fetch messages.
+	size_t edge_count;
+	/// The value of edge_count when the thread was done with the last vertex it computed.
+	size_t edge_count_at_last_vertex;
+#ifdef IP_ENABLE_HARDWARE_COUNTERS
+	/// The hardware counters accumulated in each phase.
+	uint64_t phase_hardware_counters[IP_METRICS_PHASE_COUNT][IP_HARDWARE_COUNTER_COUNT];
+	/// The hardware counters read when the current phase started.
+	uint64_t hardware_counters_start[IP_HARDWARE_COUNTER_COUNT];
+	/// The hardware counters the thread could open, one bit per counter; the others are written as missing.
+	unsigned int hardware_counter_mask;
+#endif // ifdef IP_ENABLE_HARDWARE_COUNTERS
+};
+/// This structure holds what all threads did together during a superstep.
+struct ip_superstep_metrics_t
+{
+	/// The index of the ip_run() call, from 0.
+	size_t run;
+	/// The superstep number.
+	size_t superstep;
+	/// The duration of the superstep, in seconds.
+	double duration;
+	/// The number of vertices active at the end of the superstep.
+	size_t active_vertices;
+	/// The longest working time of a thread over the mean working time of all threads.
+	double imbalance_factor;
+};
+/// This structure describes a vertex that processed many edges in a phase.
+struct ip_metrics_vertex_t
+{
+	/// The identifier of the vertex.
+	IP_VERTEX_ID_TYPE id;
+	/// The index of the ip_run() call, from 0.
+	size_t run;
+	/// The superstep number.
+	size_t superstep;
+	/// The phase in which the edges were processed.
+	enum ip_metrics_phase_t phase;
+	/// The number of edges processed.
+	size_t edge_count;
+};
+/// This structure holds the vertices of a thread that processed the most edges, alone on its cache lines.
+struct ip_metrics_vertex_ranking_t
+{
+	/// The number of vertices ranked.
+	_Alignas(IP_CACHE_LINE_SIZE) size_t size;
+	/// The vertices ranked, as a binary heap whose root processed the fewest edges.
+	struct ip_metrics_vertex_t vertices[IP_METRICS_SLOWEST_VERTEX_COUNT];
+};
+
+/// The slots in which threads write, two per thread: one set for even supersteps, one for odd supersteps.
+struct ip_thread_metrics_t* ip_all_thread_metrics = NULL;
+/// The slot in which the calling thread writes for the current superstep.
+struct ip_thread_metrics_t* ip_my_thread_metrics = NULL;
+#pragma omp threadprivate(ip_my_thread_metrics)
+/// The vertex rankings of all threads, one per thread.
+struct ip_metrics_vertex_ranking_t* ip_all_vertex_rankings = NULL;
+/// The vertex ranking of the calling thread.
+struct ip_metrics_vertex_ranking_t* ip_my_vertex_ranking = NULL;
+#pragma omp threadprivate(ip_my_vertex_ranking)
+/// The supersteps kept in the ring buffer.
+struct ip_superstep_metrics_t* ip_all_superstep_metrics = NULL;
+/// The thread slots of the supersteps kept in the ring buffer, ip_thread_count per superstep.
+struct ip_thread_metrics_t* ip_all_superstep_thread_metrics = NULL;
+/// The position of the oldest superstep in the ring buffer.
+size_t ip_metrics_first = 0;
+/// The number of supersteps in the ring buffer.
+size_t ip_metrics_count = 0;
+/// The number of supersteps overwritten because the ring buffer was full.
+size_t ip_metrics_dropped = 0;
+/// The number of ip_run() calls started.
+size_t ip_metrics_run_count = 0;
+/// Whether a superstep has ended but its thread slots are not copied yet.
+bool ip_metrics_pending = false;
+/// The superstep whose thread slots are not copied yet.
+struct ip_superstep_metrics_t ip_metrics_pending_superstep;
+/// The superstep with the largest imbalance factor so far, kept in the ring buffer or not.
+struct ip_superstep_metrics_t ip_metrics_most_imbalanced_superstep;
+
+/**
+ * @brief This function gives the set of thread slots of the superstep
+ * \p superstep.
+ * @param[in] superstep The superstep number.
+ * @return The slot of the first thread for that superstep.
+ **/
+struct ip_thread_metrics_t* ip_get_thread_metrics(size_t superstep)
+{
+	return &ip_all_thread_metrics[(superstep % 2) * ip_thread_count];
+}
+
+/**
+ * @brief This function allocates the thread slots and the ring buffer, the
+ * first time it is called, and clears the thread slots.
+ * @details It must be called at the start of ip_run(), before the parallel
+ * region.
+ **/
+void ip_start_metrics_run()
+{
+	if(ip_all_thread_metrics == NULL)
+	{
+		ip_all_thread_metrics = aligned_alloc(IP_CACHE_LINE_SIZE, sizeof(struct ip_thread_metrics_t) * 2 * ip_thread_count);
+		ip_all_superstep_thread_metrics = aligned_alloc(IP_CACHE_LINE_SIZE, sizeof(struct ip_thread_metrics_t) * IP_METRICS_RING_SIZE * ip_thread_count);
+		if(ip_all_thread_metrics == NULL || ip_all_superstep_thread_metrics == NULL)
+		{
+			printf("Failed to allocate the metrics of %d threads over %d supersteps.\n", ip_thread_count, IP_METRICS_RING_SIZE);
+			exit(-1);
+		}
+		ip_all_superstep_metrics = (struct ip_superstep_metrics_t*)ip_safe_malloc(sizeof(struct ip_superstep_metrics_t) * IP_METRICS_RING_SIZE);
+		// The rankings span all runs, so they are only cleared here.
+		ip_all_vertex_rankings = aligned_alloc(IP_CACHE_LINE_SIZE, sizeof(struct ip_metrics_vertex_ranking_t) * ip_thread_count);
+		if(ip_all_vertex_rankings == NULL)
+		{
+			printf("Failed to allocate the vertex rankings of %d threads.\n", ip_thread_count);
+			exit(-1);
+		}
+		memset(ip_all_vertex_rankings, 0, sizeof(struct ip_metrics_vertex_ranking_t) * ip_thread_count);
+	}
+	memset(ip_all_thread_metrics, 0, sizeof(struct ip_thread_metrics_t) * 2 * ip_thread_count);
+	ip_metrics_pending = false;
+	ip_metrics_run_count++;
+}
+
+/**
+ * @brief This function points the calling thread to its slot for the current
+ * superstep and starts timing its first phase.
+ * @details It must be called by every thread at the start of every superstep,
+ * before any thread can end it.
+ **/
+void ip_start_metrics_superstep()
+{
+	ip_my_thread_metrics = &ip_get_thread_metrics(ip_get_superstep())[omp_get_thread_num()];
+	ip_my_thread_metrics->phase_start = omp_get_wtime();
+	ip_my_vertex_ranking = &ip_all_vertex_rankings[omp_get_thread_num()];
+	#ifdef IP_ENABLE_HARDWARE_COUNTERS
+		ip_open_hardware_counters();
+		ip_my_thread_metrics->hardware_counter_mask = ip_my_hardware_counter_mask;
+		ip_read_hardware_counters(ip_my_thread_metrics->hardware_counters_start);
+	#endif // ifdef IP_ENABLE_HARDWARE_COUNTERS
+}
+
+/**
+ * @brief This function records that the calling thread starts waiting for the
+ * other threads, at a barrier or outside a single region.
+ **/
+void ip_start_metrics_wait()
+{
+	ip_my_thread_metrics->wait_start = omp_get_wtime();
+}
+
+/**
+ * @brief This function records that the calling thread is done waiting for the
+ * other threads.
+ * @details A wait still going on when a phase ends stops with it, so a phase
+ * ending with a barrier does not need to call this function.
+ **/
+void ip_stop_metrics_wait()
+{
+	if(ip_my_thread_metrics->wait_start > 0.0)
+	{
+		ip_my_thread_metrics->phase_wait_duration += omp_get_wtime() - ip_my_thread_metrics->wait_start;
+		ip_my_thread_metrics->wait_start = 0.0;
+	}
+}
+
+/**
+ * @brief This function adds the time elapsed since the end of the previous
+ * phase, or the start of the superstep, to the phase \p phase.
+ * @details The time spent waiting for the other threads in that phase is also
+ * added to the waiting time of the thread, and the rest to its working time.
+ * @param[in] phase The phase that just ended.
+ **/
+void ip_stop_metrics_phase(enum ip_metrics_phase_t phase)
+{
+	ip_stop_metrics_wait();
+	double now = omp_get_wtime();
+	ip_my_thread_metrics->phase_durations[phase] += now - ip_my_thread_metrics->phase_start;
+	ip_my_thread_metrics->busy_duration += now - ip_my_thread_metrics->phase_start - ip_my_thread_metrics->phase_wait_duration;
+	ip_my_thread_metrics->wait_duration += ip_my_thread_metrics->phase_wait_duration;
+	ip_my_thread_metrics->phase_wait_duration = 0.0;
+	ip_my_thread_metrics->phase_start = now;
+	#ifdef IP_ENABLE_HARDWARE_COUNTERS
+		uint64_t counters[IP_HARDWARE_COUNTER_COUNT];
+		memcpy(counters, ip_my_thread_metrics->hardware_counters_start, sizeof(counters));
+		ip_read_hardware_counters(counters);
+		for(int i = 0; i < IP_HARDWARE_COUNTER_COUNT; i++)
+		{
+			ip_my_thread_metrics->phase_hardware_counters[phase][i] += counters[i] - ip_my_thread_metrics->hardware_counters_start[i];
+		}
+		memcpy(ip_my_thread_metrics->hardware_counters_start, counters, sizeof(counters));
+	#endif // ifdef IP_ENABLE_HARDWARE_COUNTERS
+}
+
+/**
+ * @brief This function ranks the vertex \p v among the vertices of the calling
+ * thread that processed the most edges in a phase.
+ * @param[in] v The vertex.
+ * @param[in] edge_count The number of edges \p v processed.
+ * @param[in] phase The phase in which \p v processed them.
+ **/
+void ip_rank_metrics_vertex(struct ip_vertex_t* v, size_t edge_count, enum ip_metrics_phase_t phase)
+{
+	struct ip_metrics_vertex_ranking_t* ranking = ip_my_vertex_ranking;
+	if(edge_count == 0 || (ranking->size == IP_METRICS_SLOWEST_VERTEX_COUNT && edge_count <= ranking->vertices[0].edge_count))
+	{
+		return;
+	}
+
+	// A vertex keeps a single entry, holding the most edges it processed at once.
+	IP_VERTEX_ID_TYPE id = ip_get_vertex_id(v);
+	size_t i = 0;
+	while(i < ranking->size && ranking->vertices[i].id != id)
+	{
+		i++;
+	}
+	if(i < ranking->size && edge_count <= ranking->vertices[i].edge_count)
+	{
+		return;
+	}
+
+	if(i == ranking->size && ranking->size < IP_METRICS_SLOWEST_VERTEX_COUNT)
+	{
+		// The vertex is added as a leaf and moves up past the vertices that processed more edges.
+		ranking->size++;
+		while(i > 0 && ranking->vertices[(i - 1) / 2].edge_count > edge_count)
+		{
+			ranking->vertices[i] = ranking->vertices[(i - 1) / 2];
+			i = (i - 1) / 2;
+		}
+	}
+	else
+	{
+		// The vertex replaces its own entry, or the root if it has none, and moves down past the vertices that processed fewer edges.
+		if(i == ranking->size)
+		{
+			i = 0;
+		}
+		while(2 * i + 1 < ranking->size)
+		{
+			size_t child = 2 * i + 1;
+			if(child + 1 < ranking->size && ranking->vertices[child + 1].edge_count < ranking->vertices[child].edge_count)
+			{
+				child++;
+			}
+			if(ranking->vertices[child].edge_count >= edge_count)
+			{
+				break;
+			}
+			ranking->vertices[i] = ranking->vertices[child];
+			i = child;
+		}
+	}
+	ranking->vertices[i].id = id;
+	ranking->vertices[i].run = ip_metrics_run_count - 1;
+	ranking->vertices[i].superstep = ip_get_superstep();
+	ranking->vertices[i].phase = phase;
+	ranking->vertices[i].edge_count = edge_count;
+}
+
+/**
+ * @brief This function counts the vertex \p v, which the calling thread just
+ * computed, and ranks it by the edges it traversed meanwhile.
+ * @param[in] v The vertex computed.
+ **/
+void ip_record_metrics_vertex(struct ip_vertex_t* v)
+{
+	ip_my_thread_metrics->vertex_count++;
+	ip_rank_metrics_vertex(v, ip_my_thread_metrics->edge_count - ip_my_thread_metrics->edge_count_at_last_vertex, IP_METRICS_COMPUTE);
+	ip_my_thread_metrics->edge_count_at_last_vertex = ip_my_thread_metrics->edge_count;
+}
+
+/**
+ * @brief This function counts the edges through which the vertex \p v fetched
+ * the messages broadcast to it, and ranks it by them.
+ * @param[in] v The vertex that fetched messages.
+ * @param[in] edge_count The number of edges \p v went through.
+ **/
+void ip_record_metrics_fetch(struct ip_vertex_t* v, size_t edge_count)
+{
+	ip_my_thread_metrics->edge_count += edge_count;
+	ip_my_thread_metrics->edge_count_at_last_vertex += edge_count;
+	ip_rank_metrics_vertex(v, edge_count, IP_METRICS_FETCH);
+}
+
+/**
+ * @brief This function gives the longest working time of a thread over the
+ * mean working time of all threads.
+ * @param[in] slots The thread slots of a superstep.
+ * @return The imbalance factor, 1 if no thread worked.
+ **/
+double ip_get_metrics_imbalance_factor(const struct ip_thread_metrics_t* slots)
+{
+	double longest = 0.0;
+	double total = 0.0;
+	for(int i = 0; i < ip_thread_count; i++)
+	{
+		total += slots[i].busy_duration;
+		if(slots[i].busy_duration > longest)
+		{
+			longest = slots[i].busy_duration;
+		}
+	}
+	return total > 0.0 ? longest * ip_thread_count / total : 1.0;
+}
+
+/**
+ * @brief This function copies the pending superstep and its thread slots into
+ * the ring buffer, then clears these slots for the superstep after next.
+ **/
+void ip_commit_pending_metrics()
+{
+	if(!ip_metrics_pending)
+	{
+		return;
+	}
+
+	size_t position = (ip_metrics_first + ip_metrics_count) % IP_METRICS_RING_SIZE;
+	if(ip_metrics_count == IP_METRICS_RING_SIZE)
+	{
+		ip_metrics_first = (ip_metrics_first + 1) % IP_METRICS_RING_SIZE;
+		ip_metrics_dropped++;
+	}
+	else
+	{
+		ip_metrics_count++;
+	}
+	struct ip_thread_metrics_t* slots = ip_get_thread_metrics(ip_metrics_pending_superstep.superstep);
+	ip_metrics_pending_superstep.imbalance_factor = ip_get_metrics_imbalance_factor(slots);
+	if(ip_metrics_pending_superstep.imbalance_factor > ip_metrics_most_imbalanced_superstep.imbalance_factor)
+	{
+		ip_metrics_most_imbalanced_superstep = ip_metrics_pending_superstep;
+	}
+	ip_all_superstep_metrics[position] = ip_metrics_pending_superstep;
+	memcpy(&ip_all_superstep_thread_metrics[position * ip_thread_count], slots, sizeof(struct ip_thread_metrics_t) * ip_thread_count);
+	memset(slots, 0, sizeof(struct ip_thread_metrics_t) * ip_thread_count);
+	ip_metrics_pending = false;
+}
+
+/**
+ * @brief This function records the end of the current superstep.
+ * @details It must be called by a single thread, before the superstep number
+ * is incremented, and once every thread is done with the previous superstep.
+ * The superstep is only copied into the ring buffer at the end of the next
+ * one, or of the run, when no thread writes in its slots anymore.
+ * @param[in] duration The duration of the superstep, in seconds.
+ * @param[in] active_vertices The number of vertices active at the end of the
+ * superstep.
+ **/
+void ip_end_metrics_superstep(double duration, size_t active_vertices)
+{
+	ip_commit_pending_metrics();
+	ip_metrics_pending_superstep.run = ip_metrics_run_count - 1;
+	ip_metrics_pending_superstep.superstep = ip_get_superstep();
+	ip_metrics_pending_superstep.duration = duration;
+	ip_metrics_pending_superstep.active_vertices = active_vertices;
+	ip_metrics_pending = true;
+}
+
+/**
+ * @brief This function writes the metrics of a thread as a JSON object.
+ * @param[out] f The file to write into.
+ * @param[in] m The metrics of the thread.
+ **/
+void ip_write_thread_metrics_json(FILE* f, const struct ip_thread_metrics_t* m)
+{
+	fprintf(f, "{");
+	for(int i = 0; i < IP_METRICS_PHASE_COUNT; i++)
+	{
+		fprintf(f, "\"%s\": %.9f, ", ip_metrics_phase_names[i], m->phase_durations[i]);
+	}
+	fprintf(f, "\"busy\": %.9f, \"wait\": %.9f, ", m->busy_duration, m->wait_duration);
+	fprintf(f, "\"vertices\": %zu, \"messages\": %zu, \"edges\": %zu", m->vertex_count, m->message_count, m->edge_count);
+	#ifdef IP_ENABLE_HARDWARE_COUNTERS
+		fprintf(f, ", \"hardware_counters\": {");
+		for(int i = 0; i < IP_METRICS_PHASE_COUNT; i++)
+		{
+			fprintf(f, "%s\"%s\": {", i == 0 ? "" : ", ", ip_metrics_phase_names[i]);
+			for(int j = 0; j < IP_HARDWARE_COUNTER_COUNT; j++)
+			{
+				fprintf(f, "%s\"%s\": ", j == 0 ? "" : ", ", ip_hardware_counter_names[j]);
+				if(m->hardware_counter_mask & (1u << j))
+				{
+					fprintf(f, "%" PRIu64, m->phase_hardware_counters[i][j]);
+				}
+				else
+				{
+					fprintf(f, "null");
+				}
+			}
+			fprintf(f, "}");
+		}
+		fprintf(f, "}");
+	#endif // ifdef IP_ENABLE_HARDWARE_COUNTERS
+	fprintf(f, "}");
+}
+
+/**
+ * @brief This function writes the metrics of a thread as the end of a CSV
+ * line.
+ * @param[out] f The file to write into.
+ * @param[in] m The metrics of the thread.
+ **/
+void ip_write_thread_metrics_csv(FILE* f, const struct ip_thread_metrics_t* m)
+{
+	for(int i = 0; i < IP_METRICS_PHASE_COUNT; i++)
+	{
+		fprintf(f, ",%.9f", m->phase_durations[i]);
+	}
+	fprintf(f, ",%.9f,%.9f", m->busy_duration, m->wait_duration);
+	fprintf(f, ",%zu,%zu,%zu", m->vertex_count, m->message_count, m->edge_count);
+	#ifdef IP_ENABLE_HARDWARE_COUNTERS
+		// Counters the thread could not open are left empty.
+		for(int i = 0; i < IP_METRICS_PHASE_COUNT; i++)
+		{
+			for(int j = 0; j < IP_HARDWARE_COUNTER_COUNT; j++)
+			{
+				if(m->hardware_counter_mask & (1u << j))
+				{
+					fprintf(f, ",%" PRIu64, m->phase_hardware_counters[i][j]);
+				}
+				else
+				{
+					fprintf(f, ",");
+				}
+			}
+		}
+	#endif // ifdef IP_ENABLE_HARDWARE_COUNTERS
+	fprintf(f, "\n");
+}
+
+/**
+ * @brief This function orders two ranked vertices by decreasing number of
+ * edges processed, as qsort expects.
+ * @param[in] a The first vertex.
+ * @param[in] b The second vertex.
+ * @return A negative value if \p a processed more edges than \p b, a positive
+ * value if it processed fewer, 0 otherwise.
+ **/
+int ip_compare_metrics_vertices(const void* a, const void* b)
+{
+	size_t a_edge_count = ((const struct ip_metrics_vertex_t*)a)->edge_count;
+	size_t b_edge_count = ((const struct ip_metrics_vertex_t*)b)->edge_count;
+	return (a_edge_count < b_edge_count) - (a_edge_count > b_edge_count);
+}
+
+/**
+ * @brief This function merges the vertex rankings of all threads.
+ * @param[out] vertices The vertices that processed the most edges, once each,
+ * from the most; it must hold IP_METRICS_SLOWEST_VERTEX_COUNT vertices.
+ * @return The number of vertices written in \p vertices.
+ **/
+size_t ip_get_slowest_metrics_vertices(struct ip_metrics_vertex_t* vertices)
+{
+	size_t total = 0;
+	for(int i = 0; i < ip_thread_count; i++)
+	{
+		total += ip_all_vertex_rankings[i].size;
+	}
+	struct ip_metrics_vertex_t* all_vertices = (struct ip_metrics_vertex_t*)ip_safe_malloc(sizeof(struct ip_metrics_vertex_t) * (total + 1));
+	size_t count = 0;
+	for(int i = 0; i < ip_thread_count; i++)
+	{
+		memcpy(&all_vertices[count], ip_all_vertex_rankings[i].vertices, sizeof(struct ip_metrics_vertex_t) * ip_all_vertex_rankings[i].size);
+		count += ip_all_vertex_rankings[i].size;
+	}
+	qsort(all_vertices, count, sizeof(struct ip_metrics_vertex_t), ip_compare_metrics_vertices);
+
+	// A vertex may be ranked by several threads; only its first, largest, entry is kept.
+	size_t unique_count = 0;
+	for(size_t i = 0; i < count && unique_count < IP_METRICS_SLOWEST_VERTEX_COUNT; i++)
+	{
+		size_t j = 0;
+		while(j < unique_count && vertices[j].id != all_vertices[i].id)
+		{
+			j++;
+		}
+		if(j == unique_count)
+		{
+			vertices[unique_count] = all_vertices[i];
+			unique_count++;
+		}
+	}
+	ip_safe_free(all_vertices);
+	return unique_count;
+}
+
+/**
+ * @brief This function writes the supersteps kept in the ring buffer in the
+ * file named by the environment variable IP_METRICS_PATH, if set.
+ * @details The file is overwritten at the end of every ip_run(), so it holds
+ * the supersteps of all runs so far, within the capacity of the ring buffer.
+ * A file that cannot be open is reported but does not stop the program.
+ **/
+void ip_write_metrics()
+{
+	const char* path = getenv("IP_METRICS_PATH");
+	if(path == NULL || path[0] == '\0')
+	{
+		return;
+	}
+	FILE* f = fopen(path, "w");
+	if(f == NULL)
+	{
+		printf("MetricsFailed:cannot open \"%s\"\n", path);
+		return;
+	}
+
+	size_t path_length = strlen(path);
+	bool json = path_length >= 5 && strcmp(path + path_length - 5, ".json") == 0;
+	if(json)
+	{
+		fprintf(f, "{\n\t\"application\": \"%s\",\n\t\"engine\": \"%s\",\n\t\"threads\": %d,\n\t\"dropped_supersteps\": %zu,\n\t\"supersteps\": [", IP_APPLICATION, IP_ENGINE_NAME, ip_thread_count, ip_metrics_dropped);
+	}
+	else
+	{
+		fprintf(f, "run,superstep,duration,active_vertices,imbalance_factor,thread");
+		for(int i = 0; i < IP_METRICS_PHASE_COUNT; i++)
+		{
+			fprintf(f, ",%s", ip_metrics_phase_names[i]);
+		}
+		fprintf(f, ",busy,wait,vertices,messages,edges");
+		#ifdef IP_ENABLE_HARDWARE_COUNTERS
+			for(int i = 0; i < IP_METRICS_PHASE_COUNT; i++)
+			{
+				for(int j = 0; j < IP_HARDWARE_COUNTER_COUNT; j++)
+				{
+					fprintf(f, ",%s_%s", ip_metrics_phase_names[i], ip_hardware_counter_names[j]);
+				}
+			}
+		#endif // ifdef IP_ENABLE_HARDWARE_COUNTERS
+		fprintf(f, "\n");
+	}
+	for(size_t i = 0; i < ip_metrics_count; i++)
+	{
+		size_t position = (ip_metrics_first + i) % IP_METRICS_RING_SIZE;
+		const struct ip_superstep_metrics_t* s = &ip_all_superstep_metrics[position];
+		const struct ip_thread_metrics_t* slots = &ip_all_superstep_thread_metrics[position * ip_thread_count];
+		if(json)
+		{
+			fprintf(f, "%s\n\t\t{\"run\": %zu, \"superstep\": %zu, \"duration\": %.9f, \"active_vertices\": %zu, \"imbalance_factor\": %.6f, \"threads\": [", i == 0 ? "" : ",", s->run, s->superstep, s->duration, s->active_vertices, s->imbalance_factor);
+			for(int j = 0; j < ip_thread_count; j++)
+			{
+				fprintf(f, "%s\n\t\t\t", j == 0 ? "" : ",");
+				ip_write_thread_metrics_json(f, &slots[j]);
+			}
+			fprintf(f, "\n\t\t]}");
+		}
+		else
+		{
+			for(int j = 0; j < ip_thread_count; j++)
+			{
+				fprintf(f, "%zu,%zu,%.9f,%zu,%.6f,%d", s->run, s->superstep, s->duration, s->active_vertices, s->imbalance_factor, j);
+				ip_write_thread_metrics_csv(f, &slots[j]);
+			}
+		}
+	}
+	if(json)
+	{
+		struct ip_metrics_vertex_t vertices[IP_METRICS_SLOWEST_VERTEX_COUNT];
+		size_t vertex_count = ip_get_slowest_metrics_vertices(vertices);
+		fprintf(f, "\n\t],\n\t\"slowest_vertices\": [");
+		for(size_t i = 0; i < vertex_count; i++)
+		{
+			fprintf(f, "%s\n\t\t{\"vertex\": %" PRIuMAX ", \"run\": %zu, \"superstep\": %zu, \"phase\": \"%s\", \"edges\": %zu}", i == 0 ? "" : ",", (uintmax_t)vertices[i].id, vertices[i].run, vertices[i].superstep, ip_metrics_phase_names[vertices[i].phase], vertices[i].edge_count);
+		}
+		fprintf(f, "\n\t]\n}\n");
+	}
+
+	if(fclose(f) != 0)
+	{
+		printf("MetricsFailed:cannot write \"%s\"\n", path);
+		return;
+	}
+	printf("MetricsFile:%s\n", path);
+	printf("MetricsSupersteps:%zu\n", ip_metrics_count);
+	printf("MetricsDroppedSupersteps:%zu\n", ip_metrics_dropped);
+}
+
+/**
+ * @brief This function prints the most imbalanced superstep so far and the
+ * vertices that processed the most edges.
+ **/
+void ip_report_metrics_imbalance()
+{
+	if(ip_metrics_most_imbalanced_superstep.imbalance_factor > 0.0)
+	{
+		printf("MetricsMaxImbalanceFactor:%f\n", ip_metrics_most_imbalanced_superstep.imbalance_factor);
+		printf("MetricsMaxImbalanceSuperstep:run=%zu,superstep=%zu\n", ip_metrics_most_imbalanced_superstep.run, ip_metrics_most_imbalanced_superstep.superstep);
+	}
+	struct ip_metrics_vertex_t vertices[IP_METRICS_SLOWEST_VERTEX_COUNT];
+	size_t vertex_count = ip_get_slowest_metrics_vertices(vertices);
+	for(size_t i = 0; i < vertex_count; i++)
+	{
+		printf("MetricsSlowestVertex%zu:vertex=%" PRIuMAX ",run=%zu,superstep=%zu,phase=%s,edges=%zu\n", i, (uintmax_t)vertices[i].id, vertices[i].run, vertices[i].superstep, ip_metrics_phase_names[vertices[i].phase], vertices[i].edge_count);
+	}
+}
+
+/**
+ * @brief This function copies the last superstep into the ring buffer, writes
+ * the metrics file and reports the imbalance.
+ * @details It must be called at the end of ip_run(), after the parallel
+ * region.
+ **/
+void ip_stop_metrics_run()
+{
+	ip_commit_pending_metrics();
+	ip_write_metrics();
+	ip_report_metrics_imbalance();
+}
+
+#endif // METRICS_H_INCLUDED
@@ -0,0 +1,211 @@
+/**
+ * @file send_cache.h
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This file implements the sender-side combining cache, enabled with
+ * IP_USE_SEND_CACHE in the versions that push messages.
+ * @details On graphs with locality, consecutive messages sent by a thread
+ * often go to the same few vertices. Each thread keeps a direct-mapped cache
+ * of IP_SEND_CACHE_SIZE destinations, indexed by the lowest bits of their
+ * identifier, in which messages to the same destination are combined without
+ * any atomic operation. A message reaches the actual mailbox of its
+ * destination only when it is evicted by a message to another destination
+ * mapped to the same entry, or when the cache is flushed at the end of the
+ * compute phase. Cached messages go through ip_send_message_to_mailbox, which
+ * each version defines. Messages to hubs, when IP_USE_HUB_MAILBOXES is
+ * defined, are not cached: they already avoid atomics, and flushing the cache
+ * must not write the private mailboxes of hubs while they are being reduced.
+ * This file must be included by the version postambles.
+ **/
+
+#ifndef SEND_CACHE_H_INCLUDED
+#define SEND_CACHE_H_INCLUDED
+
+#include <omp.h>
+
+/// The number of entries in the cache of each thread.
+#ifndef IP_SEND_CACHE_SIZE
+	#define IP_SEND_CACHE_SIZE 64
+#endif // ifndef IP_SEND_CACHE_SIZE
+
+#if IP_SEND_CACHE_SIZE <= 0 || (IP_SEND_CACHE_SIZE & (IP_SEND_CACHE_SIZE - 1)) != 0
+	#error "IP_SEND_CACHE_SIZE must be a power of 2."
+#endif
+
+/// This structure holds an entry of the sender-side cache.
+struct ip_send_cache_entry_t
+{
+	/// The identifier of the destination.
+	IP_VERTEX_ID_TYPE id;
+	/// Indicates whether the entry holds a message.
+	bool valid;
+	/// Contains the combination of the messages sent to the destination since the entry was filled.
+	IP_MESSAGE_TYPE message;
+};
+/// This structure holds the sender-side cache of a thread, alone on its cache lines.
+struct ip_send_cache_t
+{
+	/// The entries of the cache.
+	_Alignas(IP_CACHE_LINE_SIZE) struct ip_send_cache_entry_t* entries;
+	/// The number of valid entries, so that flushing an empty cache costs nothing.
+	size_t occupied;
+	#ifdef IP_ENABLE_THREAD_PROFILING
+		/// The number of messages combined into a valid entry.
+		size_t hit_count;
+		/// The number of messages stored in an entry that was empty or held another destination.
+		size_t miss_count;
+		/// The number of messages sent to a mailbox because their entry was needed by another destination.
+		size_t eviction_count;
+	#endif // ifdef IP_ENABLE_THREAD_PROFILING
+};
+/// The caches of all threads.
+struct ip_send_cache_t* ip_all_send_caches = NULL;
+
+/**
+ * @brief This function sends the message \p message to the mailbox of the
+ * vertex \p id, bypassing the sender-side cache.
+ * @details It is defined by each version that pushes messages.
+ * @param[in] id The identifier of the destination vertex.
+ * @param[in] message The message to send.
+ **/
+void ip_send_message_to_mailbox(IP_VERTEX_ID_TYPE id, IP_MESSAGE_TYPE message);
+
+/**
+ * @brief This function allocates the caches of all threads.
+ * @details Each thread allocates and initialises its own entries so that
+ * they are placed close to it.
+ * @pre The number of threads is known.
+ **/
+void ip_init_send_cache()
+{
+	ip_all_send_caches = (struct ip_send_cache_t*)aligned_alloc(IP_CACHE_LINE_SIZE, sizeof(struct ip_send_cache_t) * ip_thread_count);
+	if(ip_all_send_caches == NULL)
+	{
+		printf("Failed to allocate the send caches.\n");
+		exit(-1);
+	}
+	#pragma omp parallel default(none) shared(ip_all_send_caches)
+	{
+		struct ip_send_cache_t* cache = &ip_all_send_caches[omp_get_thread_num()];
+		cache->entries = (struct ip_send_cache_entry_t*)ip_safe_tagged_malloc(sizeof(struct ip_send_cache_entry_t) * IP_SEND_CACHE_SIZE, IP_MEMORY_MAILBOXES);
+		for(size_t i = 0; i < IP_SEND_CACHE_SIZE; i++)
+		{
+			cache->entries[i].valid = false;
+		}
+		cache->occupied = 0;
+		#ifdef IP_ENABLE_THREAD_PROFILING
+			cache->hit_count = 0;
+			cache->miss_count = 0;
+			cache->eviction_count = 0;
+		#endif // ifdef IP_ENABLE_THREAD_PROFILING
+	}
+	printf("\t- Send cache of %d entries per thread.\n", IP_SEND_CACHE_SIZE);
+}
+
+/**
+ * @brief This function stores the message \p message to the vertex \p id in
+ * the cache of the calling thread.
+ * @details If the entry of \p id holds a message to another destination, that
+ * message is evicted: the message passed takes its place, and \p id and \p
+ * message are overwritten with the evicted destination and message, which the
+ * caller must then send to the mailbox.
+ * @param[inout] id The identifier of the destination vertex.
+ * @param[inout] message The message to send.
+ * @retval true The message has been cached, there is nothing left to send.
+ * @retval false A message has been evicted and is now in \p id and \p
+ * message.
+ **/
+bool ip_cache_message(IP_VERTEX_ID_TYPE* id, IP_MESSAGE_TYPE* message)
+{
+	struct ip_send_cache_t* cache = &ip_all_send_caches[omp_get_thread_num()];
+	struct ip_send_cache_entry_t* entry = &cache->entries[*id & (IP_SEND_CACHE_SIZE - 1)];
+	if(!entry->valid)
+	{
+		entry->id = *id;
+		entry->message = *message;
+		entry->valid = true;
+		cache->occupied++;
+		#ifdef IP_ENABLE_THREAD_PROFILING
+			cache->miss_count++;
+		#endif // ifdef IP_ENABLE_THREAD_PROFILING
+		return true;
+	}
+
+	if(entry->id == *id)
+	{
+		ip_combine(&entry->message, *message);
+		#ifdef IP_ENABLE_THREAD_PROFILING
+			cache->hit_count++;
+		#endif // ifdef IP_ENABLE_THREAD_PROFILING
+		return true;
+	}
+
+	IP_VERTEX_ID_TYPE evicted_id = entry->id;
+	IP_MESSAGE_TYPE evicted_message = entry->message;
+	entry->id = *id;
+	entry->message = *message;
+	*id = evicted_id;
+	*message = evicted_message;
+	#ifdef IP_ENABLE_THREAD_PROFILING
+		cache->miss_count++;
+		cache->eviction_count++;
+	#endif // ifdef IP_ENABLE_THREAD_PROFILING
+	return false;
+}
+
+/**
+ * @brief This function sends every message held in the cache of the calling
+ * thread to the mailbox of its destination and empties the cache.
+ * @details It must be called by every thread at the end of the compute phase,
+ * before the mailboxes are read.
+ **/
+void ip_flush_send_cache()
+{
+	struct ip_send_cache_t* cache = &ip_all_send_caches[omp_get_thread_num()];
+	for(size_t i = 0; i < IP_SEND_CACHE_SIZE && cache->occupied > 0; i++)
+	{
+		if(cache->entries[i].valid)
+		{
+			cache->entries[i].valid = false;
+			cache->occupied--;
+			ip_send_message_to_mailbox(cache->entries[i].id, cache->entries[i].message);
+		}
+	}
+}
+
+#ifdef IP_ENABLE_THREAD_PROFILING
+/**
+ * @brief This function prints the number of cache hits, misses and evictions
+ * of every thread, followed by their totals and the hit rate.
+ **/
+void ip_report_send_cache_statistics()
+{
+	size_t hit_count = 0;
+	size_t miss_count = 0;
+	size_t eviction_count = 0;
+	for(int i = 0; i < ip_thread_count; i++)
+	{
+		printf("Thread %d: SendCacheHits:%zu SendCacheMisses:%zu SendCacheEvictions:%zu\n", i, ip_all_send_caches[i].hit_count, ip_all_send_caches[i].miss_count, ip_all_send_caches[i].eviction_count);
+		hit_count += ip_all_send_caches[i].hit_count;
+		miss_count += ip_all_send_caches[i].miss_count;
+		eviction_count += ip_all_send_caches[i].eviction_count;
+	}
+	printf("SendCacheHitCount:%zu\n", hit_count);
+	printf("SendCacheMissCount:%zu\n", miss_count);
+	printf("SendCacheEvictionCount:%zu\n", eviction_count);
+	printf("SendCacheHitRate:%f\n", (hit_count + miss_count) > 0 ? ((double)hit_count) / (hit_count + miss_count) : 0.0);
+}
+#endif // ifdef IP_ENABLE_THREAD_PROFILING
+
+#endif // SEND_CACHE_H_INCLUDED
@@ -0,0 +1,207 @@
+/**
+ * @file superstep_driver.h
+ * @copyright Copyright (C) 2019 Ludovic Capelli
+ * @par License
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ * @author Ludovic Capelli
+ * @brief This file contains the building blocks of the light superstep driver
+ * enabled with IP_USE_LIGHT_SUPERSTEP.
+ * @details When supersteps are short, as on high-diameter graphs where the
+ * frontier holds a handful of vertices for thousands of supersteps, the
+ * synchronisation between supersteps costs more than the supersteps
+ * themselves. This file provides:
+ * - a sense-reversing barrier, optionally hierarchical: threads are split in
+ * groups of IP_BARRIER_GROUP_SIZE (typically the number of cores per socket),
+ * each group synchronising on its own counter before its last thread arrives
+ * at the top-level counter.
+ * - a buffer for superstep statistics, so that they are printed once the
+ * computation is over instead of from within the superstep loop.
+ **/
+
+#ifndef SUPERSTEP_DRIVER_H_INCLUDED
+#define SUPERSTEP_DRIVER_H_INCLUDED
+
+#include <stdatomic.h>
+#include <sched.h>
+#include <omp.h>
+
+/// The number of threads per barrier group; 0 makes the barrier flat.
+#ifndef IP_BARRIER_GROUP_SIZE
+	#define IP_BARRIER_GROUP_SIZE 0
+#endif // ifndef IP_BARRIER_GROUP_SIZE
+/// The number of spins after which a thread waiting at a barrier yields, unless threads outnumber processors.
+#ifndef IP_BARRIER_SPIN_COUNT
+	#define IP_BARRIER_SPIN_COUNT 4096
+#endif // ifndef IP_BARRIER_SPIN_COUNT
+
+/// This structure holds a counter alone on its cache line.
+struct ip_barrier_counter_t
+{
+	/// The number of threads yet to arrive.
+	_Alignas(IP_CACHE_LINE_SIZE) atomic_int remaining;
+	/// The number of threads expected.
+	int expected;
+};
+/// This structure describes a sense-reversing barrier.
+struct ip_barrier_t
+{
+	/// The sense that waiting threads expect; it flips every time the barrier opens.
+	_Alignas(IP_CACHE_LINE_SIZE) atomic_bool sense;
+	/// The number of groups.
+	int group_count;
+	/// The number of threads per group.
+	int group_size;
+	/// The number of spins after which a waiting thread yields.
+	unsigned int spin_count;
+	/// The top-level counter, on which the last thread of each group arrives.
+	struct ip_barrier_counter_t top;
+	/// The counters of each group.
+	struct ip_barrier_counter_t* groups;
+};
+/// This structure holds the statistics of a superstep.
+struct ip_superstep_statistics_t
+{
+	/// The duration of the superstep, in seconds.
+	double duration;
+	/// The number of vertices active at the end of the superstep.
+	size_t active_vertices;
+};
+/// This structure holds the statistics buffered for all supersteps.
+struct ip_superstep_statistics_list_t
+{
+	/// The size of the memory buffer. It is used for reallocation purpose.
+	size_t max_size;
+	/// The number of supersteps recorded.
+	size_t size;
+	/// The statistics of each superstep recorded.
+	struct ip_superstep_statistics_t* data;
+};
+/// The statistics buffered since the last flush.
+struct ip_superstep_statistics_list_t ip_all_superstep_statistics = {0, 0, NULL};
+
+/**
+ * @brief This function initialises the barrier \p b for \p thread_count
+ * threads.
+ * @param[out] b The barrier to initialise.
+ * @param[in] thread_count The number of threads that will use the barrier.
+ * @pre \p thread_count >= 1
+ **/
+void ip_barrier_init(struct ip_barrier_t* b, int thread_count)
+{
+	b->group_size = (IP_BARRIER_GROUP_SIZE > 0 && IP_BARRIER_GROUP_SIZE < thread_count) ? IP_BARRIER_GROUP_SIZE : thread_count;
+	b->group_count = (thread_count + b->group_size - 1) / b->group_size;
+	b->groups = aligned_alloc(IP_CACHE_LINE_SIZE, sizeof(struct ip_barrier_counter_t) * b->group_count);
+	if(b->groups == NULL)
+	{
+		printf("Failed to allocate the barrier groups.\n");
+		exit(-1);
+	}
+	for(int i = 0; i < b->group_count; i++)
+	{
+		int first_thread = i * b->group_size;
+		b->groups[i].expected = (thread_count - first_thread < b->group_size) ? thread_count - first_thread : b->group_size;
+		atomic_init(&b->groups[i].remaining, b->groups[i].expected);
+	}
+	b->top.expected = b->group_count;
+	atomic_init(&b->top.remaining, b->top.expected);
+	atomic_init(&b->sense, false);
+	// With more threads than processors, the thread everybody waits for may need the core of a spinning thread.
+	b->spin_count = (thread_count > omp_get_num_procs()) ? 1 : IP_BARRIER_SPIN_COUNT;
+}
+
+/**
+ * @brief This function releases the memory held by the barrier \p b.
+ * @param[inout] b The barrier to destroy.
+ **/
+void ip_barrier_destroy(struct ip_barrier_t* b)
+{
+	free(b->groups);
+	b->groups = NULL;
+}
+
+/**
+ * @brief This function blocks the calling thread until all threads reach the
+ * barrier \p b.
+ * @details Every write made by a thread before the barrier is visible to all
+ * threads after the barrier.
+ * @param[inout] b The barrier to wait at.
+ * @param[in] thread_num The number of the calling thread, in [0;
+ * thread_count).
+ * @param[inout] local_sense The sense of the calling thread. It must be
+ * initialised to false before the first wait and left untouched between waits.
+ **/
+void ip_barrier_wait(struct ip_barrier_t* b, int thread_num, bool* local_sense)
+{
+	*local_sense = !*local_sense;
+	struct ip_barrier_counter_t* group = &b->groups[thread_num / b->group_size];
+	if(atomic_fetch_sub_explicit(&group->remaining, 1, memory_order_acq_rel) == 1)
+	{
+		// Last of its group; nobody else from that group can arrive again before the barrier opens.
+		atomic_store_explicit(&group->remaining, group->expected, memory_order_relaxed);
+		if(atomic_fetch_sub_explicit(&b->top.remaining, 1, memory_order_acq_rel) == 1)
+		{
+			atomic_store_explicit(&b->top.remaining, b->top.expected, memory_order_relaxed);
+			atomic_store_explicit(&b->sense, *local_sense, memory_order_release);
+			return;
+		}
+	}
+
+	unsigned int spins = 0;
+	while(atomic_load_explicit(&b->sense, memory_order_acquire) != *local_sense)
+	{
+		if(++spins >= b->spin_count)
+		{
+			// Leave the core to other threads in case of oversubscription.
+			spins = 0;
+			sched_yield();
+		}
+		#if defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+		#endif
+	}
+}
+
+/**
+ * @brief This function buffers the statistics of a superstep.
+ * @param[in] duration The duration of the superstep, in seconds.
+ * @param[in] active_vertices The number of vertices active at the end of the
+ * superstep.
+ **/
+void ip_record_superstep_statistics(double duration, size_t active_vertices)
+{
+	if(ip_all_superstep_statistics.size == ip_all_superstep_statistics.max_size)
+	{
+		ip_all_superstep_statistics.max_size = (ip_all_superstep_statistics.max_size == 0) ? 1024 : ip_all_superstep_statistics.max_size * 2;
+		ip_all_superstep_statistics.data = ip_safe_realloc(ip_all_superstep_statistics.data, sizeof(struct ip_superstep_statistics_t) * ip_all_superstep_statistics.max_size);
+	}
+	ip_all_superstep_statistics.data[ip_all_superstep_statistics.size].duration = duration;
+	ip_all_superstep_statistics.data[ip_all_superstep_statistics.size].active_vertices = active_vertices;
+	ip_all_superstep_statistics.size++;
+}
+
+/**
+ * @brief This function prints the statistics buffered, in the same format as
+ * the one used when they are printed straight away, and empties the buffer.
+ * @param[in] first_superstep The superstep number of the first statistics
+ * buffered.
+ **/
+void ip_flush_superstep_statistics(size_t first_superstep)
+{
+	for(size_t i = 0; i < ip_all_superstep_statistics.size; i++)
+	{
+		printf("Superstep%zuDuration:%f\n", first_superstep + i, ip_all_superstep_statistics.data[i].duration);
+		printf("Superstep%zuActiveVertexCount:%zu\n", first_superstep + i, ip_all_superstep_statistics.data[i].active_vertices);
+	}
+	ip_all_superstep_statistics.size = 0;
+}
+
+#endif // SUPERSTEP_DRIVER_H_INCLUDED